@@ -0,0 +1,276 @@
+/**
+ * @file decim_bench.c
+ * @brief Throughput and anti-aliasing of the decimation stage.
+ *
+ * Feeds a 1 kHz 3-axis acceleration stream through the decimation stage in batches like the dispatcher does, and
+ * reports:
+ * - The throughput of the stage in input samples per second on one core, for CIC and FIR filters of several factors
+ *   and lengths.
+ * - The throughput of the FIR dot product and the CIC kernels built for this target against their scalar versions,
+ *   and the largest difference between their results.
+ * - How much a tone in the passband and a vibration which aliases into the decimated band are attenuated by each
+ *   filter, against simply keeping one sample out of every `factor`.
+ */
+#include "drivers/sensor_api.h"
+#include "pipeline/pipeline.h"
+#include "stages/stages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The rate of the input stream in Hz. */
+#define INPUT_RATE 1000
+
+/** The number of input samples per throughput run. */
+#define THROUGHPUT_SAMPLES 2000000
+
+/** The number of input samples per attenuation run. */
+#define TONE_SAMPLES 20000
+
+/** The number of decimated samples ignored at the start of an attenuation run, while the filter settles. */
+#define TONE_SETTLE 100
+
+/** The number of calls per kernel run. */
+#define KERNEL_CALLS 2000000
+
+/** The decimation factor of the attenuation runs. */
+#define TONE_FACTOR 10
+
+/** A frequency well inside the decimated band, in Hz. */
+#define PASS_FREQ 10.0
+
+/** A vibration frequency which aliases to 30 Hz once decimated to 100 Hz, in Hz. */
+#define ALIAS_FREQ 230.0
+
+/** The stage under test. */
+static stage_t stage;
+static decim_stage_ctx_t ctx;
+
+/** The input and output of the stage for one batch. */
+static sample_t batch[PIPELINE_BATCH_LEN];
+static sample_t output[STAGE_BATCH_LEN];
+
+/** The x axis of the decimated samples of an attenuation run. */
+static float decimated[TONE_SAMPLES];
+static size_t num_decimated;
+
+/** The windows and taps the kernels are run on. */
+static float window[2 * DECIM_MAX_TAPS];
+static float taps[DECIM_MAX_TAPS];
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Sets up a fresh stage which decimates the acceleration stream.
+ * @param filter The filter to use.
+ * @param factor The decimation factor.
+ * @param order The number of FIR taps or CIC stages, or 0 for the default.
+ * @return True if the stage accepted the rule, false otherwise.
+ */
+static bool setup(decim_filter_t filter, uint16_t factor, uint16_t order) {
+    decim_config_t config = {
+        .rules = {{.tag = TAG_LINEAR_ACCEL_REL, .filter = filter, .factor = factor, .order = order}},
+        .nrules = 1,
+    };
+    if (decim_stage_init(&stage, &ctx, &config) != EOK) return false;
+    stage.source = STAGE_SOURCE_BASE;
+    num_decimated = 0;
+    return true;
+}
+
+/**
+ * Runs a sum of sines on every axis through the stage and keeps the x axis of the decimated samples.
+ * @param n The number of input samples.
+ * @param freq The frequency of the sine in Hz, or 0 for random noise.
+ * @return The time spent in the stage in nanoseconds.
+ */
+static uint64_t run(size_t n, double freq) {
+    uint64_t elapsed = 0;
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < n; i += PIPELINE_BATCH_LEN) {
+        size_t len = n - i < PIPELINE_BATCH_LEN ? n - i : PIPELINE_BATCH_LEN;
+        for (size_t j = 0; j < len; j++) {
+            double t = (double)(i + j) / INPUT_RATE;
+            float value = freq > 0 ? (float)sin(2 * M_PI * freq * t) : (float)rand() / (float)RAND_MAX - 0.5f;
+            batch[j] = (sample_t){.time = (uint64_t)(i + j) * (1000000000 / INPUT_RATE), .source = 0, .prio = 1};
+            batch[j].msg.type = TAG_LINEAR_ACCEL_REL;
+            batch[j].msg.data.VEC3D = (vec3d_t){.x = value, .y = 9.81f + value, .z = -value};
+        }
+
+        stage_out_t out = {.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+        uint64_t start = now_ns();
+        stage.process(&stage, batch, len, &out);
+        elapsed += now_ns() - start;
+
+        for (size_t j = 0; j < out.len; j++) {
+            if (output[j].flags == SAMPLE_DECIMATED && num_decimated < TONE_SAMPLES) {
+                decimated[num_decimated++] = output[j].msg.data.VEC3D.x;
+            }
+        }
+    }
+    if (dropped > 0) fprintf(stderr, "The stage dropped %llu samples\n", (unsigned long long)dropped);
+    return elapsed;
+}
+
+/**
+ * Measures the amplitude of the sine left in a decimated signal, from its RMS once the filter settled.
+ * @param values The decimated signal.
+ * @param n The number of values.
+ * @return The amplitude of the sine.
+ */
+static double amplitude(const float *values, size_t n) {
+    double sum = 0;
+    for (size_t i = TONE_SETTLE; i < n; i++) {
+        sum += (double)values[i] * values[i];
+    }
+    return sqrt(2 * sum / (double)(n - TONE_SETTLE));
+}
+
+/**
+ * Prints the attenuation of a filter at the passband and aliasing frequencies.
+ * @param name The name of the filter.
+ * @param filter The filter, or -1 to keep one sample out of every factor without filtering.
+ * @param order The number of FIR taps or CIC stages, or 0 for the default.
+ */
+static void attenuation(const char *name, int filter, uint16_t order) {
+    double gains[2];
+    const double freqs[2] = {PASS_FREQ, ALIAS_FREQ};
+    for (int f = 0; f < 2; f++) {
+        if (filter < 0) {
+            num_decimated = 0;
+            for (size_t i = 0; i < TONE_SAMPLES; i += TONE_FACTOR) {
+                decimated[num_decimated++] = (float)sin(2 * M_PI * freqs[f] * (double)i / INPUT_RATE);
+            }
+        } else {
+            setup((decim_filter_t)filter, TONE_FACTOR, order);
+            run(TONE_SAMPLES, freqs[f]);
+        }
+        gains[f] = 20 * log10(amplitude(decimated, num_decimated));
+    }
+    printf("  %-16s %+7.2f dB at %3.0f Hz, %+7.1f dB at %3.0f Hz\n", name, gains[0], PASS_FREQ, gains[1],
+           ALIAS_FREQ);
+}
+
+/**
+ * Prints the throughput of the stage with a filter.
+ * @param filter The filter.
+ * @param factor The decimation factor.
+ * @param order The number of FIR taps or CIC stages, or 0 for the default.
+ */
+static void throughput(decim_filter_t filter, uint16_t factor, uint16_t order) {
+    if (!setup(filter, factor, order)) {
+        printf("  %s factor %u order %u rejected\n", filter == DECIM_FIR ? "FIR" : "CIC", factor, order);
+        return;
+    }
+    uint64_t elapsed = run(THROUGHPUT_SAMPLES, 0);
+    printf("  %s, factor %3u, %3u %-6s %6.1f ns/sample, %6.2f M samples/s\n", filter == DECIM_FIR ? "FIR" : "CIC",
+           factor, ctx.config.rules[0].order, filter == DECIM_FIR ? "taps:" : "stages:",
+           (double)elapsed / THROUGHPUT_SAMPLES, THROUGHPUT_SAMPLES / ((double)elapsed / 1e3));
+}
+
+/**
+ * Prints the throughput of the vectorized and scalar FIR dot products, and the largest difference between them.
+ * @param n The number of taps.
+ */
+static void dot_kernels(size_t n) {
+    volatile float sink = 0;
+    double max_diff = 0;
+    uint64_t elapsed[2];
+    for (int scalar = 0; scalar < 2; scalar++) {
+        uint64_t start = now_ns();
+        for (size_t i = 0; i < KERNEL_CALLS / n * 16; i++) {
+            const float *w = &window[i % DECIM_MAX_TAPS];
+            sink = scalar ? decim_dot_scalar(taps, w, n) : decim_dot(taps, w, n);
+        }
+        elapsed[scalar] = now_ns() - start;
+    }
+    for (size_t i = 0; i < DECIM_MAX_TAPS; i++) {
+        double diff = fabs((double)decim_dot(taps, &window[i], n) - (double)decim_dot_scalar(taps, &window[i], n));
+        if (diff > max_diff) max_diff = diff;
+    }
+    (void)sink;
+    double calls = (double)(KERNEL_CALLS / n * 16);
+    printf("  dot, %3zu taps: %-6s %6.1f ns, scalar %6.1f ns (%.1fx), largest difference %.2g\n", n, DECIM_KERNEL_ISA,
+           (double)elapsed[0] / calls, (double)elapsed[1] / calls, (double)elapsed[1] / (double)elapsed[0], max_diff);
+}
+
+/**
+ * Prints the throughput of the vectorized and scalar CIC kernels, and checks that they agree exactly.
+ * @param order The number of CIC stages.
+ * @return True if the kernels agree, false otherwise.
+ */
+static bool cic_kernels(uint8_t order) {
+    static decim_cic_lanes_t state[2][2][DECIM_CIC_MAX_ORDER];
+    uint64_t elapsed[2];
+    bool same = true;
+    memset(state, 0, sizeof(state));
+    for (int scalar = 0; scalar < 2; scalar++) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < KERNEL_CALLS; i++) {
+            decim_cic_lanes_t value = {i * 2654435761u, ~i, i << 40, 0};
+            if (scalar) {
+                decim_cic_integrate_scalar(state[1][0], order, value);
+            } else {
+                decim_cic_integrate(state[0][0], order, value);
+            }
+            if (i % 10 != 0) continue;
+            memcpy(value, state[scalar][0][order - 1], sizeof(value));
+            if (scalar) {
+                decim_cic_comb_scalar(state[1][1], order, value);
+            } else {
+                decim_cic_comb(state[0][1], order, value);
+            }
+        }
+        elapsed[scalar] = now_ns() - start;
+    }
+    same = memcmp(state[0], state[1], sizeof(state[0])) == 0;
+    printf("  CIC, %u stages: %-6s %5.1f ns, scalar %5.1f ns per sample (%.1fx), %s\n", order, DECIM_KERNEL_ISA,
+           (double)elapsed[0] / KERNEL_CALLS, (double)elapsed[1] / KERNEL_CALLS,
+           (double)elapsed[1] / (double)elapsed[0], same ? "identical" : "DIFFERENT");
+    return same;
+}
+
+int main(void) {
+    pipeline_init();
+    srand(1);
+    for (size_t i = 0; i < DECIM_MAX_TAPS; i++) {
+        taps[i] = (float)rand() / (float)RAND_MAX - 0.5f;
+        window[i] = window[i + DECIM_MAX_TAPS] = (float)rand() / (float)RAND_MAX - 0.5f;
+    }
+
+    printf("Stage throughput on 3-axis samples (%s kernels):\n", DECIM_KERNEL_ISA);
+    const uint16_t factors[] = {4, 10, 50};
+    for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++) {
+        throughput(DECIM_CIC, factors[i], 0);
+    }
+    for (size_t i = 0; i < sizeof(factors) / sizeof(factors[0]); i++) {
+        throughput(DECIM_FIR, factors[i], 0);
+    }
+    throughput(DECIM_FIR, 10, 256);
+    throughput(DECIM_FIR, 10, 512);
+
+    printf("Kernels:\n");
+    const size_t lengths[] = {32, 80, 256, 512};
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        dot_kernels(lengths[i]);
+    }
+    bool ok = cic_kernels(3) && cic_kernels(6);
+
+    printf("Gain from %d Hz to %d Hz:\n", INPUT_RATE, INPUT_RATE / TONE_FACTOR);
+    attenuation("no filter", -1, 0);
+    attenuation("CIC, 3 stages", DECIM_CIC, 3);
+    attenuation("CIC, 5 stages", DECIM_CIC, 5);
+    attenuation("FIR, 80 taps", DECIM_FIR, 80);
+    attenuation("FIR, 160 taps", DECIM_FIR, 160);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file engine_bench.c
+ * @brief CPU usage and wake-up jitter of the acquisition engine against a thread per sensor.
+ *
+ * Simulates the sensors of the flight computer, each read in a cycle of starting a conversion, waiting for it and
+ * fetching its result, with the conversion times of the real sensors. An I2C transfer is simulated by holding the bus
+ * (a mutex, since one bus serves every sensor) for the time the transfer would take. The sensors are read for a few
+ * seconds once with a thread per sensor sleeping through each conversion, like the collector threads, and once as tasks
+ * of the acquisition engine, and for each the benchmark reports:
+ * - The CPU time used per second of reading, and per conversion.
+ * - The number of readings of each sensor per second.
+ * - How late the result of each conversion was fetched after it was ready, including any wait for the bus: the mean,
+ *   99th percentile and maximum.
+ */
+#include "collectors/engine.h"
+#include "pipeline/pipeline.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** How long each mode reads the sensors, in seconds. */
+#define RUN_SECS 5
+
+/** The number of nanoseconds in a microsecond. */
+#define NS_PER_US 1000ULL
+
+/** The width of a bin of the lateness histograms, in nanoseconds. */
+#define BIN_NS 10000
+
+/** The number of bins of the lateness histograms. Later wake-ups go in the last bin. */
+#define NUM_BINS 1000
+
+/** A simulated sensor. */
+typedef struct {
+    const char *name;    /**< The name of the sensor. */
+    uint8_t conversions; /**< The number of conversions per reading. */
+    uint32_t wait_us;    /**< How long a conversion takes, in microseconds. */
+    uint32_t transfer_us;  /**< How long each transfer holds the bus, in microseconds. */
+} sim_sensor_t;
+
+/** The simulated sensors, with the waits of the real collectors and the time their transfers take at 400 kHz. */
+static const sim_sensor_t SENSORS[] = {
+    {.name = "MS5611", .conversions = 2, .wait_us = 10000, .transfer_us = 100},
+    {.name = "SHT41", .conversions = 1, .wait_us = 8300, .transfer_us = 200},
+    {.name = "LSM6DSO32", .conversions = 1, .wait_us = 10000, .transfer_us = 1000},
+    {.name = "PAC1952-2", .conversions = 1, .wait_us = 1000, .transfer_us = 150},
+    {.name = "SYSCLOCK", .conversions = 1, .wait_us = 10000, .transfer_us = 0},
+};
+
+/** The number of simulated sensors. */
+#define NUM_SENSORS (sizeof(SENSORS) / sizeof(SENSORS[0]))
+
+/** What reading a sensor measured. */
+typedef struct {
+    uint64_t readings; /**< The number of readings. */
+    uint64_t wakeups;  /**< The number of waits for a conversion. */
+    uint64_t late_sum; /**< The sum of how late the waits ended, in nanoseconds. */
+    uint64_t late_max; /**< The latest a wait ended, in nanoseconds. */
+    uint32_t histogram[NUM_BINS]; /**< How many waits ended how late. */
+} sim_result_t;
+
+/** The state of a simulated sensor. */
+typedef struct {
+    const sim_sensor_t *sensor; /**< The sensor. */
+    task_t task;                /**< The sensor's task when run by the engine. */
+    uint8_t conversion;         /**< The conversion in progress. */
+    bool converting;            /**< Whether a conversion is in progress. */
+    sim_result_t result;        /**< What reading the sensor measured. */
+} sim_state_t;
+
+/** The simulated sensors. */
+static sim_state_t states[NUM_SENSORS];
+
+/** The simulated I2C bus. */
+static pthread_mutex_t bus = PTHREAD_MUTEX_INITIALIZER;
+
+/** Whether the collector threads should stop. */
+static atomic_bool stop;
+
+/** When the engine's tasks should stop, on the pipeline's clock. */
+static uint64_t end;
+
+/**
+ * Sleeps for a number of nanoseconds.
+ * @param ns The time to sleep.
+ */
+static void sleep_ns(uint64_t ns) {
+    struct timespec duration = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+    while (nanosleep(&duration, &duration) == -1 && errno == EINTR) {
+    }
+}
+
+/**
+ * Records how late a wait for a conversion ended.
+ * @param result The results of the sensor.
+ * @param late How late the wait ended, in nanoseconds.
+ */
+static void record_wakeup(sim_result_t *result, uint64_t late) {
+    result->wakeups++;
+    result->late_sum += late;
+    if (late > result->late_max) result->late_max = late;
+    uint64_t bin = late / BIN_NS;
+    result->histogram[bin < NUM_BINS ? bin : NUM_BINS - 1]++;
+}
+
+/**
+ * Simulates an I2C transfer with a sensor.
+ * @param state The state of the sensor.
+ * @param due When the transfer was due if it fetches the result of a conversion, which records how late it started.
+ * Zero for a transfer which starts a conversion.
+ */
+static void transfer(sim_state_t *state, uint64_t due) {
+    // The system clock is not on the bus
+    bool on_bus = state->sensor->transfer_us > 0;
+    if (on_bus) pthread_mutex_lock(&bus);
+    if (due != 0) record_wakeup(&state->result, pipeline_time() - due);
+    if (on_bus) {
+        sleep_ns(state->sensor->transfer_us * NS_PER_US);
+        pthread_mutex_unlock(&bus);
+    }
+}
+
+/**
+ * Reads a simulated sensor in a loop like a collector thread, sleeping through each conversion.
+ * @param arg The state of the sensor.
+ * @return NULL.
+ */
+static void *sim_thread(void *arg) {
+    sim_state_t *state = arg;
+    const sim_sensor_t *sensor = state->sensor;
+    while (!atomic_load(&stop)) {
+        for (uint8_t c = 0; c < sensor->conversions; c++) {
+            transfer(state, 0); // Start the conversion
+            uint64_t due = pipeline_time() + sensor->wait_us * NS_PER_US;
+            usleep(sensor->wait_us);
+            transfer(state, due); // Fetch its result
+        }
+        state->result.readings++;
+    }
+    return NULL;
+}
+
+/**
+ * Takes the next step of reading a simulated sensor as a task of the engine.
+ * @param task The task of the sensor.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE once the run is over.
+ */
+static uint64_t sim_step(task_t *task, uint64_t now) {
+    sim_state_t *state = task->ctx;
+    const sim_sensor_t *sensor = state->sensor;
+
+    if (state->converting) {
+        transfer(state, task->due); // Fetch the result of the conversion
+        if (++state->conversion == sensor->conversions) {
+            state->conversion = 0;
+            state->result.readings++;
+        }
+    }
+    if (now >= end) return TASK_DONE;
+
+    transfer(state, 0); // Start the next conversion
+    state->converting = true;
+    return now + sensor->wait_us * NS_PER_US;
+}
+
+/**
+ * Gets the CPU time used by the process.
+ * @return The CPU time in nanoseconds.
+ */
+static uint64_t cpu_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Finds a percentile of how late the waits of every sensor ended.
+ * @param percent The percentage of waits which ended at most that late.
+ * @return The upper edge of the histogram bin holding the percentile, in nanoseconds.
+ */
+static uint64_t percentile(uint64_t percent) {
+    uint64_t total = 0;
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        total += states[s].result.wakeups;
+    }
+    uint64_t count = 0;
+    for (size_t b = 0; b < NUM_BINS; b++) {
+        for (size_t s = 0; s < NUM_SENSORS; s++) {
+            count += states[s].result.histogram[b];
+        }
+        if (count * 100 >= percent * total) return (b + 1) * BIN_NS;
+    }
+    return NUM_BINS * BIN_NS;
+}
+
+/**
+ * Prints what a run measured.
+ * @param mode The name of the mode the sensors were read in.
+ * @param cpu The CPU time used during the run, in nanoseconds.
+ * @param wall The duration of the run, in nanoseconds.
+ */
+static void print_results(const char *mode, uint64_t cpu, uint64_t wall) {
+    uint64_t wakeups = 0;
+    uint64_t late_sum = 0;
+    uint64_t late_max = 0;
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        wakeups += states[s].result.wakeups;
+    }
+    printf("%s: %.2f ms of CPU per second, %.1f us per conversion\n", mode, (double)cpu / (double)wall * 1000,
+           (double)cpu / 1000 / (double)wakeups);
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        const sim_result_t *result = &states[s].result;
+        printf("  %-10s %6.1f readings/s, %5.1f us late on average, %6.1f us at most\n", SENSORS[s].name,
+               (double)result->readings * 1000000000 / (double)wall,
+               (double)result->late_sum / 1000 / (double)result->wakeups, (double)result->late_max / 1000);
+        late_sum += result->late_sum;
+        if (result->late_max > late_max) late_max = result->late_max;
+    }
+    printf("  all        %llu wake-ups, %5.1f us late on average, 99%% within %llu us, %6.1f us at most\n",
+           (unsigned long long)wakeups, (double)late_sum / 1000 / (double)wakeups,
+           (unsigned long long)(percentile(99) / 1000), (double)late_max / 1000);
+}
+
+/**
+ * Resets the simulated sensors.
+ */
+static void reset_sensors(void) {
+    memset(states, 0, sizeof(states));
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        states[s].sensor = &SENSORS[s];
+    }
+}
+
+int main(void) {
+    pipeline_init();
+    printf("Reading %zu simulated sensors for %d s in each mode\n", NUM_SENSORS, RUN_SECS);
+
+    // A thread per sensor
+    reset_sensors();
+    pthread_t threads[NUM_SENSORS];
+    atomic_store(&stop, false);
+    uint64_t cpu = cpu_ns();
+    uint64_t start = pipeline_time();
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        pthread_create(&threads[s], NULL, sim_thread, &states[s]);
+    }
+    sleep_ns(RUN_SECS * 1000000000ULL);
+    atomic_store(&stop, true);
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        pthread_join(threads[s], NULL);
+    }
+    print_results("threads", cpu_ns() - cpu, pipeline_time() - start);
+
+    // Every sensor on one thread
+    reset_sensors();
+    engine_init();
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        states[s].task = (task_t){.name = SENSORS[s].name, .ctx = &states[s], .step = sim_step};
+        engine_add(&states[s].task);
+    }
+    cpu = cpu_ns();
+    start = pipeline_time();
+    end = start + RUN_SECS * 1000000000ULL;
+    engine_run();
+    print_results("loop", cpu_ns() - cpu, pipeline_time() - start);
+    return EXIT_SUCCESS;
+}
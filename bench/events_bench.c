@@ -0,0 +1,228 @@
+/**
+ * @file events_bench.c
+ * @brief Detection latency and cost of the flight event detection stage, on synthetic or recorded flights.
+ *
+ * Feeds flights through the fusion and event detection stages in batches like the dispatcher does, and reports the
+ * flight events they publish. Without arguments, the synthetic flights are simulated and every event is compared
+ * against the true time of launch, burnout and apogee, once with apogee detected from the fused vertical velocity and
+ * once from the barometric altitude alone. A flight must produce each event exactly once, and the pad flight none.
+ * Otherwise the given recording segments are replayed through the stages and the events they produce are listed:
+ *     ./bench/events_bench [segment.rec ...]
+ */
+#include "drivers/sensor_api.h"
+#include "flight_sim.h"
+#include "pipeline/pipeline.h"
+#include "recorder/recorder.h"
+#include "stages/stages.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The names of the flight events. */
+static const char *EVENT_NAMES[] = {
+    [EVENT_LAUNCH] = "launch",
+    [EVENT_BURNOUT] = "burnout",
+    [EVENT_APOGEE] = "apogee",
+};
+
+/** The simulated flight. */
+static sim_t sim;
+
+/** The stages the flights run through. */
+static stage_t fusion_stage;
+static fusion_stage_ctx_t fusion_ctx;
+static stage_t events_stage;
+static events_stage_ctx_t events_ctx;
+
+/** Whether the fusion stage runs before the event detection stage. */
+static bool fusion;
+
+/** The outputs of the stages for one batch. */
+static sample_t fused[STAGE_BATCH_LEN];
+static sample_t output[STAGE_BATCH_LEN];
+
+/** The samples read back from a recording. */
+static sample_t batch[PIPELINE_BATCH_LEN];
+
+/** Reads recorded segments. */
+static rec_reader_t reader;
+
+/** The events published by the stage. */
+static struct {
+    unsigned count;   /**< How many times the event was published. */
+    uint64_t time;    /**< The time of the first event sample. */
+    uint32_t latency; /**< The detection latency it reported, in microseconds. */
+} events[EVENT_APOGEE + 1];
+
+/** The number of event samples with an unknown event. */
+static unsigned unknown_events;
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Sets up fresh stages with their default settings.
+ * @param with_fusion Whether the fusion stage runs before the event detection stage.
+ */
+static void setup(bool with_fusion) {
+    fusion_config_t fusion_config = {
+        .axis = 2,
+        .accel_sd = FUSION_DEFAULT_ACCEL_SD,
+        .baro_sd = FUSION_DEFAULT_BARO_SD,
+        .bias_sd = FUSION_DEFAULT_BIAS_SD,
+    };
+    events_config_t events_config = {
+        .axis = 2,
+        .launch_accel = EVENTS_DEFAULT_LAUNCH_ACCEL,
+        .burnout_accel = EVENTS_DEFAULT_BURNOUT_ACCEL,
+        .hold_ms = EVENTS_DEFAULT_HOLD_MS,
+        .filter_ms = EVENTS_DEFAULT_FILTER_MS,
+        .apogee_vel = EVENTS_DEFAULT_APOGEE_VEL,
+        .apogee_drop = EVENTS_DEFAULT_APOGEE_DROP,
+    };
+    fusion = with_fusion;
+    fusion_stage_init(&fusion_stage, &fusion_ctx, &fusion_config);
+    fusion_stage.source = STAGE_SOURCE_BASE;
+    events_stage_init(&events_stage, &events_ctx, &events_config);
+    events_stage.source = STAGE_SOURCE_BASE + 1;
+    memset(events, 0, sizeof(events));
+    unknown_events = 0;
+}
+
+/**
+ * Runs a batch of samples through the stages and collects the events they publish.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @return The time spent in the stages in nanoseconds.
+ */
+static uint64_t run_batch(const sample_t *samples, size_t n) {
+    uint64_t dropped = 0;
+    stage_out_t out = {.samples = fused, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+    uint64_t start = now_ns();
+    if (fusion) {
+        fusion_stage.process(&fusion_stage, samples, n, &out);
+        samples = fused;
+        n = out.len;
+    }
+    out = (stage_out_t){.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+    events_stage.process(&events_stage, samples, n, &out);
+    uint64_t elapsed = now_ns() - start;
+
+    if (dropped > 0) fprintf(stderr, "The stages dropped %llu samples\n", (unsigned long long)dropped);
+    for (size_t i = 0; i < out.len; i++) {
+        if (output[i].msg.type != TAG_FLIGHT_EVENT || output[i].source != events_stage.source) continue;
+        uint8_t event = output[i].msg.id;
+        if (event < EVENT_LAUNCH || event > EVENT_APOGEE) {
+            unknown_events++;
+            continue;
+        }
+        if (events[event].count++ == 0) {
+            events[event].time = output[i].time;
+            events[event].latency = output[i].msg.data.U32;
+        }
+    }
+    return elapsed;
+}
+
+/**
+ * Runs the simulated flight through the stages and compares the events against the truth.
+ * @param flight The flight which was simulated.
+ * @param with_fusion Whether the fusion stage runs before the event detection stage.
+ * @return True if every expected event was published exactly once and nothing else, false otherwise.
+ */
+static bool run_flight(const sim_flight_t *flight, bool with_fusion) {
+    setup(with_fusion);
+    uint64_t elapsed = 0;
+    for (size_t i = 0; i < sim.num_samples; i += PIPELINE_BATCH_LEN) {
+        size_t n = sim.num_samples - i < PIPELINE_BATCH_LEN ? sim.num_samples - i : PIPELINE_BATCH_LEN;
+        elapsed += run_batch(&sim.samples[i], n);
+    }
+
+    bool launched = flight->thrust > 0;
+    size_t truth[EVENT_APOGEE + 1] = {
+        [EVENT_LAUNCH] = (size_t)SIM_PAD_SECS * SIM_IMU_RATE,
+        [EVENT_BURNOUT] = sim.burnout,
+        [EVENT_APOGEE] = sim.apogee,
+    };
+    bool ok = unknown_events == 0;
+    printf("%s (apogee from %s):\n", flight->name, with_fusion ? "fused velocity" : "barometer");
+    for (uint8_t event = EVENT_LAUNCH; event <= EVENT_APOGEE; event++) {
+        if (events[event].count == 0) {
+            printf("  %-7s %s\n", EVENT_NAMES[event], launched ? "MISSED" : "none");
+            ok = ok && !launched;
+            continue;
+        }
+        if (!launched) {
+            printf("  %-7s FALSE at %.3f s\n", EVENT_NAMES[event], (double)events[event].time / 1e9);
+            ok = false;
+            continue;
+        }
+        double actual = (double)truth[event] / SIM_IMU_RATE;
+        double detected = (double)events[event].time / 1e9;
+        double triggered = detected - (double)events[event].latency / 1e6;
+        printf("  %-7s at %7.3f s, triggered %+7.1f ms, detected %+7.1f ms later (reported latency %.1f ms)%s\n",
+               EVENT_NAMES[event], actual, (triggered - actual) * 1000, (detected - actual) * 1000,
+               (double)events[event].latency / 1000, events[event].count > 1 ? " REPEATED" : "");
+        ok = ok && events[event].count == 1;
+    }
+    printf("  cost: %.1f ns per input sample\n", (double)elapsed / (double)sim.num_samples);
+    return ok;
+}
+
+/**
+ * Replays recorded segments through the stages and lists the events they publish.
+ * @param paths The paths of the segments, in order.
+ * @param n The number of segments.
+ * @return True if every segment could be read, false otherwise.
+ */
+static bool replay_segments(char **paths, int n) {
+    setup(true);
+    size_t samples = 0;
+    uint64_t elapsed = 0;
+    for (int i = 0; i < n; i++) {
+        if (rec_reader_open(&reader, paths[i]) != EOK) {
+            fprintf(stderr, "Could not read segment '%s'\n", paths[i]);
+            return false;
+        }
+        size_t len;
+        while ((len = rec_reader_read(&reader, batch, PIPELINE_BATCH_LEN)) > 0) {
+            elapsed += run_batch(batch, len);
+            samples += len;
+        }
+        rec_reader_close(&reader);
+    }
+
+    printf("Replayed %zu samples\n", samples);
+    for (uint8_t event = EVENT_LAUNCH; event <= EVENT_APOGEE; event++) {
+        if (events[event].count == 0) {
+            printf("  %-7s none\n", EVENT_NAMES[event]);
+            continue;
+        }
+        printf("  %-7s detected at %.3f s, %.1f ms after its triggering sample\n", EVENT_NAMES[event],
+               (double)events[event].time / 1e9, (double)events[event].latency / 1000);
+    }
+    if (samples > 0) printf("  cost: %.1f ns per input sample\n", (double)elapsed / (double)samples);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    pipeline_init();
+    if (argc > 1) return replay_segments(&argv[1], argc - 1) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    bool ok = true;
+    srand(1);
+    for (size_t f = 0; f < SIM_NUM_FLIGHTS; f++) {
+        sim_run(&sim, &SIM_FLIGHTS[f]);
+        ok = run_flight(&SIM_FLIGHTS[f], true) && ok;
+        ok = run_flight(&SIM_FLIGHTS[f], false) && ok;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file flight_sim.c
+ * @brief Synthetic flights for the benchmarks of the processing stages.
+ *
+ * Synthetic flights for the benchmarks of the processing stages. The rocket waits on the pad, burns its motor at a
+ * constant acceleration against gravity and drag, coasts to apogee and descends under a parachute. The accelerometer
+ * reads the acceleration plus gravity along its z axis with noise, a constant bias and motor vibration during the burn.
+ * The barometer reads the altitude with noise, a little after the IMU.
+ */
+#include "flight_sim.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+/** The standard deviation of the accelerometer noise in m/s^2. */
+#define ACCEL_NOISE 0.3
+
+/** The amplitude of the motor vibration during the burn in m/s^2. */
+#define VIBRATION 20.0
+
+/** The frequency of the motor vibration in Hz. */
+#define VIBRATION_HZ 230
+
+/** The constant bias of the simulated accelerometer in m/s^2. */
+#define ACCEL_BIAS 0.2
+
+/** The standard deviation of the barometric altitude noise in meters. */
+#define BARO_NOISE 0.5
+
+/** How long after the IMU the barometer is read, in nanoseconds. */
+#define BARO_DELAY_NS 200000
+
+/** Standard gravity in m/s^2. */
+#define GRAVITY 9.80665
+
+/** The flights to simulate. */
+const sim_flight_t SIM_FLIGHTS[] = {
+    {.name = "pad", .thrust = 0, .burn = 0, .drag = 0, .descent = 0},
+    {.name = "high-thrust", .thrust = 120, .burn = 2.5, .drag = 0.0006, .descent = 25},
+    {.name = "long-burn", .thrust = 35, .burn = 8, .drag = 0.0004, .descent = 20},
+};
+
+/** The number of flights to simulate. */
+const size_t SIM_NUM_FLIGHTS = sizeof(SIM_FLIGHTS) / sizeof(SIM_FLIGHTS[0]);
+
+/**
+ * Gets normally distributed noise.
+ * @param sd The standard deviation of the noise.
+ * @return The noise.
+ */
+static double gauss(double sd) {
+    double u = ((double)rand() + 1) / ((double)RAND_MAX + 2);
+    double v = ((double)rand() + 1) / ((double)RAND_MAX + 2);
+    return sd * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/**
+ * Simulates a flight, storing the truth and the samples the sensors would produce. The IMU publishes from source 0 and
+ * the barometer from source 1.
+ * @param sim Where to store the simulated flight.
+ * @param flight The flight to simulate.
+ */
+void sim_run(sim_t *sim, const sim_flight_t *flight) {
+    double alt = 0;
+    double vel = 0;
+    double dt = 1.0 / SIM_IMU_RATE;
+    bool launched = false;
+    sim->num_samples = 0;
+    sim->burnout = SIM_STEPS;
+    sim->apogee = SIM_STEPS;
+
+    for (size_t k = 0; k < SIM_STEPS; k++) {
+        double t = (double)k * dt;
+        bool burning = flight->thrust > 0 && t >= SIM_PAD_SECS && t < SIM_PAD_SECS + flight->burn;
+        double accel = 0;
+        if (flight->thrust > 0 && t >= SIM_PAD_SECS) {
+            launched = true;
+            double drag = flight->drag * vel * fabs(vel);
+            accel = (burning ? flight->thrust : 0) - GRAVITY - drag;
+            if (vel <= -flight->descent && accel < 0) accel = 0; // Under the parachute
+        }
+        if (launched && alt <= 0 && accel < 0 && vel <= 0) {
+            accel = 0; // Landed
+            vel = 0;
+        }
+        vel += accel * dt;
+        alt += vel * dt;
+        if (vel < -flight->descent) vel = -flight->descent;
+        sim->alt[k] = alt;
+        sim->vel[k] = vel;
+        if (launched && !burning && sim->burnout == SIM_STEPS) sim->burnout = k;
+        if (sim->burnout < k && vel < 0 && sim->apogee == SIM_STEPS) sim->apogee = k;
+
+        uint64_t time = (uint64_t)k * 1000000000 / SIM_IMU_RATE;
+        double vibration = burning ? VIBRATION * sin(2 * M_PI * VIBRATION_HZ * t) : 0;
+        double measured = accel + GRAVITY + ACCEL_BIAS + vibration + gauss(ACCEL_NOISE);
+        sample_t imu = {.time = time, .source = 0, .prio = 1};
+        imu.msg.type = TAG_LINEAR_ACCEL_REL;
+        imu.msg.data.VEC3D = (vec3d_t){(float)gauss(ACCEL_NOISE), (float)gauss(ACCEL_NOISE), (float)measured};
+        sim->samples[sim->num_samples++] = imu;
+
+        if (k % (SIM_IMU_RATE / SIM_BARO_RATE) == 0) {
+            sample_t baro = {.time = time + BARO_DELAY_NS, .source = 1, .prio = 2};
+            baro.msg.type = TAG_ALTITUDE_REL;
+            baro.msg.data.FLOAT = (float)(alt + gauss(BARO_NOISE));
+            sim->samples[sim->num_samples++] = baro;
+        }
+    }
+}
+
+/**
+ * Gets the IMU step of a sample.
+ * @param time The time of the sample in nanoseconds.
+ * @return The IMU step at or before the time.
+ */
+size_t sim_step(uint64_t time) { return (size_t)(time * SIM_IMU_RATE / 1000000000); }
@@ -0,0 +1,58 @@
+/**
+ * @file flight_sim.h
+ * @brief Synthetic flights for the benchmarks of the processing stages.
+ *
+ * Synthetic flights for the benchmarks of the processing stages. Each flight is simulated from a known trajectory into
+ * the noisy IMU and barometer samples the collectors would publish for it, so a stage's output can be compared against
+ * the truth.
+ */
+#ifndef _FLIGHT_SIM_H_
+#define _FLIGHT_SIM_H_
+
+#include "pipeline/sample.h"
+#include <stddef.h>
+
+/** The IMU rate of the simulated flights in Hz. */
+#define SIM_IMU_RATE 1000
+
+/** The barometer rate of the simulated flights in Hz. */
+#define SIM_BARO_RATE 50
+
+/** The length of each simulated flight in seconds. */
+#define SIM_FLIGHT_SECS 120
+
+/** The time the rocket waits on the pad before launch, in seconds. */
+#define SIM_PAD_SECS 5
+
+/** The number of IMU steps in a flight. */
+#define SIM_STEPS (SIM_FLIGHT_SECS * SIM_IMU_RATE)
+
+/** The number of samples in a flight. */
+#define SIM_SAMPLES (SIM_STEPS + SIM_STEPS / (SIM_IMU_RATE / SIM_BARO_RATE))
+
+/** The parameters of a simulated flight. */
+typedef struct {
+    const char *name; /**< The name of the flight. */
+    double thrust;    /**< The acceleration of the motor in m/s^2, or 0 to stay on the pad. */
+    double burn;      /**< The burn time of the motor in seconds. */
+    double drag;      /**< The drag acceleration per squared m/s of speed. */
+    double descent;   /**< The descent rate under the parachute in m/s. */
+} sim_flight_t;
+
+/** A simulated flight: its true trajectory and the samples the sensors produced. */
+typedef struct {
+    double alt[SIM_STEPS];         /**< The true altitude at each IMU step, in m. */
+    double vel[SIM_STEPS];         /**< The true vertical velocity at each IMU step, in m/s. */
+    size_t burnout;                /**< The IMU step at which the motor burns out. */
+    size_t apogee;                 /**< The first IMU step after burnout with a negative velocity. */
+    sample_t samples[SIM_SAMPLES]; /**< The samples of the flight, in the order they are published. */
+    size_t num_samples;            /**< The number of samples of the flight. */
+} sim_t;
+
+extern const sim_flight_t SIM_FLIGHTS[];
+extern const size_t SIM_NUM_FLIGHTS;
+
+void sim_run(sim_t *sim, const sim_flight_t *flight);
+size_t sim_step(uint64_t time);
+
+#endif // _FLIGHT_SIM_H_
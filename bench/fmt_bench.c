@@ -0,0 +1,198 @@
+/**
+ * @file fmt_bench.c
+ * @brief Benchmark of the plain-text formatter against the original `fprintf` based implementation.
+ *
+ * Formats a mix of messages resembling flight data (mostly IMU readings) with both implementations, checks that they
+ * produce identical text and reports how many lines per second each can write to /dev/null.
+ */
+#include "drivers/sensor_api.h"
+#include "formatters/formatters.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of messages to format with each implementation. */
+#define NUM_MESSAGES 2000000
+
+/** The number of lines written at once by the new implementation, matching the pipeline's batch size. */
+#define BATCH_LINES 256
+
+/** The messages to format. */
+static common_t messages[NUM_MESSAGES];
+
+/** Buffer for a batch of formatted lines. */
+static char batch[BATCH_LINES * FMT_MAX_LINE];
+
+/**
+ * The original implementation of `sensor_write_data`, kept as the baseline.
+ * @param stream The output stream for writing sensor data.
+ * @param msg The message to print.
+ */
+static void legacy_write_data(FILE *stream, const common_t *msg) {
+
+    if (SENSOR_TAG_DATA[msg->type].has_id) fprintf(stream, "ID: %u ", msg->id);
+
+    char format_str[40] = "%s: ";
+    strcat(format_str, SENSOR_TAG_DATA[msg->type].fmt_str);
+    strcat(format_str, " %s\n");
+
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    switch (SENSOR_TAG_DATA[msg->type].dtype) {
+    case TYPE_FLOAT:
+#pragma GCC diagnostic ignored "-Wdouble-promotion"
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.FLOAT, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_U32:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.U32, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_U16:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.U16, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_U8:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.U8, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_I32:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.I32, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_I16:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.I16, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_I8:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.I8, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_VEC3D:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.VEC3D.x, msg->data.VEC3D.y,
+                msg->data.VEC3D.z, SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_VEC2D:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.VEC2D.x, msg->data.VEC2D.y,
+                SENSOR_TAG_DATA[msg->type].unit);
+        break;
+    case TYPE_VEC2D_I32:
+        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.VEC2D_I32.x, msg->data.VEC2D_I32.y,
+                SENSOR_TAG_DATA[msg->type].unit);
+    }
+}
+
+/**
+ * Gets a random float in a range.
+ * @param min The minimum value.
+ * @param max The maximum value.
+ * @return A random float between min and max.
+ */
+static float rand_float(float min, float max) { return min + (max - min) * ((float)rand() / (float)RAND_MAX); }
+
+/**
+ * Fills the message array with a mix of messages resembling what the collectors produce during flight.
+ */
+static void generate_messages(void) {
+    srand(1);
+    for (size_t i = 0; i < NUM_MESSAGES; i++) {
+        common_t *msg = &messages[i];
+        msg->id = 0;
+        switch (i % 16) {
+        case 0:
+            msg->type = TAG_TIME;
+            msg->data.U32 = (uint32_t)(i / 16);
+            break;
+        case 1:
+            msg->type = TAG_TEMPERATURE;
+            msg->data.FLOAT = rand_float(-40, 85);
+            break;
+        case 2:
+            msg->type = TAG_PRESSURE;
+            msg->data.FLOAT = rand_float(10, 105);
+            break;
+        case 3:
+            msg->type = TAG_ALTITUDE_REL;
+            msg->data.FLOAT = rand_float(-5, 10000);
+            break;
+        case 4:
+            msg->type = TAG_VOLTAGE;
+            msg->id = 1 + (i & 1);
+            msg->data.I16 = (int16_t)(rand() % 32000);
+            break;
+        case 5:
+            msg->type = TAG_COORDS;
+            msg->data.VEC2D_I32 = (vec2d_i32_t){.x = 453800000 + rand() % 1000, .y = -756900000 - rand() % 1000};
+            break;
+        default:
+            msg->type = (i & 1) ? TAG_LINEAR_ACCEL_REL : TAG_ANGULAR_VEL;
+            msg->data.VEC3D = (vec3d_t){rand_float(-300, 300), rand_float(-300, 300), rand_float(-300, 300)};
+            break;
+        }
+    }
+}
+
+/**
+ * Gets the current time in seconds.
+ * @return The current time in seconds on the monotonic clock.
+ */
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/**
+ * Checks that both implementations produce the same text for every message.
+ * @return The number of messages which were formatted differently.
+ */
+static size_t verify(void) {
+    size_t mismatches = 0;
+    char expected[FMT_MAX_LINE];
+    char actual[FMT_MAX_LINE];
+    for (size_t i = 0; i < NUM_MESSAGES; i++) {
+        FILE *mem = fmemopen(expected, sizeof(expected), "w");
+        legacy_write_data(mem, &messages[i]);
+        long expected_len = ftell(mem);
+        fclose(mem);
+
+        size_t actual_len = text_fmt_line(actual, &messages[i]);
+        if ((size_t)expected_len != actual_len || memcmp(expected, actual, actual_len) != 0) {
+            if (mismatches == 0) {
+                fprintf(stderr, "Mismatch on message %zu:\n  expected: %.*s  actual:   %.*s", i, (int)expected_len,
+                        expected, (int)actual_len, actual);
+            }
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(void) {
+    generate_messages();
+
+    size_t mismatches = verify();
+    printf("Verified %d messages: %zu mismatches\n", NUM_MESSAGES, mismatches);
+
+    // Original implementation: one fprintf per message into a buffered stream
+    FILE *devnull = fopen("/dev/null", "w");
+    double start = now();
+    for (size_t i = 0; i < NUM_MESSAGES; i++) {
+        legacy_write_data(devnull, &messages[i]);
+    }
+    fflush(devnull);
+    double legacy = now() - start;
+    fclose(devnull);
+
+    // New implementation: batches of lines formatted into one buffer and written at once
+    int fd = open("/dev/null", O_WRONLY);
+    start = now();
+    for (size_t i = 0; i < NUM_MESSAGES; i += BATCH_LINES) {
+        size_t len = 0;
+        for (size_t j = i; j < i + BATCH_LINES && j < NUM_MESSAGES; j++) {
+            len += text_fmt_line(&batch[len], &messages[j]);
+        }
+        if (write(fd, batch, len) == -1) perror("write");
+    }
+    double formatter = now() - start;
+    close(fd);
+
+    printf("fprintf:   %10.0f lines/s\n", NUM_MESSAGES / legacy);
+    printf("formatter: %10.0f lines/s (%.1fx)\n", NUM_MESSAGES / formatter, legacy / formatter);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,168 @@
+/**
+ * @file fusion_bench.c
+ * @brief Accuracy, latency and cost of the altitude fusion stage on synthetic flights.
+ *
+ * Simulates flights with known trajectories, feeds the noisy IMU and barometer samples they would produce through the
+ * fusion stage in batches like the dispatcher does, and compares the fused altitude and vertical velocity against the
+ * truth. For each flight it reports the RMS and worst errors next to those of the barometer alone, how late apogee is
+ * seen (the fused velocity turning negative) and the cost per sample. With `-w <dir>`, each flight is also written as
+ * a recording, which can be replayed through fetcher with `fetcher --replay <dir>/fetcher-<seq>.rec --fusion`.
+ */
+#include "drivers/sensor_api.h"
+#include "flight_sim.h"
+#include "pipeline/pipeline.h"
+#include "recorder/recorder.h"
+#include "stages/stages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The simulated flight. */
+static sim_t sim;
+
+/** The fused altitude and vertical velocity at each IMU step, or NAN before the filter started. */
+static double fused_alt[SIM_STEPS];
+static double fused_vel[SIM_STEPS];
+
+/** The output of the stage for one batch. */
+static sample_t output[STAGE_BATCH_LEN];
+
+/** Writes the flights as recordings, if requested. */
+static recorder_t rec;
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Runs the samples of a flight through a fresh fusion stage and collects its output.
+ * @return The time spent in the stage in nanoseconds.
+ */
+static uint64_t run_stage(void) {
+    static stage_t stage;
+    static fusion_stage_ctx_t ctx;
+    fusion_config_t config = {
+        .axis = 2,
+        .accel_sd = FUSION_DEFAULT_ACCEL_SD,
+        .baro_sd = FUSION_DEFAULT_BARO_SD,
+        .bias_sd = FUSION_DEFAULT_BIAS_SD,
+    };
+    fusion_stage_init(&stage, &ctx, &config);
+    stage.source = STAGE_SOURCE_BASE;
+
+    for (size_t k = 0; k < SIM_STEPS; k++) {
+        fused_alt[k] = NAN;
+        fused_vel[k] = NAN;
+    }
+
+    uint64_t dropped = 0;
+    uint64_t elapsed = 0;
+    for (size_t i = 0; i < sim.num_samples; i += PIPELINE_BATCH_LEN) {
+        size_t n = sim.num_samples - i < PIPELINE_BATCH_LEN ? sim.num_samples - i : PIPELINE_BATCH_LEN;
+        stage_out_t out = {.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+        uint64_t start = now_ns();
+        stage.process(&stage, &sim.samples[i], n, &out);
+        elapsed += now_ns() - start;
+
+        for (size_t j = 0; j < out.len; j++) {
+            if (output[j].source != stage.source) continue;
+            size_t k = sim_step(output[j].time);
+            if (output[j].msg.type == TAG_ALTITUDE_FUSED) fused_alt[k] = output[j].msg.data.FLOAT;
+            if (output[j].msg.type == TAG_VERTICAL_VEL) fused_vel[k] = output[j].msg.data.FLOAT;
+        }
+    }
+    if (dropped > 0) fprintf(stderr, "The stage dropped %llu samples\n", (unsigned long long)dropped);
+    return elapsed;
+}
+
+/**
+ * Gets the time of the first step at or after a given step where the fused velocity is negative.
+ * @param from The step to start looking from.
+ * @return The step, or SIM_STEPS if the fused velocity never turns negative.
+ */
+static size_t first_negative(size_t from) {
+    for (size_t k = from; k < SIM_STEPS; k++) {
+        if (fused_vel[k] < 0) return k;
+    }
+    return SIM_STEPS;
+}
+
+/**
+ * Reports the accuracy of the fusion against the truth and the barometer alone.
+ * @param flight The flight which was simulated.
+ * @param elapsed The time spent in the stage in nanoseconds.
+ */
+static void report(const sim_flight_t *flight, uint64_t elapsed) {
+    double alt_sq = 0, vel_sq = 0, alt_max = 0, vel_max = 0, baro_sq = 0, baro_max = 0;
+    size_t n = 0, nbaro = 0;
+    for (size_t k = 0; k < SIM_STEPS; k++) {
+        if (isnan(fused_alt[k])) continue;
+        double e = fused_alt[k] - sim.alt[k];
+        double ev = fused_vel[k] - sim.vel[k];
+        alt_sq += e * e;
+        vel_sq += ev * ev;
+        alt_max = fmax(alt_max, fabs(e));
+        vel_max = fmax(vel_max, fabs(ev));
+        n++;
+    }
+    for (size_t i = 0; i < sim.num_samples; i++) {
+        if (sim.samples[i].msg.type != TAG_ALTITUDE_REL) continue;
+        double e = sim.samples[i].msg.data.FLOAT - sim.alt[sim_step(sim.samples[i].time)];
+        baro_sq += e * e;
+        baro_max = fmax(baro_max, fabs(e));
+        nbaro++;
+    }
+
+    printf("%s:\n", flight->name);
+    printf("  altitude: RMS %6.3f m, max %6.3f m (barometer alone: RMS %6.3f m, max %6.3f m)\n", sqrt(alt_sq / n),
+           alt_max, sqrt(baro_sq / nbaro), baro_max);
+    printf("  velocity: RMS %6.3f m/s, max %6.3f m/s\n", sqrt(vel_sq / n), vel_max);
+    if (flight->thrust > 0) {
+        size_t seen = first_negative(sim.burnout);
+        printf("  apogee at %.3f s (%.1f m), fused velocity negative %+.1f ms later\n",
+               (double)sim.apogee / SIM_IMU_RATE, sim.alt[sim.apogee],
+               (double)((long)seen - (long)sim.apogee) * 1000 / SIM_IMU_RATE);
+    }
+    printf("  cost: %.1f ns per input sample\n", (double)elapsed / (double)sim.num_samples);
+}
+
+int main(int argc, char **argv) {
+    const char *dir = NULL;
+    int c;
+    while ((c = getopt(argc, argv, "w:")) != -1) {
+        if (c != 'w') {
+            fprintf(stderr, "Usage: %s [-w <recording dir>]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        dir = optarg;
+    }
+
+    pipeline_init();
+    srand(1);
+    for (size_t f = 0; f < SIM_NUM_FLIGHTS; f++) {
+        sim_run(&sim, &SIM_FLIGHTS[f]);
+        report(&SIM_FLIGHTS[f], run_stage());
+
+        if (dir != NULL) {
+            rec_config_t config = {.dir = dir, .segment_len = 16 * 1024 * 1024, .encoding = REC_ENCODING_PACKED};
+            int err = recorder_open(&rec, &config);
+            if (err == EOK) err = recorder_write(&rec, sim.samples, sim.num_samples, 0);
+            if (err == EOK) err = recorder_close(&rec);
+            if (err != EOK) {
+                fprintf(stderr, "Could not record flight in '%s': %s\n", dir, strerror(err));
+                return EXIT_FAILURE;
+            }
+            printf("  recorded as %s\n", rec.path);
+        }
+    }
+    return EXIT_SUCCESS;
+}
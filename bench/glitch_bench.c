@@ -0,0 +1,235 @@
+/**
+ * @file glitch_bench.c
+ * @brief Detection rate and cost per sample of the glitch rejection stage.
+ *
+ * Corrupts the barometric altitude of the synthetic flights from `flight_sim.c` like bus errors do, runs the flights
+ * through the glitch rejection stage in batches like the dispatcher does, and reports for each flight:
+ * - How many of the corrupted samples were rejected, by kind of corruption: values outside the physical range or not
+ *   numbers, isolated wild values, two wild values in a row, and a value after a gap in the data. The value after a
+ *   gap is in range and within the slew rate of the last value before the gap, so only the running median catches it.
+ * - How many clean samples were rejected, which should be none even through launch and burnout.
+ * - The time the stage spends per input sample.
+ */
+#include "drivers/sensor_api.h"
+#include "flight_sim.h"
+#include "pipeline/pipeline.h"
+#include "stages/stages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** One in how many barometer samples starts a glitch. */
+#define GLITCH_ODDS 50
+
+/** One in how many glitches is a gap in the data followed by a wrong value. */
+#define GAP_ODDS 10
+
+/** The number of barometer samples lost in a gap, one second's worth. */
+#define GAP_SAMPLES SIM_BARO_RATE
+
+/**
+ * How far above the last value before a gap the value after it is, in m. The stage's 1000 m/s slew rate allows that
+ * much over the gap, but it is well beyond the 500 m allowed from the running median, and beyond any true change over
+ * the gap at the simulated flights' speeds.
+ */
+#define GAP_OFFSET 700.0f
+
+/** The kinds of corruption. */
+typedef enum {
+    CLEAN,  /**< Not corrupted. */
+    RANGE,  /**< Outside the physical range, or not a number. */
+    SINGLE, /**< An isolated wild value. */
+    DOUBLE, /**< One of two wild values in a row. */
+    GAP,    /**< A value after a gap, within the slew rate of the value before the gap but far from the median. */
+    KINDS,  /**< The number of kinds. */
+} kind_t;
+
+/** The names of the kinds of corruption. */
+static const char *const KIND_NAMES[KINDS] = {"clean", "out of range", "isolated", "two in a row", "after a gap"};
+
+/** The simulated flight. */
+static sim_t sim;
+
+/** The kind of corruption of each sample of the flight. */
+static kind_t kinds[SIM_SAMPLES];
+
+/** Whether each sample of the flight was lost in a gap. */
+static bool lost[SIM_SAMPLES];
+
+/** The stage under test. */
+static stage_t stage;
+static glitch_stage_ctx_t ctx;
+
+/** The output of the stage for one batch. */
+static sample_t output[STAGE_BATCH_LEN];
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Gets a wild offset like a corrupted pressure reading gives, well beyond the barometer's noise.
+ * @return The offset in m.
+ */
+static float wild_offset(void) {
+    float magnitude = 600.0f + (float)(rand() % 20000);
+    return rand() % 2 ? magnitude : -magnitude;
+}
+
+/**
+ * Loses the barometer samples of a gap starting at a sample, and replaces the first one after it with a value the
+ * running median should reject.
+ * @param i The index of the first sample of the gap.
+ * @param last The last clean barometer value before the gap.
+ * @return The index of the value after the gap, or the last index of the flight if the gap runs to its end.
+ */
+static size_t gap(size_t i, float last) {
+    size_t missing = 0;
+    for (; i < sim.num_samples; i++) {
+        if (sim.samples[i].msg.type != TAG_ALTITUDE_REL) continue;
+        if (missing == GAP_SAMPLES) {
+            sim.samples[i].msg.data.FLOAT = last + GAP_OFFSET;
+            kinds[i] = GAP;
+            return i;
+        }
+        lost[i] = true;
+        missing++;
+    }
+    return sim.num_samples - 1;
+}
+
+/** Corrupts some of the barometer samples of the flight, remembering which, then drops the samples lost in gaps. */
+static void corrupt(void) {
+    memset(kinds, 0, sizeof(kinds));
+    memset(lost, 0, sizeof(lost));
+    float last = 0;
+    for (size_t i = 0; i < sim.num_samples; i++) {
+        sample_t *sample = &sim.samples[i];
+        if (sample->msg.type != TAG_ALTITUDE_REL) continue;
+        if (rand() % GLITCH_ODDS != 0) {
+            last = sample->msg.data.FLOAT;
+            continue;
+        }
+
+        if (rand() % GAP_ODDS == 0) {
+            i = gap(i, last);
+            continue;
+        }
+        switch (rand() % 3) {
+        case 0:
+            sample->msg.data.FLOAT = rand() % 2 ? NAN : 1e6f;
+            kinds[i] = RANGE;
+            break;
+        case 1:
+            sample->msg.data.FLOAT += wild_offset();
+            kinds[i] = SINGLE;
+            break;
+        default:
+            // The next barometer sample is corrupted too
+            sample->msg.data.FLOAT += wild_offset();
+            kinds[i] = DOUBLE;
+            for (size_t j = i + 1; j < sim.num_samples; j++) {
+                if (sim.samples[j].msg.type != TAG_ALTITUDE_REL) continue;
+                sim.samples[j].msg.data.FLOAT += wild_offset();
+                kinds[j] = DOUBLE;
+                i = j;
+                break;
+            }
+            break;
+        }
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < sim.num_samples; i++) {
+        if (lost[i]) continue;
+        sim.samples[n] = sim.samples[i];
+        kinds[n++] = kinds[i];
+    }
+    sim.num_samples = n;
+}
+
+/**
+ * Runs the flight through a fresh stage with the default barometer rule and counts the samples of each kind which were
+ * rejected.
+ * @param total Set to the number of samples of each kind.
+ * @param rejected Set to the number of rejected samples of each kind.
+ * @return The time spent in the stage in nanoseconds.
+ */
+static uint64_t run(size_t *total, size_t *rejected) {
+    glitch_config_t config = {
+        .rules = {{.tag = TAG_ALTITUDE_REL, .median_len = 5, .median_dev = 500.0f, .max_slew = 1000.0f},
+                  {.tag = TAG_LINEAR_ACCEL_REL}},
+        .nrules = 2,
+    };
+    if (glitch_stage_init(&stage, &ctx, &config) != EOK) {
+        fprintf(stderr, "Stage rejected the rules\n");
+        exit(EXIT_FAILURE);
+    }
+    stage.source = STAGE_SOURCE_BASE;
+
+    memset(total, 0, KINDS * sizeof(*total));
+    memset(rejected, 0, KINDS * sizeof(*rejected));
+    uint64_t elapsed = 0;
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < sim.num_samples; i += PIPELINE_BATCH_LEN) {
+        size_t len = sim.num_samples - i < PIPELINE_BATCH_LEN ? sim.num_samples - i : PIPELINE_BATCH_LEN;
+        stage_out_t out = {.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+        uint64_t start = now_ns();
+        stage.process(&stage, &sim.samples[i], len, &out);
+        elapsed += now_ns() - start;
+
+        // The stage keeps the order of the samples it passes, so the missing ones are the rejected ones
+        size_t k = 0;
+        for (size_t j = i; j < i + len; j++) {
+            bool passed = k < out.len && output[k].time == sim.samples[j].time &&
+                          output[k].msg.type == sim.samples[j].msg.type;
+            if (passed) k++;
+            if (sim.samples[j].msg.type != TAG_ALTITUDE_REL) continue;
+            total[kinds[j]]++;
+            if (!passed) rejected[kinds[j]]++;
+        }
+    }
+    return elapsed;
+}
+
+/**
+ * Gets how many samples the running median rejected in the last run, which should be exactly those after a gap since
+ * the other wild values are too fast.
+ * @return The number of samples rejected by the running median.
+ */
+static uint64_t median_rejected(void) {
+    uint64_t rejected = 0;
+    for (uint8_t i = 0; i < ctx.nstreams; i++) {
+        rejected += ctx.streams[i].rejected[GLITCH_MEDIAN];
+    }
+    return rejected;
+}
+
+int main(void) {
+    srand(1);
+    bool ok = true;
+    for (size_t f = 0; f < SIM_NUM_FLIGHTS; f++) {
+        sim_run(&sim, &SIM_FLIGHTS[f]);
+        corrupt();
+
+        size_t total[KINDS], rejected[KINDS];
+        uint64_t elapsed = run(total, rejected);
+        printf("%s: %.1f ns/sample\n", SIM_FLIGHTS[f].name, (double)elapsed / (double)sim.num_samples);
+        for (int k = 0; k < KINDS; k++) {
+            printf("  %-13s %5zu of %5zu rejected\n", KIND_NAMES[k], rejected[k], total[k]);
+        }
+        uint64_t median = median_rejected();
+        printf("  %llu rejected by the running median\n", (unsigned long long)median);
+        ok = ok && rejected[CLEAN] == 0 && rejected[RANGE] == total[RANGE] && total[GAP] > 0 &&
+             rejected[GAP] == total[GAP] && median == total[GAP];
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
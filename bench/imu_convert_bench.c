@@ -0,0 +1,204 @@
+/**
+ * @file imu_convert_bench.c
+ * @brief Accuracy and throughput of the LSM6DSO32 unit conversion against the original integer implementation.
+ *
+ * Checks that the vectorized batch conversion gives exactly the same floats as the scalar reference for every possible
+ * count at every full scale range, including batch lengths which leave a tail for the scalar loop. Then reports the
+ * worst error of the original integer conversion against the data sheet sensitivities, and how many values per second
+ * each implementation converts.
+ */
+#include "drivers/lsm6dso32/lsm6dso32.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of distinct 16 bit counts. */
+#define NUM_COUNTS 65536
+
+/** The number of times every count is converted for the throughput measurements. */
+#define REPEATS 200
+
+/** Every possible count, in order. */
+static int16_t counts[NUM_COUNTS];
+
+/** The results of the vectorized and scalar conversions. */
+static float vector_values[NUM_COUNTS];
+static float scalar_values[NUM_COUNTS];
+
+/** The results of the original conversion. */
+static int16_t legacy_values[NUM_COUNTS];
+
+/** The accelerometer full scale ranges. */
+static const accel_fsr_e ACCEL_FSRS[] = {LA_FS_4G, LA_FS_8G, LA_FS_16G, LA_FS_32G};
+
+/** The gyroscope full scale ranges. */
+static const gyro_fsr_e GYRO_FSRS[] = {G_FS_125, G_FS_250, G_FS_500, G_FS_1000, G_FS_2000};
+
+/**
+ * The original implementation of the acceleration conversion, kept as the baseline.
+ * @param acc_fsr The full scale range of the accelerometer.
+ * @param x A pointer to the X component of the acceleration.
+ * @param y A pointer to the Y component of the acceleration.
+ * @param z A pointer to the Z component of the acceleration.
+ */
+static void legacy_convert_accel(accel_fsr_e acc_fsr, int16_t *x, int16_t *y, int16_t *z) {
+    int16_t conversion_factor = 1025;
+    switch (acc_fsr) {
+    case LA_FS_4G:
+        conversion_factor = 8197;
+        break;
+    case LA_FS_8G:
+        conversion_factor = 4098;
+        break;
+    case LA_FS_16G:
+        conversion_factor = 2049;
+        break;
+    case LA_FS_32G:
+        conversion_factor = 1025;
+        break;
+    }
+    if (x) (*x) = (int16_t)(((*x) / conversion_factor) * 9);
+    if (y) (*y) = (int16_t)(((*y) / conversion_factor) * 9);
+    if (z) (*z) = (int16_t)(((*z) / conversion_factor) * 9);
+}
+
+/**
+ * The original implementation of the angular velocity conversion, kept as the baseline.
+ * @param gyro_fsr The full scale range of the gyroscope.
+ * @param x A pointer to the X component of the angular velocity.
+ * @param y A pointer to the Y component of the angular velocity.
+ * @param z A pointer to the Z component of the angular velocity.
+ */
+static void legacy_convert_angular_vel(gyro_fsr_e gyro_fsr, int16_t *x, int16_t *y, int16_t *z) {
+    int16_t conversion_factor = 57;
+    switch (gyro_fsr) {
+    case G_FS_125:
+        conversion_factor = 229;
+        break;
+    case G_FS_250:
+        conversion_factor = 114;
+        break;
+    case G_FS_500:
+        conversion_factor = 57;
+        break;
+    case G_FS_1000:
+        conversion_factor = 29;
+        break;
+    case G_FS_2000:
+        conversion_factor = 14;
+        break;
+    }
+    if (x) (*x) = (int16_t)((*x) / conversion_factor);
+    if (y) (*y) = (int16_t)((*y) / conversion_factor);
+    if (z) (*z) = (int16_t)((*z) / conversion_factor);
+}
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Checks that the vectorized conversion matches the scalar one bit for bit on every count, for batches of every length
+ * from 1 to 64 and for one batch of every count.
+ * @param sensitivity The sensitivity to convert with.
+ * @return True if every result matched, false otherwise.
+ */
+static bool check_exact(float sensitivity) {
+    lsm6dso32_convert(counts, vector_values, NUM_COUNTS, sensitivity);
+    lsm6dso32_convert_scalar(counts, scalar_values, NUM_COUNTS, sensitivity);
+    if (memcmp(vector_values, scalar_values, sizeof(vector_values)) != 0) return false;
+
+    for (size_t len = 1; len <= 64; len++) {
+        for (size_t i = 0; i + len <= NUM_COUNTS; i += len * 97) {
+            lsm6dso32_convert(&counts[i], vector_values, len, sensitivity);
+            if (memcmp(vector_values, &scalar_values[i], len * sizeof(float)) != 0) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Finds the worst error of the original conversion against the exact one.
+ * @param accel True for the accelerometer, false for the gyroscope.
+ * @param fsr The full scale range.
+ * @param sensitivity The data sheet sensitivity at that range.
+ * @return The largest absolute error over every count.
+ */
+static double legacy_error(bool accel, int fsr, float sensitivity) {
+    double worst = 0;
+    for (size_t i = 0; i < NUM_COUNTS; i += 3) {
+        int16_t axes[3] = {counts[i], counts[(i + 1) % NUM_COUNTS], counts[(i + 2) % NUM_COUNTS]};
+        if (accel) {
+            legacy_convert_accel((accel_fsr_e)fsr, &axes[0], &axes[1], &axes[2]);
+        } else {
+            legacy_convert_angular_vel((gyro_fsr_e)fsr, &axes[0], &axes[1], &axes[2]);
+        }
+        for (size_t a = 0; a < 3; a++) {
+            double exact = (double)counts[(i + a) % NUM_COUNTS] * sensitivity;
+            double error = fabs((double)axes[a] - exact);
+            if (error > worst) worst = error;
+        }
+    }
+    return worst;
+}
+
+int main(void) {
+    for (size_t i = 0; i < NUM_COUNTS; i++) {
+        counts[i] = (int16_t)(i - NUM_COUNTS / 2);
+    }
+
+    bool ok = true;
+    printf("Accelerometer (m/s^2):\n");
+    for (size_t f = 0; f < sizeof(ACCEL_FSRS) / sizeof(ACCEL_FSRS[0]); f++) {
+        float sensitivity = lsm6dso32_accel_sensitivity(ACCEL_FSRS[f]);
+        bool exact = check_exact(sensitivity);
+        ok = ok && exact;
+        printf("  +/-%2d g: %.7f per count, batch %s, original conversion off by up to %.2f\n", ACCEL_FSRS[f],
+               (double)sensitivity, exact ? "bit-exact" : "DIFFERENT", legacy_error(true, ACCEL_FSRS[f], sensitivity));
+    }
+    printf("Gyroscope (dps):\n");
+    for (size_t f = 0; f < sizeof(GYRO_FSRS) / sizeof(GYRO_FSRS[0]); f++) {
+        float sensitivity = lsm6dso32_gyro_sensitivity(GYRO_FSRS[f]);
+        bool exact = check_exact(sensitivity);
+        ok = ok && exact;
+        printf("  +/-%4d dps: %.6f per count, batch %s, original conversion off by up to %.2f\n", GYRO_FSRS[f],
+               (double)sensitivity, exact ? "bit-exact" : "DIFFERENT", legacy_error(false, GYRO_FSRS[f], sensitivity));
+    }
+
+    float sensitivity = lsm6dso32_accel_sensitivity(LA_FS_32G);
+    uint64_t start = now_ns();
+    for (int r = 0; r < REPEATS; r++) {
+        lsm6dso32_convert(counts, vector_values, NUM_COUNTS, sensitivity);
+    }
+    uint64_t vector_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < REPEATS; r++) {
+        lsm6dso32_convert_scalar(counts, scalar_values, NUM_COUNTS, sensitivity);
+    }
+    uint64_t scalar_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < REPEATS; r++) {
+        memcpy(legacy_values, counts, sizeof(counts));
+        for (size_t i = 0; i + 3 <= NUM_COUNTS; i += 3) {
+            legacy_convert_accel(LA_FS_32G, &legacy_values[i], &legacy_values[i + 1], &legacy_values[i + 2]);
+        }
+    }
+    uint64_t legacy_ns = now_ns() - start;
+
+    double values = (double)REPEATS * NUM_COUNTS;
+    printf("Throughput:\n");
+    printf("  batch:    %7.1f M values/s\n", values / ((double)vector_ns / 1e3));
+    printf("  scalar:   %7.1f M values/s\n", values / ((double)scalar_ns / 1e3));
+    printf("  original: %7.1f M values/s\n", values / ((double)legacy_ns / 1e3));
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
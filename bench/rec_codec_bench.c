@@ -0,0 +1,278 @@
+/**
+ * @file rec_codec_bench.c
+ * @brief Benchmark of the flight recorder's packed block encoding.
+ *
+ * Packs samples into recorder blocks the way the recorder does, checks that every block decodes back to the original
+ * samples and reports the compression ratio against raw blocks along with encoding and decoding throughput. The samples
+ * are read from the recording segments given on the command line, or simulate a flight if none are given:
+ *     ./bench/rec_codec_bench [segment.rec ...]
+ */
+#include "drivers/sensor_api.h"
+#include "recorder/recorder.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The maximum number of samples to benchmark with. */
+#define NUM_SAMPLES (1024 * 1024)
+
+/** The number of times encoding and decoding are timed. The fastest run is reported. */
+#define RUNS 5
+
+/** The period of the IMU samples in the simulated flight in nanoseconds (6667 Hz). */
+#define IMU_PERIOD_NS 150000
+
+/** The sensitivity of the simulated accelerometer at ±32 g in m/s^2 per LSB (0.976 mg/LSB). */
+#define ACCEL_SENS (0.000976f * 9.80665f)
+
+/** The sensitivity of the simulated gyroscope at ±2000 dps in dps per LSB (70 mdps/LSB). */
+#define GYRO_SENS 0.07f
+
+/** The samples to benchmark with. */
+static sample_t samples[NUM_SAMPLES];
+
+/** The samples decoded from the packed blocks. */
+static sample_t decoded[NUM_SAMPLES];
+
+/** The number of samples to benchmark with. */
+static size_t num_samples;
+
+/** The packed blocks, one after another. */
+static uint8_t packed[NUM_SAMPLES * REC_CODEC_MAX_SAMPLE];
+
+/** Where each packed block starts in `packed`, how many samples it holds and the time of its first sample. */
+static struct {
+    size_t offset;
+    size_t len;
+    uint32_t count;
+    uint64_t first_time;
+} blocks[NUM_SAMPLES / REC_CODEC_STREAMS];
+
+/** The number of packed blocks. */
+static size_t num_blocks;
+
+/** The encoder state. */
+static rec_encoder_t enc;
+
+/** Reads recorded segments. */
+static rec_reader_t reader;
+
+/**
+ * Gets a random number of LSBs of sensor noise.
+ * @param lsb The standard deviation of the noise in LSBs, roughly.
+ * @return The noise.
+ */
+static int noise(int lsb) { return (rand() % (2 * lsb + 1) + rand() % (2 * lsb + 1)) / 2 - lsb; }
+
+/**
+ * Gets a jittered acquisition time.
+ * @param time The nominal time in nanoseconds.
+ * @return The time delayed by up to 10 µs.
+ */
+static uint64_t jitter(uint64_t time) { return time + (uint64_t)(rand() % 10001); }
+
+/**
+ * Adds a sample to the simulated flight, if there is room.
+ * @param time The acquisition time.
+ * @param source The collector.
+ * @param prio The priority.
+ * @param msg The message.
+ */
+static void add(uint64_t time, uint8_t source, uint8_t prio, common_t msg) {
+    if (num_samples < NUM_SAMPLES) {
+        samples[num_samples++] = (sample_t){.time = time, .msg = msg, .source = source, .prio = prio};
+    }
+}
+
+/**
+ * Simulates the samples of a flight: waiting on the pad, a 3 s boost at 10 g, coasting to apogee and descending under a
+ * parachute, with every sensor at its usual rate. IMU readings are whole multiples of the sensitivity, like the driver
+ * produces, and all other values are quantized like their sensors.
+ */
+static void simulate_flight(void) {
+    srand(1);
+    double alt = 0;
+    double vel = 0;
+    for (uint64_t k = 0; num_samples < NUM_SAMPLES; k++) {
+        uint64_t t = k * IMU_PERIOD_NS;
+        double secs = (double)t / 1000000000;
+        double accel = secs < 20 ? 0 : secs < 23 ? 98 : vel > 0 ? -9.81 - 0.002 * vel * vel : 0;
+        if (secs >= 20) {
+            vel += accel * IMU_PERIOD_NS / 1000000000;
+            if (vel < -6) vel = -6;
+            alt += vel * IMU_PERIOD_NS / 1000000000;
+        }
+        double vibration = secs >= 20 && secs < 23 ? 40 * sin(secs * 2 * M_PI * 180) : 0;
+
+        common_t msg = {.type = TAG_LINEAR_ACCEL_REL};
+        int counts = (int)((accel + 9.81 + vibration) / ACCEL_SENS);
+        msg.data.VEC3D = (vec3d_t){ACCEL_SENS * (float)noise(8), ACCEL_SENS * (float)noise(8),
+                                   ACCEL_SENS * (float)(counts + noise(8))};
+        add(jitter(t), 0, 1, msg);
+
+        msg = (common_t){.type = TAG_ANGULAR_VEL};
+        msg.data.VEC3D = (vec3d_t){GYRO_SENS * (float)noise(6), GYRO_SENS * (float)noise(6),
+                                   GYRO_SENS * (float)(noise(6) + (secs > 23 ? 2000 : 0))};
+        add(jitter(t) + 20000, 0, 0, msg);
+
+        if (k % 67 == 0) { // 100 Hz barometer, altitude and power monitor
+            int32_t pascals = (int32_t)(101325 * pow(1 - alt / 44330, 5.255)) + noise(2);
+            msg = (common_t){.type = TAG_PRESSURE, .data.FLOAT = (float)pascals / 1000};
+            add(jitter(t), 1, 0, msg);
+            msg = (common_t){.type = TAG_TEMPERATURE, .data.FLOAT = (float)(2000 - (int)alt / 150 + noise(1)) / 100};
+            add(jitter(t) + 9000, 1, 0, msg);
+            msg = (common_t){.type = TAG_ALTITUDE_REL, .data.FLOAT = (float)(alt + noise(10) / 100.0)};
+            add(jitter(t) + 9500, 1, 0, msg);
+            for (uint8_t id = 1; id <= 4; id++) {
+                msg = (common_t){.type = TAG_VOLTAGE, .id = id, .data.I16 = (int16_t)(3300 * id / 2 + noise(3))};
+                add(jitter(t) + 12000 + id * 3000, 3, 0, msg);
+            }
+        }
+        if (k % 667 == 0) { // 10 Hz GPS
+            msg = (common_t){.type = TAG_COORDS};
+            msg.data.VEC2D_I32 = (vec2d_i32_t){453800000 + noise(20), -756900000 + noise(20)};
+            add(jitter(t) + 40000, 2, 0, msg);
+            msg = (common_t){.type = TAG_ALTITUDE_SEA, .data.FLOAT = (float)(70 + alt + noise(300) / 100.0)};
+            add(jitter(t) + 41000, 2, 0, msg);
+        }
+        if (k % 6667 == 0) { // 1 Hz humidity, temperature and system time
+            msg = (common_t){.type = TAG_HUMIDITY, .data.FLOAT = (float)(4500 + noise(20)) / 100};
+            add(jitter(t) + 60000, 4, 0, msg);
+            msg = (common_t){.type = TAG_TIME, .data.U32 = (uint32_t)(t / 1000000)};
+            add(jitter(t) + 70000, 5, 0, msg);
+        }
+    }
+}
+
+/**
+ * Reads the samples of recorded segments.
+ * @param paths The paths of the segments.
+ * @param n The number of segments.
+ * @return True if every segment could be read, false otherwise.
+ */
+static bool read_segments(char **paths, int n) {
+    for (int i = 0; i < n; i++) {
+        if (rec_reader_open(&reader, paths[i]) != EOK) {
+            fprintf(stderr, "Could not read segment '%s'\n", paths[i]);
+            return false;
+        }
+        num_samples += rec_reader_read(&reader, &samples[num_samples], NUM_SAMPLES - num_samples);
+        rec_reader_close(&reader);
+    }
+    return true;
+}
+
+/**
+ * Gets the current time in seconds.
+ * @return The current time in seconds on the monotonic clock.
+ */
+static double now(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double)t.tv_sec + (double)t.tv_nsec / 1e9;
+}
+
+/**
+ * Packs all the samples into blocks, sealing a block when the recorder would.
+ * @return The total length of the packed blocks, including the block headers.
+ */
+static size_t encode(void) {
+    size_t offset = 0;
+    num_blocks = 0;
+    for (size_t i = 0; i < num_samples;) {
+        rec_encoder_begin(&enc, &packed[offset], samples[i].time);
+        uint32_t count = 0;
+        while (i < num_samples && count < REC_BLOCK_SAMPLES && enc.len + REC_CODEC_MAX_SAMPLE <= REC_BLOCK_MAX &&
+               rec_encoder_add(&enc, &samples[i])) {
+            count++;
+            i++;
+        }
+        blocks[num_blocks].offset = offset;
+        blocks[num_blocks].len = rec_encoder_finish(&enc);
+        blocks[num_blocks].count = count;
+        blocks[num_blocks].first_time = samples[i - count].time;
+        offset += rec_align(blocks[num_blocks].len);
+        num_blocks++;
+    }
+    return offset + num_blocks * sizeof(rec_block_hdr_t);
+}
+
+/**
+ * Decodes all the packed blocks.
+ * @return True if every block decoded, false otherwise.
+ */
+static bool decode(void) {
+    size_t n = 0;
+    for (size_t b = 0; b < num_blocks; b++) {
+        if (!rec_decode_packed(&packed[blocks[b].offset], blocks[b].len, blocks[b].count, blocks[b].first_time,
+                               &decoded[n])) {
+            return false;
+        }
+        n += blocks[b].count;
+    }
+    return true;
+}
+
+/**
+ * Checks that the decoded samples match the original ones, in every field the recorder stores.
+ * @return The number of samples which differ.
+ */
+static size_t verify(void) {
+    size_t mismatches = 0;
+    for (size_t i = 0; i < num_samples; i++) {
+        const sample_t *a = &samples[i];
+        const sample_t *b = &decoded[i];
+        size_t dsize = a->msg.type < SENSOR_TAG_COUNT ? SENSOR_TAG_DATA[a->msg.type].dsize : sizeof(a->msg.data);
+        if (a->time != b->time || a->source != b->source || a->prio != b->prio || a->msg.type != b->msg.type ||
+            a->msg.id != b->msg.id || memcmp(&a->msg.data, &b->msg.data, dsize) != 0) {
+            if (mismatches == 0) fprintf(stderr, "Mismatch on sample %zu\n", i);
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        if (!read_segments(&argv[1], argc - 1)) return EXIT_FAILURE;
+    } else {
+        simulate_flight();
+    }
+    if (num_samples == 0) {
+        fprintf(stderr, "No samples to benchmark with\n");
+        return EXIT_FAILURE;
+    }
+
+    double encode_time = INFINITY;
+    double decode_time = INFINITY;
+    size_t packed_len = 0;
+    bool ok = true;
+    for (int run = 0; run < RUNS; run++) {
+        double start = now();
+        packed_len = encode();
+        encode_time = fmin(encode_time, now() - start);
+
+        start = now();
+        ok = decode() && ok;
+        decode_time = fmin(decode_time, now() - start);
+    }
+
+    size_t mismatches = ok ? verify() : num_samples;
+    printf("Verified %zu samples in %zu blocks: %zu mismatches\n", num_samples, num_blocks, mismatches);
+
+    // Raw blocks hold as many samples as fit in REC_BLOCK_MAX bytes
+    size_t raw_bytes = num_samples * sizeof(rec_raw_t);
+    size_t per_block = REC_BLOCK_MAX / sizeof(rec_raw_t);
+    size_t raw_len = raw_bytes + (num_samples + per_block - 1) / per_block * sizeof(rec_block_hdr_t);
+    double raw_mb = (double)raw_bytes / 1e6;
+    printf("raw:    %10zu bytes (%.2f bytes/sample)\n", raw_len, (double)raw_len / (double)num_samples);
+    printf("packed: %10zu bytes (%.2f bytes/sample, %.2fx smaller)\n", packed_len,
+           (double)packed_len / (double)num_samples, (double)raw_len / (double)packed_len);
+    printf("encode: %8.1f MB/s of raw samples (%.0f samples/s)\n", raw_mb / encode_time,
+           (double)num_samples / encode_time);
+    printf("decode: %8.1f MB/s of raw samples (%.0f samples/s)\n", raw_mb / decode_time,
+           (double)num_samples / decode_time);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,262 @@
+/**
+ * @file rec_seek_bench.c
+ * @brief Correctness and cost of reading time ranges back from a flight recorder segment.
+ *
+ * Records a simulated run into a segment, with a 5 kHz IMU and a 50 Hz barometer published as they are sampled, and a
+ * 1 Hz GPS receiver whose samples are published 1.5 s after their time. Then reads random time ranges back with
+ * `rec_reader_seek`, of every stream and of single streams, and reports:
+ * - How many ranges did not read back exactly the samples recorded in them, which should be none.
+ * - Whether a GPS sample recorded after a block whose samples are all past the end of its range was read back.
+ * - The time a seek and read of a range takes, against reading the whole segment.
+ *
+ * The segment and its index are written to the given directory (`/tmp` by default) and removed afterwards:
+ *     ./bench/rec_seek_bench [dir]
+ */
+#include "drivers/sensor_api.h"
+#include "pipeline/pipeline.h"
+#include "recorder/recorder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The length of the simulated run in seconds. */
+#define RUN_SECS 30
+
+/** The period of the IMU samples in nanoseconds (5 kHz). */
+#define IMU_PERIOD_NS 200000
+
+/** The number of IMU periods between two barometer samples (50 Hz). */
+#define BARO_EVERY 100
+
+/** The number of IMU periods between two GPS samples (1 Hz). */
+#define GPS_EVERY 5000
+
+/** How long after their time the GPS samples are published, in nanoseconds. */
+#define GPS_LATE_NS (1500 * NS_PER_MS)
+
+/** The number of samples in the simulated run. */
+#define NUM_SAMPLES ((size_t)RUN_SECS * (2 * GPS_EVERY + GPS_EVERY / BARO_EVERY + 1))
+
+/** The number of random time ranges read back. */
+#define NUM_RANGES 2000
+
+/** The time of the GPS sample published at 10 s, whose range is checked for late samples, in nanoseconds. */
+#define LATE_CHECK_TIME (10 * NS_PER_SEC - GPS_LATE_NS)
+
+/** The streams of the simulated run. */
+static const rec_stream_t STREAMS[] = {
+    {.source = 0, .type = TAG_LINEAR_ACCEL_REL},
+    {.source = 0, .type = TAG_ANGULAR_VEL},
+    {.source = 1, .type = TAG_PRESSURE},
+    {.source = 2, .type = TAG_COORDS},
+};
+
+/** The number of streams of the simulated run. */
+#define NUM_STREAMS (sizeof(STREAMS) / sizeof(STREAMS[0]))
+
+/** The samples of the simulated run, in the order they were published. */
+static sample_t samples[NUM_SAMPLES];
+
+/** The number of samples of the simulated run. */
+static size_t num_samples;
+
+/** The samples read back. */
+static sample_t batch[REC_BLOCK_SAMPLES];
+
+/** The recorder writing the segment. */
+static recorder_t rec;
+
+/** Reads the segment back. */
+static rec_reader_t reader;
+
+/** The samples of a time range: how many there are and a checksum of them. */
+typedef struct {
+    size_t count; /**< The number of samples. */
+    uint64_t sum; /**< The sum of the times, types and sources of the samples. */
+} range_t;
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * NS_PER_SEC + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Adds a sample to the simulated run.
+ * @param time The time of the sample.
+ * @param source The collector.
+ * @param type The tag of the sample.
+ */
+static void add(uint64_t time, uint8_t source, uint8_t type) {
+    samples[num_samples++] = (sample_t){.time = time, .source = source, .msg = {.type = type}};
+}
+
+/** Simulates the samples of the run, in the order they are published. */
+static void simulate(void) {
+    for (uint64_t k = 0; k < (uint64_t)RUN_SECS * GPS_EVERY; k++) {
+        uint64_t t = k * IMU_PERIOD_NS;
+        add(t, 0, TAG_LINEAR_ACCEL_REL);
+        add(t + 1000, 0, TAG_ANGULAR_VEL);
+        if (k % BARO_EVERY == 0) add(t + 2000, 1, TAG_PRESSURE);
+        if (k % GPS_EVERY == 0 && t >= GPS_LATE_NS) add(t - GPS_LATE_NS, 2, TAG_COORDS);
+    }
+}
+
+/**
+ * Adds a sample to the checksum of a range.
+ * @param range The range.
+ * @param sample The sample.
+ */
+static void count(range_t *range, const sample_t *sample) {
+    range->count++;
+    range->sum += sample->time + ((uint64_t)sample->msg.type << 40) + ((uint64_t)sample->source << 48);
+}
+
+/**
+ * Finds the samples of a time range in the simulated run.
+ * @param stream The stream, or NULL for every stream.
+ * @param start The start of the range.
+ * @param end The end of the range.
+ * @return The samples of the range.
+ */
+static range_t expected(const rec_stream_t *stream, uint64_t start, uint64_t end) {
+    range_t range = {0};
+    for (size_t i = 0; i < num_samples; i++) {
+        const sample_t *sample = &samples[i];
+        if (sample->time < start || sample->time > end) continue;
+        if (stream != NULL && (sample->source != stream->source || sample->msg.type != stream->type)) continue;
+        count(&range, sample);
+    }
+    return range;
+}
+
+/**
+ * Reads the samples of a time range back from the segment.
+ * @param stream The stream, or NULL for every stream.
+ * @param start The start of the range.
+ * @param end The end of the range.
+ * @return The samples read back.
+ */
+static range_t read_back(const rec_stream_t *stream, uint64_t start, uint64_t end) {
+    range_t range = {0};
+    rec_reader_seek(&reader, stream, start, end);
+    size_t n;
+    while ((n = rec_reader_read(&reader, batch, REC_BLOCK_SAMPLES)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            count(&range, &batch[i]);
+        }
+    }
+    return range;
+}
+
+/**
+ * Checks that the segment has a block whose samples are all after a time, followed by a block with a sample at or
+ * before it, so that reading a range ending at that time has to look past the first block.
+ * @param time The end of the range.
+ * @return True if such blocks were found.
+ */
+static bool late_block_follows(uint64_t time) {
+    bool past = false;
+    size_t offset = rec_align(reader.hdr->hdr_len);
+    while (offset + sizeof(rec_block_hdr_t) <= reader.len) {
+        const rec_block_hdr_t *block = (const rec_block_hdr_t *)&reader.map[offset];
+        if (block->magic != REC_BLOCK_MAGIC) break;
+        if (block->min_time > time) past = true;
+        if (past && block->min_time <= time) return true;
+        offset = rec_align(offset + sizeof(*block) + block->len);
+    }
+    return false;
+}
+
+/**
+ * Records the simulated run into a new segment.
+ * @param dir The directory to write the segment into.
+ * @return True if the segment was written.
+ */
+static bool record(const char *dir) {
+    rec_config_t config = {
+        .dir = dir,
+        .segment_len = REC_DEFAULT_SEGMENT_LEN,
+        .sync_ms = 0,
+        .sync_bytes = REC_DEFAULT_SYNC_BYTES,
+        .index_ms = REC_DEFAULT_INDEX_MS,
+        .encoding = REC_ENCODING_PACKED,
+    };
+    int err = recorder_open(&rec, &config);
+    for (size_t i = 0; err == EOK && i < num_samples; i += PIPELINE_BATCH_LEN) {
+        size_t n = num_samples - i < PIPELINE_BATCH_LEN ? num_samples - i : PIPELINE_BATCH_LEN;
+        err = recorder_write(&rec, &samples[i], n, 0);
+    }
+    if (err == EOK) err = recorder_close(&rec);
+    if (err != EOK) {
+        fprintf(stderr, "Could not record into '%s': %s\n", dir, strerror(err));
+        return false;
+    }
+    return true;
+}
+
+/** Removes the segment and its index. */
+static void remove_segment(void) {
+    unlink(rec.path);
+    memcpy(strrchr(rec.path, '.'), ".idx", 4);
+    unlink(rec.path);
+}
+
+int main(int argc, char **argv) {
+    const char *dir = argc > 1 ? argv[1] : "/tmp";
+    simulate();
+    if (!record(dir)) return EXIT_FAILURE;
+    int err = rec_reader_open(&reader, rec.path);
+    if (err != EOK) {
+        fprintf(stderr, "Could not read '%s': %s\n", rec.path, strerror(err));
+        remove_segment();
+        return EXIT_FAILURE;
+    }
+    printf("Recorded %zu samples in %zu bytes\n", num_samples, reader.len);
+
+    // A range ending at a GPS sample, which is recorded behind 1.5 s of newer IMU samples
+    bool ok = late_block_follows(LATE_CHECK_TIME) &&
+              expected(&STREAMS[NUM_STREAMS - 1], LATE_CHECK_TIME, LATE_CHECK_TIME).count == 1;
+    range_t want = expected(NULL, LATE_CHECK_TIME - 100 * NS_PER_MS, LATE_CHECK_TIME);
+    range_t got = read_back(NULL, LATE_CHECK_TIME - 100 * NS_PER_MS, LATE_CHECK_TIME);
+    bool late_ok = ok && got.count == want.count && got.sum == want.sum;
+    printf("Late GPS sample after a block past its range: %s (%zu of %zu samples read back)\n",
+           !ok ? "no such block" : late_ok ? "read back" : "missed", got.count, want.count);
+
+    srand(1);
+    size_t wrong = 0;
+    uint64_t elapsed = 0;
+    for (size_t r = 0; r < NUM_RANGES; r++) {
+        uint64_t start = (uint64_t)rand() % ((uint64_t)RUN_SECS * NS_PER_SEC);
+        uint64_t end = start + (uint64_t)(rand() % 5000 + 1) * NS_PER_MS;
+        const rec_stream_t *stream = r % 2 ? &STREAMS[(size_t)rand() % NUM_STREAMS] : NULL;
+
+        want = expected(stream, start, end);
+        uint64_t before = now_ns();
+        got = read_back(stream, start, end);
+        elapsed += now_ns() - before;
+        if (got.count != want.count || got.sum != want.sum) wrong++;
+    }
+    printf("%zu of %d random ranges read back wrong, %.1f us per range\n", wrong, NUM_RANGES,
+           (double)elapsed / NUM_RANGES / 1000);
+
+    uint64_t before = now_ns();
+    got = read_back(NULL, 0, UINT64_MAX);
+    printf("Reading the whole segment: %.1f us, %zu samples\n", (double)(now_ns() - before) / 1000, got.count);
+
+    rec_reader_close(&reader);
+    remove_segment();
+    return late_ok && wrong == 0 && got.count == num_samples ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file resample_bench.c
+ * @brief Accuracy, delay and cost per sample of the resampling stage.
+ *
+ * Runs the synthetic flights from `flight_sim.c` (IMU at 1 kHz, barometer at 50 Hz) through the resampling stage in
+ * batches like the dispatcher does, with the barometric altitude and the acceleration on a 100 Hz grid, and reports for
+ * each flight:
+ * - The RMS error of the altitude in the snapshots against the true altitude at each tick, interpolated linearly and
+ *   held from the last sample like a consumer matching samples by hand would do.
+ * - How long after its tick each snapshot came out, in sample time, against the delay the ticks may wait.
+ * - How many snapshots were complete, and how many ticks were forced out before every stream caught up.
+ * - The same delay and counts when the barometer stops publishing halfway through the flight, which the ticks may only
+ *   wait for until the delay is up.
+ * - The time the stage spends per input sample.
+ */
+#include "drivers/sensor_api.h"
+#include "flight_sim.h"
+#include "pipeline/pipeline.h"
+#include "stages/stages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The rate of the time grid in Hz. */
+#define GRID_RATE 100
+
+/** The longest time a tick may wait for the streams, in ms. */
+#define GRID_DELAY_MS 50
+
+/** The time at which the barometer stops publishing in the failing runs, in ns. */
+#define BARO_FAILURE_NS (SIM_FLIGHT_SECS / 2 * 1000000000ULL)
+
+/** The simulated flight. */
+static sim_t sim;
+
+/** The samples of the flight without the barometer samples after it failed. */
+static sample_t failed[SIM_SAMPLES];
+static size_t num_failed;
+
+/** The stage under test. */
+static stage_t stage;
+static resample_stage_ctx_t ctx;
+
+/** The output of the stage for one batch. */
+static sample_t output[STAGE_BATCH_LEN];
+
+/** What a run through the stage measured. */
+typedef struct {
+    double squares;     /**< The sum of squared altitude errors. */
+    size_t snapshots;   /**< The number of snapshots. */
+    size_t complete;    /**< The number of snapshots with both streams. */
+    double delay_sum;   /**< The sum of the delays of the snapshots, in ns. */
+    uint64_t delay_max; /**< The longest delay of a snapshot, in ns. */
+    uint64_t forced;    /**< The number of ticks forced out before every stream caught up. */
+    uint64_t elapsed;   /**< The time spent in the stage, in ns. */
+} result_t;
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Runs samples of the flight through a fresh stage.
+ * @param samples The samples.
+ * @param n The number of samples.
+ * @param method How the altitude is resampled.
+ * @param result Set to what the run measured.
+ */
+static void run(const sample_t *samples, size_t n, resample_method_t method, result_t *result) {
+    resample_config_t config = {
+        .fields =
+            {
+                {.tag = TAG_ALTITUDE_REL, .source = RESAMPLE_ANY_SOURCE, .method = method},
+                {.tag = TAG_LINEAR_ACCEL_REL, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            },
+        .nfields = 2,
+        .rate_hz = GRID_RATE,
+        .delay_ms = GRID_DELAY_MS,
+    };
+    if (resample_stage_init(&stage, &ctx, &config) != EOK) {
+        fprintf(stderr, "Stage rejected the configuration\n");
+        exit(EXIT_FAILURE);
+    }
+    stage.source = STAGE_SOURCE_BASE;
+
+    memset(result, 0, sizeof(*result));
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < n; i += PIPELINE_BATCH_LEN) {
+        size_t len = n - i < PIPELINE_BATCH_LEN ? n - i : PIPELINE_BATCH_LEN;
+        stage_out_t out = {.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+        uint64_t start = now_ns();
+        stage.process(&stage, &samples[i], len, &out);
+        result->elapsed += now_ns() - start;
+
+        // Snapshots follow the input sample which let them out
+        uint64_t latest = 0;
+        for (size_t j = 0; j < out.len; j++) {
+            const sample_t *sample = &output[j];
+            if (sample->source != STAGE_SOURCE_BASE) {
+                latest = sample->time;
+                continue;
+            }
+            if (sample->msg.type == TAG_SNAPSHOT) {
+                uint64_t delay = latest - sample->time;
+                result->snapshots++;
+                result->complete += sample->msg.id == config.nfields;
+                result->delay_sum += (double)delay;
+                if (delay > result->delay_max) result->delay_max = delay;
+            } else if (sample->msg.type == TAG_ALTITUDE_REL) {
+                size_t step = sim_step(sample->time);
+                if (step >= SIM_STEPS) continue;
+                double error = sample->msg.data.FLOAT - sim.alt[step];
+                result->squares += error * error;
+            }
+        }
+    }
+    result->forced = ctx.forced;
+    if (dropped > 0) fprintf(stderr, "%lu samples did not fit in the stage's output\n", (unsigned long)dropped);
+}
+
+/**
+ * Prints the snapshots, their delay and the forced ticks of a run.
+ * @param label What the run was.
+ * @param result What the run measured.
+ */
+static void print_delays(const char *label, const result_t *result) {
+    printf("  %-15s %5zu snapshots, %5zu complete, %5llu forced out; delay %4.1f ms mean, %4.1f ms max\n", label,
+           result->snapshots, result->complete, (unsigned long long)result->forced,
+           result->delay_sum / 1000000 / (double)result->snapshots, (double)result->delay_max / 1000000);
+}
+
+int main(void) {
+    printf("Grid of %d Hz, ticks wait for at most %d ms\n", GRID_RATE, GRID_DELAY_MS);
+    for (size_t f = 0; f < SIM_NUM_FLIGHTS; f++) {
+        sim_run(&sim, &SIM_FLIGHTS[f]);
+        num_failed = 0;
+        for (size_t i = 0; i < sim.num_samples; i++) {
+            if (sim.samples[i].msg.type == TAG_ALTITUDE_REL && sim.samples[i].time >= BARO_FAILURE_NS) continue;
+            failed[num_failed++] = sim.samples[i];
+        }
+
+        result_t linear, hold, failing;
+        run(sim.samples, sim.num_samples, RESAMPLE_HOLD, &hold);
+        run(failed, num_failed, RESAMPLE_LINEAR, &failing);
+        run(sim.samples, sim.num_samples, RESAMPLE_LINEAR, &linear);
+        printf("%s: %.1f ns/sample\n", SIM_FLIGHTS[f].name, (double)linear.elapsed / (double)sim.num_samples);
+        printf("  altitude error: %.3f m RMS interpolated, %.3f m RMS held\n",
+               sqrt(linear.squares / (double)linear.snapshots), sqrt(hold.squares / (double)hold.snapshots));
+        print_delays("all sensors", &linear);
+        print_delays("barometer fails", &failing);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+/**
+ * @file startup_bench.c
+ * @brief Time from the start of fetcher to the first sample of each sensor, started one after the other or at once.
+ *
+ * Simulates the startup of the sensors of the flight computer: each sensor is set up with the transfers and waits of
+ * its real collector (resets, calibration reads, configuration and its acknowledgement) and then read once, publishing
+ * its first sample. An I2C transfer is simulated by holding the bus (a mutex, since one bus serves every sensor) for
+ * the time the transfer would take. The sensors are started in three ways:
+ * - serial: one after the other on one thread, each set up and read before the next is started.
+ * - threads: each on its own thread, like the collector threads.
+ * - engine: each as a task of the acquisition engine on one thread, like `--engine loop`.
+ *
+ * For each, the benchmark reports when each sensor was set up and when the pipeline dispatched its first sample, and
+ * when every sensor had published, counted from the start of the run. With `-c`, the GPS receiver already has our
+ * configuration, like when fetcher is restarted, so it is only polled for it instead of being reset and configured.
+ */
+#include "collectors/engine.h"
+#include "pipeline/pipeline.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of nanoseconds in a microsecond. */
+#define NS_PER_US 1000ULL
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The maximum number of operations in the startup of a sensor. */
+#define MAX_OPS 20
+
+/** How long to wait for the pipeline to dispatch every first sample, in microseconds. */
+#define DISPATCH_WAIT_US 1000
+
+/** An operation of the startup of a sensor: a transfer, then a wait for the sensor before the next operation. */
+typedef struct {
+    uint32_t transfer_us; /**< How long the transfer holds the bus, in microseconds. Zero if there is none. */
+    uint32_t wait_us;     /**< How long to wait for the sensor after the transfer, in microseconds. */
+} sim_op_t;
+
+/** A simulated sensor. */
+typedef struct {
+    const char *name;      /**< The name of the sensor. */
+    uint8_t setup_ops;     /**< The number of operations which set the sensor up, before its first reading. */
+    uint8_t num_ops;       /**< The number of operations until the first sample is published. */
+    sim_op_t ops[MAX_OPS]; /**< The operations, with the waits of the real collectors and transfers at 400 kHz. */
+} sim_sensor_t;
+
+/** A transfer of a command or a short register read, in microseconds. */
+#define SHORT 100
+
+/**
+ * The simulated sensors. The M10SPG's responses are assumed to take 50 ms for the acknowledgement of its configuration
+ * and 20 ms for a navigation message, since they depend on the receiver.
+ */
+static const sim_sensor_t SENSORS[] = {
+    {.name = "MS5611",
+     .setup_ops = 13,
+     .num_ops = 17,
+     .ops = {{SHORT, 10000},                                                          // Reset
+             {SHORT, 0}, {SHORT, 0}, {SHORT, 0}, {SHORT, 0},                          // Calibration
+             {SHORT, 0}, {SHORT, 0}, {SHORT, 0}, {SHORT, 0},                          //
+             {SHORT, 9040}, {SHORT, 0}, {SHORT, 9040}, {SHORT, 0},                    // Ground pressure
+             {SHORT, 9040}, {SHORT, 0}, {SHORT, 9040}, {SHORT, 0}}},                  // First reading
+    {.name = "SHT41", .setup_ops = 1, .num_ops = 3, .ops = {{SHORT, 100}, {SHORT, 8300}, {200, 0}}},
+    {.name = "LSM6DSO32",
+     .setup_ops = 11,
+     .num_ops = 12,
+     .ops = {{SHORT, 0}, {SHORT, 100},                                                // Reset and reboot
+             {SHORT, 0}, {SHORT, 0}, {SHORT, 0}, {SHORT, 0}, {SHORT, 0},              // Configuration
+             {SHORT, 0}, {SHORT, 0}, {SHORT, 0}, {SHORT, 10000},                      //
+             {1000, 0}}},                                                             // FIFO
+    {.name = "PAC1952-2", .setup_ops = 1, .num_ops = 3, .ops = {{150, 0}, {150, 1000}, {150, 0}}},
+    {.name = "MAXM10S",
+     .setup_ops = 3,
+     .num_ops = 7,
+     .ops = {{SHORT, 1000000},                                                        // Soft reset
+             {500, 50000}, {SHORT, 0},                                                // Configuration and its ack
+             {SHORT, 20000}, {200, 0}, {SHORT, 20000}, {300, 0}}},                    // Status and position
+    {.name = "SYSCLOCK", .setup_ops = 0, .num_ops = 0},
+};
+
+/** The index of the GPS receiver in SENSORS. */
+#define GPS 4
+
+/** The GPS receiver when it already has our configuration, so that it is polled for it instead of reset. */
+static const sim_sensor_t CONFIGURED_GPS = {
+    .name = "MAXM10S",
+    .setup_ops = 3,
+    .num_ops = 7,
+    .ops = {{SHORT, 20000}, {300, 0}, {SHORT, 0},                                     // Configuration poll and its ack
+            {SHORT, 20000}, {200, 0}, {SHORT, 20000}, {300, 0}}};                     // Status and position
+
+/** The number of simulated sensors. */
+#define NUM_SENSORS (sizeof(SENSORS) / sizeof(SENSORS[0]))
+
+/** The state of a simulated sensor. */
+typedef struct {
+    const sim_sensor_t *sensor; /**< The sensor. */
+    uint8_t source;             /**< The index identifying the sensor's samples in the pipeline. */
+    task_t task;                /**< The sensor's task when run by the engine. */
+    uint8_t op;                 /**< The next operation. */
+    uint64_t ready;             /**< When the sensor was set up, on the pipeline's clock. */
+} sim_state_t;
+
+/** The simulated sensors. */
+static sim_state_t states[NUM_SENSORS];
+
+/** The simulated I2C bus. */
+static pthread_mutex_t bus = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Sleeps for a number of nanoseconds.
+ * @param ns The time to sleep.
+ */
+static void sleep_ns(uint64_t ns) {
+    struct timespec duration = {.tv_sec = ns / 1000000000, .tv_nsec = ns % 1000000000};
+    while (nanosleep(&duration, &duration) == -1 && errno == EINTR) {
+    }
+}
+
+/**
+ * Simulates the transfer of an operation.
+ * @param op The operation.
+ */
+static void transfer(const sim_op_t *op) {
+    if (op->transfer_us == 0) return;
+    pthread_mutex_lock(&bus);
+    sleep_ns(op->transfer_us * NS_PER_US);
+    pthread_mutex_unlock(&bus);
+}
+
+/**
+ * Records that the setup of a sensor is done if the next operation is its first reading, and publishes its first
+ * sample once every operation is done.
+ * @param state The state of the sensor.
+ * @return True once the first sample was published.
+ */
+static bool advance(sim_state_t *state) {
+    if (state->op == state->sensor->setup_ops && state->ready == 0) state->ready = pipeline_time();
+    if (state->op < state->sensor->num_ops) return false;
+    common_t msg = {.type = TAG_TIME};
+    pipeline_publish(state->source, &msg, 0);
+    return true;
+}
+
+/**
+ * Starts a simulated sensor like a collector thread, sleeping through each wait.
+ * @param arg The state of the sensor.
+ * @return NULL.
+ */
+static void *sim_thread(void *arg) {
+    sim_state_t *state = arg;
+    while (!advance(state)) {
+        const sim_op_t *op = &state->sensor->ops[state->op++];
+        transfer(op);
+        sleep_ns(op->wait_us * NS_PER_US);
+    }
+    return NULL;
+}
+
+/**
+ * Takes the next step of starting a simulated sensor as a task of the engine.
+ * @param task The task of the sensor.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE once the first sample was published.
+ */
+static uint64_t sim_step(task_t *task, uint64_t now) {
+    sim_state_t *state = task->ctx;
+    if (advance(state)) return TASK_DONE;
+    const sim_op_t *op = &state->sensor->ops[state->op++];
+    transfer(op);
+    return now + (op->transfer_us + op->wait_us) * NS_PER_US;
+}
+
+/**
+ * Resets the simulated sensors.
+ * @param first_source The source of the first sensor, so that each run has its own first samples.
+ * @param configured Whether the GPS receiver already has our configuration.
+ */
+static void reset_sensors(uint8_t first_source, bool configured) {
+    memset(states, 0, sizeof(states));
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        states[s].sensor = configured && s == GPS ? &CONFIGURED_GPS : &SENSORS[s];
+        states[s].source = (uint8_t)(first_source + s);
+    }
+}
+
+/**
+ * Prints when each sensor was set up and published its first sample, once they have all been dispatched.
+ * @param mode The name of the way the sensors were started.
+ * @param start When the run started, on the pipeline's clock.
+ */
+static void print_results(const char *mode, uint64_t start) {
+    uint64_t last = 0;
+    uint64_t first[NUM_SENSORS];
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        while (!pipeline_first_sample(states[s].source, &first[s])) {
+            usleep(DISPATCH_WAIT_US);
+        }
+        if (first[s] > last) last = first[s];
+    }
+
+    printf("%s: every sensor published within %.1f ms\n", mode, (double)(last - start) / NS_PER_MS);
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        printf("  %-10s set up at %7.1f ms, first sample at %7.1f ms\n", states[s].sensor->name,
+               (double)(states[s].ready - start) / NS_PER_MS, (double)(first[s] - start) / NS_PER_MS);
+    }
+}
+
+int main(int argc, char **argv) {
+    bool configured = argc > 1 && !strcmp(argv[1], "-c");
+    int err = pipeline_init();
+    if (err == EOK) err = pipeline_start();
+    if (err != EOK) {
+        fprintf(stderr, "Could not start the pipeline: %s\n", strerror(err));
+        return EXIT_FAILURE;
+    }
+    printf("Starting %zu simulated sensors in each mode, with the GPS receiver %s\n", NUM_SENSORS,
+           configured ? "already configured" : "reset");
+
+    // One sensor after the other
+    reset_sensors(0, configured);
+    uint64_t start = pipeline_time();
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        sim_thread(&states[s]);
+    }
+    print_results("serial", start);
+
+    // A thread per sensor
+    reset_sensors(NUM_SENSORS, configured);
+    pthread_t threads[NUM_SENSORS];
+    start = pipeline_time();
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        pthread_create(&threads[s], NULL, sim_thread, &states[s]);
+    }
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        pthread_join(threads[s], NULL);
+    }
+    print_results("threads", start);
+
+    // Every sensor on one thread
+    reset_sensors(2 * NUM_SENSORS, configured);
+    engine_init();
+    for (size_t s = 0; s < NUM_SENSORS; s++) {
+        states[s].task = (task_t){.name = SENSORS[s].name, .ctx = &states[s], .step = sim_step};
+        engine_add(&states[s].task);
+    }
+    start = pipeline_time();
+    engine_run();
+    print_results("engine", start);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,201 @@
+/**
+ * @file stats_bench.c
+ * @brief Cost and accuracy of the rolling statistics stage.
+ *
+ * Feeds a 1 kHz 3-axis acceleration stream (slow drift, noise and occasional spikes) through the statistics stage in
+ * batches like the dispatcher does, and reports:
+ * - The time the stage spends per input sample for several window lengths, which should not grow with the window.
+ * - The largest difference between every published statistic and the same statistic recomputed from scratch over the
+ *   samples in the window, after long runs in which the incremental updates could build up rounding errors.
+ */
+#include "drivers/sensor_api.h"
+#include "pipeline/pipeline.h"
+#include "stages/stages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The rate of the input stream in Hz. */
+#define INPUT_RATE 1000
+
+/** The time between two input samples in ns. */
+#define INPUT_PERIOD_NS (1000000000 / INPUT_RATE)
+
+/** The number of input samples per run. */
+#define RUN_SAMPLES 1000000
+
+/** The time between two publications during the runs, in ms. */
+#define INTERVAL_MS 100
+
+/** The stage under test. */
+static stage_t stage;
+static stats_stage_ctx_t ctx;
+
+/** The input and output of the stage for one batch. */
+static sample_t batch[PIPELINE_BATCH_LEN];
+static sample_t output[STAGE_BATCH_LEN];
+
+/** Every input sample of a run, kept to recompute the statistics from scratch. */
+static vec3d_t inputs[RUN_SAMPLES];
+
+/** The largest differences from the statistics recomputed from scratch. */
+typedef struct {
+    double min;      /**< Of the minimum and maximum. */
+    double mean;     /**< Of the mean. */
+    double variance; /**< Of the variance, relative to it. */
+    double rms;      /**< Of the RMS. */
+} errors_t;
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Gets an axis of a vector.
+ * @param v The vector.
+ * @param axis The axis, 0 to 2.
+ * @return The value of the axis.
+ */
+static double axis_of(const vec3d_t *v, int axis) { return axis == 0 ? v->x : axis == 1 ? v->y : v->z; }
+
+/**
+ * Checks a published statistic against the same statistic recomputed over the window ending at an input sample.
+ * @param stat The published statistic.
+ * @param last The index of the input sample it was published after.
+ * @param window_ms The length of the window.
+ * @param errors The largest differences so far, updated.
+ */
+static void check(const sample_t *stat, size_t last, uint32_t window_ms, errors_t *errors) {
+    size_t len = (size_t)window_ms * INPUT_RATE / 1000;
+    if (len > STATS_WINDOW_LEN) len = STATS_WINDOW_LEN;
+    if (len > last + 1) len = last + 1;
+    size_t first = last + 1 - len;
+
+    for (int a = 0; a < 3; a++) {
+        double min = INFINITY, max = -INFINITY, sum = 0, squares = 0;
+        for (size_t i = first; i <= last; i++) {
+            double value = axis_of(&inputs[i], a);
+            if (value < min) min = value;
+            if (value > max) max = value;
+            sum += value;
+        }
+        double mean = sum / (double)len;
+        for (size_t i = first; i <= last; i++) {
+            double delta = axis_of(&inputs[i], a) - mean;
+            squares += delta * delta;
+        }
+        double variance = squares / (double)len;
+        double got = axis_of(&stat->msg.data.VEC3D, a);
+
+        double error;
+        switch (stat->msg.type) {
+        case TAG_STATS_MIN:
+            error = fabs(got - min);
+            if (error > errors->min) errors->min = error;
+            break;
+        case TAG_STATS_MAX:
+            error = fabs(got - max);
+            if (error > errors->min) errors->min = error;
+            break;
+        case TAG_STATS_MEAN:
+            error = fabs(got - mean);
+            if (error > errors->mean) errors->mean = error;
+            break;
+        case TAG_STATS_VARIANCE:
+            error = fabs(got - variance) / variance;
+            if (error > errors->variance) errors->variance = error;
+            break;
+        case TAG_STATS_RMS:
+            error = fabs(got - sqrt(variance + mean * mean));
+            if (error > errors->rms) errors->rms = error;
+            break;
+        }
+    }
+}
+
+/**
+ * Runs the acceleration stream through a fresh stage.
+ * @param window_ms The length of the window.
+ * @param verify Whether to check every published statistic.
+ * @param errors The largest differences from the recomputed statistics, if verifying.
+ * @param published Set to the number of statistics published.
+ * @return The time spent in the stage in nanoseconds.
+ */
+static uint64_t run(uint32_t window_ms, bool verify, errors_t *errors, size_t *published) {
+    stats_config_t config = {
+        .rules = {{.tag = TAG_LINEAR_ACCEL_REL, .window_ms = window_ms}},
+        .nrules = 1,
+        .interval_ms = INTERVAL_MS,
+    };
+    if (stats_stage_init(&stage, &ctx, &config) != EOK) {
+        fprintf(stderr, "Stage rejected a window of %u ms\n", window_ms);
+        exit(EXIT_FAILURE);
+    }
+    stage.source = STAGE_SOURCE_BASE;
+
+    uint64_t elapsed = 0;
+    uint64_t dropped = 0;
+    *published = 0;
+    for (size_t i = 0; i < RUN_SAMPLES; i += PIPELINE_BATCH_LEN) {
+        size_t len = RUN_SAMPLES - i < PIPELINE_BATCH_LEN ? RUN_SAMPLES - i : PIPELINE_BATCH_LEN;
+        for (size_t j = 0; j < len; j++) {
+            batch[j] = (sample_t){.time = (uint64_t)(i + j) * INPUT_PERIOD_NS, .source = 0, .prio = 1};
+            batch[j].msg.type = TAG_LINEAR_ACCEL_REL;
+            batch[j].msg.data.VEC3D = inputs[i + j];
+        }
+
+        stage_out_t out = {.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+        uint64_t start = now_ns();
+        stage.process(&stage, batch, len, &out);
+        elapsed += now_ns() - start;
+
+        // Statistics follow the input sample they were published after
+        size_t last = i;
+        for (size_t j = 0; j < out.len; j++) {
+            if (output[j].msg.type == TAG_LINEAR_ACCEL_REL) {
+                last = (size_t)(output[j].time / INPUT_PERIOD_NS);
+                continue;
+            }
+            (*published)++;
+            if (verify) check(&output[j], last, window_ms, errors);
+        }
+    }
+    if (dropped > 0) fprintf(stderr, "%lu samples did not fit in the stage's output\n", (unsigned long)dropped);
+    return elapsed;
+}
+
+int main(void) {
+    srand(1);
+    for (size_t i = 0; i < RUN_SAMPLES; i++) {
+        double t = (double)i / INPUT_RATE;
+        float noise = (float)rand() / (float)RAND_MAX - 0.5f;
+        float spike = rand() % 1000 == 0 ? 50.0f : 0.0f;
+        inputs[i] = (vec3d_t){
+            .x = (float)(0.01 * t) + noise + spike,
+            .y = 9.81f + 0.2f * noise,
+            .z = (float)sin(t) + 0.05f * noise - spike,
+        };
+    }
+
+    static const uint32_t WINDOWS_MS[] = {10, 100, 1000, 2000, 5000};
+    printf("%-8s %11s %10s %10s %10s %12s %10s\n", "window", "ns/sample", "published", "min/max", "mean", "variance",
+           "rms");
+    for (size_t w = 0; w < sizeof(WINDOWS_MS) / sizeof(WINDOWS_MS[0]); w++) {
+        errors_t errors = {0};
+        size_t published;
+        uint64_t elapsed = run(WINDOWS_MS[w], false, &errors, &published);
+        run(WINDOWS_MS[w], true, &errors, &published);
+        printf("%5u ms %11.1f %10zu %10.2g %10.2g %11.2g%% %10.2g\n", WINDOWS_MS[w], (double)elapsed / RUN_SAMPLES,
+               published, errors.min, errors.mean, errors.variance * 100, errors.rms);
+    }
+    printf("Windows longer than %u samples are cut to their last %u samples.\n", STATS_WINDOW_LEN, STATS_WINDOW_LEN);
+    return EXIT_SUCCESS;
+}
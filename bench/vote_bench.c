@@ -0,0 +1,176 @@
+/**
+ * @file vote_bench.c
+ * @brief Accuracy and cost per sample of the voting stage on redundant accelerometers.
+ *
+ * Simulates three accelerometers measuring the same fast changing acceleration at 1 kHz, each read in batches of 10
+ * samples like the IMU's FIFO, with the batches of the three arriving one after the other. Runs them through the voting
+ * stage with each method, once with three healthy sensors and once with the third one failing halfway through (a large
+ * bias and four times the noise), and reports:
+ * - The RMS error of the consensus against the true acceleration, next to that of a single healthy sensor and that of
+ *   the failing one.
+ * - The mean spread between the sensors.
+ * - The time the stage spends per input sample.
+ */
+#include "drivers/sensor_api.h"
+#include "pipeline/pipeline.h"
+#include "stages/stages.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of redundant sensors. */
+#define NUM_SENSORS 3
+
+/** The rate of each sensor in Hz. */
+#define RATE 1000
+
+/** The number of samples of each sensor per batch. */
+#define BATCH 10
+
+/** The number of samples of each sensor per run. */
+#define RUN_SAMPLES 200000
+
+/** The standard deviation of a healthy sensor's noise, in m/s^2. */
+#define NOISE_SD 0.3f
+
+/** The bias of the failing sensor, in m/s^2. */
+#define FAULT_BIAS 5.0f
+
+/** The amplitude and frequency of the true acceleration along z. */
+#define SIGNAL_AMPLITUDE 20.0f
+#define SIGNAL_FREQ 2.0f
+
+/** The stage under test. */
+static stage_t stage;
+static vote_stage_ctx_t ctx;
+
+/** The input and output of the stage for one batch. */
+static sample_t batch[PIPELINE_BATCH_LEN];
+static sample_t output[STAGE_BATCH_LEN];
+
+/** The errors of a run. */
+typedef struct {
+    double consensus; /**< The sum of squared errors of the consensus. */
+    size_t votes;     /**< The number of votes. */
+    double healthy;   /**< The sum of squared errors of the first sensor. */
+    double failing;   /**< The sum of squared errors of the last sensor. */
+    size_t samples;   /**< The number of samples of each sensor. */
+    double spread;    /**< The sum of the z spreads. */
+} errors_t;
+
+/**
+ * Gets the current time in nanoseconds.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+static uint64_t now_ns(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + (uint64_t)t.tv_nsec;
+}
+
+/**
+ * Gets the true acceleration along z.
+ * @param time The time in ns.
+ * @return The acceleration in m/s^2.
+ */
+static double truth(uint64_t time) {
+    return SIGNAL_AMPLITUDE * sin(2 * M_PI * SIGNAL_FREQ * (double)time / 1000000000);
+}
+
+/**
+ * Draws normally distributed noise.
+ * @param sd The standard deviation.
+ * @return The noise.
+ */
+static double noise(double sd) {
+    double u = ((double)rand() + 1) / ((double)RAND_MAX + 2);
+    double v = ((double)rand() + 1) / ((double)RAND_MAX + 2);
+    return sd * sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/**
+ * Runs the sensors through a fresh stage.
+ * @param method How the stage combines the sensors.
+ * @param fault Whether the last sensor fails halfway through.
+ * @param errors Set to the errors of the run.
+ * @return The time spent in the stage in nanoseconds.
+ */
+static uint64_t run(vote_method_t method, bool fault, errors_t *errors) {
+    vote_config_t config = {
+        .method = method,
+        .tags = {TAG_LINEAR_ACCEL_REL},
+        .ntags = 1,
+        .stale_ms = VOTE_DEFAULT_STALE_MS,
+        .groups = {{.sources = {0, 1, 2}, .n = NUM_SENSORS}},
+        .ngroups = 1,
+    };
+    if (vote_stage_init(&stage, &ctx, &config) != EOK) {
+        fprintf(stderr, "Stage rejected the configuration\n");
+        exit(EXIT_FAILURE);
+    }
+    stage.source = STAGE_SOURCE_BASE;
+
+    memset(errors, 0, sizeof(*errors));
+    uint64_t elapsed = 0;
+    uint64_t dropped = 0;
+    for (size_t first = 0; first < RUN_SAMPLES; first += BATCH) {
+        size_t len = 0;
+        for (uint8_t s = 0; s < NUM_SENSORS; s++) {
+            for (size_t k = first; k < first + BATCH; k++) {
+                uint64_t time = (uint64_t)k * (1000000000 / RATE) + s * 100000;
+                bool failing = fault && s == NUM_SENSORS - 1 && k > RUN_SAMPLES / 2;
+                double value = truth(time) + (failing ? FAULT_BIAS + noise(4 * NOISE_SD) : noise(NOISE_SD));
+
+                sample_t *sample = &batch[len++];
+                *sample = (sample_t){.time = time, .source = s, .prio = 1};
+                sample->msg.type = TAG_LINEAR_ACCEL_REL;
+                sample->msg.data.VEC3D = (vec3d_t){.x = 0, .y = 0, .z = (float)value};
+
+                double error = value - truth(time);
+                if (s == 0) errors->healthy += error * error;
+                if (s == NUM_SENSORS - 1) errors->failing += error * error;
+            }
+        }
+        errors->samples += BATCH;
+
+        stage_out_t out = {.samples = output, .len = 0, .max = STAGE_BATCH_LEN, .dropped = &dropped};
+        uint64_t start = now_ns();
+        stage.process(&stage, batch, len, &out);
+        elapsed += now_ns() - start;
+
+        for (size_t j = 0; j < out.len; j++) {
+            if (output[j].source != STAGE_SOURCE_BASE) continue;
+            if (output[j].msg.type == TAG_VOTE_SPREAD) {
+                errors->spread += output[j].msg.data.VEC3D.z;
+                continue;
+            }
+            double error = output[j].msg.data.VEC3D.z - truth(output[j].time);
+            errors->consensus += error * error;
+            errors->votes++;
+        }
+    }
+    return elapsed;
+}
+
+int main(void) {
+    static const vote_method_t METHODS[] = {VOTE_MEDIAN, VOTE_WEIGHTED};
+    static const char *const METHOD_NAMES[] = {"median", "weighted"};
+
+    srand(1);
+    printf("%-9s %-8s %9s %10s %10s %10s %11s\n", "method", "sensors", "votes", "consensus", "healthy", "failing",
+           "ns/sample");
+    for (int fault = 0; fault < 2; fault++) {
+        for (size_t m = 0; m < sizeof(METHODS) / sizeof(METHODS[0]); m++) {
+            errors_t errors;
+            uint64_t elapsed = run(METHODS[m], fault, &errors);
+            printf("%-9s %-8s %9zu %10.3f %10.3f %10.3f %11.1f   (mean spread %.2f)\n", METHOD_NAMES[m],
+                   fault ? "1 fails" : "healthy", errors.votes, sqrt(errors.consensus / (double)errors.votes),
+                   sqrt(errors.healthy / (double)errors.samples), sqrt(errors.failing / (double)errors.samples),
+                   (double)elapsed / (double)(errors.samples * NUM_SENSORS), errors.spread / (double)errors.votes);
+        }
+    }
+    printf("Errors are RMS in m/s^2.\n");
+    return EXIT_SUCCESS;
+}
@@ -2,9 +2,12 @@
 #include <string.h>
 
 static const clctr_entry_t COLLECTORS[] = {
-    {.name = "SHT41", .collector = sht41_collector},    {.name = "SYSCLOCK", .collector = sysclock_collector},
-    {.name = "MS5611", .collector = ms5611_collector},  {.name = "LSM6DSO32", .collector = lsm6dso32_collector},
-    {.name = "MAXM10S", .collector = m10spg_collector}, {.name = "PAC1952-2", .collector = pac1952_2_collector},
+    {.name = "SHT41", .collector = sht41_collector, .task = sht41_task},
+    {.name = "SYSCLOCK", .collector = sysclock_collector, .task = sysclock_task},
+    {.name = "MS5611", .collector = ms5611_collector, .task = ms5611_task},
+    {.name = "LSM6DSO32", .collector = lsm6dso32_collector, .task = lsm6dso32_task},
+    {.name = "MAXM10S", .collector = m10spg_collector, .task = m10spg_task},
+    {.name = "PAC1952-2", .collector = pac1952_2_collector, .task = pac1952_2_task},
 };
 
 /**
@@ -20,3 +23,46 @@ collector_t collector_search(const char *sensor_name) {
     }
     return NULL;
 }
+
+/**
+ * Searches for the engine task of a collector matching the sensor name in the list of implemented collectors.
+ * @param sensor_name The name of the sensor to find a collector task for.
+ * @return A function pointer which sets up the collector task, or NULL if no match is found.
+ */
+collector_task_t collector_task_search(const char *sensor_name) {
+    for (uint8_t i = 0; i < sizeof(COLLECTORS) / sizeof(clctr_entry_t); i++) {
+        if (!strcasecmp(sensor_name, COLLECTORS[i].name)) {
+            return COLLECTORS[i].task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Gets the time between two readings of a collector.
+ * @param rates The rates of the collector.
+ * @param default_us The time between two readings the collector uses by default, in microseconds.
+ * @return The time between two readings in microseconds.
+ */
+uint32_t clctr_period_us(const clctr_rates_t *rates, uint32_t default_us) {
+    return rates->period_us != 0 ? rates->period_us : default_us;
+}
+
+/**
+ * Counts a reading of a tag and checks whether it should be published. Must be called once per reading, so a reading
+ * which publishes several values of one tag counts once.
+ * @param rates The rates of the collector, which keep the count of its readings of each divided tag.
+ * @param tag The tag of the reading.
+ * @return True if the reading should be published: always for a tag which is not divided, otherwise for the first of
+ * every `n` readings.
+ */
+bool clctr_due(clctr_rates_t *rates, uint8_t tag) {
+    for (uint8_t i = 0; i < rates->ndividers; i++) {
+        clctr_divider_t *divider = &rates->dividers[i];
+        if (divider->tag != tag) continue;
+        bool due = divider->count == 0;
+        if (++divider->count >= divider->n) divider->count = 0;
+        return due;
+    }
+    return true;
+}
@@ -1,33 +1,81 @@
 #ifndef _COLLECTORS_H_
 #define _COLLECTORS_H_
 
-#include <mqueue.h>
+#include "../phase/phase.h"
+#include "../pipeline/pipeline.h"
+#include "../realtime/realtime.h"
+#include "engine.h"
+#include "startup.h"
 #include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
-/** The name of the message queue to be used for sensors to write their data. */
-#define SENSOR_QUEUE "fetcher/sensors"
-
 /** Macro for dereferencing the collector argument. */
 #define clctr_args(args) ((collector_args_t *)((args)))
 
+/** The maximum number of sensors of one kind which can be run as tasks of the acquisition engine. */
+#define COLLECTOR_MAX_TASKS 5
+
+/** The number of nanoseconds in a microsecond, for scheduling the steps of collector tasks. */
+#define NS_PER_US 1000ULL
+
+/** The maximum number of tags whose samples a collector can thin out. */
+#define CLCTR_MAX_DIVIDERS 4
+
+/** Publishes only one of every few readings of a tag. */
+typedef struct {
+    uint8_t tag;    /**< The tag of the readings. */
+    uint16_t n;     /**< One of every `n` readings is published. */
+    uint16_t count; /**< The number of readings since the last published one. */
+} clctr_divider_t;
+
+/** The rate at which a collector reads its sensor and publishes each tag. Zeroed, the collector's defaults are used. */
+typedef struct {
+    uint32_t period_us;                           /**< The time between two readings in microseconds, or 0. */
+    clctr_divider_t dividers[CLCTR_MAX_DIVIDERS]; /**< The tags of which only some readings are published. */
+    uint8_t ndividers;                            /**< The number of divided tags. */
+} clctr_rates_t;
+
+/**
+ * How an IMU filters its samples on chip, and how fast it samples in flight. Zeroed, the collector's defaults are used:
+ * no filtering beyond the first low-pass filter. Only used by IMU collectors.
+ */
+typedef struct {
+    uint16_t odr_hz;    /**< The output data rate and the rate samples are batched at in flight in Hz, or 0. */
+    uint16_t accel_lpf; /**< The accelerometer's low-pass bandwidth as a divisor of the output data rate, or 0. */
+    uint16_t accel_hpf; /**< The accelerometer's high-pass cutoff as a divisor of the output data rate, or 0. */
+    bool gyro_lpf_on;   /**< Whether the gyroscope's low-pass filter is enabled. */
+    uint8_t gyro_lpf;   /**< The bandwidth setting of the gyroscope's low-pass filter. */
+    uint16_t gyro_hpf;  /**< The gyroscope's high-pass cutoff in mHz, or 0. */
+} clctr_imu_t;
+
+/** Arguments for sensor threads. */
+typedef struct {
+    int bus;             /**< The I2C bus file descriptor. */
+    uint8_t addr;        /**< The address of the device on the I2C bus. */
+    uint8_t source;      /**< The index identifying this collector's samples in the pipeline. */
+    clctr_rates_t rates; /**< The rates at which the sensor is read and its tags are published. */
+    clctr_imu_t imu;     /**< How an IMU filters its samples. */
+} collector_args_t;
+
 typedef void *(*collector_t)(void *);
 
+/** Sets up a collector as a task of the acquisition engine, or returns NULL if no more tasks of its kind are left. */
+typedef task_t *(*collector_task_t)(const collector_args_t *args);
+
 /** Collector name + thread entries for associating control threads with sensor names. */
 typedef struct {
     const char *name;            /**< The name of the sensor associated with the collector thread. */
     const collector_t collector; /**< The function pointer to the collector thread. */
+    const collector_task_t task; /**< The function setting up the collector as an engine task. */
 } clctr_entry_t;
 
-/** Arguments for sensor threads. */
-typedef struct {
-    int bus;      /**< The I2C bus file descriptor. */
-    uint8_t addr; /**< The address of the device on the I2C bus. */
-} collector_args_t;
-
 collector_t collector_search(const char *sensor_name);
+collector_task_t collector_task_search(const char *sensor_name);
+uint32_t clctr_period_us(const clctr_rates_t *rates, uint32_t default_us);
+bool clctr_due(clctr_rates_t *rates, uint8_t tag);
 
 /* Collector threads */
 void *sysclock_collector(void *args);
@@ -37,4 +85,12 @@ void *lsm6dso32_collector(void *args);
 void *m10spg_collector(void *args);
 void *pac1952_2_collector(void *args);
 
+/* Collector tasks */
+task_t *sysclock_task(const collector_args_t *args);
+task_t *ms5611_task(const collector_args_t *args);
+task_t *sht41_task(const collector_args_t *args);
+task_t *lsm6dso32_task(const collector_args_t *args);
+task_t *m10spg_task(const collector_args_t *args);
+task_t *pac1952_2_task(const collector_args_t *args);
+
 #endif // _COLLECTORS_H_
@@ -0,0 +1,144 @@
+/**
+ * @file engine.c
+ * @brief Implementation of the engine which runs every collector on one thread.
+ *
+ * Implementation of the engine which runs every collector on one thread, stepping each task when it is due.
+ */
+#include "engine.h"
+#include "../logging-utils/logging.h"
+#include "../pipeline/pipeline.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The tasks which are still running, as a min-heap ordered by when their next step is due. */
+static task_t *heap[ENGINE_MAX_TASKS];
+
+/** The number of tasks which are still running. */
+static uint8_t ntasks = 0;
+
+/** Every task which was added to the engine, in the order they were added, for reporting. */
+static task_t *tasks[ENGINE_MAX_TASKS];
+
+/** The number of tasks which were added to the engine. */
+static uint8_t ntotal = 0;
+
+/**
+ * Moves a task up the heap until its parent is due before it.
+ * @param i The position of the task in the heap.
+ */
+static void sift_up(uint8_t i) {
+    while (i > 0) {
+        uint8_t parent = (uint8_t)((i - 1) / 2);
+        if (heap[parent]->due <= heap[i]->due) break;
+        task_t *swap = heap[parent];
+        heap[parent] = heap[i];
+        heap[i] = swap;
+        i = parent;
+    }
+}
+
+/**
+ * Moves a task down the heap until it is due before its children.
+ * @param i The position of the task in the heap.
+ */
+static void sift_down(uint8_t i) {
+    for (;;) {
+        uint8_t first = i;
+        uint8_t left = (uint8_t)(2 * i + 1);
+        uint8_t right = (uint8_t)(2 * i + 2);
+        if (left < ntasks && heap[left]->due < heap[first]->due) first = left;
+        if (right < ntasks && heap[right]->due < heap[first]->due) first = right;
+        if (first == i) return;
+        task_t *swap = heap[first];
+        heap[first] = heap[i];
+        heap[i] = swap;
+        i = first;
+    }
+}
+
+/**
+ * Removes every task from the engine. Only needed to run the engine again after it returned.
+ */
+void engine_init(void) {
+    ntasks = 0;
+    ntotal = 0;
+}
+
+/**
+ * Adds a task to the engine. Its first step is due as soon as the engine runs.
+ * @param task The task to add. Its name, context and step method must already be set.
+ * @return EOK if successful, ENOSPC if too many tasks were added.
+ */
+int engine_add(task_t *task) {
+    if (ntotal == ENGINE_MAX_TASKS) return ENOSPC;
+
+    task->due = pipeline_time();
+    memset(&task->stats, 0, sizeof(task->stats));
+    task->stats.name = task->name;
+    tasks[ntotal++] = task;
+    heap[ntasks] = task;
+    sift_up(ntasks++);
+    return EOK;
+}
+
+/**
+ * Runs the tasks on the calling thread, stepping each one when it is due, until every task has stopped. How late the
+ * steps were taken is reported periodically.
+ */
+void engine_run(void) {
+    uint64_t next_report = pipeline_time() + ENGINE_REPORT_PERIOD * NS_PER_SEC;
+
+    while (ntasks > 0) {
+        task_t *task = heap[0];
+        uint64_t now = pipeline_time();
+        if (now >= next_report) {
+            engine_report(stderr);
+            next_report += ENGINE_REPORT_PERIOD * NS_PER_SEC;
+        }
+        if (task->due > now) {
+            // Interrupted sleeps simply check again
+            uint64_t wait = task->due - now;
+            struct timespec duration = {.tv_sec = wait / NS_PER_SEC, .tv_nsec = wait % NS_PER_SEC};
+            nanosleep(&duration, NULL);
+            continue;
+        }
+
+        rt_stats_record(&task->stats, now - task->due);
+        uint64_t next = task->step(task, now);
+        if (next == TASK_DONE) {
+            log_print(stderr, LOG_WARN, "Collector task %s stopped", task->name);
+            heap[0] = heap[--ntasks];
+        } else {
+            task->due = next;
+        }
+        sift_down(0);
+    }
+}
+
+/**
+ * Schedules the next period of a task which runs at a fixed rate. Its periods start a whole number of periods after the
+ * first, no matter how late its steps are taken, so its rate does not drift.
+ * @param task The task, which counts the deadlines it missed.
+ * @param periodic The schedule of the task's periods, started on the pipeline's clock.
+ * @param now The current time in nanoseconds.
+ * @return When the task's next period is due.
+ */
+uint64_t engine_period(task_t *task, rt_periodic_t *periodic, uint64_t now) {
+    task->stats.overruns += rt_periodic_advance(periodic, now);
+    return periodic->next;
+}
+
+/**
+ * Prints how many steps each task took, how late they were taken after they were due and how many periodic deadlines
+ * each task missed.
+ * @param stream The stream to print the report to.
+ */
+void engine_report(FILE *stream) {
+    for (uint8_t i = 0; i < ntotal; i++) {
+        rt_stats_log(stream, "Collector task", &tasks[i]->stats);
+    }
+}
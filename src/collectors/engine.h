@@ -0,0 +1,55 @@
+/**
+ * @file engine.h
+ * @brief Types and function prototypes for the engine which runs every collector on one thread.
+ *
+ * Instead of giving each sensor its own thread which blocks while a conversion completes, the acquisition engine runs
+ * each collector as a task: a state machine whose steps never wait on the sensor. A step starts an operation (like a
+ * conversion), fetches the result of one which has had time to complete, or publishes it, and returns the time at which
+ * the task wants to take its next step. The engine keeps the tasks in a min-heap ordered by that time and sleeps until
+ * the earliest one is due, so one thread serves every sensor without polling and the order in which the sensors are
+ * read is decided in one place.
+ *
+ * The I2C transfers themselves are still synchronous, so a task's step holds up the loop while its transfers run.
+ */
+#ifndef _ENGINE_H_
+#define _ENGINE_H_
+
+#include "../realtime/realtime.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/** The maximum number of tasks that can be run by the engine. */
+#define ENGINE_MAX_TASKS 16
+
+/** The number of seconds between reports of how late the tasks' steps were taken. */
+#define ENGINE_REPORT_PERIOD 10
+
+/** Returned by a task's step once the task has stopped, so the engine no longer schedules it. */
+#define TASK_DONE UINT64_MAX
+
+/** A collector run by the acquisition engine as a state machine. */
+typedef struct task_t {
+    /** The name of the task, used for reporting. */
+    const char *name;
+    /** Task specific state. The memory must be provided by the user. */
+    void *ctx;
+    /**
+     * Takes the next step of the task. A step must not wait for the sensor to complete an operation.
+     * @param task The task who this step method belongs to.
+     * @param now The current time on the pipeline's clock in nanoseconds.
+     * @return The time at which the task's next step is due on the pipeline's clock, or TASK_DONE to stop the task.
+     */
+    uint64_t (*step)(struct task_t *task, uint64_t now);
+    /** The time at which the task's next step is due. */
+    uint64_t due;
+    /** How late the task's steps were taken after they were due, and how many periodic deadlines it missed. */
+    rt_stats_t stats;
+} task_t;
+
+void engine_init(void);
+int engine_add(task_t *task);
+void engine_run(void);
+uint64_t engine_period(task_t *task, rt_periodic_t *periodic, uint64_t now);
+void engine_report(FILE *stream);
+
+#endif // _ENGINE_H_
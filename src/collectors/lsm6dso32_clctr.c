@@ -6,118 +6,565 @@
 
 #define return_err(err) return (void *)((uint64_t)errno)
 
+/** The accelerometer and gyroscope full scale ranges. */
+#define ACCEL_FSR LA_FS_32G
+#define GYRO_FSR G_FS_500
+
+/** The time between two polls of the FIFO at flight rates in microseconds, short enough for the FIFO not to fill. */
+#define POLL_PERIOD_US 10000
+
+/** How the LSM6DSO32 is set up and read in a flight phase. */
+typedef struct {
+    accel_odr_e accel_odr;    /**< The output data rate of the accelerometer. */
+    gyro_odr_e gyro_odr;      /**< The output data rate of the gyroscope. */
+    bool high_performance;    /**< Whether the accelerometer runs in high performance mode. */
+    bool fifo;                /**< Whether samples are batched into the FIFO, or the sensor only watches for motion. */
+    accel_odr_e accel_bdr;    /**< The rate at which accelerometer samples are batched into the FIFO. */
+    gyro_odr_e gyro_bdr;      /**< The rate at which gyroscope samples are batched into the FIFO. */
+    uint32_t batch_period_ns; /**< The time between two samples batched into the FIFO in nanoseconds. */
+    uint32_t period_us;       /**< The default time between two polls, in microseconds. */
+} lsm6dso32_profile_t;
+
 /**
- * Collector thread for the LSM6DSO32 sensor.
- * @param args Arguments in the form of `collector_args_t`
- * @return The error `errno_t` which caused the thread to exit, encoded as a pointer.
+ * On the ground: the accelerometer only watches for motion with its wake-up and free-fall functions, and only their
+ * source is polled. Motion wakes the sensor up to flight rates within a sample and a poll.
  */
-void *lsm6dso32_collector(void *args) {
+static const lsm6dso32_profile_t GROUND = {
+    .accel_odr = LA_ODR_208,
+    .gyro_odr = G_ODR_12_5,
+    .high_performance = false,
+    .fifo = false,
+    .period_us = 10000,
+};
 
-    /* Open message queue. */
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_WRONLY);
-    if (sensor_q == -1) {
-        log_print(stderr, LOG_ERROR, "LSM6DSO32 collector could not open message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
-        return_err(err);
+/**
+ * Around launch and up to apogee, and on the ground once motion woke the sensor up: both sensors are batched into the
+ * FIFO at 833 Hz.
+ */
+static const lsm6dso32_profile_t FLIGHT = {
+    .accel_odr = LA_ODR_6664,
+    .gyro_odr = G_ODR_6664,
+    .high_performance = true,
+    .fifo = true,
+    .accel_bdr = LA_ODR_833,
+    .gyro_bdr = G_ODR_833,
+    .batch_period_ns = 1200000,
+    .period_us = POLL_PERIOD_US,
+};
+
+/** Under the parachute: both sensors are batched into the FIFO at 208 Hz. */
+static const lsm6dso32_profile_t DESCENT = {
+    .accel_odr = LA_ODR_208,
+    .gyro_odr = G_ODR_208,
+    .high_performance = true,
+    .fifo = true,
+    .accel_bdr = LA_ODR_208,
+    .gyro_bdr = G_ODR_208,
+    .batch_period_ns = 4800000,
+    .period_us = 50000,
+};
+
+/** How the LSM6DSO32 is set up in each flight phase. */
+static const lsm6dso32_profile_t *const PROFILES[PHASE_COUNT] = {
+    [PHASE_IDLE] = &GROUND,  [PHASE_ARMED] = &FLIGHT,   [PHASE_BOOST] = &FLIGHT,
+    [PHASE_COAST] = &FLIGHT, [PHASE_DESCENT] = &DESCENT, [PHASE_LANDED] = &GROUND,
+};
+
+/** The slope of the acceleration between two samples which wakes the sensor up, in thousandths of g. */
+#define WAKE_UP_THRESHOLD_MG 250
+
+/** How many samples after the first the slope must stay above the wake-up threshold for. */
+#define WAKE_UP_DURATION 0
+
+/** The acceleration below which every axis must stay for a free fall, which also wakes the sensor up. */
+#define FREE_FALL_THRESHOLD FF_THS_312MG
+
+/** How many samples the acceleration must stay below the free-fall threshold for (about 30 ms at 208 Hz). */
+#define FREE_FALL_DURATION 6
+
+/** How long the sensor stays at flight rates after motion woke it up, unless the flight phase moves on, in ns. */
+#define AWAKE_TIME_NS 10000000000ULL
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** An output data rate which can be selected for flight, and the time between two samples at that rate. */
+typedef struct {
+    uint16_t hz;        /**< The output data rate in Hz, rounded. */
+    accel_odr_e accel;  /**< The accelerometer's setting for the rate. */
+    gyro_odr_e gyro;    /**< The gyroscope's setting for the rate. */
+    uint32_t period_ns; /**< The time between two samples in nanoseconds. */
+} odr_t;
+
+/** The output data rates which can be selected for flight, which are all 6666.7 Hz divided by a power of two. */
+static const odr_t ODRS[] = {
+    {.hz = 26, .accel = LA_ODR_26, .gyro = G_ODR_26, .period_ns = 38400000},
+    {.hz = 52, .accel = LA_ODR_52, .gyro = G_ODR_52, .period_ns = 19200000},
+    {.hz = 104, .accel = LA_ODR_104, .gyro = G_ODR_104, .period_ns = 9600000},
+    {.hz = 208, .accel = LA_ODR_208, .gyro = G_ODR_208, .period_ns = 4800000},
+    {.hz = 416, .accel = LA_ODR_416, .gyro = G_ODR_416, .period_ns = 2400000},
+    {.hz = 833, .accel = LA_ODR_833, .gyro = G_ODR_833, .period_ns = 1200000},
+    {.hz = 1666, .accel = LA_ODR_1666, .gyro = G_ODR_1666, .period_ns = 600000},
+    {.hz = 3332, .accel = LA_ODR_3332, .gyro = G_ODR_3332, .period_ns = 300000},
+    {.hz = 6664, .accel = LA_ODR_6664, .gyro = G_ODR_6664, .period_ns = 150000},
+};
+
+/** How long to wait after rebooting the memory content, in microseconds. */
+#define REBOOT_TIME_US 100
+
+/** The steps of reading the LSM6DSO32 as an engine task. */
+typedef enum {
+    LSM6DSO32_RESET,     /**< Reset the sensor and reboot its memory content. */
+    LSM6DSO32_CONFIGURE, /**< Configure the sensor for the current flight phase. */
+    LSM6DSO32_POLL,      /**< Read and publish the sensor, and follow the flight phase. */
+} lsm6dso32_step_e;
+
+/** The state of the LSM6DSO32 collector task. */
+typedef struct {
+    task_t task;                        /**< The task run by the engine. */
+    SensorLocation loc;                 /**< The location of the sensor. */
+    lsm6dso32_shadow_t shadow;          /**< The shadow of the sensor's registers. */
+    uint8_t source;                     /**< The index identifying the collector's samples in the pipeline. */
+    lsm6dso32_step_e next;              /**< The next step of the task. */
+    rt_periodic_t periodic;             /**< The schedule of the polls. */
+    clctr_rates_t rates;                /**< The rates of the polls and of each tag. */
+    phase_view_t view;                  /**< The flight phase the sensor is configured for. */
+    clctr_imu_t imu;                    /**< How the sensor filters its samples. */
+    lsm6dso32_profile_t flight;         /**< How the sensor is set up in flight. */
+    const lsm6dso32_profile_t *profile; /**< How the sensor is configured. */
+    uint64_t motion;                    /**< When motion was last detected, on the pipeline's clock. */
+} lsm6dso32_task_t;
+
+/**
+ * Sets up how the LSM6DSO32 is read in flight: at the output data rate selected for the collector if any, with every
+ * sample batched into the FIFO, and at the default flight profile otherwise.
+ * @param imu How the collector's IMU filters its samples and samples in flight.
+ * @param flight Set to how the sensor is read in flight.
+ */
+static void flight_profile(const clctr_imu_t *imu, lsm6dso32_profile_t *flight) {
+    *flight = FLIGHT;
+    if (imu->odr_hz == 0) return;
+    for (size_t i = 0; i < sizeof(ODRS) / sizeof(ODRS[0]); i++) {
+        if (ODRS[i].hz != imu->odr_hz) continue;
+        flight->accel_odr = ODRS[i].accel;
+        flight->gyro_odr = ODRS[i].gyro;
+        flight->accel_bdr = ODRS[i].accel;
+        flight->gyro_bdr = ODRS[i].gyro;
+        flight->batch_period_ns = ODRS[i].period_ns;
+        return;
     }
+    log_print(stderr, LOG_WARN, "LSM6DSO32 has no %u Hz output data rate, keeping the default", imu->odr_hz);
+}
 
-    SensorLocation loc = {
-        .addr = {.addr = clctr_args(args)->addr, .fmt = I2C_ADDRFMT_7BIT},
-        .bus = clctr_args(args)->bus,
-    };
+/**
+ * Gets how the LSM6DSO32 is set up in a flight phase.
+ * @param phase The flight phase.
+ * @param flight How the sensor is set up in flight, which replaces the default flight profile.
+ * @return How the sensor is set up.
+ */
+static const lsm6dso32_profile_t *phase_profile(phase_e phase, const lsm6dso32_profile_t *flight) {
+    return PROFILES[phase] == &FLIGHT ? flight : PROFILES[phase];
+}
 
-    int err;
-    err = lsm6dso32_reset(&loc);
+/** The samples which a poll takes from the FIFO, all of them dated from the first read of the FIFO. */
+typedef struct {
+    uint64_t time; /**< When the FIFO was first read in the poll, on the pipeline's clock. */
+    size_t words;  /**< The number of words the FIFO held then, which is all the poll takes. */
+    size_t naccel; /**< The number of accelerometer samples among them. */
+    size_t ngyro;  /**< The number of gyroscope samples among them. */
+    size_t accel;  /**< The number of accelerometer samples taken so far. */
+    size_t gyro;   /**< The number of gyroscope samples taken so far. */
+} fifo_poll_t;
+
+/**
+ * Converts the samples read from the FIFO and publishes them in the order they were acquired. The FIFO does not keep
+ * acquisition times, so the newest samples the FIFO held when the poll first read it are taken to have been acquired
+ * then, and the others one batch period apart before them. Only the first read tells how many words the FIFO holds, so
+ * the number of samples of each sensor is estimated from the share of each in the first read. Samples beyond that
+ * estimate are dated from the first read, so that a sensor's times never go back. Each sample counts as a reading of
+ * its tag, so thinned out samples are dropped.
+ * @param source The index of the collector.
+ * @param rates The rates of the collector.
+ * @param fifo The samples read from the FIFO.
+ * @param batch_period_ns The time between two samples batched into the FIFO in nanoseconds.
+ * @param poll The samples of the poll, updated with the samples read.
+ */
+static void publish_fifo(uint8_t source, clctr_rates_t *rates, const lsm6dso32_fifo_t *fifo, uint32_t batch_period_ns,
+                         fifo_poll_t *poll) {
+    float accel[LSM6DSO32_FIFO_BURST][3];
+    float gyro[LSM6DSO32_FIFO_BURST][3];
+    sample_t samples[2 * LSM6DSO32_FIFO_BURST];
+    size_t n = 0;
+
+    lsm6dso32_convert(fifo->accel[0], accel[0], 3 * fifo->naccel, lsm6dso32_accel_sensitivity(ACCEL_FSR));
+    lsm6dso32_convert(fifo->gyro[0], gyro[0], 3 * fifo->ngyro, lsm6dso32_gyro_sensitivity(GYRO_FSR));
+
+    // Both sensors are batched at the same rate, so samples with as many newer samples of their own sensor after them
+    // were acquired at the same time
+    size_t a = 0;
+    size_t g = 0;
+    while (a < fifo->naccel || g < fifo->ngyro) {
+        bool is_accel = g == fifo->ngyro || (a < fifo->naccel && fifo->naccel - a >= fifo->ngyro - g);
+        size_t total = is_accel ? poll->naccel : poll->ngyro;
+        size_t taken = is_accel ? poll->accel++ : poll->gyro++;
+        size_t age = taken < total ? total - 1 - taken : 0;
+        uint64_t offset = (uint64_t)age * batch_period_ns;
+
+        const float *axes = is_accel ? accel[a++] : gyro[g++];
+        SensorTag tag = is_accel ? TAG_LINEAR_ACCEL_REL : TAG_ANGULAR_VEL;
+        if (!clctr_due(rates, tag)) continue;
+
+        sample_t *sample = &samples[n++];
+        *sample = (sample_t){.time = poll->time > offset ? poll->time - offset : 0,
+                             .source = source,
+                             .prio = is_accel ? 1 : 0};
+        sample->msg.type = tag;
+        sample->msg.data.VEC3D = (vec3d_t){.x = axes[0], .y = axes[1], .z = axes[2]};
+    }
+    pipeline_inject(samples, n);
+}
+
+/**
+ * Resets the LSM6DSO32 and reboots its memory content. It can be configured once the reboot time has passed.
+ * @param loc The location of the sensor.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int reset(SensorLocation *loc) {
+    int err = lsm6dso32_reset(loc);
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "Failed to reset LSM6DSO32: %s", strerror(err));
-        return_err(err);
+        return err;
     }
 
-    err = lsm6dso32_mem_reboot(&loc);
+    err = lsm6dso32_mem_reboot(loc);
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "Failed to reboot LSM6DSO32 memory content: %s", strerror(err));
-        return_err(err);
     }
+    return err;
+}
 
-    usleep(100);
+/**
+ * Stages the settings of the LSM6DSO32 for a flight phase: its output data rates and power mode, and whether samples
+ * are batched into its FIFO.
+ * @param shadow The shadow of the sensor's registers.
+ * @param profile How the sensor is set up.
+ */
+static void stage_profile(lsm6dso32_shadow_t *shadow, const lsm6dso32_profile_t *profile) {
+    lsm6dso32_high_performance(shadow, profile->high_performance);
+    lsm6dso32_set_acc_odr(shadow, profile->accel_odr);
+    lsm6dso32_set_gyro_odr(shadow, profile->gyro_odr);
+    if (profile->fifo) {
+        lsm6dso32_fifo_start(shadow, profile->accel_bdr, profile->gyro_bdr);
+    } else {
+        lsm6dso32_fifo_stop(shadow);
+    }
+}
 
-    err = lsm6dso32_high_performance(&loc, true);
+/**
+ * Sets the LSM6DSO32 up for a flight phase. The control registers are known from configuring the sensor, so this only
+ * takes a write and a readback of the control registers and of the FIFO's. Stopping the FIFO drops whatever it still
+ * holds, so it should be polled first.
+ * @param loc The location of the sensor.
+ * @param shadow The shadow of the sensor's registers.
+ * @param profile How the sensor is set up.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int apply_profile(SensorLocation *loc, lsm6dso32_shadow_t *shadow, const lsm6dso32_profile_t *profile) {
+    stage_profile(shadow, profile);
+    int err = lsm6dso32_commit(loc, shadow);
     if (err != EOK) {
-        log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 to high performance mode: %s", strerror(err));
-        return_err(err);
+        log_print(stderr, LOG_ERROR, "Failed to set up LSM6DSO32 for the flight phase: %s", strerror(err));
     }
+    return err;
+}
 
-    err = lsm6dso32_set_acc_fsr(&loc, LA_FS_32G);
+/**
+ * Stages the settings of the LSM6DSO32's digital filters: the accelerometer's LPF2 or high-pass filter, and the
+ * gyroscope's LPF1 and high-pass filter.
+ * @param shadow The shadow of the sensor's registers.
+ * @param imu How the sensor filters its samples.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int stage_filters(lsm6dso32_shadow_t *shadow, const clctr_imu_t *imu) {
+    accel_filter_e path = XL_FILTER_LPF1;
+    accel_bw_e bw = XL_BW_ODR_4;
+    if (imu->accel_lpf != 0) {
+        path = XL_FILTER_LPF2;
+        bw = (accel_bw_e)imu->accel_lpf;
+    } else if (imu->accel_hpf != 0) {
+        path = XL_FILTER_HPF;
+        bw = (accel_bw_e)imu->accel_hpf;
+    }
+    int err = lsm6dso32_accel_filter(shadow, path, bw);
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 accelerometer filter: %s", strerror(err));
+        return err;
+    }
+
+    err = lsm6dso32_gyro_lpf1(shadow, imu->gyro_lpf_on, imu->gyro_lpf);
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 gyroscope low-pass filter: %s", strerror(err));
+        return err;
+    }
+
+    err = lsm6dso32_gyro_hpf(shadow, (gyro_hpf_e)imu->gyro_hpf);
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 gyroscope high-pass filter: %s", strerror(err));
+    }
+    return err;
+}
+
+/**
+ * Configures the LSM6DSO32's full scale ranges, digital filters and its wake-up and free-fall functions, and sets it up
+ * for a flight phase. Every setting is staged first, and then written together: the control registers, the FIFO's and
+ * the embedded functions' each take a read, a write and a readback.
+ * @param loc The location of the sensor.
+ * @param shadow The shadow of the sensor's registers, emptied since the sensor was reset.
+ * @param imu How the sensor filters its samples.
+ * @param profile How the sensor is set up in the flight phase.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int configure(SensorLocation *loc, lsm6dso32_shadow_t *shadow, const clctr_imu_t *imu,
+                     const lsm6dso32_profile_t *profile) {
+    int err = lsm6dso32_set_acc_fsr(shadow, ACCEL_FSR);
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 accelerometer FSR: %s", strerror(err));
-        return_err(err);
+        return err;
     }
 
-    err = lsm6dso32_set_gyro_fsr(&loc, G_FS_500);
+    err = lsm6dso32_set_gyro_fsr(shadow, GYRO_FSR);
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 gyroscope FSR: %s", strerror(err));
-        return_err(err);
+        return err;
     }
 
-    err = lsm6dso32_set_acc_odr(&loc, LA_ODR_6664);
+    err = stage_filters(shadow, imu);
+    if (err != EOK) return err;
+
+    err = lsm6dso32_wake_up_config(shadow, ACCEL_FSR, WAKE_UP_THRESHOLD_MG, WAKE_UP_DURATION);
     if (err != EOK) {
-        log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 accelerometer ODR: %s", strerror(err));
-        return_err(err);
+        log_print(stderr, LOG_ERROR, "Failed to set up LSM6DSO32 wake-up detection: %s", strerror(err));
+        return err;
     }
 
-    err = lsm6dso32_set_gyro_odr(&loc, G_ODR_6664);
+    err = lsm6dso32_free_fall_config(shadow, FREE_FALL_THRESHOLD, FREE_FALL_DURATION);
     if (err != EOK) {
-        log_print(stderr, LOG_ERROR, "Failed to set LSM6DSO32 gyroscope ODR: %s", strerror(err));
-        return_err(err);
+        log_print(stderr, LOG_ERROR, "Failed to set up LSM6DSO32 free-fall detection: %s", strerror(err));
+        return err;
+    }
+
+    lsm6dso32_int_enable(shadow, true);
+    stage_profile(shadow, profile);
+    err = lsm6dso32_commit(loc, shadow);
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Failed to configure LSM6DSO32: %s", strerror(err));
     }
+    return err;
+}
 
+/**
+ * Reads and publishes the temperature, and every sample batched into the FIFO since the last poll if the FIFO is used.
+ * The temperature is not read at all on the polls where it is thinned out.
+ * @param loc The location of the sensor.
+ * @param source The index of the collector.
+ * @param rates The rates of the collector.
+ * @param profile How the sensor is set up.
+ */
+static void poll_sensor(SensorLocation *loc, uint8_t source, clctr_rates_t *rates, const lsm6dso32_profile_t *profile) {
     common_t msg;
     int16_t temperature;
-    int16_t x;
-    int16_t y;
-    int16_t z;
-
-    for (;;) {
+    lsm6dso32_fifo_t fifo;
+    int err;
 
-        // Read temperature
-        err = lsm6dso32_get_temp(&loc, &temperature);
+    // Read temperature
+    if (clctr_due(rates, TAG_TEMPERATURE)) {
+        err = lsm6dso32_get_temp(loc, &temperature);
         if (err != EOK) {
             log_print(stderr, LOG_ERROR, "LSM6DSO32 could not read temperature: %s", strerror(err));
         } else {
             msg.type = TAG_TEMPERATURE;
-            msg.data.FLOAT = (float)temperature;
-            if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-                log_print(stderr, LOG_ERROR, "LSM6DSO32 couldn't send message: %s", strerror(err));
-            }
+            msg.data.FLOAT = lsm6dso32_convert_temp(temperature);
+            pipeline_publish(source, &msg, 0);
         }
+    }
 
-        // Read linear acceleration
-        err = lsm6dso32_get_accel(&loc, &x, &y, &z);
+    // Read the linear acceleration and angular velocity batched since the last poll, up to what the FIFO held when it
+    // was first read. Samples batched while it is read are left for the next poll, which dates them from its own read.
+    if (!profile->fifo) return;
+    fifo_poll_t poll = {0};
+    do {
+        err = lsm6dso32_fifo_read(loc, &fifo);
         if (err != EOK) {
-            log_print(stderr, LOG_ERROR, "LSM6DSO32 could not read linear acceleration: %s", strerror(err));
-        } else {
-            lsm6dso32_convert_accel(LA_FS_32G, &x, &y, &z);
-            msg.type = TAG_LINEAR_ACCEL_REL;
-            msg.data.VEC3D = (vec3d_t){.x = x, .y = y, .z = z};
-            if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 1) == -1) {
-                log_print(stderr, LOG_ERROR, "LSM6DSO32 couldn't send message: %s", strerror(err));
-            }
+            log_print(stderr, LOG_ERROR, "LSM6DSO32 could not read FIFO: %s", strerror(err));
+            break;
+        }
+        if (fifo.overrun) {
+            log_print(stderr, LOG_WARN, "LSM6DSO32 FIFO overflowed, some samples were lost");
+        }
+        size_t read = fifo.naccel + fifo.ngyro;
+        if (poll.words == 0) {
+            if (read == 0) break;
+            poll.time = pipeline_time();
+            poll.words = read + fifo.remaining;
+            poll.naccel = poll.words * fifo.naccel / read;
+            poll.ngyro = poll.words - poll.naccel;
         }
+        publish_fifo(source, rates, &fifo, profile->batch_period_ns, &poll);
+    } while (fifo.remaining > 0 && poll.accel + poll.gyro < poll.words);
+}
 
-        // Read angular velocity
-        err = lsm6dso32_get_angular_vel(&loc, &x, &y, &z);
+/**
+ * Sets the LSM6DSO32 up for the flight phase if it changed since it was last set up. In a phase where the sensor only
+ * watches for motion, it is set up at flight rates as soon as motion is detected, and back once it has been still for
+ * AWAKE_TIME_NS. It is called right after a poll, so nothing batched into the FIFO is lost. If the sensor could not be
+ * set up, it is tried again after the next poll.
+ * @param loc The location of the sensor.
+ * @param shadow The shadow of the sensor's registers.
+ * @param view The flight phase the sensor is set up for, updated once it is set up for the new one.
+ * @param flight How the sensor is set up in flight.
+ * @param profile How the sensor is set up.
+ * @param motion When motion was last detected, updated when it is detected again.
+ * @return How the sensor is set up now.
+ */
+static const lsm6dso32_profile_t *follow_phase(SensorLocation *loc, lsm6dso32_shadow_t *shadow, phase_view_t *view,
+                                               const lsm6dso32_profile_t *flight, const lsm6dso32_profile_t *profile,
+                                               uint64_t *motion) {
+    phase_view_t next = *view;
+    if (phase_poll(&next)) {
+        if (apply_profile(loc, shadow, phase_profile(next.phase, flight)) != EOK) return profile;
+        *view = next;
+        phase_applied(view, "LSM6DSO32");
+        return phase_profile(view->phase, flight);
+    }
+    if (PROFILES[view->phase]->fifo) return profile;
 
-        if (err != EOK) {
-            log_print(stderr, LOG_ERROR, "LSM6DSO32 could not read angular velocity: %s", strerror(err));
-        } else {
-            lsm6dso32_convert_angular_vel(G_FS_500, &x, &y, &z);
-            msg.type = TAG_ANGULAR_VEL;
-            msg.data.VEC3D = (vec3d_t){.x = x, .y = y, .z = z};
-            if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-                log_print(stderr, LOG_ERROR, "LSM6DSO32 couldn't send message: %s", strerror(err));
-            }
+    // Reading the source clears it, so each detection is seen once
+    uint8_t src;
+    int err = lsm6dso32_get_wake_up_src(loc, &src);
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "LSM6DSO32 could not read wake-up source: %s", strerror(err));
+        return profile;
+    }
+
+    uint64_t now = pipeline_time();
+    if (src & (LSM6DSO32_WU_IA | LSM6DSO32_FF_IA)) {
+        *motion = now;
+        if (profile == flight || apply_profile(loc, shadow, flight) != EOK) return profile;
+        log_print(stderr, LOG_INFO, "LSM6DSO32 woke up on %s", (src & LSM6DSO32_FF_IA) ? "free fall" : "motion");
+        return flight;
+    }
+
+    if (profile != flight || now - *motion < AWAKE_TIME_NS) return profile;
+    if (apply_profile(loc, shadow, PROFILES[view->phase]) != EOK) return profile;
+    log_print(stderr, LOG_INFO, "LSM6DSO32 back to sleep after %llu s without motion", AWAKE_TIME_NS / NS_PER_SEC);
+    return PROFILES[view->phase];
+}
+
+/**
+ * Collector thread for the LSM6DSO32 sensor.
+ * @param args Arguments in the form of `collector_args_t`
+ * @return The error `errno_t` which caused the thread to exit, encoded as a pointer.
+ */
+void *lsm6dso32_collector(void *args) {
+
+    SensorLocation loc = {
+        .addr = {.addr = clctr_args(args)->addr, .fmt = I2C_ADDRFMT_7BIT},
+        .bus = clctr_args(args)->bus,
+    };
+
+    int err = reset(&loc);
+    if (err != EOK) {
+        return_err(err);
+    }
+
+    rt_usleep(REBOOT_TIME_US);
+
+    lsm6dso32_shadow_t shadow;
+    lsm6dso32_shadow_init(&shadow);
+    lsm6dso32_profile_t flight;
+    flight_profile(&clctr_args(args)->imu, &flight);
+    phase_view_t view;
+    phase_get(&view);
+    const lsm6dso32_profile_t *profile = phase_profile(view.phase, &flight);
+    err = configure(&loc, &shadow, &clctr_args(args)->imu, profile);
+    if (err != EOK) {
+        return_err(err);
+    }
+    startup_ready(clctr_args(args)->source);
+
+    // Polls missed while the bus was busy are skipped, since the FIFO keeps every sample until the next poll
+    clctr_rates_t rates = clctr_args(args)->rates;
+    uint64_t motion = 0;
+    rt_periodic_t periodic;
+    rt_periodic_init(&periodic, clctr_period_us(&rates, profile->period_us), RT_SKIP, rt_now());
+    for (;;) {
+        rt_periodic_wait(&periodic);
+        poll_sensor(&loc, clctr_args(args)->source, &rates, profile);
+        const lsm6dso32_profile_t *next = follow_phase(&loc, &shadow, &view, &flight, profile, &motion);
+        if (next != profile) {
+            profile = next;
+            rt_periodic_init(&periodic, clctr_period_us(&rates, profile->period_us), RT_SKIP, rt_now());
         }
+    }
+}
+
+/**
+ * Takes the next step of reading the LSM6DSO32. The time between polls of the FIFO is waited for by the engine instead
+ * of sleeping.
+ * @param task The LSM6DSO32 collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE if the sensor could not be set up.
+ */
+static uint64_t lsm6dso32_step(task_t *task, uint64_t now) {
+    lsm6dso32_task_t *t = task->ctx;
 
-        usleep(1000);
+    switch (t->next) {
+    case LSM6DSO32_RESET:
+        if (reset(&t->loc) != EOK) return TASK_DONE;
+        t->next = LSM6DSO32_CONFIGURE;
+        return now + REBOOT_TIME_US * NS_PER_US;
+    case LSM6DSO32_CONFIGURE:
+        phase_get(&t->view);
+        t->profile = phase_profile(t->view.phase, &t->flight);
+        lsm6dso32_shadow_init(&t->shadow);
+        if (configure(&t->loc, &t->shadow, &t->imu, t->profile) != EOK) return TASK_DONE;
+        startup_ready(t->source);
+        t->next = LSM6DSO32_POLL;
+        rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, t->profile->period_us), RT_SKIP, now);
+        break;
+    case LSM6DSO32_POLL: {
+        poll_sensor(&t->loc, t->source, &t->rates, t->profile);
+        const lsm6dso32_profile_t *next =
+            follow_phase(&t->loc, &t->shadow, &t->view, &t->flight, t->profile, &t->motion);
+        if (next != t->profile) {
+            t->profile = next;
+            rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, t->profile->period_us), RT_SKIP, now);
+        }
+        break;
+    }
     }
+    return engine_period(task, &t->periodic, now);
+}
+
+/**
+ * Sets up an LSM6DSO32 collector as a task of the acquisition engine.
+ * @param args The location, index and rates of the collector.
+ * @return The task, or NULL if no more LSM6DSO32 tasks are left.
+ */
+task_t *lsm6dso32_task(const collector_args_t *args) {
+    static lsm6dso32_task_t tasks[COLLECTOR_MAX_TASKS];
+    static uint8_t ntasks = 0;
+    if (ntasks == COLLECTOR_MAX_TASKS) return NULL;
+
+    lsm6dso32_task_t *t = &tasks[ntasks++];
+    *t = (lsm6dso32_task_t){
+        .task = {.name = "LSM6DSO32", .ctx = t, .step = lsm6dso32_step},
+        .loc = {.bus = args->bus, .addr = {.addr = args->addr, .fmt = I2C_ADDRFMT_7BIT}},
+        .source = args->source,
+        .rates = args->rates,
+        .imu = args->imu,
+        .next = LSM6DSO32_RESET,
+    };
+    flight_profile(&t->imu, &t->flight);
+    return &t->task;
 }
@@ -3,48 +3,186 @@
 #include "../logging-utils/logging.h"
 #include "collectors.h"
 
+/** How long the M10SPG takes to soft reset, in microseconds. */
+#define RESET_TIME_US 1000000
+
+/**
+ * How long to wait for the GPS subsystem to restart after the configuration was interrupted, and before trying to open
+ * the M10SPG again after any other error, in microseconds.
+ */
+#define RESTART_TIME_US 500000
+
+/** How long to wait between checks for a response from the M10SPG, in microseconds. */
+#define RECV_POLL_US 1000
+
+/** How long to wait for a response from the M10SPG, in microseconds. */
+#define RESPONSE_TIMEOUT_US 2000000
+
+/**
+ * The time between two measurements of the receiver in each flight phase, in milliseconds. The position changes the
+ * fastest during the boost and the coast, and hardly at all on the ground.
+ */
+static const uint16_t MEASUREMENT_RATES[PHASE_COUNT] = {
+    [PHASE_IDLE] = 1000, [PHASE_ARMED] = NOMINAL_MEASUREMENT_RATE, [PHASE_BOOST] = 100,
+    [PHASE_COAST] = 100, [PHASE_DESCENT] = 200,                    [PHASE_LANDED] = 1000,
+};
+
 union read_buffer {
     UBXNavPositionPayload pos;
     UBXNavVelocityPayload vel;
     UBXNavStatusPayload stat;
 };
 
+/** The steps of reading the M10SPG as an engine task. */
+typedef enum {
+    M10SPG_QUERY,      /**< Poll the receiver's configuration. */
+    M10SPG_CONFIG,     /**< Check whether the receiver already has our configuration. */
+    M10SPG_CONFIG_ACK, /**< Check whether the poll was acknowledged, and keep the receiver's state if so. */
+    M10SPG_RESET,      /**< Soft reset the receiver. */
+    M10SPG_CONFIGURE,  /**< Send our configuration. */
+    M10SPG_ACK,        /**< Check whether the configuration was acknowledged. */
+    M10SPG_RATE_ACK,   /**< Check whether the measurement rate of a new flight phase was acknowledged. */
+    M10SPG_REQUEST,    /**< Request the navigation status. */
+    M10SPG_STATUS,     /**< Check for the navigation status, and request the position if there is a fix. */
+    M10SPG_POSITION,   /**< Check for the position and publish it. */
+} m10spg_step_e;
+
+/** The state of the M10SPG collector task. */
+typedef struct {
+    task_t task;            /**< The task run by the engine. */
+    SensorLocation loc;     /**< The location of the sensor. */
+    uint8_t source;         /**< The index identifying the collector's samples in the pipeline. */
+    m10spg_step_e next;     /**< The next step of the task. */
+    uint64_t deadline;      /**< When the response being waited for times out. */
+    GPSFixType fix_type;    /**< The fix type of the position being read. */
+    union read_buffer buf;  /**< The response being read. */
+    rt_periodic_t periodic; /**< The schedule of the readings. */
+    clctr_rates_t rates;    /**< The rates of the readings and of each tag. */
+    uint16_t rate_ms;       /**< The time between two measurements of the receiver, in milliseconds. */
+    uint16_t config_rate;   /**< The time between two measurements the receiver was found with, in milliseconds. */
+    bool applied;           /**< Whether the receiver was found with our configuration. */
+    phase_view_t view;      /**< The flight phase the measurement rate follows. */
+    phase_view_t pending;   /**< The flight phase whose measurement rate is waiting to be acknowledged. */
+} m10spg_task_t;
+
 /**
- * Helper function to simplify sending a message on the message queue
+ * Gets the time between two measurements of the receiver, which is also the time between two readings so that the same
+ * measurement is not read twice. A rate selected for the collector applies in every flight phase.
+ * @param rates The rates of the collector.
+ * @param phase The flight phase.
+ * @return The time between two measurements in milliseconds, within what the receiver accepts.
  */
-#define send_msg(sensor_q, msg, prio)                                                                                  \
-    if (mq_send((sensor_q), (char *)(&(msg)), sizeof(msg), (prio)) == -1) {                                            \
-        log_print(stderr, LOG_WARN, "M10SPG couldn't send message: %s.", strerror(errno));                             \
-    }
+static uint16_t measurement_rate(const clctr_rates_t *rates, phase_e phase) {
+    uint32_t rate_ms = clctr_period_us(rates, MEASUREMENT_RATES[phase] * 1000) / 1000;
+    if (rate_ms < MIN_MEASUREMENT_RATE) return MIN_MEASUREMENT_RATE;
+    if (rate_ms > UINT16_MAX) return UINT16_MAX;
+    return (uint16_t)rate_ms;
+}
 
-void *m10spg_collector(void *args) {
+/**
+ * Publishes a position read from the M10SPG, except for the values whose tags are thinned out.
+ * @param source The index of the collector.
+ * @param rates The rates of the collector.
+ * @param fix_type The fix type of the position.
+ * @param pos The position.
+ */
+static void publish_position(uint8_t source, clctr_rates_t *rates, GPSFixType fix_type,
+                             const UBXNavPositionPayload *pos) {
+    common_t msg;
+    switch (fix_type) {
+    case GPS_3D_FIX:
+        if (clctr_due(rates, TAG_ALTITUDE_SEA)) {
+            msg.type = TAG_ALTITUDE_SEA;
+            msg.data.FLOAT = (((float)pos->hMSL) / ALT_SCALE_TO_METERS);
+            pipeline_publish(source, &msg, 2);
+        }
+        // FALL THROUGH
+    case GPS_FIX_DEAD_RECKONING:
+        // FALL THROUGH
+    case GPS_2D_FIX:
+        // FALL THROUGH
+    case GPS_DEAD_RECKONING:
+        if (!clctr_due(rates, TAG_COORDS)) break;
+        msg.type = TAG_COORDS;
+        msg.data.VEC2D_I32.x = pos->lat;
+        msg.data.VEC2D_I32.y = pos->lon;
+        pipeline_publish(source, &msg, 3);
+        break;
+    case GPS_TIME_ONLY:
+        break;
+    default:
+        break;
+    }
+}
 
-    /* Open message queue. */
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_WRONLY);
-    if (sensor_q == -1) {
-        log_print(stderr, LOG_ERROR, "M10SPG collector could not open message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
-        return (void *)((uint64_t)errno);
+/**
+ * Changes the measurement rate of the M10SPG and waits for the change to be acknowledged.
+ * @param loc The location of the receiver.
+ * @param rate_ms The time between two measurements in milliseconds.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int set_rate(const SensorLocation *loc, uint16_t rate_ms) {
+    int err = m10spg_set_rate(loc, rate_ms);
+    for (uint32_t waited = 0; err == EOK || err == EAGAIN; waited += RECV_POLL_US) {
+        if (waited >= RESPONSE_TIMEOUT_US) {
+            err = ETIMEDOUT;
+            break;
+        }
+        rt_usleep(RECV_POLL_US);
+        err = m10spg_fetch_ack(loc);
+        if (err == EOK) return EOK;
     }
+    log_print(stderr, LOG_ERROR, "Could not set M10SPG measurement rate: %s", strerror(err));
+    return err;
+}
+
+/**
+ * Collector thread for the M10SPG sensor.
+ * @param args Arguments in the form of `collector_args_t`
+ * @return The error `errno_t` which caused the thread to exit, encoded as a pointer.
+ */
+void *m10spg_collector(void *args) {
 
     SensorLocation loc = {
         .bus = clctr_args(args)->bus,
         .addr = {.addr = (clctr_args(args)->addr), .fmt = I2C_ADDRFMT_7BIT},
     };
 
+    clctr_rates_t rates = clctr_args(args)->rates;
+    phase_view_t view;
+    phase_get(&view);
+    uint16_t rate_ms = measurement_rate(&rates, view.phase);
     int err;
     do {
-        err = m10spg_open(&loc);
+        err = m10spg_open(&loc, rate_ms);
         if (err != EOK) {
             log_print(stderr, LOG_ERROR, "Could not open M10SPG: %s", strerror(err));
+            // An interrupted configuration already waited for the restart, anything else waits before trying again
+            if (err != EINTR) rt_usleep(RESTART_TIME_US);
         }
     } while (err != EOK);
+    startup_ready(clctr_args(args)->source);
 
+    // Read once per measurement, so that the same epoch is not read again
+    rt_periodic_t periodic;
+    rt_periodic_init(&periodic, rate_ms * 1000, RT_SKIP, rt_now());
     for (;;) {
-        // TODO - Don't read if the next epoch hasn't happened
+        rt_periodic_wait(&periodic);
+
+        // Follow the flight phase between two readings, keeping the old rate to try again if it could not be changed
+        phase_view_t next = view;
+        if (phase_poll(&next)) {
+            uint16_t next_rate = measurement_rate(&rates, next.phase);
+            if (next_rate == rate_ms || set_rate(&loc, next_rate) == EOK) {
+                view = next;
+                rate_ms = next_rate;
+                rt_periodic_init(&periodic, rate_ms * 1000, RT_SKIP, rt_now());
+                phase_applied(&view, "MAXM10S");
+            }
+        }
+
         union read_buffer buf;
         GPSFixType fix_type = GPS_NO_FIX;
-        common_t msg;
         err = m10spg_send_command(&loc, UBX_NAV_STAT, &buf, sizeof(UBXNavStatusPayload));
 
         // Check if we could send command
@@ -68,27 +206,7 @@ void *m10spg_collector(void *args) {
             continue;
         }
 
-        switch (fix_type) {
-        case GPS_3D_FIX:
-            msg.type = TAG_ALTITUDE_SEA;
-            msg.data.FLOAT = (((float)buf.pos.hMSL) / ALT_SCALE_TO_METERS);
-            send_msg(sensor_q, msg, 2);
-            // FALL THROUGH
-        case GPS_FIX_DEAD_RECKONING:
-            // FALL THROUGH
-        case GPS_2D_FIX:
-            // FALL THROUGH
-        case GPS_DEAD_RECKONING:
-            msg.type = TAG_COORDS;
-            msg.data.VEC2D_I32.x = buf.pos.lat;
-            msg.data.VEC2D_I32.y = buf.pos.lon;
-            send_msg(sensor_q, msg, 3);
-            break;
-        case GPS_TIME_ONLY:
-            break;
-        default:
-            break;
-        }
+        publish_position(clctr_args(args)->source, &rates, fix_type, &buf.pos);
     }
 
     // Read velocity
@@ -111,3 +229,196 @@ void *m10spg_collector(void *args) {
     log_print(stderr, LOG_ERROR, "%s", strerror(err));
     return (void *)((uint64_t)err);
 }
+
+/**
+ * Checks for a response from the M10SPG, and whether it has timed out.
+ * @param t The M10SPG collector task.
+ * @param err The result of fetching the response.
+ * @param now The current time in nanoseconds.
+ * @return EAGAIN if the response should be checked for again, ETIMEDOUT if it timed out, otherwise `err`.
+ */
+static int check_response(const m10spg_task_t *t, int err, uint64_t now) {
+    if (err == EAGAIN && now >= t->deadline) return ETIMEDOUT;
+    return err;
+}
+
+/**
+ * Starts reading the M10SPG once it has been opened.
+ * @param t The M10SPG collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the first reading is due.
+ */
+static uint64_t start_reading(m10spg_task_t *t, uint64_t now) {
+    t->next = M10SPG_REQUEST;
+    startup_ready(t->source);
+    rt_periodic_init(&t->periodic, t->rate_ms * 1000, RT_SKIP, now);
+    return now;
+}
+
+/**
+ * Takes the next step of reading the M10SPG. The receiver is only reset and configured if it does not already have our
+ * configuration, so that it keeps its navigation state when fetcher restarts. The reset and the responses are waited
+ * for by the engine instead of sleeping, by checking for a response every millisecond until it arrives or times out.
+ * @param task The M10SPG collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due.
+ */
+static uint64_t m10spg_step(task_t *task, uint64_t now) {
+    m10spg_task_t *t = task->ctx;
+    int err = EOK;
+
+    switch (t->next) {
+    case M10SPG_QUERY:
+        err = m10spg_query_config(&t->loc);
+        if (err != EOK) break;
+        t->next = M10SPG_CONFIG;
+        t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+        return now + RECV_POLL_US * NS_PER_US;
+    case M10SPG_CONFIG:
+        err = m10spg_fetch_config(&t->loc, &t->applied, &t->config_rate);
+        // Read through anything left over from before, like the response to a poll of a previous run
+        if (err == EINTR) err = EAGAIN;
+        err = check_response(t, err, now);
+        if (err == EAGAIN) return now + RECV_POLL_US * NS_PER_US;
+        t->next = err == EOK ? M10SPG_CONFIG_ACK : M10SPG_RESET;
+        t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+        return now + RECV_POLL_US * NS_PER_US;
+    case M10SPG_CONFIG_ACK:
+        err = check_response(t, m10spg_fetch_ack(&t->loc), now);
+        if (err == EAGAIN) return now + RECV_POLL_US * NS_PER_US;
+        if (err != EOK || !t->applied) {
+            t->next = M10SPG_RESET;
+            return now;
+        }
+        if (t->config_rate == t->rate_ms) return start_reading(t, now);
+
+        // Only the measurement rate differs, which needs no reset
+        err = m10spg_set_rate(&t->loc, t->rate_ms);
+        if (err != EOK) break;
+        t->next = M10SPG_ACK;
+        t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+        return now + RECV_POLL_US * NS_PER_US;
+    case M10SPG_RESET:
+        m10spg_reset(&t->loc); // Has no response
+        t->next = M10SPG_CONFIGURE;
+        return now + RESET_TIME_US * NS_PER_US;
+    case M10SPG_CONFIGURE:
+        err = m10spg_configure(&t->loc, t->rate_ms);
+        if (err != EOK) break;
+        t->next = M10SPG_ACK;
+        t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+        return now + RECV_POLL_US * NS_PER_US;
+    case M10SPG_ACK:
+        err = check_response(t, m10spg_fetch_ack(&t->loc), now);
+        if (err == EAGAIN) return now + RECV_POLL_US * NS_PER_US;
+        if (err == EOK) return start_reading(t, now);
+        if (err == EINTR) {
+            // Give the gps subsystem time to restart, because we disabled the BDS signal
+            log_print(stderr, LOG_ERROR, "Could not open M10SPG: %s", strerror(err));
+            t->next = M10SPG_RESET;
+            return now + RESTART_TIME_US * NS_PER_US;
+        }
+        break;
+    case M10SPG_RATE_ACK:
+        err = check_response(t, m10spg_fetch_ack(&t->loc), now);
+        if (err == EAGAIN) return now + RECV_POLL_US * NS_PER_US;
+        t->next = M10SPG_REQUEST;
+        if (err != EOK) {
+            // Keep the old rate, and try again at the start of the next period
+            log_print(stderr, LOG_ERROR, "Could not set M10SPG measurement rate: %s", strerror(err));
+            return engine_period(task, &t->periodic, now);
+        }
+        t->view = t->pending;
+        t->rate_ms = measurement_rate(&t->rates, t->view.phase);
+        rt_periodic_init(&t->periodic, t->rate_ms * 1000, RT_SKIP, now);
+        phase_applied(&t->view, "MAXM10S");
+        return now;
+    case M10SPG_REQUEST:
+        // Follow the flight phase between two readings
+        t->pending = t->view;
+        if (phase_poll(&t->pending)) {
+            uint16_t rate_ms = measurement_rate(&t->rates, t->pending.phase);
+            if (rate_ms == t->rate_ms) {
+                t->view = t->pending;
+                phase_applied(&t->view, "MAXM10S");
+            } else if ((err = m10spg_set_rate(&t->loc, rate_ms)) == EOK) {
+                t->next = M10SPG_RATE_ACK;
+                t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+                return now + RECV_POLL_US * NS_PER_US;
+            } else {
+                log_print(stderr, LOG_ERROR, "Could not set M10SPG measurement rate: %s", strerror(err));
+            }
+        }
+
+        err = m10spg_request(&t->loc, UBX_NAV_STAT);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not send command to M10SPG: %s", strerror(err));
+            return now + RECV_POLL_US * NS_PER_US;
+        }
+        t->next = M10SPG_STATUS;
+        t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+        return now + RECV_POLL_US * NS_PER_US;
+    case M10SPG_STATUS:
+        err = check_response(t, m10spg_fetch(&t->loc, &t->buf, sizeof(UBXNavStatusPayload)), now);
+        if (err == EAGAIN) return now + RECV_POLL_US * NS_PER_US;
+        t->next = M10SPG_REQUEST;
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not send command to M10SPG: %s", strerror(err));
+            return engine_period(task, &t->periodic, now);
+        }
+
+        // Don't bother reading any information if there's no fix
+        t->fix_type = t->buf.stat.gpsFix;
+        if (t->fix_type == GPS_NO_FIX) {
+            log_print(stderr, LOG_WARN, "M10SPG could not get fix, fix type: %d", t->fix_type);
+            return engine_period(task, &t->periodic, now);
+        }
+
+        err = m10spg_request(&t->loc, UBX_NAV_POSLLH);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "M10SPG failed to read position: %s", strerror(err));
+            return engine_period(task, &t->periodic, now);
+        }
+        t->next = M10SPG_POSITION;
+        t->deadline = now + RESPONSE_TIMEOUT_US * NS_PER_US;
+        return now + RECV_POLL_US * NS_PER_US;
+    case M10SPG_POSITION:
+        err = check_response(t, m10spg_fetch(&t->loc, &t->buf, sizeof(UBXNavPositionPayload)), now);
+        if (err == EAGAIN) return now + RECV_POLL_US * NS_PER_US;
+        t->next = M10SPG_REQUEST;
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "M10SPG failed to read position: %s", strerror(err));
+            return engine_period(task, &t->periodic, now);
+        }
+        publish_position(t->source, &t->rates, t->fix_type, &t->buf.pos);
+        return engine_period(task, &t->periodic, now);
+    }
+
+    // The receiver could not be opened, so start over like the collector thread does once the bus had time to recover
+    log_print(stderr, LOG_ERROR, "Could not open M10SPG: %s", strerror(err));
+    t->next = M10SPG_QUERY;
+    return now + RESTART_TIME_US * NS_PER_US;
+}
+
+/**
+ * Sets up an M10SPG collector as a task of the acquisition engine.
+ * @param args The location, index and rates of the collector.
+ * @return The task, or NULL if no more M10SPG tasks are left.
+ */
+task_t *m10spg_task(const collector_args_t *args) {
+    static m10spg_task_t tasks[COLLECTOR_MAX_TASKS];
+    static uint8_t ntasks = 0;
+    if (ntasks == COLLECTOR_MAX_TASKS) return NULL;
+
+    m10spg_task_t *t = &tasks[ntasks++];
+    *t = (m10spg_task_t){
+        .task = {.name = "MAXM10S", .ctx = t, .step = m10spg_step},
+        .loc = {.bus = args->bus, .addr = {.addr = args->addr, .fmt = I2C_ADDRFMT_7BIT}},
+        .source = args->source,
+        .rates = args->rates,
+        .next = M10SPG_QUERY,
+    };
+    phase_get(&t->view);
+    t->rate_ms = measurement_rate(&t->rates, t->view.phase);
+    return &t->task;
+}
@@ -6,6 +6,115 @@
 
 #define return_errno(err) return (void *)((uint64_t)err)
 
+/** How long the MS5611 takes to reset, in microseconds. */
+#define RESET_TIME_US 10000
+
+/** How the MS5611 is read in a flight phase. */
+typedef struct {
+    MS5611Resolution resolution; /**< The resolution of the conversions. */
+    uint32_t period_us;          /**< The default time between two readings, in microseconds. */
+} ms5611_profile_t;
+
+/**
+ * How the MS5611 is read in each flight phase. Each period leaves room for both conversions and their transfers. During
+ * the boost, the readings come faster at a lower resolution, since the altitude changes the most then.
+ */
+static const ms5611_profile_t PROFILES[PHASE_COUNT] = {
+    [PHASE_IDLE] = {.resolution = ADC_RES_4096, .period_us = 200000},
+    [PHASE_ARMED] = {.resolution = ADC_RES_4096, .period_us = 25000},
+    [PHASE_BOOST] = {.resolution = ADC_RES_1024, .period_us = 10000},
+    [PHASE_COAST] = {.resolution = ADC_RES_4096, .period_us = 25000},
+    [PHASE_DESCENT] = {.resolution = ADC_RES_2048, .period_us = 50000},
+    [PHASE_LANDED] = {.resolution = ADC_RES_4096, .period_us = 200000},
+};
+
+/** The steps of reading the MS5611 as an engine task. */
+typedef enum {
+    MS5611_RESET,            /**< Reset the sensor. */
+    MS5611_CALIBRATE,        /**< Read the calibration coefficients once the reset is done. */
+    MS5611_CONVERT,          /**< Start converting the pressure at the start of a period. */
+    MS5611_READ_PRESSURE,    /**< Read the pressure and start converting the temperature. */
+    MS5611_READ_TEMPERATURE, /**< Read the temperature and publish the reading. */
+} ms5611_step_e;
+
+/** The state of the MS5611 collector task. */
+typedef struct {
+    task_t task;            /**< The task run by the engine. */
+    SensorLocation loc;     /**< The location of the sensor. */
+    uint8_t source;         /**< The index identifying the collector's samples in the pipeline. */
+    ms5611_step_e next;     /**< The next step of the task. */
+    MS5611Context ctx;      /**< The calibration of the sensor. */
+    bool grounded;          /**< Whether the ground pressure has been read. */
+    uint32_t d1;            /**< The raw pressure of the reading in progress. */
+    rt_periodic_t periodic; /**< The schedule of the readings. */
+    clctr_rates_t rates;    /**< The rates of the readings and of each tag. */
+    phase_view_t view;      /**< The flight phase the readings follow. */
+} ms5611_task_t;
+
+/**
+ * Publishes a reading of the MS5611, except for the values whose tags are thinned out.
+ * @param source The index of the collector.
+ * @param rates The rates of the collector.
+ * @param temperature The temperature in degrees Celsius.
+ * @param pressure The pressure in kPa.
+ * @param altitude The altitude above the ground in m.
+ */
+static void publish_reading(uint8_t source, clctr_rates_t *rates, double temperature, double pressure,
+                            double altitude) {
+    common_t msg;
+
+    // Transmit temperature
+    if (clctr_due(rates, TAG_TEMPERATURE)) {
+        msg.type = TAG_TEMPERATURE;
+        msg.data.FLOAT = (float)temperature;
+        pipeline_publish(source, &msg, 0);
+    }
+
+    // Transmit pressure
+    if (clctr_due(rates, TAG_PRESSURE)) {
+        msg.type = TAG_PRESSURE;
+        msg.data.FLOAT = (float)pressure;
+        pipeline_publish(source, &msg, 1);
+    }
+
+    // Transmit altitude
+    if (clctr_due(rates, TAG_ALTITUDE_REL)) {
+        msg.type = TAG_ALTITUDE_REL;
+        msg.data.FLOAT = (float)altitude;
+        pipeline_publish(source, &msg, 2);
+    }
+}
+
+/**
+ * Reads the MS5611 once, sleeping through each conversion so that the wake-up latency of the thread is measured.
+ * @param loc The location of the sensor.
+ * @param ctx The calibration of the sensor.
+ * @param resolution The resolution of the conversions.
+ * @param temperature Where to store the temperature in degrees Celsius, or NULL.
+ * @param pressure Where to store the pressure in kPa, or NULL.
+ * @param altitude Where to store the altitude above the ground in m, or NULL.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static errno_t read_reading(SensorLocation *loc, const MS5611Context *ctx, MS5611Resolution resolution,
+                            double *temperature, double *pressure, double *altitude) {
+    uint32_t d1;
+    uint32_t d2;
+    errno_t err = ms5611_start_conversion(loc, MS5611_D1, resolution);
+    if (err != EOK) return err;
+    rt_usleep(ms5611_conversion_time(resolution));
+    err = ms5611_read_adc(loc, &d1);
+    if (err != EOK) return err;
+
+    err = ms5611_start_conversion(loc, MS5611_D2, resolution);
+    if (err != EOK) return err;
+    rt_usleep(ms5611_conversion_time(resolution));
+    err = ms5611_read_adc(loc, &d2);
+    if (err != EOK) return err;
+
+    ms5611_compute(ctx, 1, d1, d2, temperature, pressure, altitude);
+    return EOK;
+}
+
 /**
  * Collector thread for the MS5611 sensor.
  * @param args Arguments in the form of `collector_args_t`
@@ -13,14 +122,6 @@
  */
 void *ms5611_collector(void *args) {
 
-    /* Open message queue. */
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_WRONLY);
-    if (sensor_q == -1) {
-        log_print(stderr, LOG_ERROR, "MS5611 collector could not open message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
-        return (void *)((uint64_t)errno);
-    }
-
     /* Configure MS5611. */
     SensorLocation loc = {
         .bus = clctr_args(args)->bus,
@@ -33,7 +134,7 @@ void *ms5611_collector(void *args) {
         log_print(stderr, LOG_ERROR, "Failed to reset MS5611: %s\n", strerror(err));
         return_errno(err);
     }
-    usleep(10000); // Takes some time to reset
+    rt_usleep(RESET_TIME_US); // Takes some time to reset
 
     // Get the calibration coefficients
     MS5611Context ctx;
@@ -45,22 +146,35 @@ void *ms5611_collector(void *args) {
     }
 
     // Get the current pressure (ground pressure)
-    err = ms5611_read_all(&loc, ADC_RES_4096, &ctx, 1, NULL, &ctx.ground_pressure, NULL);
+    phase_view_t view;
+    phase_get(&view);
+    err = read_reading(&loc, &ctx, PROFILES[view.phase].resolution, NULL, &ctx.ground_pressure, NULL);
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "MS5611 failed to read ground pressure: %s", strerror(err));
         return_errno(err);
     }
+    startup_ready(clctr_args(args)->source);
 
     // Data storage
-    common_t msg;
     double pressure;
     double altitude;
     double temperature;
 
+    clctr_rates_t rates = clctr_args(args)->rates;
+    rt_periodic_t periodic;
+    rt_periodic_init(&periodic, clctr_period_us(&rates, PROFILES[view.phase].period_us), RT_SKIP, rt_now());
+
     for (;;) {
+        rt_periodic_wait(&periodic);
+
+        // The resolution is only a parameter of the conversions, so a new phase applies at once
+        if (phase_poll(&view)) {
+            rt_periodic_init(&periodic, clctr_period_us(&rates, PROFILES[view.phase].period_us), RT_SKIP, rt_now());
+            phase_applied(&view, "MS5611");
+        }
 
         // Read all three data types
-        err = ms5611_read_all(&loc, ADC_RES_4096, &ctx, 1, &temperature, &pressure, &altitude);
+        err = read_reading(&loc, &ctx, PROFILES[view.phase].resolution, &temperature, &pressure, &altitude);
 
         // If read failed, just continue without crashing
         if (err != EOK) {
@@ -68,25 +182,108 @@ void *ms5611_collector(void *args) {
             continue;
         }
 
-        // Transmit temperature
-        msg.type = TAG_TEMPERATURE;
-        msg.data.FLOAT = (float)temperature;
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-            log_print(stderr, LOG_ERROR, "MS5611 couldn't send message: %s.", strerror(errno));
+        publish_reading(clctr_args(args)->source, &rates, temperature, pressure, altitude);
+    }
+}
+
+/**
+ * Takes the next step of reading the MS5611. The conversions of the pressure and the temperature are waited for by the
+ * engine instead of sleeping.
+ * @param task The MS5611 collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE if the sensor could not be set up.
+ */
+static uint64_t ms5611_step(task_t *task, uint64_t now) {
+    ms5611_task_t *t = task->ctx;
+    MS5611Resolution resolution = PROFILES[t->view.phase].resolution;
+    errno_t err = EOK;
+
+    switch (t->next) {
+    case MS5611_RESET:
+        err = ms5611_reset(&t->loc);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Failed to reset MS5611: %s", strerror(err));
+            return TASK_DONE;
+        }
+        t->next = MS5611_CALIBRATE;
+        return now + RESET_TIME_US * NS_PER_US; // Takes some time to reset
+    case MS5611_CALIBRATE:
+        err = ms5611_init_coefs(&t->loc, &t->ctx);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Failed to initialize MS5611 calibration coefficients: %s", strerror(err));
+            return TASK_DONE;
         }
+        phase_get(&t->view);
+        resolution = PROFILES[t->view.phase].resolution;
+        rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, PROFILES[t->view.phase].period_us), RT_SKIP, now);
+        // FALL THROUGH
+    case MS5611_CONVERT:
+        // The resolution is only a parameter of the conversions, so a new phase applies at once
+        if (phase_poll(&t->view)) {
+            resolution = PROFILES[t->view.phase].resolution;
+            rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, PROFILES[t->view.phase].period_us), RT_SKIP,
+                             now);
+            phase_applied(&t->view, "MS5611");
+        }
+        err = ms5611_start_conversion(&t->loc, MS5611_D1, resolution);
+        break;
+    case MS5611_READ_PRESSURE:
+        err = ms5611_read_adc(&t->loc, &t->d1);
+        if (err != EOK) break;
+        err = ms5611_start_conversion(&t->loc, MS5611_D2, resolution);
+        if (err != EOK) break;
+        t->next = MS5611_READ_TEMPERATURE;
+        return now + ms5611_conversion_time(resolution) * NS_PER_US;
+    case MS5611_READ_TEMPERATURE: {
+        uint32_t d2;
+        err = ms5611_read_adc(&t->loc, &d2);
+        if (err != EOK) break;
 
-        // Transmit pressure
-        msg.type = TAG_PRESSURE;
-        msg.data.FLOAT = (float)pressure;
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 1) == -1) {
-            log_print(stderr, LOG_ERROR, "MS5611 couldn't send message: %s.", strerror(errno));
+        if (!t->grounded) {
+            ms5611_compute(&t->ctx, 1, t->d1, d2, NULL, &t->ctx.ground_pressure, NULL);
+            t->grounded = true;
+            startup_ready(t->source);
+        } else {
+            double temperature, pressure, altitude;
+            ms5611_compute(&t->ctx, 1, t->d1, d2, &temperature, &pressure, &altitude);
+            publish_reading(t->source, &t->rates, temperature, pressure, altitude);
         }
+        t->next = MS5611_CONVERT;
+        return engine_period(task, &t->periodic, now);
+    }
+    }
 
-        // Transmit altitude
-        msg.type = TAG_ALTITUDE_REL;
-        msg.data.FLOAT = (float)altitude;
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 2) == -1) {
-            log_print(stderr, LOG_ERROR, "MS5611 couldn't send message: %s.", strerror(errno));
+    if (err != EOK) {
+        // Start over with the next reading, without crashing
+        if (!t->grounded) {
+            log_print(stderr, LOG_ERROR, "MS5611 failed to read ground pressure: %s", strerror(err));
+        } else {
+            log_print(stderr, LOG_ERROR, "MS5611 failed to read data: %s", strerror(err));
         }
+        t->next = MS5611_CONVERT;
+        return engine_period(task, &t->periodic, now);
     }
+    t->next = MS5611_READ_PRESSURE;
+    return now + ms5611_conversion_time(resolution) * NS_PER_US;
+}
+
+/**
+ * Sets up an MS5611 collector as a task of the acquisition engine.
+ * @param args The location, index and rates of the collector.
+ * @return The task, or NULL if no more MS5611 tasks are left.
+ */
+task_t *ms5611_task(const collector_args_t *args) {
+    static ms5611_task_t tasks[COLLECTOR_MAX_TASKS];
+    static uint8_t ntasks = 0;
+    if (ntasks == COLLECTOR_MAX_TASKS) return NULL;
+
+    ms5611_task_t *t = &tasks[ntasks++];
+    *t = (ms5611_task_t){
+        .task = {.name = "MS5611", .ctx = t, .step = ms5611_step},
+        .loc = {.bus = args->bus, .addr = {.addr = args->addr, .fmt = I2C_ADDRFMT_7BIT}},
+        .source = args->source,
+        .rates = args->rates,
+        .next = MS5611_RESET,
+    };
+    return &t->task;
 }
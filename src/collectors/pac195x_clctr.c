@@ -9,73 +9,246 @@
 /** The RSENSE value connected to the PAC1952-2 in milliohms. */
 #define RSENSE 18
 
-void *pac1952_2_collector(void *args) {
+/** How long to wait after a refresh until accumulator data can be read again, in microseconds. */
+#define REFRESH_TIME_US 1000
 
-    /* Open message queue. */
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_WRONLY);
-    if (sensor_q == -1) {
-        log_print(stderr, LOG_ERROR, "PAC195X collector could not open message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
-        return_err(err);
+/** How the PAC1952-2 is read in a flight phase. */
+typedef struct {
+    pac195x_sm_e mode;  /**< The sample mode. */
+    uint32_t period_us; /**< The default time between two readings, in microseconds. */
+} pac195x_profile_t;
+
+/**
+ * How the PAC1952-2 is read in each flight phase. Each period leaves room for the refresh and for reading the voltages.
+ * On the ground the voltages drift slowly, so they are sampled and read less often.
+ */
+static const pac195x_profile_t PROFILES[PHASE_COUNT] = {
+    [PHASE_IDLE] = {.mode = SAMPLE_8_SPS_AD, .period_us = 500000},
+    [PHASE_ARMED] = {.mode = SAMPLE_1024_SPS_AD, .period_us = 2000},
+    [PHASE_BOOST] = {.mode = SAMPLE_1024_SPS_AD, .period_us = 2000},
+    [PHASE_COAST] = {.mode = SAMPLE_1024_SPS_AD, .period_us = 2000},
+    [PHASE_DESCENT] = {.mode = SAMPLE_64_SPS_AD, .period_us = 20000},
+    [PHASE_LANDED] = {.mode = SAMPLE_8_SPS_AD, .period_us = 500000},
+};
+
+/** The steps of reading the PAC1952-2 as an engine task. */
+typedef enum {
+    PAC195X_CONFIGURE, /**< Configure the sensor. */
+    PAC195X_REFRESH,   /**< Follow the flight phase and refresh the voltages at the start of a period. */
+    PAC195X_READ,      /**< Read and publish the voltages. */
+} pac195x_step_e;
+
+/** The state of the PAC1952-2 collector task. */
+typedef struct {
+    task_t task;            /**< The task run by the engine. */
+    SensorLocation loc;     /**< The location of the sensor. */
+    pac195x_shadow_t ctrl;  /**< The shadow of the sensor's CTRL register. */
+    uint8_t source;         /**< The index identifying the collector's samples in the pipeline. */
+    pac195x_step_e next;    /**< The next step of the task. */
+    rt_periodic_t periodic; /**< The schedule of the readings. */
+    clctr_rates_t rates;    /**< The rates of the readings and of each tag. */
+    phase_view_t view;      /**< The flight phase the sensor is configured for. */
+} pac195x_task_t;
+
+/**
+ * Configures the PAC1952-2 to sample both channels, with the sample mode and the channels written to CTRL together.
+ * The measurements can be read once the refresh time has passed.
+ * @param loc The location of the sensor.
+ * @param ctrl The shadow of the sensor's CTRL register.
+ * @param mode The sample mode.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int configure(SensorLocation *loc, pac195x_shadow_t *ctrl, pac195x_sm_e mode) {
+    pac195x_shadow_init(ctrl);
+    pac195x_set_sample_mode(ctrl, mode);
+    pac195x_toggle_channel(ctrl, CHANNEL1 | CHANNEL2, true);
+    int err = pac195x_commit(loc, ctrl);
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Failed to set sampling mode and enable all channels on PAC195X: %s",
+                  strerror(err));
+        return err;
     }
 
-    SensorLocation loc = {
-        .addr = {.addr = clctr_args(args)->addr, .fmt = I2C_ADDRFMT_7BIT},
-        .bus = clctr_args(args)->bus,
-    };
+    err = pac195x_refresh(loc); // Refresh after all configuration to force changes into effect
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Failed to refresh PAC195X: %s", strerror(err));
+    }
+    return err;
+}
 
-    int err = pac195x_set_sample_mode(&loc, SAMPLE_1024_SPS_AD);
+/**
+ * Changes the sample mode of the PAC1952-2 for a new flight phase. CTRL is known from configuring the sensor, so it is
+ * not read first. The measurements can be read once the refresh time has passed.
+ * @param loc The location of the sensor.
+ * @param ctrl The shadow of the sensor's CTRL register.
+ * @param mode The sample mode.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int set_mode(SensorLocation *loc, pac195x_shadow_t *ctrl, pac195x_sm_e mode) {
+    pac195x_set_sample_mode(ctrl, mode);
+    int err = pac195x_commit(loc, ctrl);
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "Failed to set sampling mode on PAC195X: %s", strerror(err));
-        return_err(err);
+        return err;
     }
 
-    err = pac195x_toggle_channel(&loc, CHANNEL1 | CHANNEL2, true);
+    err = pac195x_refresh(loc); // Forces the new sample mode into effect
     if (err != EOK) {
-        log_print(stderr, LOG_ERROR, "Failed to enable all channels on PAC195X: %s", strerror(err));
-        return_err(err);
+        log_print(stderr, LOG_ERROR, "Failed to refresh PAC195X: %s", strerror(err));
+    }
+    return err;
+}
+
+/**
+ * Reads the bus voltages of both channels.
+ * @param loc The location of the sensor.
+ * @param vbus Set to the raw bus voltage of each channel.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int read_voltages(SensorLocation *loc, uint16_t vbus[2]) {
+    int err = EOK;
+    for (int i = 0; i < 2; i++) {
+        err = pac195x_get_vbusn(loc, i + 1, &vbus[i]);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "PAC195X could not read VBUS_%u: %s", i + 1, strerror(err));
+            break;
+        }
     }
+    return err;
+}
+
+/**
+ * Publishes the bus voltages of both channels.
+ * @param source The index of the collector.
+ * @param vbus The raw bus voltage of each channel.
+ */
+static void publish_voltages(uint8_t source, const uint16_t vbus[2]) {
+    common_t msg;
+
+    // Calculate voltage on SENSE 1
+    msg.type = TAG_VOLTAGE;
+    msg.id = 1;
+    msg.data.U32 = pac195x_calc_bus_voltage(32, vbus[0], false);
+    pipeline_publish(source, &msg, 0);
+
+    // Calculate voltage on SENSE 2
+    msg.type = TAG_VOLTAGE;
+    msg.id = 2;
+    msg.data.U32 = pac195x_calc_bus_voltage(32, vbus[1], false);
+    pipeline_publish(source, &msg, 0);
+}
 
-    err = pac195x_refresh(&loc); // Refresh after all configuration to force changes into effect
-    usleep(1000);                // 1ms after refresh until accumulator data can be read again.
+void *pac1952_2_collector(void *args) {
+
+    SensorLocation loc = {
+        .addr = {.addr = clctr_args(args)->addr, .fmt = I2C_ADDRFMT_7BIT},
+        .bus = clctr_args(args)->bus,
+    };
+
+    phase_view_t view;
+    phase_get(&view);
+    pac195x_shadow_t ctrl;
+    int err = configure(&loc, &ctrl, PROFILES[view.phase].mode);
     if (err != EOK) {
-        log_print(stderr, LOG_ERROR, "Failed to refresh PAC195X: %s", strerror(err));
         return_err(err);
     }
+    startup_ready(clctr_args(args)->source);
 
     uint16_t vbus[2];
-    common_t msg;
+    clctr_rates_t rates = clctr_args(args)->rates;
+    rt_periodic_t periodic;
+    rt_periodic_init(&periodic, clctr_period_us(&rates, PROFILES[view.phase].period_us), RT_SKIP, rt_now());
 
     for (;;) {
+        rt_periodic_wait(&periodic);
 
-        for (int i = 0; i < 2; i++) {
-            err = pac195x_get_vbusn(&loc, i + 1, &vbus[i]);
-            if (err != EOK) {
-                log_print(stderr, LOG_ERROR, "PAC195X could not read VBUS_%u: %s", i + 1, strerror(err));
-                break;
-            }
+        // Follow the flight phase, keeping the old mode to try again next period if it could not be changed
+        phase_view_t next = view;
+        if (phase_poll(&next) && set_mode(&loc, &ctrl, PROFILES[next.phase].mode) == EOK) {
+            view = next;
+            rt_periodic_init(&periodic, clctr_period_us(&rates, PROFILES[view.phase].period_us), RT_SKIP, rt_now());
+            phase_applied(&view, "PAC1952-2");
+            rt_usleep(REFRESH_TIME_US);
         }
 
-        // Calculate voltage on SENSE 1
-        msg.type = TAG_VOLTAGE;
-        msg.id = 1;
-        msg.data.U32 = pac195x_calc_bus_voltage(32, vbus[0], false);
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-            log_print(stderr, LOG_ERROR, "Could not send voltage measurement: %s", strerror(errno));
-        }
-
-        // Calculate voltage on SENSE 2
-        msg.type = TAG_VOLTAGE;
-        msg.id = 2;
-        msg.data.U32 = pac195x_calc_bus_voltage(32, vbus[1], false);
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-            log_print(stderr, LOG_ERROR, "Could not send voltage measurement: %s", strerror(errno));
-        }
+        // The voltages are the only readings, so thinned out periods do not use the bus at all
+        if (!clctr_due(&rates, TAG_VOLTAGE)) continue;
 
         // Get new measurements
         pac195x_refresh_v(&loc);
-        usleep(1000);
+        rt_usleep(REFRESH_TIME_US); // 1ms after refresh until accumulator data can be read again.
+
+        // Only publish voltages which were read
+        if (read_voltages(&loc, vbus) == EOK) publish_voltages(clctr_args(args)->source, vbus);
     }
 
     return_err(EOK);
 }
+
+/**
+ * Takes the next step of reading the PAC1952-2. The refreshes are waited for by the engine instead of sleeping.
+ * @param task The PAC1952-2 collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE if the sensor could not be configured.
+ */
+static uint64_t pac195x_step(task_t *task, uint64_t now) {
+    pac195x_task_t *t = task->ctx;
+
+    switch (t->next) {
+    case PAC195X_CONFIGURE:
+        phase_get(&t->view);
+        if (configure(&t->loc, &t->ctrl, PROFILES[t->view.phase].mode) != EOK) return TASK_DONE;
+        startup_ready(t->source);
+        rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, PROFILES[t->view.phase].period_us), RT_SKIP, now);
+        // FALL THROUGH
+    case PAC195X_REFRESH: {
+        // Follow the flight phase, keeping the old mode to try again next period if it could not be changed
+        phase_view_t next = t->view;
+        if (phase_poll(&next) && set_mode(&t->loc, &t->ctrl, PROFILES[next.phase].mode) == EOK) {
+            t->view = next;
+            rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, PROFILES[t->view.phase].period_us), RT_SKIP,
+                             now);
+            phase_applied(&t->view, "PAC1952-2");
+            t->next = PAC195X_REFRESH;
+            return now + REFRESH_TIME_US * NS_PER_US;
+        }
+
+        // The voltages are the only readings, so thinned out periods do not use the bus at all
+        if (!clctr_due(&t->rates, TAG_VOLTAGE)) break;
+
+        // Get new measurements
+        pac195x_refresh_v(&t->loc);
+        t->next = PAC195X_READ;
+        return now + REFRESH_TIME_US * NS_PER_US;
+    }
+    case PAC195X_READ: {
+        // Only publish voltages which were read
+        uint16_t vbus[2];
+        if (read_voltages(&t->loc, vbus) == EOK) publish_voltages(t->source, vbus);
+        break;
+    }
+    }
+    t->next = PAC195X_REFRESH;
+    return engine_period(task, &t->periodic, now);
+}
+
+/**
+ * Sets up a PAC1952-2 collector as a task of the acquisition engine.
+ * @param args The location, index and rates of the collector.
+ * @return The task, or NULL if no more PAC1952-2 tasks are left.
+ */
+task_t *pac1952_2_task(const collector_args_t *args) {
+    static pac195x_task_t tasks[COLLECTOR_MAX_TASKS];
+    static uint8_t ntasks = 0;
+    if (ntasks == COLLECTOR_MAX_TASKS) return NULL;
+
+    pac195x_task_t *t = &tasks[ntasks++];
+    *t = (pac195x_task_t){
+        .task = {.name = "PAC1952-2", .ctx = t, .step = pac195x_step},
+        .loc = {.bus = args->bus, .addr = {.addr = args->addr, .fmt = I2C_ADDRFMT_7BIT}},
+        .source = args->source,
+        .rates = args->rates,
+        .next = PAC195X_CONFIGURE,
+    };
+    return &t->task;
+}
@@ -9,6 +9,57 @@
 /** Macro to cast `errno_t` to void pointer before returning. */
 #define return_errno(err) return (void *)((uint64_t)err)
 
+/** The precision the SHT41 is read with. */
+#define PRECISION SHT41_HIGH_PRES
+
+/** How long to wait after resetting the SHT41, in microseconds. */
+#define RESET_TIME_US 100
+
+/** The default time between two measurements, in microseconds. Leaves room for the measurement and the transfers. */
+#define PERIOD_US 10000
+
+/** The steps of reading the SHT41 as an engine task. */
+typedef enum {
+    SHT41_RESET,   /**< Reset the sensor. */
+    SHT41_MEASURE, /**< Start a measurement at the start of a period. */
+    SHT41_FETCH,   /**< Fetch and publish the measurement. */
+} sht41_step_e;
+
+/** The state of the SHT41 collector task. */
+typedef struct {
+    task_t task;            /**< The task run by the engine. */
+    SensorLocation loc;     /**< The location of the sensor. */
+    uint8_t source;         /**< The index identifying the collector's samples in the pipeline. */
+    sht41_step_e next;      /**< The next step of the task. */
+    rt_periodic_t periodic; /**< The schedule of the measurements. */
+    clctr_rates_t rates;    /**< The rates of the measurements and of each tag. */
+} sht41_task_t;
+
+/**
+ * Publishes a measurement of the SHT41, except for the values whose tags are thinned out.
+ * @param source The index of the collector.
+ * @param rates The rates of the collector.
+ * @param temperature The temperature in degrees Celsius.
+ * @param humidity The relative humidity in percentage.
+ */
+static void publish_measurement(uint8_t source, clctr_rates_t *rates, float temperature, float humidity) {
+    common_t msg;
+
+    // Send temperature
+    if (clctr_due(rates, TAG_TEMPERATURE)) {
+        msg.type = TAG_TEMPERATURE;
+        msg.data.FLOAT = temperature;
+        pipeline_publish(source, &msg, 0);
+    }
+
+    // Send humidity
+    if (clctr_due(rates, TAG_HUMIDITY)) {
+        msg.type = TAG_HUMIDITY;
+        msg.data.FLOAT = humidity;
+        pipeline_publish(source, &msg, 0);
+    }
+}
+
 /**
  * Collector thread for the SHT41 sensor.
  * @param args Arguments in the form of `collector_args_t`
@@ -16,14 +67,6 @@
  */
 void *sht41_collector(void *args) {
 
-    /* Open message queue. */
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_WRONLY);
-    if (sensor_q == -1) {
-        log_print(stderr, LOG_ERROR, "SHT41 collector could not open message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
-        return (void *)((uint64_t)errno);
-    }
-
     /* Set up SHT41. */
     SensorLocation loc = {
         .bus = clctr_args(args)->bus,
@@ -32,34 +75,102 @@ void *sht41_collector(void *args) {
 
     // Reset SHT41
     int err = sht41_reset(&loc);
-    usleep(100); // Wait just a little bit
+    rt_usleep(RESET_TIME_US); // Wait just a little bit
     if (err != EOK) {
         log_print(stderr, LOG_ERROR, "%s", strerror(err));
         return_errno(err);
     }
+    startup_ready(clctr_args(args)->source);
 
     // Data storage
     float temperature;
     float humidity;
-    common_t msg;
 
-    for (;;) {
+    clctr_rates_t rates = clctr_args(args)->rates;
+    rt_periodic_t periodic;
+    rt_periodic_init(&periodic, clctr_period_us(&rates, PERIOD_US), RT_SKIP, rt_now());
 
-        // Read temperature and humidity
-        sht41_read(&loc, SHT41_HIGH_PRES, &temperature, &humidity);
+    for (;;) {
+        rt_periodic_wait(&periodic);
 
-        // Send temperature
-        msg.type = TAG_TEMPERATURE;
-        msg.data.FLOAT = temperature;
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-            log_print(stderr, LOG_ERROR, "SHT41 couldn't send message: %s", strerror(errno));
+        // Read temperature and humidity, skipping readings which failed rather than sending stale or partial values
+        err = sht41_start(&loc, PRECISION);
+        if (err == EOK) {
+            rt_usleep(sht41_measurement_time(PRECISION));
+            err = sht41_fetch(&loc, &temperature, &humidity);
+        }
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "SHT41 failed to read data: %s", strerror(err));
+            continue;
         }
 
-        // Send humidity
-        msg.type = TAG_HUMIDITY;
-        msg.data.FLOAT = humidity;
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-            log_print(stderr, LOG_ERROR, "SHT41 couldn't send message: %s", strerror(errno));
+        publish_measurement(clctr_args(args)->source, &rates, temperature, humidity);
+    }
+}
+
+/**
+ * Takes the next step of reading the SHT41. The measurements are waited for by the engine instead of sleeping.
+ * @param task The SHT41 collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE if the sensor could not be reset.
+ */
+static uint64_t sht41_step(task_t *task, uint64_t now) {
+    sht41_task_t *t = task->ctx;
+    uint64_t measurement = sht41_measurement_time(PRECISION) * NS_PER_US;
+    int err;
+
+    switch (t->next) {
+    case SHT41_RESET:
+        err = sht41_reset(&t->loc);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "%s", strerror(err));
+            return TASK_DONE;
+        }
+        t->next = SHT41_MEASURE;
+        startup_ready(t->source);
+        rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, PERIOD_US), RT_SKIP, now + RESET_TIME_US * NS_PER_US);
+        return t->periodic.next;
+    case SHT41_MEASURE:
+        err = sht41_start(&t->loc, PRECISION);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "SHT41 failed to read data: %s", strerror(err));
+            return engine_period(task, &t->periodic, now);
+        }
+        t->next = SHT41_FETCH;
+        return now + measurement;
+    case SHT41_FETCH: {
+        // Skip readings which failed rather than sending stale or partial values
+        float temperature, humidity;
+        err = sht41_fetch(&t->loc, &temperature, &humidity);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "SHT41 failed to read data: %s", strerror(err));
+        } else {
+            publish_measurement(t->source, &t->rates, temperature, humidity);
         }
+        t->next = SHT41_MEASURE;
+        return engine_period(task, &t->periodic, now);
     }
+    }
+    return TASK_DONE;
+}
+
+/**
+ * Sets up an SHT41 collector as a task of the acquisition engine.
+ * @param args The location, index and rates of the collector.
+ * @return The task, or NULL if no more SHT41 tasks are left.
+ */
+task_t *sht41_task(const collector_args_t *args) {
+    static sht41_task_t tasks[COLLECTOR_MAX_TASKS];
+    static uint8_t ntasks = 0;
+    if (ntasks == COLLECTOR_MAX_TASKS) return NULL;
+
+    sht41_task_t *t = &tasks[ntasks++];
+    *t = (sht41_task_t){
+        .task = {.name = "SHT41", .ctx = t, .step = sht41_step},
+        .loc = {.bus = args->bus, .addr = {.addr = args->addr, .fmt = I2C_ADDRFMT_7BIT}},
+        .source = args->source,
+        .rates = args->rates,
+        .next = SHT41_RESET,
+    };
+    return &t->task;
 }
@@ -0,0 +1,209 @@
+/**
+ * @file startup.c
+ * @brief Implementation of the boot timeline of the collectors.
+ *
+ * Implementation of the boot timeline of the collectors.
+ */
+#include "startup.h"
+#include "../logging-utils/logging.h"
+#include "../pipeline/pipeline.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** How often the watcher checks whether every collector has published, in microseconds. */
+#define WATCH_PERIOD_US 10000
+
+/** The longest name of a collector on the boot timeline, including the null terminator. */
+#define MAX_NAME 24
+
+/** When one collector reached each point of its startup, in nanoseconds since the start of the process. */
+typedef struct {
+    char name[MAX_NAME]; /**< The name of the collector's sensor. */
+    bool begun;          /**< Whether the collector was started. */
+    bool ready;          /**< Whether the collector's sensor was set up. */
+    uint64_t begin;      /**< When the collector was started. */
+    uint64_t ready_time; /**< When the collector's sensor was set up. */
+} startup_entry_t;
+
+/** The collectors on the boot timeline, by source. */
+static startup_entry_t entries[STARTUP_MAX_COLLECTORS];
+
+/** When the process started. */
+static struct timespec process_start;
+
+/** Protects the boot timeline. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** The thread which logs the boot timeline. */
+static pthread_t watcher_thread;
+
+/** How long the watcher waits for every collector's first sample, in nanoseconds since the start of the process. */
+static uint64_t watch_timeout;
+
+/**
+ * Starts the boot timeline. Should be called as early as possible, since the timeline counts from this call.
+ */
+void startup_init(void) {
+    pthread_mutex_lock(&lock);
+    clock_gettime(CLOCK_MONOTONIC, &process_start);
+    memset(entries, 0, sizeof(entries));
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Gets the time elapsed since the start of the process.
+ * @return The elapsed time in nanoseconds.
+ */
+uint64_t startup_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - process_start.tv_sec) * NS_PER_SEC + (uint64_t)now.tv_nsec -
+           (uint64_t)process_start.tv_nsec;
+}
+
+/**
+ * Records that a collector was started.
+ * @param source The index of the collector. Collectors beyond STARTUP_MAX_COLLECTORS are not followed.
+ * @param name The name of the collector's sensor.
+ */
+void startup_begin(uint8_t source, const char *name) {
+    if (source >= STARTUP_MAX_COLLECTORS) return;
+    uint64_t now = startup_time();
+    pthread_mutex_lock(&lock);
+    startup_entry_t *entry = &entries[source];
+    *entry = (startup_entry_t){.begun = true, .begin = now};
+    strncpy(entry->name, name, MAX_NAME - 1);
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Records that a collector has set its sensor up, and is about to read it for the first time. Only the first call of
+ * each collector counts, so that setting a sensor up again after an error does not hide how long it first took.
+ * @param source The index of the collector.
+ */
+void startup_ready(uint8_t source) {
+    if (source >= STARTUP_MAX_COLLECTORS) return;
+    uint64_t now = startup_time();
+    pthread_mutex_lock(&lock);
+    startup_entry_t *entry = &entries[source];
+    if (!entry->ready) {
+        entry->ready = true;
+        entry->ready_time = now;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Gets when a collector's first sample was published, if it was.
+ * @param source The index of the collector.
+ * @param offset The time between the start of the process and the start of the pipeline's clock, in nanoseconds.
+ * @param time Set to the time of the first sample in nanoseconds since the start of the process.
+ * @return True if the collector's first sample was dispatched, false otherwise.
+ */
+static bool first_sample(uint8_t source, uint64_t offset, uint64_t *time) {
+    uint64_t first;
+    if (!pipeline_first_sample(source, &first)) return false;
+    *time = first + offset;
+    return true;
+}
+
+/**
+ * Gets the time between the start of the process and the start of the pipeline's clock.
+ * @return The offset in nanoseconds.
+ */
+static uint64_t pipeline_offset(void) { return startup_time() - pipeline_time(); }
+
+/**
+ * Checks whether every collector which was started has published a sample.
+ * @return True if they all have.
+ */
+static bool complete(void) {
+    bool done = true;
+    uint64_t time;
+    pthread_mutex_lock(&lock);
+    for (uint8_t i = 0; i < STARTUP_MAX_COLLECTORS; i++) {
+        if (entries[i].begun && !first_sample(i, 0, &time)) done = false;
+    }
+    pthread_mutex_unlock(&lock);
+    return done;
+}
+
+/**
+ * Thread which logs the boot timeline once every collector has published a sample, or once the timeout has passed.
+ * @param arg Unused.
+ * @return NULL.
+ */
+static void *watcher(void *arg) {
+    (void)(arg);
+    while (!complete() && startup_time() < watch_timeout) {
+        usleep(WATCH_PERIOD_US);
+    }
+    startup_report(stderr);
+    return NULL;
+}
+
+/**
+ * Starts a thread which logs the boot timeline once every collector which was started has published a sample. Must be
+ * called after every collector was started.
+ * @param timeout_s How long after the start of the process to log the timeline anyway, in seconds.
+ * @return EOK if successful, otherwise the error which occurred creating the thread.
+ */
+int startup_watch(uint32_t timeout_s) {
+    watch_timeout = (uint64_t)timeout_s * NS_PER_SEC;
+    int err = pthread_create(&watcher_thread, NULL, watcher, NULL);
+    if (err != EOK) return err;
+    return pthread_detach(watcher_thread);
+}
+
+/**
+ * Logs when each collector was started, when it set its sensor up and when it published its first sample, and how long
+ * it took until every collector had.
+ * @param stream The stream to log to.
+ */
+void startup_report(FILE *stream) {
+    uint64_t offset = pipeline_offset();
+    uint64_t last = 0;
+    unsigned started = 0;
+    unsigned sampled = 0;
+
+    pthread_mutex_lock(&lock);
+    for (uint8_t i = 0; i < STARTUP_MAX_COLLECTORS; i++) {
+        const startup_entry_t *entry = &entries[i];
+        if (!entry->begun) continue;
+        started++;
+
+        char ready[32] = "not set up";
+        char sample[32] = "no sample yet";
+        uint64_t time;
+        if (entry->ready) {
+            snprintf(ready, sizeof(ready), "set up at %.1f ms", (double)entry->ready_time / NS_PER_MS);
+        }
+        if (first_sample(i, offset, &time)) {
+            snprintf(sample, sizeof(sample), "first sample at %.1f ms", (double)time / NS_PER_MS);
+            if (time > last) last = time;
+            sampled++;
+        }
+        log_print(stream, LOG_INFO, "Startup of %s (%u): started at %.1f ms, %s, %s", entry->name, i,
+                  (double)entry->begin / NS_PER_MS, ready, sample);
+    }
+    pthread_mutex_unlock(&lock);
+
+    if (sampled == started) {
+        log_print(stream, LOG_INFO, "Every sensor published within %.1f ms of the start of the process",
+                  (double)last / NS_PER_MS);
+    } else {
+        uint64_t now = startup_time();
+        log_print(stream, LOG_WARN, "%u of %u sensors published within %.1f s of the start of the process", sampled,
+                  started, (double)now / NS_PER_SEC);
+    }
+}
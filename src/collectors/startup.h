@@ -0,0 +1,30 @@
+/**
+ * @file startup.h
+ * @brief Function prototypes for the boot timeline of the collectors.
+ *
+ * Every collector sets its sensor up on its own thread or as its own task of the acquisition engine, so the sensors
+ * start concurrently and a slow one (like the GPS receiver resetting) holds none of the others up. The boot timeline
+ * records when each collector was started, when its sensor was set up and when the pipeline dispatched its first
+ * sample, counted from the start of the process. It is logged once every collector has published a sample, or once the
+ * report timeout has passed for the collectors which have not.
+ */
+#ifndef _STARTUP_H_
+#define _STARTUP_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** The maximum number of collectors on the boot timeline. */
+#define STARTUP_MAX_COLLECTORS 16
+
+/** How long to wait for every collector's first sample before logging the boot timeline anyway, in seconds. */
+#define STARTUP_REPORT_TIMEOUT 30
+
+void startup_init(void);
+uint64_t startup_time(void);
+void startup_begin(uint8_t source, const char *name);
+void startup_ready(uint8_t source);
+int startup_watch(uint32_t timeout_s);
+void startup_report(FILE *stream);
+
+#endif // _STARTUP_H_
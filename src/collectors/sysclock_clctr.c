@@ -9,6 +9,45 @@
 /** Macro to cast `errno_t` to void pointer before returning. */
 #define return_err(err) return (void *)((uint64_t)err)
 
+/** The default time between two samples of the time, in microseconds. */
+#define PERIOD_US 10000
+
+/** The state of the system clock collector task. */
+typedef struct {
+    task_t task;            /**< The task run by the engine. */
+    uint8_t source;         /**< The index identifying the collector's samples in the pipeline. */
+    bool started;           /**< Whether the startup time has been read. */
+    struct timespec start;  /**< The startup time. */
+    rt_periodic_t periodic; /**< The schedule of the samples. */
+    clctr_rates_t rates;    /**< The rate of the samples. */
+} sysclock_task_t;
+
+/**
+ * Publishes the time elapsed since startup, unless this sample is thinned out.
+ * @param source The index of the collector.
+ * @param rates The rates of the collector.
+ * @param start The startup time.
+ * @return EOK if successful, otherwise the error from getting the current time.
+ */
+static int publish_time(uint8_t source, clctr_rates_t *rates, const struct timespec *start) {
+    if (!clctr_due(rates, TAG_TIME)) return EOK;
+
+    // Get time with nanosecond precision
+    struct timespec now;
+    if (clock_gettime(CLOCK_REALTIME, &now)) {
+        return errno;
+    }
+
+    // Calculate elapsed time from launch
+    common_t msg;
+    msg.type = TAG_TIME;
+    long elapsed_s = now.tv_sec - start->tv_sec;
+    long elapsed_ns = now.tv_nsec - start->tv_nsec;
+    msg.data.U32 = (elapsed_s * 1000) + (elapsed_ns / 1000000);
+    pipeline_publish(source, &msg, 0);
+    return EOK;
+}
+
 /**
  * Collector thread for the system clock.
  * @param args Arguments in the form of `collector_args_t`
@@ -16,16 +55,6 @@
  */
 void *sysclock_collector(void *args) {
 
-    (void)(args); // Ignore that args is unused
-
-    /* Open message queue to send data. */
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_WRONLY);
-    if (sensor_q == -1) {
-        log_print(stderr, LOG_ERROR, "Sysclock collector could not open message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
-        return (void *)((uint64_t)errno);
-    }
-
     // Get the current UNIX time and time information
     struct timespec start;
     int err = clock_gettime(CLOCK_REALTIME, &start);
@@ -33,29 +62,62 @@ void *sysclock_collector(void *args) {
         log_print(stderr, LOG_ERROR, "Could not get startup time: %s", strerror(errno));
         return_err(errno);
     }
+    startup_ready(clctr_args(args)->source);
 
-    // Infinitely check the time
-    struct timespec now;
-    common_t msg;
-    msg.type = TAG_TIME;
+    // Infinitely send the time, once per period so as not to flood the message queue
+    clctr_rates_t rates = clctr_args(args)->rates;
+    rt_periodic_t periodic;
+    rt_periodic_init(&periodic, clctr_period_us(&rates, PERIOD_US), RT_CATCH_UP, rt_now());
     for (;;) {
-
-        // Get time with nanosecond precision
-        err = clock_gettime(CLOCK_REALTIME, &now);
+        rt_periodic_wait(&periodic);
+        err = publish_time(clctr_args(args)->source, &rates, &start);
         if (err) {
-            log_print(stderr, LOG_ERROR, "Could not get current time: %s", strerror(errno));
-            continue;
+            log_print(stderr, LOG_ERROR, "Could not get current time: %s", strerror(err));
         }
+    }
+}
 
-        // Calculate elapsed time from launch
-        long elapsed_s = now.tv_sec - start.tv_sec;
-        long elapsed_ns = now.tv_nsec - start.tv_nsec;
-        msg.data.U32 = (elapsed_s * 1000) + (elapsed_ns / 1000000);
+/**
+ * Publishes the time elapsed since startup, once per period.
+ * @param task The system clock collector task.
+ * @param now The current time in nanoseconds.
+ * @return When the next step is due, or TASK_DONE if the startup time could not be read.
+ */
+static uint64_t sysclock_step(task_t *task, uint64_t now) {
+    sysclock_task_t *t = task->ctx;
 
-        // Infinitely send the time
-        if (mq_send(sensor_q, (char *)&msg, sizeof(msg), 0) == -1) {
-            log_print(stderr, LOG_ERROR, "Sysclock couldn't send message: %s.", strerror(errno));
+    if (!t->started) {
+        if (clock_gettime(CLOCK_REALTIME, &t->start)) {
+            log_print(stderr, LOG_ERROR, "Could not get startup time: %s", strerror(errno));
+            return TASK_DONE;
         }
-        usleep(10000); // Little sleep to not flood message queue
+        t->started = true;
+        startup_ready(t->source);
+        rt_periodic_init(&t->periodic, clctr_period_us(&t->rates, PERIOD_US), RT_CATCH_UP, now);
     }
+
+    int err = publish_time(t->source, &t->rates, &t->start);
+    if (err) {
+        log_print(stderr, LOG_ERROR, "Could not get current time: %s", strerror(err));
+    }
+    return engine_period(task, &t->periodic, now);
+}
+
+/**
+ * Sets up a system clock collector as a task of the acquisition engine.
+ * @param args The index and rates of the collector.
+ * @return The task, or NULL if no more system clock tasks are left.
+ */
+task_t *sysclock_task(const collector_args_t *args) {
+    static sysclock_task_t tasks[COLLECTOR_MAX_TASKS];
+    static uint8_t ntasks = 0;
+    if (ntasks == COLLECTOR_MAX_TASKS) return NULL;
+
+    sysclock_task_t *t = &tasks[ntasks++];
+    *t = (sysclock_task_t){
+        .task = {.name = "SYSCLOCK", .ctx = t, .step = sysclock_step},
+        .source = args->source,
+        .rates = args->rates,
+    };
+    return &t->task;
 }
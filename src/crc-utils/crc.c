@@ -64,4 +64,42 @@ void generate_crc8_lookup(CRC8LookupTable *lookup, uint8_t polynomial) {
         }
         lookup->table[curr] = remainder;
     }
-}
\ No newline at end of file
+}
+/**
+ * Calculates a reflected 32 bit cyclic redundancy check (CRC-32) for the provided data using a lookup table. The
+ * result can be passed back in as the initial value to continue the CRC over more data.
+ * @param buff A pointer to the data to have its CRC calculated
+ * @param n_bytes The length of the data in bytes
+ * @param lookup A lookup table generated by generate_crc32_lookup
+ * @param initial The initial value of the CRC, 0xFFFFFFFF for the standard CRC-32
+ * @return uint32_t The calculated CRC, which must be inverted to get the standard CRC-32
+ */
+uint32_t calculate_crc32(const uint8_t *buf, size_t nbytes, const CRC32LookupTable *lookup, uint32_t initial) {
+    uint32_t crc = initial;
+    for (size_t byte = 0; byte < nbytes; byte++) {
+        crc = lookup->table[(crc ^ buf[byte]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+/**
+ * Generates a lookup table for a reflected 32 bit cyclic redundancy check (CRC-32)
+ * @param lookup The lookup table to store the calculated CRC values in
+ * @param polynomial The reversed 32 bit polynomial to generate the lookup table with, 0xEDB88320 for the standard
+ * CRC-32
+ */
+void generate_crc32_lookup(CRC32LookupTable *lookup, uint32_t polynomial) {
+    for (uint16_t curr = 0; curr <= 0xFF; curr++) {
+        uint32_t remainder = curr;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            if (remainder & 1) {
+                // Discard the lowest bit (implicit XOR), then divide by the polynomial
+                remainder >>= 1;
+                remainder ^= polynomial;
+            } else {
+                // Continue until the lowest bit is set
+                remainder >>= 1;
+            }
+        }
+        lookup->table[curr] = remainder;
+    }
+}
@@ -13,8 +13,15 @@ typedef struct crc8_lookup_t {
     uint8_t table[256];
 } CRC8LookupTable;
 
+/** Structure that contains information required for a CRC-32 lookup table */
+typedef struct crc32_lookup_t {
+    uint32_t table[256];
+} CRC32LookupTable;
+
 uint8_t calculate_crc8(const uint8_t *buf, size_t nbytes, const CRC8LookupTable *lookup, uint8_t initial);
 void generate_crc8_lookup(CRC8LookupTable *lookup, uint8_t polynomial);
 uint8_t calculate_crc8_bitwise(const uint8_t *buf, size_t nbytes, uint8_t polynomial, uint8_t initial);
+uint32_t calculate_crc32(const uint8_t *buf, size_t nbytes, const CRC32LookupTable *lookup, uint32_t initial);
+void generate_crc32_lookup(CRC32LookupTable *lookup, uint32_t polynomial);
 
-#endif // _CRC_H_
\ No newline at end of file
+#endif // _CRC_H_
\ No newline at end of file
@@ -16,42 +16,127 @@
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /** The acceleration of 1 G in meters per second squared. */
-#define GRAVIT_ACC 9.81
+#define GRAVIT_ACC 9.80665f
+
+/** The length of a FIFO word in bytes: a tag followed by three 16 bit values. */
+#define FIFO_WORD_LEN 7
+
+/** The FIFO_CTRL4 mode in which new samples overwrite the oldest ones when the FIFO is full. */
+#define FIFO_MODE_CONTINUOUS 0x06
+
+/** The FIFO_CTRL4 mode in which nothing is batched and the FIFO is emptied. */
+#define FIFO_MODE_BYPASS 0x00
+
+/** The bit of FIFO_STATUS2 which is set if the FIFO overflowed since it was last read. */
+#define FIFO_OVR_LATCHED 0x08
+
+/** The bit of CTRL1_XL which sends the accelerometer's output through LPF2 (or the high-pass filter). */
+#define LPF2_XL_EN 0x02
+
+/** The bit of CTRL8_XL which selects the high-pass filter rather than LPF2. */
+#define HP_SLOPE_XL_EN 0x04
+
+/** The bit of CTRL4_C which enables the gyroscope's LPF1. */
+#define LPF1_SEL_G 0x02
+
+/** The bit of CTRL7_G which enables the gyroscope's high-pass filter. */
+#define HP_EN_G 0x40
+
+/** The bit of TAP_CFG0 which latches the wake-up and free-fall interrupts until their source is read. */
+#define LIR 0x01
+
+/** The bit of TAP_CFG0 which clears latched interrupts as soon as their source register is read. */
+#define INT_CLR_ON_READ 0x40
+
+/** The bit of TAP_CFG2 which enables the wake-up, free-fall, tap and 6D/4D embedded functions. */
+#define INTERRUPTS_ENABLE 0x80
+
+/** The bit of WAKE_UP_DUR which sets the weight of one WAKE_UP_THS count to a 256th of the full scale range. */
+#define WAKE_THS_W 0x10
+
+/** The largest wake-up threshold in counts, the width of the WK_THS field of WAKE_UP_THS. */
+#define WAKE_THS_MAX 0x3F
+
+/** The largest wake-up duration in samples, the width of the WAKE_DUR field of WAKE_UP_DUR. */
+#define WAKE_DUR_MAX 3
+
+/** The largest free-fall duration in samples, split between FREE_FALL and the top bit of WAKE_UP_DUR. */
+#define FF_DUR_MAX 0x3F
+
+/** The sensors which can tag a FIFO word. */
+enum fifo_tag {
+    FIFO_TAG_GYRO = 0x01,  /**< Gyroscope sample. */
+    FIFO_TAG_ACCEL = 0x02, /**< Accelerometer sample. */
+};
 
 /** The different registers that are present in the IMU (and used by this program). */
 enum imu_reg {
-    WHO_AM_I = 0x0F,   /**< Returns the hard-coded address of the IMU on the I2C bus. */
-    TIMESTAMP0 = 0x40, /**< First timestamp register (32 bits total) */
-    STATUS_REG = 0x1E, /**< The status register of whether data is available. */
-    CTRL1_XL = 0x10,   /**< Accelerometer control register 1 */
-    CTRL2_G = 0x11,    /**< Gyroscope control register 2 */
-    CTRL3_C = 0x12,    /**< Control register 3 */
-    CTRL4_C = 0x13,    /**< Control register 4 */
-    CTRL5_C = 0x14,    /**< Control register 5 */
-    CTRL6_C = 0x15,    /**< Control register 6 */
-    CTRL7_G = 0x16,    /**< Control register 7 */
-    CTRL8_XL = 0x17,   /**< Control register 8 */
-    CTRL9_XL = 0x18,   /**< Control register 9 */
-    CTRL10_C = 0x19,   /**< Control register 10 */
-    FIFO_CTRL4 = 0x0A, /**< The fourth FIFO control register (for setting continuous mode) */
-    OUT_TEMP_L = 0x20, /**< The temperature data output low byte. (Two's complement) */
-    OUT_TEMP_H = 0x21, /**< The temperature data output high byte. (Two's complement) */
-    OUTX_L_G = 0x22,   /**< The angular rate sensor pitch axis (X) low byte. (Two's complement) */
-    OUTX_H_G = 0x23,   /**< The angular rate sensor pitch axis (X) high byte. (Two's complement) */
-    OUTY_L_G = 0x24,   /**< The angular rate sensor roll axis (Y) low byte. (Two's complement) */
-    OUTY_H_G = 0x25,   /**< The angular rate sensor roll axis (Y) high byte. (Two's complement) */
-    OUTZ_L_G = 0x26,   /**< The angular rate sensor yaw axis (Z) low byte. (Two's complement) */
-    OUTZ_H_G = 0x27,   /**< The angular rate sensor yaw axis (Z) high byte. (Two's complement) */
-    OUTX_L_A = 0x28,   /**< The linear acceleration (X) low byte. (Two's complement) */
-    OUTX_H_A = 0x29,   /**< The linear acceleration (X) high byte. (Two's complement) */
-    OUTY_L_A = 0x2A,   /**< The linear acceleration (Y) low byte. (Two's complement) */
-    OUTY_H_A = 0x2B,   /**< The linear acceleration (Y) high byte. (Two's complement) */
-    OUTZ_L_A = 0x2C,   /**< The linear acceleration (Z) low byte. (Two's complement) */
-    OUTZ_H_A = 0x2D,   /**< The linear acceleration (Z) high byte. (Two's complement) */
-    X_OFS_USR = 0x73,  /** The x-axis user offset correction for linear acceleration. */
-    Y_OFS_USR = 0x74,  /** The y-axis user offset correction for linear acceleration. */
-    Z_OFS_USR = 0x75,  /** The z-axis user offset correction for linear acceleration. */
+    WHO_AM_I = 0x0F,          /**< Returns the hard-coded address of the IMU on the I2C bus. */
+    TIMESTAMP0 = 0x40,        /**< First timestamp register (32 bits total) */
+    STATUS_REG = 0x1E,        /**< The status register of whether data is available. */
+    WAKE_UP_SRC = 0x1B,       /**< The source of the wake-up and free-fall interrupts. */
+    TAP_CFG0 = 0x56,          /**< Interrupt latching and the filter of the wake-up function. */
+    TAP_CFG2 = 0x58,          /**< Enables the embedded interrupt functions. */
+    WAKE_UP_THS = 0x5B,       /**< The wake-up threshold. */
+    WAKE_UP_DUR = 0x5C,       /**< The wake-up duration and threshold weight, and the top free-fall duration bit. */
+    FREE_FALL = 0x5D,         /**< The free-fall threshold and duration. */
+    MD2_CFG = 0x5F,           /**< Routes the embedded functions to INT2, the last of their settings. */
+    CTRL1_XL = 0x10,          /**< Accelerometer control register 1 */
+    CTRL2_G = 0x11,           /**< Gyroscope control register 2 */
+    CTRL3_C = 0x12,           /**< Control register 3 */
+    CTRL4_C = 0x13,           /**< Control register 4 */
+    CTRL5_C = 0x14,           /**< Control register 5 */
+    CTRL6_C = 0x15,           /**< Control register 6 */
+    CTRL7_G = 0x16,           /**< Control register 7 */
+    CTRL8_XL = 0x17,          /**< Control register 8 */
+    CTRL9_XL = 0x18,          /**< Control register 9 */
+    CTRL10_C = 0x19,          /**< Control register 10 */
+    FIFO_CTRL1 = 0x07,        /**< The first FIFO control register, the first of the FIFO and interrupt settings. */
+    FIFO_CTRL3 = 0x09,        /**< The third FIFO control register (for setting the batch data rates) */
+    FIFO_CTRL4 = 0x0A,        /**< The fourth FIFO control register (for setting continuous mode) */
+    INT2_CTRL = 0x0E,         /**< The INT2 pin control register, the last of the FIFO and interrupt settings. */
+    FIFO_STATUS1 = 0x3A,      /**< The number of unread FIFO words, low byte. */
+    FIFO_STATUS2 = 0x3B,      /**< The number of unread FIFO words, high bits, and the FIFO status flags. */
+    FIFO_DATA_OUT_TAG = 0x78, /**< The tag of the oldest FIFO word, followed by its data. */
+    OUT_TEMP_L = 0x20,        /**< The temperature data output low byte. (Two's complement) */
+    OUT_TEMP_H = 0x21,        /**< The temperature data output high byte. (Two's complement) */
+    OUTX_L_G = 0x22,          /**< The angular rate sensor pitch axis (X) low byte. (Two's complement) */
+    OUTX_H_G = 0x23,          /**< The angular rate sensor pitch axis (X) high byte. (Two's complement) */
+    OUTY_L_G = 0x24,          /**< The angular rate sensor roll axis (Y) low byte. (Two's complement) */
+    OUTY_H_G = 0x25,          /**< The angular rate sensor roll axis (Y) high byte. (Two's complement) */
+    OUTZ_L_G = 0x26,          /**< The angular rate sensor yaw axis (Z) low byte. (Two's complement) */
+    OUTZ_H_G = 0x27,          /**< The angular rate sensor yaw axis (Z) high byte. (Two's complement) */
+    OUTX_L_A = 0x28,          /**< The linear acceleration (X) low byte. (Two's complement) */
+    OUTX_H_A = 0x29,          /**< The linear acceleration (X) high byte. (Two's complement) */
+    OUTY_L_A = 0x2A,          /**< The linear acceleration (Y) low byte. (Two's complement) */
+    OUTY_H_A = 0x2B,          /**< The linear acceleration (Y) high byte. (Two's complement) */
+    OUTZ_L_A = 0x2C,          /**< The linear acceleration (Z) low byte. (Two's complement) */
+    OUTZ_H_A = 0x2D,          /**< The linear acceleration (Z) high byte. (Two's complement) */
+    X_OFS_USR = 0x73,         /** The x-axis user offset correction for linear acceleration. */
+    Y_OFS_USR = 0x74,         /** The y-axis user offset correction for linear acceleration. */
+    Z_OFS_USR = 0x75,         /** The z-axis user offset correction for linear acceleration. */
+};
+
+/** A setting of some bits of one register: an entry of the declarative tables staged into a shadow. */
+typedef struct {
+    uint8_t reg;   /**< The address of the register. */
+    uint8_t mask;  /**< The bits of the register which are set. */
+    uint8_t value; /**< The value of those bits. */
+} lsm6dso32_reg_t;
+
+/** The first and last address of each range of adjacent settings registers, which can be written in one transaction. */
+static const uint8_t WRITABLE[][2] = {
+    {FIFO_CTRL1, INT2_CTRL},
+    {CTRL1_XL, CTRL10_C},
+    {TAP_CFG0, MD2_CFG},
+    {X_OFS_USR, Z_OFS_USR},
 };
 
 /** Macro to early return an error. */
@@ -105,161 +190,407 @@ static errno_t lsm6dso32_read_byte(SensorLocation const *loc, uint8_t reg, uint8
 }
 
 /**
- * Reads temperature from the IMU.
+ * Read consecutive registers starting at address `reg` in one transaction.
+ * WARNING: This function does not lock the I2C bus, as it is meant to be used in a continuous stream of calls.
+ * @param loc The location of the IMU on the I2C bus.
+ * @param reg The address of the first register to read from.
+ * @param buf The buffer to read data into.
+ * @param len The number of registers to read. Must be at least 1.
+ * @return EOK if the read was okay, otherwise the error status of the read command.
+ */
+static errno_t lsm6dso32_read_bytes(SensorLocation const *loc, uint8_t reg, uint8_t *buf, size_t len) {
+
+    i2c_sendrecv_t read_hdr = {.stop = 1, .send_len = 1, .recv_len = (uint32_t)len, .slave = loc->addr};
+    buf[0] = reg; // Data to be sent is the register address, which the received data then overwrites
+
+    iov_t siov[2];
+    SETIOV(&siov[0], &read_hdr, sizeof(read_hdr));
+    SETIOV(&siov[1], buf, len);
+    return devctlv(loc->bus, DCMD_I2C_SENDRECV, 2, 2, siov, siov, NULL);
+}
+
+/**
+ * Write data to consecutive registers starting at address `reg` in one transaction.
+ * WARNING: This function does not lock the I2C bus, as it is meant to be used in a continuous stream of calls.
+ * @param loc The location of the IMU on the I2C bus.
+ * @param reg The address of the first register to write to.
+ * @param data The data to write to the registers.
+ * @param len The number of registers to write.
+ * @return EOK if the write was okay, otherwise the error status of the write command.
+ */
+static errno_t lsm6dso32_write_bytes(SensorLocation const *loc, uint8_t reg, uint8_t *data, size_t len) {
+
+    struct {
+        i2c_send_t hdr;
+        uint8_t reg;
+    } cmd = {.hdr = {.len = (uint32_t)len + 1, .stop = 1, .slave = loc->addr}, .reg = reg};
+
+    iov_t siov[2];
+    SETIOV(&siov[0], &cmd, sizeof(cmd));
+    SETIOV(&siov[1], data, len);
+    return devctlv(loc->bus, DCMD_I2C_SEND, 2, 0, siov, NULL, NULL);
+}
+
+/**
+ * Checks whether a register holds settings, so that it can be written along with its neighbours.
+ * @param reg The address of the register.
+ * @return True if the register can be written, false if it is read-only or reserved.
+ */
+static bool writable(size_t reg) {
+    for (size_t i = 0; i < sizeof(WRITABLE) / sizeof(WRITABLE[0]); i++) {
+        if (reg >= WRITABLE[i][0] && reg <= WRITABLE[i][1]) return true;
+    }
+    return false;
+}
+
+/**
+ * Checks whether the value of a register is in the shadow.
+ * @param shadow The shadow of the IMU's registers.
+ * @param reg The address of the register.
+ * @return True if the value of the register is known.
+ */
+static bool known(const lsm6dso32_shadow_t *shadow, size_t reg) {
+    return shadow->known[reg / 8] & (1 << (reg % 8));
+}
+
+/**
+ * Marks the values of a range of registers in the shadow as known or unknown.
+ * @param shadow The shadow of the IMU's registers.
+ * @param first The address of the first register.
+ * @param last The address of the last register.
+ * @param is_known Whether the values are known.
+ */
+static void set_known(lsm6dso32_shadow_t *shadow, size_t first, size_t last, bool is_known) {
+    for (size_t reg = first; reg <= last; reg++) {
+        if (is_known) {
+            shadow->known[reg / 8] |= (uint8_t)(1 << (reg % 8));
+        } else {
+            shadow->known[reg / 8] &= (uint8_t)~(1 << (reg % 8));
+        }
+    }
+}
+
+/**
+ * Stages a table of settings into the shadow. A later setting of the same bits overrides an earlier one.
+ * @param shadow The shadow of the IMU's registers.
+ * @param table The settings.
+ * @param n The number of settings.
+ */
+static void stage(lsm6dso32_shadow_t *shadow, const lsm6dso32_reg_t *table, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        const lsm6dso32_reg_t *setting = &table[i];
+        shadow->value[setting->reg] = (shadow->value[setting->reg] & ~setting->mask) | (setting->value & setting->mask);
+        shadow->mask[setting->reg] |= setting->mask;
+    }
+}
+
+/**
+ * Empties a shadow, so that nothing is staged and every register is read before it is partly written. Must be called
+ * before the shadow is first used, and again whenever the IMU is reset or rebooted.
+ * @param shadow The shadow of the IMU's registers.
+ */
+void lsm6dso32_shadow_init(lsm6dso32_shadow_t *shadow) { memset(shadow, 0, sizeof(*shadow)); }
+
+/**
+ * Writes every setting staged in the shadow to the IMU. Staged registers which only settings registers separate are
+ * written together in one transaction, along with the registers in between. Before a range is written, it is read in
+ * one transaction unless the shadow already knows every register which is not entirely staged, and after it is
+ * written, it is read back in one transaction to verify it. Writing a range takes two or three transactions, instead
+ * of two per setting when reading and writing each register in turn.
+ * @param loc The location of the IMU on the I2C bus.
+ * @param shadow The shadow of the IMU's registers.
+ * @return Any error which occurred communicating with the IMU, EOK if successful, EIO if a range read back differently
+ * than it was written. On error, the settings which were not written stay staged.
+ */
+int lsm6dso32_commit(SensorLocation const *loc, lsm6dso32_shadow_t *shadow) {
+    uint8_t readback[LSM6DSO32_NREGS];
+
+    for (size_t first = 0; first < LSM6DSO32_NREGS; first++) {
+        if (shadow->mask[first] == 0) continue;
+
+        // Extend the range up to the last staged register with only settings registers in between
+        size_t last = first;
+        for (size_t reg = first + 1; reg < LSM6DSO32_NREGS && writable(reg); reg++) {
+            if (shadow->mask[reg] != 0) last = reg;
+        }
+        size_t len = last - first + 1;
+
+        // The bits which are not staged keep their values, so they must be known
+        bool fetch = false;
+        for (size_t reg = first; reg <= last; reg++) {
+            if (shadow->mask[reg] != 0xFF && !known(shadow, reg)) fetch = true;
+        }
+        int err = EOK;
+        if (fetch) err = lsm6dso32_read_bytes(loc, (uint8_t)first, &shadow->regs[first], len);
+        if (err != EOK) {
+            set_known(shadow, first, last, false);
+            return err;
+        }
+
+        for (size_t reg = first; reg <= last; reg++) {
+            shadow->regs[reg] = (shadow->regs[reg] & ~shadow->mask[reg]) | (shadow->value[reg] & shadow->mask[reg]);
+        }
+        err = lsm6dso32_write_bytes(loc, (uint8_t)first, &shadow->regs[first], len);
+        if (err == EOK) err = lsm6dso32_read_bytes(loc, (uint8_t)first, readback, len);
+        if (err == EOK && memcmp(readback, &shadow->regs[first], len) != 0) err = EIO;
+        if (err != EOK) {
+            set_known(shadow, first, last, false);
+            return err;
+        }
+
+        set_known(shadow, first, last, true);
+        memset(&shadow->mask[first], 0, len);
+        memset(&shadow->value[first], 0, len);
+        first = last;
+    }
+    return EOK;
+}
+
+/**
+ * Reads temperature from the IMU in one transaction.
  * @param loc The sensor location.
- * @temperature A pointer to where to store the temperature in degrees Celsius.
+ * @param temperature A pointer to where to store the raw temperature, see `lsm6dso32_convert_temp`.
  * @return The error status of reading from the sensor. EOK if successful.
  */
 int lsm6dso32_get_temp(SensorLocation const *loc, int16_t *temperature) {
-    int err = lsm6dso32_read_byte(loc, OUT_TEMP_L, (uint8_t *)(temperature)); // Read low byte
-    return_err(err);
-    err = lsm6dso32_read_byte(loc, OUT_TEMP_H, ((uint8_t *)(temperature) + 1)); // Read high byte
-    return_err(err);
-    *temperature = (*temperature / 256.0f) + 25.0f; // In degrees Celsius
-    return err;
+    return lsm6dso32_read_bytes(loc, OUT_TEMP_L, (uint8_t *)temperature, sizeof(*temperature));
 }
 
 /**
- * Read the linear acceleration data from the IMU.
- * @param x A pointer to where to store the X component of the acceleration in milli-Gs per LSB.
- * @param y A pointer to where to store the Y component of the acceleration in milli-Gs per LSB.
- * @param z A pointer to where to store the Z component of the acceleration in milli-Gs per LSB.
+ * Read the linear acceleration data from the IMU, all three axes in one transaction.
+ * @param x A pointer to where to store the raw X component of the acceleration.
+ * @param y A pointer to where to store the raw Y component of the acceleration.
+ * @param z A pointer to where to store the raw Z component of the acceleration.
  * @return Any error that occurred while reading the sensor, EOK if successful.
  */
 int lsm6dso32_get_accel(SensorLocation const *loc, int16_t *x, int16_t *y, int16_t *z) {
-
-    int err = lsm6dso32_read_byte(loc, OUTX_L_A, (uint8_t *)(x)); // Read low byte
+    int16_t axes[3];
+    int err = lsm6dso32_read_bytes(loc, OUTX_L_A, (uint8_t *)axes, sizeof(axes));
     return_err(err);
-    err = lsm6dso32_read_byte(loc, OUTX_H_A, (uint8_t *)(x) + 1); // Read high byte
-    return_err(err);
-
-    err = lsm6dso32_read_byte(loc, OUTY_L_A, (uint8_t *)(y));
-    return_err(err);
-    err = lsm6dso32_read_byte(loc, OUTY_H_A, (uint8_t *)(y) + 1);
-    return_err(err);
-
-    err = lsm6dso32_read_byte(loc, OUTZ_L_A, (uint8_t *)(z));
-    return_err(err);
-    err = lsm6dso32_read_byte(loc, OUTZ_H_A, (uint8_t *)(z) + 1);
+    *x = axes[0];
+    *y = axes[1];
+    *z = axes[2];
     return err;
 }
 
 /**
- * Read the linear angular velocity data from the IMU.
- * @param x A pointer to where to store the X component of the angular velocity in millidegrees per LSB.
- * @param y A pointer to where to store the Y component of the angular velocity in millidegrees per LSB.
- * @param z A pointer to where to store the Z component of the angular velocity in millidegrees per LSB.
+ * Read the linear angular velocity data from the IMU, all three axes in one transaction.
+ * @param x A pointer to where to store the raw X component of the angular velocity.
+ * @param y A pointer to where to store the raw Y component of the angular velocity.
+ * @param z A pointer to where to store the raw Z component of the angular velocity.
  * @return Any error that occurred while reading the sensor, EOK if successful.
  */
 int lsm6dso32_get_angular_vel(SensorLocation const *loc, int16_t *x, int16_t *y, int16_t *z) {
-    int err = lsm6dso32_read_byte(loc, OUTX_L_G, (uint8_t *)(x)); // Read low byte
-    return_err(err);
-    err = lsm6dso32_read_byte(loc, OUTX_H_G, (uint8_t *)(x) + 1); // Read high byte
+    int16_t axes[3];
+    int err = lsm6dso32_read_bytes(loc, OUTX_L_G, (uint8_t *)axes, sizeof(axes));
     return_err(err);
+    *x = axes[0];
+    *y = axes[1];
+    *z = axes[2];
+    return err;
+}
+
+/**
+ * Read the temperature, angular velocity and linear acceleration from the IMU in one transaction.
+ * @param loc The location of the IMU on the I2C bus.
+ * @param raw Where to store the raw outputs.
+ * @return Any error that occurred while reading the sensor, EOK if successful.
+ */
+int lsm6dso32_get_raw(SensorLocation const *loc, lsm6dso32_raw_t *raw) {
+    _Static_assert(sizeof(lsm6dso32_raw_t) == OUTZ_H_A - OUT_TEMP_L + 1, "Raw outputs must match the registers");
+    return lsm6dso32_read_bytes(loc, OUT_TEMP_L, (uint8_t *)raw, sizeof(*raw));
+}
+
+/**
+ * Stages batching accelerometer and gyroscope samples into the FIFO in continuous mode, where new samples overwrite the
+ * oldest ones once the FIFO is full.
+ * @param shadow The shadow of the IMU's registers.
+ * @param accel_rate The rate at which accelerometer samples are batched. Must not be above the accelerometer's ODR.
+ * @param gyro_rate The rate at which gyroscope samples are batched. Must not be above the gyroscope's ODR.
+ * @return EOK.
+ */
+int lsm6dso32_fifo_start(lsm6dso32_shadow_t *shadow, accel_odr_e accel_rate, gyro_odr_e gyro_rate) {
+    // The batch data rates of FIFO_CTRL3 use the same codes as the ODRs of CTRL1_XL and CTRL2_G
+    uint8_t bdr = (uint8_t)((gyro_rate & 0xF0) | ((accel_rate & 0xF0) >> 4));
+    const lsm6dso32_reg_t settings[] = {
+        {.reg = FIFO_CTRL3, .mask = 0xFF, .value = bdr},
+        {.reg = FIFO_CTRL4, .mask = 0xFF, .value = FIFO_MODE_CONTINUOUS},
+    };
+    stage(shadow, settings, 2);
+    return EOK;
+}
+
+/**
+ * Stages stopping batching samples into the FIFO, which empties it so that only the latest outputs can be read.
+ * @param shadow The shadow of the IMU's registers.
+ * @return EOK.
+ */
+int lsm6dso32_fifo_stop(lsm6dso32_shadow_t *shadow) {
+    const lsm6dso32_reg_t setting = {.reg = FIFO_CTRL4, .mask = 0xFF, .value = FIFO_MODE_BYPASS};
+    stage(shadow, &setting, 1);
+    return EOK;
+}
 
-    err = lsm6dso32_read_byte(loc, OUTY_L_G, (uint8_t *)(y));
+/**
+ * Reads up to LSM6DSO32_FIFO_BURST words from the FIFO in one transaction, sorting them into accelerometer and
+ * gyroscope samples. Words from other sensors are skipped.
+ * @param loc The location of the IMU on the I2C bus.
+ * @param fifo Where to store the samples read, how many words are left and whether the FIFO overflowed.
+ * @return Any error which occurred communicating with the IMU, EOK if successful.
+ */
+int lsm6dso32_fifo_read(SensorLocation const *loc, lsm6dso32_fifo_t *fifo) {
+    fifo->naccel = 0;
+    fifo->ngyro = 0;
+
+    // Reading FIFO_STATUS2 also clears its latched overrun flag
+    uint8_t status[2];
+    int err = lsm6dso32_read_bytes(loc, FIFO_STATUS1, status, sizeof(status));
     return_err(err);
-    err = lsm6dso32_read_byte(loc, OUTY_H_G, (uint8_t *)(y) + 1);
+    size_t words = (size_t)(status[0] | ((status[1] & 0x03) << 8));
+    size_t n = words < LSM6DSO32_FIFO_BURST ? words : LSM6DSO32_FIFO_BURST;
+    fifo->overrun = status[1] & FIFO_OVR_LATCHED;
+    fifo->remaining = words - n;
+    if (n == 0) return EOK;
+
+    uint8_t buf[LSM6DSO32_FIFO_BURST * FIFO_WORD_LEN];
+    err = lsm6dso32_read_bytes(loc, FIFO_DATA_OUT_TAG, buf, n * FIFO_WORD_LEN);
     return_err(err);
 
-    err = lsm6dso32_read_byte(loc, OUTZ_L_G, (uint8_t *)(z));
-    return_err(err);
-    err = lsm6dso32_read_byte(loc, OUTZ_H_G, (uint8_t *)(z) + 1);
-    return err;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *word = &buf[i * FIFO_WORD_LEN];
+        int16_t *axes;
+        switch (word[0] >> 3) {
+        case FIFO_TAG_ACCEL:
+            axes = fifo->accel[fifo->naccel++];
+            break;
+        case FIFO_TAG_GYRO:
+            axes = fifo->gyro[fifo->ngyro++];
+            break;
+        default:
+            continue;
+        }
+        for (uint8_t a = 0; a < 3; a++) {
+            axes[a] = (int16_t)(word[1 + 2 * a] | (word[2 + 2 * a] << 8));
+        }
+    }
+    return EOK;
 }
 
 /**
- * Converts acceleration in milli-Gs per LSB to meters per second squared. Results are stored back in the pointers
- * themselves. Passing NULL as any of the pointers will result in the calculation being skipped.
+ * Gets the sensitivity of the accelerometer from the data sheet.
  * @param acc_fsr The full scale range of the accelerometer.
- * @param x A pointer to the X component of the acceleration in milli-Gs per LSB.
- * @param y A pointer to the Y component of the acceleration in milli-Gs per LSB.
- * @param z A pointer to the Z component of the acceleration in milli-Gs per LSB.
+ * @return The acceleration of one count in meters per second squared, or 0 if the full scale range is invalid.
  */
-void lsm6dso32_convert_accel(accel_fsr_e acc_fsr, int16_t *x, int16_t *y, int16_t *z) {
-
-    int16_t conversion_factor;
+float __attribute__((const)) lsm6dso32_accel_sensitivity(accel_fsr_e acc_fsr) {
     switch (acc_fsr) {
     case LA_FS_4G:
-        conversion_factor = 8197;
-        break;
+        return 0.122f / 1000 * GRAVIT_ACC;
     case LA_FS_8G:
-        conversion_factor = 4098;
-        break;
+        return 0.244f / 1000 * GRAVIT_ACC;
     case LA_FS_16G:
-        conversion_factor = 2049;
-        break;
+        return 0.488f / 1000 * GRAVIT_ACC;
     case LA_FS_32G:
-        conversion_factor = 1025;
-        break;
+        return 0.976f / 1000 * GRAVIT_ACC;
     }
-
-    if (x) (*x) = ((*x) / conversion_factor) * (int16_t)GRAVIT_ACC;
-    if (y) (*y) = ((*y) / conversion_factor) * (int16_t)GRAVIT_ACC;
-    if (z) (*z) = ((*z) / conversion_factor) * (int16_t)GRAVIT_ACC;
+    return 0;
 }
 
 /**
- * Converts angular velocity in millidegrees per LSB to degrees per second. Results are stored back in the
- * pointers themselves. Passing NULL as any of the pointers will result in the calculation being skipped.
+ * Gets the sensitivity of the gyroscope from the data sheet.
  * @param gyro_fsr The full scale range of the gyroscope.
- * @param x A pointer to the X component of the angular velocity in millidegrees per LSB.
- * @param y A pointer to the Y component of the angular velocity in millidegrees per LSB.
- * @param z A pointer to the Z component of the angular velocity in millidegrees per LSB.
+ * @return The angular velocity of one count in degrees per second, or 0 if the full scale range is invalid.
  */
-void lsm6dso32_convert_angular_vel(gyro_fsr_e gyro_fsr, int16_t *x, int16_t *y, int16_t *z) {
-
-    int16_t conversion_factor;
+float __attribute__((const)) lsm6dso32_gyro_sensitivity(gyro_fsr_e gyro_fsr) {
     switch (gyro_fsr) {
     case G_FS_125:
-        conversion_factor = 229;
-        break;
+        return 4.375f / 1000;
     case G_FS_250:
-        conversion_factor = 114;
-        break;
+        return 8.75f / 1000;
     case G_FS_500:
-        conversion_factor = 57;
-        break;
+        return 17.5f / 1000;
     case G_FS_1000:
-        conversion_factor = 29;
-        break;
+        return 35.0f / 1000;
     case G_FS_2000:
-        conversion_factor = 14;
-        break;
+        return 70.0f / 1000;
     }
+    return 0;
+}
+
+/**
+ * Converts a raw temperature to degrees Celsius.
+ * @param raw The raw temperature.
+ * @return The temperature in degrees Celsius.
+ */
+float __attribute__((const)) lsm6dso32_convert_temp(int16_t raw) { return (float)raw / 256 + 25; }
 
-    if (x) (*x) /= conversion_factor;
-    if (y) (*y) /= conversion_factor;
-    if (z) (*z) /= conversion_factor;
+/**
+ * Converts raw counts to physical units, one count at a time. This is the reference the vectorized conversion matches.
+ * @param counts The raw counts, like the X, Y and Z axes of consecutive samples.
+ * @param values Where to store the converted values.
+ * @param n The number of counts to convert.
+ * @param sensitivity The value of one count, from `lsm6dso32_accel_sensitivity` or `lsm6dso32_gyro_sensitivity`.
+ */
+void lsm6dso32_convert_scalar(const int16_t *counts, float *values, size_t n, float sensitivity) {
+    for (size_t i = 0; i < n; i++) {
+        values[i] = (float)counts[i] * sensitivity;
+    }
+}
+
+/**
+ * Converts raw counts to physical units, eight at a time with NEON or SSE2 where available. Every count converts to a
+ * float exactly and is rounded once by the multiplication, so the results are identical to
+ * `lsm6dso32_convert_scalar`.
+ * @param counts The raw counts, like the X, Y and Z axes of consecutive samples.
+ * @param values Where to store the converted values.
+ * @param n The number of counts to convert.
+ * @param sensitivity The value of one count, from `lsm6dso32_accel_sensitivity` or `lsm6dso32_gyro_sensitivity`.
+ */
+void lsm6dso32_convert(const int16_t *counts, float *values, size_t n, float sensitivity) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t raw = vld1q_s16(&counts[i]);
+        vst1q_f32(&values[i], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(raw))), sensitivity));
+        vst1q_f32(&values[i + 4], vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(raw))), sensitivity));
+    }
+#elif defined(__SSE2__)
+    __m128 scale = _mm_set1_ps(sensitivity);
+    for (; i + 8 <= n; i += 8) {
+        __m128i raw = _mm_loadu_si128((const __m128i *)&counts[i]);
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16); // Sign extend by shifting down a copy
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16);
+        _mm_storeu_ps(&values[i], _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(&values[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+#endif
+    lsm6dso32_convert_scalar(&counts[i], &values[i], n - i, sensitivity);
 }
 
 /**
- * Performs a software reset of the LSM6DSO32.
+ * Performs a software reset of the LSM6DSO32. Any shadow of its registers must then be emptied with
+ * `lsm6dso32_shadow_init`.
  * @param loc The location of the IMU on the I2C bus.
  * @return Any error which occurred while resetting the IMU, EOK if successful.
  */
 int lsm6dso32_reset(SensorLocation const *loc) { return lsm6dso32_write_byte(loc, CTRL3_C, 0x01); }
 
 /**
- * Reboots the memory content of the LSM6DSO32.
+ * Reboots the memory content of the LSM6DSO32. Any shadow of its registers must then be emptied with
+ * `lsm6dso32_shadow_init`.
  * @param loc The location of the IMU on the I2C bus.
  * @return Any error which occurred while rebooting the IMU, EOK if successful.
  */
 int lsm6dso32_mem_reboot(SensorLocation const *loc) { return lsm6dso32_write_byte(loc, CTRL3_C, 0x80); }
 
 /**
- * Sets the accelerometer full scale range.
- * @param loc The location of the IMU on the I2C bus.
+ * Stages the accelerometer full scale range.
+ * @param shadow The shadow of the IMU's registers.
  * @param fsr The FSR to set.
- * @return Any error which occurred communicating with the IMU, EOK if successful, EINVAL if bad fsr.
+ * @return EOK if successful, EINVAL if bad fsr.
  */
-int lsm6dso32_set_acc_fsr(SensorLocation const *loc, accel_fsr_e fsr) {
-
-    uint8_t reg_val;
-    int err = lsm6dso32_read_byte(loc, CTRL1_XL, &reg_val); // Don't overwrite other configurations
-    reg_val &= ~((1 << 3) | (1 << 2));                      // Clear FSR selection bits
-    return_err(err);
+int lsm6dso32_set_acc_fsr(lsm6dso32_shadow_t *shadow, accel_fsr_e fsr) {
 
+    uint8_t reg_val = 0;
     switch (fsr) {
     case LA_FS_4G:
         // All zeroes
@@ -276,22 +607,20 @@ int lsm6dso32_set_acc_fsr(SensorLocation const *loc, accel_fsr_e fsr) {
     default:
         return EINVAL;
     }
-    return lsm6dso32_write_byte(loc, CTRL1_XL, reg_val);
+    const lsm6dso32_reg_t setting = {.reg = CTRL1_XL, .mask = (1 << 3) | (1 << 2), .value = reg_val};
+    stage(shadow, &setting, 1);
+    return EOK;
 }
 
 /**
- * Sets the gyroscope full scale range.
- * @param loc The location of the IMU on the I2C bus.
+ * Stages the gyroscope full scale range.
+ * @param shadow The shadow of the IMU's registers.
  * @param fsr The FSR to set.
- * @return Any error which occurred communicating with the IMU, EOK if successful, EINVAL if bad fsr.
+ * @return EOK if successful, EINVAL if bad fsr.
  */
-int lsm6dso32_set_gyro_fsr(SensorLocation const *loc, gyro_fsr_e fsr) {
-
-    uint8_t reg_val;
-    int err = lsm6dso32_read_byte(loc, CTRL2_G, &reg_val); // Don't overwrite other configurations
-    reg_val &= ~(0x0F);                                    // Clear FSR selection bits
-    return_err(err);
+int lsm6dso32_set_gyro_fsr(lsm6dso32_shadow_t *shadow, gyro_fsr_e fsr) {
 
+    uint8_t reg_val = 0;
     switch (fsr) {
     case G_FS_125:
         reg_val |= (1 << 1);
@@ -311,76 +640,235 @@ int lsm6dso32_set_gyro_fsr(SensorLocation const *loc, gyro_fsr_e fsr) {
     default:
         return EINVAL;
     }
-    return lsm6dso32_write_byte(loc, CTRL2_G, reg_val);
+    const lsm6dso32_reg_t setting = {.reg = CTRL2_G, .mask = 0x0F, .value = reg_val};
+    stage(shadow, &setting, 1);
+    return EOK;
 }
 
 /**
- * Sets the accelerometer output data rate.
+ * Stages the accelerometer output data rate.
  * NOTE: An ODR of 1.6Hz can only be set if high performance operating mode is disabled. Otherwise the effect will be
  * 12.6Hz ODR. It is the responsibility of the caller to set disable the high performance operating mode before or after
  * this function is called.
- * @param loc The location of the IMU on the I2C bus.
+ * @param shadow The shadow of the IMU's registers.
  * @param odr The ODR to set.
- * @return Any error which occurred communicating with the IMU, EOK if successful.
+ * @return EOK.
  */
-int lsm6dso32_set_acc_odr(SensorLocation const *loc, accel_odr_e odr) {
-    uint8_t reg_val;
-    int err = lsm6dso32_read_byte(loc, CTRL1_XL, &reg_val); // Don't overwrite other configurations
-    reg_val &= ~(0xF0);                                     // Clear ODR selection bits
-    reg_val |= (uint8_t)(odr);                              // Set ODR selection
-    return_err(err);
-    return lsm6dso32_write_byte(loc, CTRL1_XL, reg_val);
+int lsm6dso32_set_acc_odr(lsm6dso32_shadow_t *shadow, accel_odr_e odr) {
+    const lsm6dso32_reg_t setting = {.reg = CTRL1_XL, .mask = 0xF0, .value = (uint8_t)odr};
+    stage(shadow, &setting, 1);
+    return EOK;
 }
 
 /**
- * Sets the gyroscope output data rate.
- * @param loc The location of the IMU on the I2C bus.
+ * Stages the gyroscope output data rate.
+ * @param shadow The shadow of the IMU's registers.
  * @param odr The ODR to set.
- * @return Any error which occurred communicating with the IMU, EOK if successful.
+ * @return EOK.
  */
-int lsm6dso32_set_gyro_odr(SensorLocation const *loc, gyro_odr_e odr) {
-    uint8_t reg_val;
-    int err = lsm6dso32_read_byte(loc, CTRL2_G, &reg_val); // Don't overwrite other configurations
-    reg_val &= ~(0xF0);                                    // Clear ODR selection bits
-    reg_val |= (uint8_t)(odr);                             // Set ODR selection
-    return_err(err);
-    return lsm6dso32_write_byte(loc, CTRL2_G, reg_val);
+int lsm6dso32_set_gyro_odr(lsm6dso32_shadow_t *shadow, gyro_odr_e odr) {
+    const lsm6dso32_reg_t setting = {.reg = CTRL2_G, .mask = 0xF0, .value = (uint8_t)odr};
+    stage(shadow, &setting, 1);
+    return EOK;
 }
 
 /**
- * Allows high performance operating mode to be enabled/disabled.
- * @param loc The location of the IMU on the I2C bus.
+ * Stages enabling or disabling the high performance operating mode of the accelerometer. With it disabled, the
+ * accelerometer runs in low power mode at output data rates up to 52 Hz and in normal mode up to 208 Hz.
+ * @param shadow The shadow of the IMU's registers.
  * @param on True to turn on high performance, false to turn it off.
- * @return Any error which occurred communicating with the IMU, EOK if successful.
+ * @return EOK.
  */
-int lsm6dso32_high_performance(SensorLocation const *loc, bool on) {
+int lsm6dso32_high_performance(lsm6dso32_shadow_t *shadow, bool on) {
+    // XL_HM_MODE disables high performance mode when set
+    const lsm6dso32_reg_t setting = {.reg = CTRL6_C, .mask = 0x10, .value = on ? 0x00 : 0x10};
+    stage(shadow, &setting, 1);
+    return EOK;
+}
 
-    uint8_t reg_val;
-    int err = lsm6dso32_read_byte(loc, CTRL6_C, &reg_val);
-    return_err(err);
+/**
+ * Stages the accelerometer's filter path after LPF1, and the bandwidth of LPF2 or the cutoff of the high-pass filter.
+ * The FIFO and the output registers get the filtered samples, so with LPF2 a lower output data rate can be used
+ * without aliasing.
+ * @param shadow The shadow of the IMU's registers.
+ * @param path The filter path.
+ * @param bw The bandwidth of LPF2 or the cutoff of the high-pass filter, ignored for XL_FILTER_LPF1.
+ * @return EOK if successful, EINVAL if bad path or bandwidth.
+ */
+int lsm6dso32_accel_filter(lsm6dso32_shadow_t *shadow, accel_filter_e path, accel_bw_e bw) {
+    uint8_t hpcf;
+    switch (bw) {
+    case XL_BW_ODR_4:
+        hpcf = 0;
+        break;
+    case XL_BW_ODR_10:
+        hpcf = 1;
+        break;
+    case XL_BW_ODR_20:
+        hpcf = 2;
+        break;
+    case XL_BW_ODR_45:
+        hpcf = 3;
+        break;
+    case XL_BW_ODR_100:
+        hpcf = 4;
+        break;
+    case XL_BW_ODR_200:
+        hpcf = 5;
+        break;
+    case XL_BW_ODR_400:
+        hpcf = 6;
+        break;
+    case XL_BW_ODR_800:
+        hpcf = 7;
+        break;
+    default:
+        return EINVAL;
+    }
+    if (path != XL_FILTER_LPF1 && path != XL_FILTER_LPF2 && path != XL_FILTER_HPF) return EINVAL;
+
+    uint8_t ctrl8 = 0;
+    if (path != XL_FILTER_LPF1) ctrl8 |= (uint8_t)(hpcf << 5);
+    if (path == XL_FILTER_HPF) ctrl8 |= HP_SLOPE_XL_EN;
+    const lsm6dso32_reg_t settings[] = {
+        {.reg = CTRL8_XL, .mask = 0xE0 | HP_SLOPE_XL_EN, .value = ctrl8},
+        {.reg = CTRL1_XL, .mask = LPF2_XL_EN, .value = path == XL_FILTER_LPF2 ? LPF2_XL_EN : 0},
+    };
+    stage(shadow, settings, 2);
+    return EOK;
+}
 
-    if (on) {
-        reg_val |= 0x10;
-    } else {
-        reg_val &= ~0x10;
+/**
+ * Stages enabling or disabling the gyroscope's LPF1 and its bandwidth. The bandwidth of each setting depends on the
+ * output data rate, see the gyroscope LPF1 bandwidth selection table of the data sheet.
+ * @param shadow The shadow of the IMU's registers.
+ * @param on True to enable LPF1, false to disable it.
+ * @param ftype The bandwidth setting, from 0 to LSM6DSO32_GYRO_LPF1_MAX.
+ * @return EOK if successful, EINVAL if bad bandwidth setting.
+ */
+int lsm6dso32_gyro_lpf1(lsm6dso32_shadow_t *shadow, bool on, uint8_t ftype) {
+    if (ftype > LSM6DSO32_GYRO_LPF1_MAX) return EINVAL;
+
+    const lsm6dso32_reg_t settings[] = {
+        {.reg = CTRL6_C, .mask = LSM6DSO32_GYRO_LPF1_MAX, .value = ftype},
+        {.reg = CTRL4_C, .mask = LPF1_SEL_G, .value = on ? LPF1_SEL_G : 0},
+    };
+    stage(shadow, settings, 2);
+    return EOK;
+}
+
+/**
+ * Stages the cutoff of the gyroscope's high-pass filter, which removes its bias, or disabling it.
+ * @param shadow The shadow of the IMU's registers.
+ * @param hpf The cutoff, or G_HPF_OFF.
+ * @return EOK if successful, EINVAL if bad cutoff.
+ */
+int lsm6dso32_gyro_hpf(lsm6dso32_shadow_t *shadow, gyro_hpf_e hpf) {
+    uint8_t reg_val = 0;
+    switch (hpf) {
+    case G_HPF_OFF:
+        break;
+    case G_HPF_16_MHZ:
+        reg_val |= HP_EN_G;
+        break;
+    case G_HPF_65_MHZ:
+        reg_val |= HP_EN_G | 0x10;
+        break;
+    case G_HPF_260_MHZ:
+        reg_val |= HP_EN_G | 0x20;
+        break;
+    case G_HPF_1040_MHZ:
+        reg_val |= HP_EN_G | 0x30;
+        break;
+    default:
+        return EINVAL;
     }
+    const lsm6dso32_reg_t setting = {.reg = CTRL7_G, .mask = HP_EN_G | 0x30, .value = reg_val};
+    stage(shadow, &setting, 1);
+    return EOK;
+}
+
+/**
+ * Stages powering down the gyroscope.
+ * @param shadow The shadow of the IMU's registers.
+ * @return EOK.
+ */
+int lsm6dso32_disable_gyro(lsm6dso32_shadow_t *shadow) { return lsm6dso32_set_gyro_odr(shadow, 0); }
 
-    return lsm6dso32_write_byte(loc, CTRL6_C, reg_val);
+/**
+ * Stages powering down the accelerometer.
+ * @param shadow The shadow of the IMU's registers.
+ * @return EOK.
+ */
+int lsm6dso32_disable_accel(lsm6dso32_shadow_t *shadow) { return lsm6dso32_set_acc_odr(shadow, 0); }
+
+/**
+ * Stages setting up the wake-up function, which detects activity: the slope of the acceleration between two
+ * consecutive samples exceeding a threshold on any axis. Since it only looks at changes, gravity does not count
+ * whichever way the sensor lies. The threshold is rounded to the nearest 256th of the full scale range.
+ * @param shadow The shadow of the IMU's registers.
+ * @param fsr The full scale range the accelerometer is set to.
+ * @param threshold_mg The threshold in thousandths of g.
+ * @param duration How many samples the slope must exceed the threshold for, from 0 (one sample) to 3.
+ * @return EOK if successful, EINVAL if the threshold or duration is out of range.
+ */
+int lsm6dso32_wake_up_config(lsm6dso32_shadow_t *shadow, accel_fsr_e fsr, uint16_t threshold_mg, uint8_t duration) {
+    uint32_t counts = ((uint32_t)threshold_mg * 256 + (uint32_t)fsr * 500) / ((uint32_t)fsr * 1000);
+    if (counts == 0 || counts > WAKE_THS_MAX || duration > WAKE_DUR_MAX) return EINVAL;
+
+    // Keep the free-fall and sleep durations, and the tap and user offset settings
+    const lsm6dso32_reg_t settings[] = {
+        {.reg = WAKE_UP_DUR, .mask = 0x70, .value = (uint8_t)(duration << 5) | WAKE_THS_W},
+        {.reg = WAKE_UP_THS, .mask = WAKE_THS_MAX, .value = (uint8_t)counts},
+    };
+    stage(shadow, settings, 2);
+    return EOK;
 }
 
 /**
- * Powers down the gyroscope.
- * @param loc The location of the IMU on the I2C bus.
- * @return Any error which occurred communicating with the IMU, EOK if successful.
+ * Stages setting up the free-fall function, which detects the acceleration on every axis staying below a threshold.
+ * @param shadow The shadow of the IMU's registers.
+ * @param threshold The threshold.
+ * @param duration How many samples the acceleration must stay below the threshold for, up to 63.
+ * @return EOK if successful, EINVAL if the duration is out of range.
  */
-int lsm6dso32_disable_gyro(SensorLocation const *loc) { return lsm6dso32_set_gyro_odr(loc, 0); }
+int lsm6dso32_free_fall_config(lsm6dso32_shadow_t *shadow, free_fall_ths_e threshold, uint8_t duration) {
+    if (duration > FF_DUR_MAX) return EINVAL;
+
+    const lsm6dso32_reg_t settings[] = {
+        {.reg = WAKE_UP_DUR, .mask = 0x80, .value = (uint8_t)((duration & 0x20) << 2)}, // FF_DUR5
+        {.reg = FREE_FALL, .mask = 0xFF, .value = (uint8_t)((duration & 0x1F) << 3) | (uint8_t)threshold},
+    };
+    stage(shadow, settings, 2);
+    return EOK;
+}
 
 /**
- * Powers down the accelerometer.
+ * Stages enabling or disabling the wake-up and free-fall functions. Their interrupts are latched until `WAKE_UP_SRC`
+ * is read, so a short event is not missed between two reads of it, and need not be routed to an interrupt pin.
+ * @param shadow The shadow of the IMU's registers.
+ * @param enable True to enable the functions, false to disable them.
+ * @return EOK.
+ */
+int lsm6dso32_int_enable(lsm6dso32_shadow_t *shadow, bool enable) {
+    // Keep the tap, filter and inactivity settings
+    const lsm6dso32_reg_t settings[] = {
+        {.reg = TAP_CFG0, .mask = LIR | INT_CLR_ON_READ, .value = LIR | INT_CLR_ON_READ},
+        {.reg = TAP_CFG2, .mask = INTERRUPTS_ENABLE, .value = enable ? INTERRUPTS_ENABLE : 0},
+    };
+    stage(shadow, settings, 2);
+    return EOK;
+}
+
+/**
+ * Reads the source of the wake-up and free-fall interrupts, which clears them.
  * @param loc The location of the IMU on the I2C bus.
+ * @param src Set to the source, a combination of LSM6DSO32_WU_IA, LSM6DSO32_FF_IA and the axes in LSM6DSO32_WU_AXES.
  * @return Any error which occurred communicating with the IMU, EOK if successful.
  */
-int lsm6dso32_disable_accel(SensorLocation const *loc) { return lsm6dso32_set_gyro_odr(loc, 0); }
+int lsm6dso32_get_wake_up_src(SensorLocation const *loc, uint8_t *src) {
+    return lsm6dso32_read_byte(loc, WAKE_UP_SRC, src);
+}
 
 /**
  * Reads the "who am I" value from the sensor. Should always be equal to 0x6C.
@@ -11,11 +11,24 @@
 
 #include "../sensor_api.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /** The value that should be returned from the WHOAMI register. */
 #define WHOAMI_VALUE 0x6C
 
+/** The most FIFO words read in one I2C transaction. */
+#define LSM6DSO32_FIFO_BURST 32
+
+/** The bit of the wake-up source which is set if the wake-up function detected activity. */
+#define LSM6DSO32_WU_IA 0x08
+
+/** The bit of the wake-up source which is set if the free-fall function detected a free fall. */
+#define LSM6DSO32_FF_IA 0x20
+
+/** The bits of the wake-up source which tell on which axes activity was detected (X 0x04, Y 0x02 and Z 0x01). */
+#define LSM6DSO32_WU_AXES 0x07
+
 /** Represents the possible full scale range settings for linear acceleration in Gs (gravitational acceleration). */
 typedef enum {
     LA_FS_4G = 4,   /**< Full scale range of +/- 4Gs */
@@ -62,23 +75,112 @@ typedef enum {
     G_ODR_6664 = 0xA0, /** 6644 Hz */
 } gyro_odr_e;
 
+/** The possible paths of the accelerometer's output after its first low-pass filter (LPF1, ODR/2 bandwidth). */
+typedef enum {
+    XL_FILTER_LPF1, /**< No further filtering. */
+    XL_FILTER_LPF2, /**< The second low-pass filter, which can band-limit the output below ODR/2. */
+    XL_FILTER_HPF,  /**< The high-pass filter, which removes gravity and drift. */
+} accel_filter_e;
+
+/** Possible bandwidths of the accelerometer's LPF2 and cutoffs of its high-pass filter, as divisors of the ODR. */
+typedef enum {
+    XL_BW_ODR_4 = 4,     /**< ODR/4 */
+    XL_BW_ODR_10 = 10,   /**< ODR/10 */
+    XL_BW_ODR_20 = 20,   /**< ODR/20 */
+    XL_BW_ODR_45 = 45,   /**< ODR/45 */
+    XL_BW_ODR_100 = 100, /**< ODR/100 */
+    XL_BW_ODR_200 = 200, /**< ODR/200 */
+    XL_BW_ODR_400 = 400, /**< ODR/400 */
+    XL_BW_ODR_800 = 800, /**< ODR/800 */
+} accel_bw_e;
+
+/** Possible cutoffs of the gyroscope's high-pass filter in mHz. */
+typedef enum {
+    G_HPF_OFF = 0,         /**< High-pass filter disabled. */
+    G_HPF_16_MHZ = 16,     /**< 16 mHz */
+    G_HPF_65_MHZ = 65,     /**< 65 mHz */
+    G_HPF_260_MHZ = 260,   /**< 260 mHz */
+    G_HPF_1040_MHZ = 1040, /**< 1.04 Hz */
+} gyro_hpf_e;
+
+/** The largest setting of the gyroscope's LPF1 bandwidth (FTYPE). */
+#define LSM6DSO32_GYRO_LPF1_MAX 7
+
+/** Possible thresholds of the free-fall function, below which the acceleration on every axis is a free fall. */
+typedef enum {
+    FF_THS_312MG = 0x00, /**< 312 mg */
+    FF_THS_438MG = 0x01, /**< 438 mg */
+    FF_THS_500MG = 0x02, /**< 500 mg */
+} free_fall_ths_e;
+
+/** The number of register addresses of the LSM6DSO32. */
+#define LSM6DSO32_NREGS 0x80
+
+/**
+ * A copy of the LSM6DSO32's registers kept by the caller. Settings are staged into it without communicating with the
+ * IMU, then written together by `lsm6dso32_commit`, so that registers already known are not read again before they
+ * are changed.
+ */
+typedef struct {
+    uint8_t regs[LSM6DSO32_NREGS];      /**< The last value read from or written to each register. */
+    uint8_t mask[LSM6DSO32_NREGS];      /**< The bits of each register which are staged to be written. */
+    uint8_t value[LSM6DSO32_NREGS];     /**< The staged value of those bits. */
+    uint8_t known[LSM6DSO32_NREGS / 8]; /**< One bit per register, set if its value in `regs` is known. */
+} lsm6dso32_shadow_t;
+
+/** The raw outputs of the LSM6DSO32, in register order so they can be read in one burst. */
+typedef struct {
+    int16_t temp;     /**< The temperature in 1/256 degrees Celsius above 25 degrees Celsius. */
+    int16_t gyro[3];  /**< The X, Y and Z angular velocity in counts of the gyroscope's sensitivity. */
+    int16_t accel[3]; /**< The X, Y and Z linear acceleration in counts of the accelerometer's sensitivity. */
+} lsm6dso32_raw_t;
+
+/** The accelerometer and gyroscope samples read from the FIFO, oldest first. */
+typedef struct {
+    int16_t accel[LSM6DSO32_FIFO_BURST][3]; /**< The raw X, Y and Z linear acceleration of each sample. */
+    int16_t gyro[LSM6DSO32_FIFO_BURST][3];  /**< The raw X, Y and Z angular velocity of each sample. */
+    size_t naccel;                          /**< The number of accelerometer samples. */
+    size_t ngyro;                           /**< The number of gyroscope samples. */
+    size_t remaining;                       /**< The number of words left in the FIFO after this read. */
+    bool overrun;                           /**< Whether the FIFO overflowed and lost samples since the last read. */
+} lsm6dso32_fifo_t;
+
 int lsm6dso32_reset(SensorLocation const *loc);
 int lsm6dso32_mem_reboot(SensorLocation const *loc);
-int lsm6dso32_disable_accel(SensorLocation const *loc);
-int lsm6dso32_disable_gyro(SensorLocation const *loc);
 
-int lsm6dso32_set_acc_fsr(SensorLocation const *loc, accel_fsr_e fsr);
-int lsm6dso32_set_gyro_fsr(SensorLocation const *loc, gyro_fsr_e fsr);
-int lsm6dso32_set_acc_odr(SensorLocation const *loc, accel_odr_e odr);
-int lsm6dso32_set_gyro_odr(SensorLocation const *loc, gyro_odr_e odr);
-int lsm6dso32_high_performance(SensorLocation const *loc, bool on);
+void lsm6dso32_shadow_init(lsm6dso32_shadow_t *shadow);
+int lsm6dso32_commit(SensorLocation const *loc, lsm6dso32_shadow_t *shadow);
+
+int lsm6dso32_disable_accel(lsm6dso32_shadow_t *shadow);
+int lsm6dso32_disable_gyro(lsm6dso32_shadow_t *shadow);
+int lsm6dso32_set_acc_fsr(lsm6dso32_shadow_t *shadow, accel_fsr_e fsr);
+int lsm6dso32_set_gyro_fsr(lsm6dso32_shadow_t *shadow, gyro_fsr_e fsr);
+int lsm6dso32_set_acc_odr(lsm6dso32_shadow_t *shadow, accel_odr_e odr);
+int lsm6dso32_set_gyro_odr(lsm6dso32_shadow_t *shadow, gyro_odr_e odr);
+int lsm6dso32_high_performance(lsm6dso32_shadow_t *shadow, bool on);
+int lsm6dso32_accel_filter(lsm6dso32_shadow_t *shadow, accel_filter_e path, accel_bw_e bw);
+int lsm6dso32_gyro_lpf1(lsm6dso32_shadow_t *shadow, bool on, uint8_t ftype);
+int lsm6dso32_gyro_hpf(lsm6dso32_shadow_t *shadow, gyro_hpf_e hpf);
 
 int lsm6dso32_get_temp(SensorLocation const *loc, int16_t *temperature);
 int lsm6dso32_get_accel(SensorLocation const *loc, int16_t *x, int16_t *y, int16_t *z);
 int lsm6dso32_get_angular_vel(SensorLocation const *loc, int16_t *x, int16_t *y, int16_t *z);
 int lsm6dso32_whoami(SensorLocation const *loc, uint8_t *val);
+int lsm6dso32_get_raw(SensorLocation const *loc, lsm6dso32_raw_t *raw);
+
+int lsm6dso32_fifo_start(lsm6dso32_shadow_t *shadow, accel_odr_e accel_rate, gyro_odr_e gyro_rate);
+int lsm6dso32_fifo_stop(lsm6dso32_shadow_t *shadow);
+int lsm6dso32_fifo_read(SensorLocation const *loc, lsm6dso32_fifo_t *fifo);
+
+int lsm6dso32_wake_up_config(lsm6dso32_shadow_t *shadow, accel_fsr_e fsr, uint16_t threshold_mg, uint8_t duration);
+int lsm6dso32_free_fall_config(lsm6dso32_shadow_t *shadow, free_fall_ths_e threshold, uint8_t duration);
+int lsm6dso32_int_enable(lsm6dso32_shadow_t *shadow, bool enable);
+int lsm6dso32_get_wake_up_src(SensorLocation const *loc, uint8_t *src);
 
-void lsm6dso32_convert_accel(accel_fsr_e acc_fsr, int16_t *x, int16_t *y, int16_t *z);
-void lsm6dso32_convert_angular_vel(gyro_fsr_e gyro_fsr, int16_t *x, int16_t *y, int16_t *z);
+float lsm6dso32_accel_sensitivity(accel_fsr_e acc_fsr);
+float lsm6dso32_gyro_sensitivity(gyro_fsr_e gyro_fsr);
+float lsm6dso32_convert_temp(int16_t raw);
+void lsm6dso32_convert(const int16_t *counts, float *values, size_t n, float sensitivity);
+void lsm6dso32_convert_scalar(const int16_t *counts, float *values, size_t n, float sensitivity);
 
 #endif // _LSM6DSO32_
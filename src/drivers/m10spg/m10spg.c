@@ -10,6 +10,7 @@
 #include "ubx_def.h"
 #include <errno.h>
 #include <hw/i2c.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 #include <time.h>
@@ -35,11 +36,39 @@
 /** How long m10spg_read should wait for a response in seconds */
 #define DEFAULT_TIMEOUT 2
 
+/** How long the M10SPG takes to soft reset, in usec */
+#define RESET_TIME 1000000
+
+/** How long the GPS subsystem takes to restart after its signals were reconfigured, in usec */
+#define RESTART_TIME 500000
+
 /** The confirmation value for the platform model that corresponds to an airborne vehicle doing <4G of acceleration */
 #define DYNMODEL_AIR_4G 8
 
-/** The nominal time between gps measurements in milliseconds */
-#define NOMINAL_MEASUREMENT_RATE 300
+/** How many other messages to read through while waiting for the response to a configuration poll */
+#define MAX_SKIPPED_MESSAGES 8
+
+/** A configuration item with a fixed value that we set on the reciever */
+typedef struct {
+    uint32_t key;      /**< The key of the item */
+    uint8_t value;     /**< The value of the item */
+    UBXValueType type; /**< The type of the value */
+} config_item_t;
+
+/** Our configuration, except for the measurement rate */
+static const config_item_t CONFIG_ITEMS[] = {
+    // Disable NMEA output on I2C
+    {.key = NMEA_I2C_OUTPUT_CONFIG_KEY, .value = 0, .type = UBX_TYPE_L},
+    // Disable NMEA input on I2C
+    {.key = NMEA_I2C_INPUT_CONFIG_KEY, .value = 0, .type = UBX_TYPE_L},
+    // Set the dynamic platform model to have the maximum speed, acceleration, and height possible
+    {.key = DYNMODEL_CONFIG_KEY, .value = DYNMODEL_AIR_4G, .type = UBX_TYPE_U1},
+    // Turn off the BDS satellites, which increases the maximum update rate, but needs a reset of the GPS subsystem
+    {.key = BSD_SIGNAL_CONFIG_KEY, .value = 0, .type = UBX_TYPE_L},
+};
+
+/** The number of configuration items with a fixed value */
+#define NUM_CONFIG_ITEMS (sizeof(CONFIG_ITEMS) / sizeof(CONFIG_ITEMS[0]))
 
 static const UBXFrame PREMADE_MESSAGES[] = {
     [UBX_NAV_UTC] = {.header = {.class = 0x01, .id = 0x21, .length = 0x00}, .checksum_a = 0x22, .checksum_b = 0x67},
@@ -98,15 +127,15 @@ static inline uint8_t test_checksum(UBXFrame *msg) {
 /**
  * Initializes a valset message, but does not add any configuration items to set
  * @param msg A message with a UBXValsetPayload as its payload
- * @param layer The layer this valset message will configure its items at
+ * @param layers The layers this valset message will configure its items at, a combination of UBXConfigLayer
  */
-static void init_valset_message(UBXFrame *msg, UBXConfigLayer layer) {
+static void init_valset_message(UBXFrame *msg, uint8_t layers) {
     msg->header.class = 0x06;
     msg->header.id = 0x8a;
 
     UBXValsetPayload *payload = ((UBXValsetPayload *)msg->payload);
     payload->version = 0x00;
-    payload->layer = (uint8_t)layer;
+    payload->layer = layers;
 
     // Set up the message with no items, configure those later and change the length then
     msg->header.length =
@@ -231,6 +260,40 @@ static int send_message(const SensorLocation *loc, const UBXFrame *msg) {
     return err;
 }
 
+/**
+ * Reads the ublox protocol message at the start of the reciever's buffer, if there is one
+ * @param loc The m10spg's location on the I2C bus
+ * @param msg An empty message structure, with a payload pointing at a data buffer to read the payload into
+ * @param max_payload The maximum size that the payload can be (the size of the buffer pointed to by it)
+ * @return int EAGAIN if no message has started. EINVAL if the buffer is too small for the message found. EBADMSG if
+ * the second sync char is not valid. EOK otherwise.
+ */
+static int try_recv_message(const SensorLocation *loc, UBXFrame *msg, uint16_t max_payload) {
+    uint8_t sync = 0;
+    errno_t err = read_bytes(loc, &sync, sizeof(sync));
+    return_err(err);
+
+    // Make sure we're at the start of a new message
+    if (sync != SYNC_ONE) return EAGAIN;
+    err = read_bytes(loc, &sync, sizeof(sync));
+    return_err(err);
+    if (sync != SYNC_TWO) return EBADMSG;
+
+    // Found something. Get message class, id, and length
+    err = read_bytes(loc, &msg->header.class,
+                     sizeof(msg->header.class) + sizeof(msg->header.id) + sizeof(msg->header.length));
+    return_err(err);
+    // Make sure the space we allocated for the payload is big enough
+    if (msg->header.length > max_payload) {
+        return EINVAL;
+    }
+    // Read payload
+    err = read_bytes(loc, msg->payload, msg->header.length);
+    return_err(err);
+    // Read in the checksums (assume contiguous)
+    return read_bytes(loc, &msg->checksum_a, 2);
+}
+
 /**
  * Gets the next ublox protcol message from the reciever, reading through any non-ublox data
  * @param loc The m10spg's location on the I2C bus
@@ -244,33 +307,9 @@ static int recv_message(const SensorLocation *loc, UBXFrame *msg, uint16_t max_p
     struct timespec start, stop;
     clock_gettime(CLOCK_MONOTONIC, &start);
     do {
-        uint8_t sync = 0;
-        errno_t err = read_bytes(loc, &sync, sizeof(sync));
-        return_err(err);
+        errno_t err = try_recv_message(loc, msg, max_payload);
+        if (err != EAGAIN) return err;
 
-        // Make sure we're at the start of a new message
-        if (sync == SYNC_ONE) {
-            err = read_bytes(loc, &sync, sizeof(sync));
-            return_err(err);
-            if (sync == SYNC_TWO) {
-                // Found something. Get message class, id, and length
-                err = read_bytes(loc, &msg->header.class,
-                                 sizeof(msg->header.class) + sizeof(msg->header.id) + sizeof(msg->header.length));
-                return_err(err);
-                // Make sure the space we allocated for the payload is big enough
-                if (msg->header.length > max_payload) {
-                    return EINVAL;
-                }
-                // Read payload
-                err = read_bytes(loc, msg->payload, msg->header.length);
-                return_err(err);
-                // Read in the checksums (assume contiguous)
-                err = read_bytes(loc, &msg->checksum_a, 2);
-                return err;
-            } else {
-                return EBADMSG;
-            }
-        }
         // Sleeping gives time for the buffer to be opened, if it has closed (timeout occurs after 1.5s)
         usleep(RECV_SLEEP_TIME);
         // Get the time now
@@ -279,6 +318,30 @@ static int recv_message(const SensorLocation *loc, UBXFrame *msg, uint16_t max_p
     return ETIMEDOUT;
 }
 
+/**
+ * Sends a polling command to the M10SPG without waiting for its response, which can be fetched with `m10spg_fetch`.
+ * @param loc The m10spg's location on the I2C bus
+ * @param command The command to send
+ * @return int The error status of the call. EOK if successful.
+ */
+int m10spg_request(const SensorLocation *loc, M10SPG_cmd_t command) {
+    return send_message(loc, &PREMADE_MESSAGES[command]);
+}
+
+/**
+ * Fetches the response to a polling command if the M10SPG has started sending it, without waiting for it.
+ * @param loc The m10spg's location on the I2C bus
+ * @param response A buffer to place the payload of the response (use a structure with the same format as the message's
+ * pre-defined payload)
+ * @param size The maximum number of bytes to read into the response buffer
+ * @return int EAGAIN if no response is ready yet, otherwise the error status of the call. EOK if successful.
+ */
+int m10spg_fetch(const SensorLocation *loc, void *response, size_t size) {
+    UBXFrame recv;
+    recv.payload = response;
+    return try_recv_message(loc, &recv, size);
+}
+
 /**
  * Reads the specified data from the M10SPG.
  * @param loc The m10spg's location on the I2C bus
@@ -288,7 +351,7 @@ static int recv_message(const SensorLocation *loc, UBXFrame *msg, uint16_t max_p
  * @return int The error status of the call. EOK if successful.
  */
 int m10spg_send_command(const SensorLocation *loc, M10SPG_cmd_t command, void *response, size_t size) {
-    int err = send_message(loc, &PREMADE_MESSAGES[command]);
+    int err = m10spg_request(loc, command);
     return_err(err);
     UBXFrame recv;
     recv.payload = response;
@@ -297,16 +360,13 @@ int m10spg_send_command(const SensorLocation *loc, M10SPG_cmd_t command, void *r
 }
 
 /**
- * Prepares the M10SPG for reading.
+ * Soft resets the M10SPG, clearing the RAM configuration to ensure our settings are the only ones being used. The
+ * reset has no response, and takes about a second.
  * @param loc The m10spg's location on the I2C bus
  * @return int The error status of the call. EOK if successful.
  */
-int m10spg_open(const SensorLocation *loc) {
+int m10spg_reset(const SensorLocation *loc) {
     UBXFrame msg;
-    UBXValsetPayload valset_payload;
-    UBXAckPayload ack_payload;
-
-    // Clear the RAM configuration to ensure our settings are the only ones being used
     msg.header.class = 0x06;
     msg.header.id = 0x04;
     msg.header.length = 4;
@@ -317,49 +377,261 @@ int m10spg_open(const SensorLocation *loc) {
     reset_payload.resetMode = UBX_SOFT_RESET;
     msg.payload = &reset_payload;
     calculate_checksum(&msg, &msg.checksum_a, &msg.checksum_b);
-    send_message(loc, &msg);
-    // Has no response, sleep to wait for reset
-    sleep(1);
+    return send_message(loc, &msg);
+}
 
-    // Configure the chip
+/**
+ * Sends our configuration to the M10SPG, which acknowledges it with a message that can be checked with
+ * `m10spg_fetch_ack`. The configuration is also stored in the battery backed memory, so that the M10SPG still has it
+ * after a reset or a power cycle, and opening it again does not need to reset it.
+ * @param loc The m10spg's location on the I2C bus
+ * @param measurement_rate The time between measurements in milliseconds, at least MIN_MEASUREMENT_RATE
+ * @return int The error status of the call. EOK if successful.
+ */
+int m10spg_configure(const SensorLocation *loc, uint16_t measurement_rate) {
+    UBXFrame msg;
+    UBXValsetPayload valset_payload;
     msg.payload = &valset_payload;
 
     // Put our actual configuration on there
-    init_valset_message(&msg, RAM_LAYER);
-    uint8_t config_disabled = 0;
-    uint8_t config_dynmodel = DYNMODEL_AIR_4G;
-    uint16_t measurement_rate = NOMINAL_MEASUREMENT_RATE;
-    // Disable NMEA output on I2C
-    add_valset_item(&msg, (uint32_t)NMEA_I2C_OUTPUT_CONFIG_KEY, &config_disabled, UBX_TYPE_L);
-    // Disable NMEA input on I2C
-    add_valset_item(&msg, (uint32_t)NMEA_I2C_INPUT_CONFIG_KEY, &config_disabled, UBX_TYPE_L);
-    // Set the dynamic platform model to have the maximum speed, acceleration, and height possible
-    add_valset_item(&msg, (uint32_t)DYNMODEL_CONFIG_KEY, &config_dynmodel, UBX_TYPE_U1);
+    init_valset_message(&msg, RAM_LAYER | BBR_LAYER);
+    for (size_t item = 0; item < NUM_CONFIG_ITEMS; item++) {
+        add_valset_item(&msg, CONFIG_ITEMS[item].key, &CONFIG_ITEMS[item].value, CONFIG_ITEMS[item].type);
+    }
     // Set the config update rate
     add_valset_item(&msg, (uint32_t)MEASUREMENT_RATE_CONFIG_KEY, &measurement_rate, UBX_TYPE_U2);
-    // Turn off the BDS satellites, which increases the maximum update rate, but needs a reset of the GPS subsystem
-    add_valset_item(&msg, (uint32_t)BSD_SIGNAL_CONFIG_KEY, &config_disabled, UBX_TYPE_L);
 
     calculate_checksum(&msg, &msg.checksum_a, &msg.checksum_b);
+    return send_message(loc, &msg);
+}
 
-    int err = send_message(loc, &msg);
-    return_err(err);
+/**
+ * Changes the time between measurements of the M10SPG, without touching the rest of its configuration or resetting it.
+ * The M10SPG acknowledges the change with a message that can be checked with `m10spg_fetch_ack`.
+ * @param loc The m10spg's location on the I2C bus
+ * @param measurement_rate The time between measurements in milliseconds, at least MIN_MEASUREMENT_RATE
+ * @return int The error status of the call. EOK if successful.
+ */
+int m10spg_set_rate(const SensorLocation *loc, uint16_t measurement_rate) {
+    UBXFrame msg;
+    UBXValsetPayload valset_payload;
+    msg.payload = &valset_payload;
 
-    // Check if configuration was successful
-    msg.payload = &ack_payload;
-    // Longer timeout for the reboot
-    err = recv_message(loc, &msg, sizeof(ack_payload), DEFAULT_TIMEOUT);
-    return_err(err);
-    if (msg.header.class == 0x05) {
-        if (msg.header.id == 0x01) {
+    init_valset_message(&msg, RAM_LAYER);
+    add_valset_item(&msg, (uint32_t)MEASUREMENT_RATE_CONFIG_KEY, &measurement_rate, UBX_TYPE_U2);
+
+    calculate_checksum(&msg, &msg.checksum_a, &msg.checksum_b);
+    return send_message(loc, &msg);
+}
+
+/**
+ * Checks whether a message acknowledges our configuration.
+ * @param msg The message recieved after sending the configuration
+ * @return int EOK if the configuration was acknowledged, ECANCELED if it was rejected, EINTR if some other message
+ * interrupted our exchange.
+ */
+static int ack_status(const UBXFrame *msg) {
+    if (msg->header.class == 0x05) {
+        if (msg->header.id == 0x01) {
             return EOK;
-        } else if (msg.header.id == 0x00) {
+        } else if (msg->header.id == 0x00) {
             // Valset was not successful, check interface manual for possible reasons
             return ECANCELED;
         }
     }
+    return EINTR;
+}
+
+/**
+ * Fetches the M10SPG's response to our configuration if it has started sending it, without waiting for it.
+ * @param loc The m10spg's location on the I2C bus
+ * @return int EAGAIN if no response is ready yet, EOK if the configuration was acknowledged, ECANCELED if it was
+ * rejected, EINTR if some other message interrupted our exchange, otherwise the error status of the call.
+ */
+int m10spg_fetch_ack(const SensorLocation *loc) {
+    UBXFrame msg;
+    UBXAckPayload ack_payload;
+    msg.payload = &ack_payload;
+    int err = try_recv_message(loc, &msg, sizeof(ack_payload));
+    return_err(err);
+    return ack_status(&msg);
+}
+
+/**
+ * Receives the acknowledgement of a configuration message.
+ * @param loc The m10spg's location on the I2C bus
+ * @return int EOK if the configuration was acknowledged, ECANCELED if it was rejected, EINTR if some other message
+ * interrupted our exchange, otherwise the error status of the call.
+ */
+static int recv_ack(const SensorLocation *loc) {
+    UBXFrame msg;
+    UBXAckPayload ack_payload;
+    msg.payload = &ack_payload;
+    int err = recv_message(loc, &msg, sizeof(ack_payload), DEFAULT_TIMEOUT);
+    return_err(err);
+    return ack_status(&msg);
+}
+
+/**
+ * Gets the size of the value of a configuration item from its key.
+ * @param key The key of the item
+ * @return size_t The size of the value in bytes, or zero if the key does not encode a valid size.
+ */
+static size_t config_value_size(uint32_t key) {
+    switch ((key >> CONFIG_KEY_SIZE_SHIFT) & CONFIG_KEY_SIZE_MASK) {
+    case UBX_KEY_SIZE_BIT:
+    case UBX_KEY_SIZE_ONE:
+        return 1;
+    case UBX_KEY_SIZE_TWO:
+        return 2;
+    case UBX_KEY_SIZE_FOUR:
+        return 4;
+    case UBX_KEY_SIZE_EIGHT:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Checks whether a message is the response to our configuration poll, and whether it holds our configuration.
+ * @param msg The message recieved after polling the configuration
+ * @param applied Set to whether every item of our configuration other than the measurement rate has our value
+ * @param measurement_rate Set to the time between measurements in milliseconds, if the response holds it
+ * @return int EOK if the message is the response, ECANCELED if the poll was rejected, EBADMSG if the response is
+ * malformed, EINTR if some other message interrupted our exchange.
+ */
+static int config_status(const UBXFrame *msg, bool *applied, uint16_t *measurement_rate) {
+    if (msg->header.class == 0x05 && msg->header.id == 0x00) return ECANCELED;
+    if (msg->header.class != 0x06 || msg->header.id != 0x8b) return EINTR;
+    if (msg->header.length < offsetof(UBXValgetPayload, config_items)) return EBADMSG;
+
+    const UBXValgetPayload *payload = msg->payload;
+    size_t len = msg->header.length - offsetof(UBXValgetPayload, config_items);
+    size_t matched = 0;
+    bool has_rate = false;
+    for (size_t i = 0; i + sizeof(uint32_t) <= len;) {
+        uint32_t key;
+        memcpy(&key, payload->config_items + i, sizeof(key));
+        i += sizeof(key);
+        size_t size = config_value_size(key);
+        if (size == 0 || i + size > len) return EBADMSG;
+        const uint8_t *value = payload->config_items + i;
+        i += size;
+
+        if (key == MEASUREMENT_RATE_CONFIG_KEY && size == sizeof(*measurement_rate)) {
+            memcpy(measurement_rate, value, sizeof(*measurement_rate));
+            has_rate = true;
+            continue;
+        }
+        for (size_t item = 0; item < NUM_CONFIG_ITEMS; item++) {
+            if (CONFIG_ITEMS[item].key == key && CONFIG_ITEMS[item].value == *value) matched++;
+        }
+    }
+    *applied = has_rate && matched == NUM_CONFIG_ITEMS;
+    return EOK;
+}
+
+/**
+ * Polls the current configuration of the M10SPG for the items we set. The M10SPG responds with the values, which can be
+ * checked with `m10spg_fetch_config`, then acknowledges the poll with a message that can be checked with
+ * `m10spg_fetch_ack`.
+ * @param loc The m10spg's location on the I2C bus
+ * @return int The error status of the call. EOK if successful.
+ */
+int m10spg_query_config(const SensorLocation *loc) {
+    UBXFrame msg;
+    UBXValgetPayload valget_payload = {.version = 0x00, .layer = VALGET_RAM_LAYER, .position = 0};
+    msg.payload = &valget_payload;
+    msg.header.class = 0x06;
+    msg.header.id = 0x8b;
+    msg.header.length = offsetof(UBXValgetPayload, config_items);
+
+    for (size_t item = 0; item <= NUM_CONFIG_ITEMS; item++) {
+        uint32_t key = item < NUM_CONFIG_ITEMS ? CONFIG_ITEMS[item].key : (uint32_t)MEASUREMENT_RATE_CONFIG_KEY;
+        memcpy(valget_payload.config_items + msg.header.length - offsetof(UBXValgetPayload, config_items), &key,
+               sizeof(key));
+        msg.header.length += sizeof(key);
+    }
+
+    calculate_checksum(&msg, &msg.checksum_a, &msg.checksum_b);
+    return send_message(loc, &msg);
+}
+
+/**
+ * Fetches the M10SPG's response to our configuration poll if it has started sending it, without waiting for it.
+ * @param loc The m10spg's location on the I2C bus
+ * @param applied Set to whether the M10SPG already has our configuration, other than the measurement rate
+ * @param measurement_rate Set to the M10SPG's time between measurements in milliseconds
+ * @return int EAGAIN if no response is ready yet, EOK if the response was read, ECANCELED if the poll was rejected,
+ * EINTR if some other message was read instead, otherwise the error status of the call.
+ */
+int m10spg_fetch_config(const SensorLocation *loc, bool *applied, uint16_t *measurement_rate) {
+    UBXFrame msg;
+    UBXValgetPayload valget_payload;
+    msg.payload = &valget_payload;
+    int err = try_recv_message(loc, &msg, sizeof(valget_payload));
+    return_err(err);
+    return config_status(&msg, applied, measurement_rate);
+}
+
+/**
+ * Polls the current configuration of the M10SPG and waits for the response and its acknowledgement.
+ * @param loc The m10spg's location on the I2C bus
+ * @param applied Set to whether the M10SPG already has our configuration, other than the measurement rate
+ * @param measurement_rate Set to the M10SPG's time between measurements in milliseconds
+ * @return int The error status of the call. EOK if successful.
+ */
+static int read_config(const SensorLocation *loc, bool *applied, uint16_t *measurement_rate) {
+    int err = m10spg_query_config(loc);
+    return_err(err);
+
+    // Read through anything left over from before, like the response to a poll of a previous run
+    UBXFrame msg;
+    UBXValgetPayload valget_payload;
+    msg.payload = &valget_payload;
+    err = EINTR;
+    for (uint8_t skipped = 0; err == EINTR && skipped < MAX_SKIPPED_MESSAGES; skipped++) {
+        err = recv_message(loc, &msg, sizeof(valget_payload), DEFAULT_TIMEOUT);
+        return_err(err);
+        err = config_status(&msg, applied, measurement_rate);
+    }
+    return_err(err);
+    return recv_ack(loc);
+}
+
+/**
+ * Prepares the M10SPG for reading. If it already has our configuration, like when fetcher is restarted, only its
+ * measurement rate is set, so that it keeps its navigation state and gets a fix again within seconds instead of
+ * resetting.
+ * @param loc The m10spg's location on the I2C bus
+ * @param measurement_rate The time between measurements in milliseconds, at least MIN_MEASUREMENT_RATE
+ * @return int The error status of the call. EOK if successful.
+ */
+int m10spg_open(const SensorLocation *loc, uint16_t measurement_rate) {
+    bool applied = false;
+    uint16_t current_rate = 0;
+    if (read_config(loc, &applied, &current_rate) == EOK && applied) {
+        if (current_rate == measurement_rate) return EOK;
+        int err = m10spg_set_rate(loc, measurement_rate);
+        return_err(err);
+        return recv_ack(loc);
+    }
+
+    m10spg_reset(loc);
+    // Has no response, sleep to wait for reset
+    usleep(RESET_TIME);
+
+    // Configure the chip
+    int err = m10spg_configure(loc, measurement_rate);
+    return_err(err);
+
+    // Check if configuration was successful
+    err = recv_ack(loc);
+    if (err != EINTR) return err;
+
     // Give at least 0.5 seconds for the gps subsystem to restart, because we disabled the BDS signal
-    usleep(500000);
+    usleep(RESTART_TIME);
 
     // Some other response interrupted our exchange
     return EINTR;
@@ -9,8 +9,15 @@
 #define _MAXM10S_
 
 #include "../sensor_api.h"
+#include <stdbool.h>
 #include <stdint.h>
 
+/** The nominal time between gps measurements in milliseconds */
+#define NOMINAL_MEASUREMENT_RATE 300
+
+/** The shortest time between gps measurements the receiver accepts, in milliseconds */
+#define MIN_MEASUREMENT_RATE 25
+
 /** An enum representing the commands that can be used for polling M10SPG data. */
 typedef enum {
     UBX_NAV_UTC,    /**< UTC time information, recieved formatted as a human readable date */
@@ -20,7 +27,15 @@ typedef enum {
     UBX_MON_VER,    /**< Firmware version information */
 } M10SPG_cmd_t;
 
-int m10spg_open(const SensorLocation *loc);
+int m10spg_open(const SensorLocation *loc, uint16_t measurement_rate);
 int m10spg_send_command(const SensorLocation *loc, M10SPG_cmd_t command, void *response, size_t size);
+int m10spg_request(const SensorLocation *loc, M10SPG_cmd_t command);
+int m10spg_fetch(const SensorLocation *loc, void *response, size_t size);
+int m10spg_reset(const SensorLocation *loc);
+int m10spg_configure(const SensorLocation *loc, uint16_t measurement_rate);
+int m10spg_set_rate(const SensorLocation *loc, uint16_t measurement_rate);
+int m10spg_fetch_ack(const SensorLocation *loc);
+int m10spg_query_config(const SensorLocation *loc);
+int m10spg_fetch_config(const SensorLocation *loc, bool *applied, uint16_t *measurement_rate);
 
 #endif // _MAXM10S_
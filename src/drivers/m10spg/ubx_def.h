@@ -32,6 +32,14 @@ typedef enum {
     FLASH_LAYER = 0x04, /**< The flash configuration - does not exist on the M10 MAX */
 } UBXConfigLayer;
 
+/** The layer to read a configuration from in a valget message (not a bit field, unlike UBXConfigLayer) */
+typedef enum {
+    VALGET_RAM_LAYER = 0x00,     /**< The current configuration */
+    VALGET_BBR_LAYER = 0x01,     /**< The battery backed memory configuration */
+    VALGET_FLASH_LAYER = 0x02,   /**< The flash configuration - does not exist on the M10 MAX */
+    VALGET_DEFAULT_LAYER = 0x07, /**< The default configuration */
+} UBXValgetLayer;
+
 /** An enum representing the different sizes of values that a configuration message can contain */
 typedef enum {
     UBX_TYPE_L = 1,  /**< One bit, occupies one byte */
@@ -81,6 +89,29 @@ typedef struct {
     uint8_t config_items[MAX_VALSET_ITEM_BYTES]; /** An array of keys and value pairs */
 } UBXValsetPayload;
 
+/** A struct representing the UBX-VALGET (get configuration) payload, both the poll request and its response */
+typedef struct {
+    uint8_t version;   /** The version of the message (0 for a request, 1 for a response) */
+    uint8_t layer;     /** The layer to read the config from, one of the UBXValgetLayer (typed to ensure one byte) */
+    uint16_t position; /** How many of the matching items to skip before the first returned */
+    uint8_t config_items[MAX_VALSET_ITEM_BYTES]; /** Keys in a request, or key and value pairs in a response */
+} UBXValgetPayload;
+
+/** The bit offset of the size of a configuration key's value, which is one of the UBXKeySize */
+#define CONFIG_KEY_SIZE_SHIFT 28
+
+/** The mask of the size of a configuration key's value after shifting it down */
+#define CONFIG_KEY_SIZE_MASK 0x07
+
+/** The sizes of a configuration key's value, encoded in the key */
+typedef enum {
+    UBX_KEY_SIZE_BIT = 0x01,   /**< One bit, occupies one byte */
+    UBX_KEY_SIZE_ONE = 0x02,   /**< One byte */
+    UBX_KEY_SIZE_TWO = 0x03,   /**< Two bytes */
+    UBX_KEY_SIZE_FOUR = 0x04,  /**< Four bytes */
+    UBX_KEY_SIZE_EIGHT = 0x05, /**< Eight bytes */
+} UBXKeySize;
+
 /** A configuration key for enabling or disabling output of NMEA messages on I2C */
 #define NMEA_I2C_OUTPUT_CONFIG_KEY 0x10720002
 
@@ -45,12 +45,6 @@ typedef enum {
     CMD_ADC_READ = 0x00, /**< ADC read command */
 } MS5611Cmd;
 
-/** The D registers on the MS5611 sensor. */
-typedef enum {
-    D1 = 0x00, /**< D register 1 */
-    D2 = 0x10, /**< D register 2 */
-} MS5611DReg;
-
 /**
  * Resets the MS5611 sensor, ensuring that calibration data is loaded into the PROM.
  * @param loc The sensor's location on the I2C bus.
@@ -66,48 +60,55 @@ errno_t ms5611_reset(SensorLocation *loc) {
 }
 
 /**
- * Reads the ADC D registers of the MS5611.
+ * Starts the conversion of one of the MS5611's D registers. Its result can be read with `ms5611_read_adc` once the
+ * conversion time for the resolution has passed.
  * @param loc The location of the MS5611 on the I2C bus.
- * @param dreg The D-register to read and the precision to read at.
- * @param value The location to store the D register value in.
- * @return Any error which occurred during the read. EOK if successful.
+ * @param dreg The D register to convert.
+ * @param res The resolution to convert at.
+ * @return Any error which occurred while starting the conversion. EOK if successful.
  */
-static errno_t ms5611_read_dreg(SensorLocation *loc, uint8_t dreg, uint32_t *value) {
-
-    // Request conversion start
+errno_t ms5611_start_conversion(SensorLocation *loc, MS5611DReg dreg, MS5611Resolution res) {
     i2c_send_t conversion = {.len = 1, .stop = 1, .slave = loc->addr};
     uint8_t conversion_cmd[sizeof(conversion) + 1];
     memcpy(conversion_cmd, &conversion, sizeof(conversion));
-    conversion_cmd[sizeof(conversion)] = CMD_ADC_CONV + dreg;
+    conversion_cmd[sizeof(conversion)] = CMD_ADC_CONV + dreg + res;
 
-    errno_t err = devctl(loc->bus, DCMD_I2C_SEND, &conversion_cmd, sizeof(conversion_cmd), NULL);
-    return_err(err);
+    return devctl(loc->bus, DCMD_I2C_SEND, &conversion_cmd, sizeof(conversion_cmd), NULL);
+}
 
-    // Wait for appropriate conversion time
-    switch (dreg & 0xF) {
+/**
+ * Gets how long a conversion takes at a resolution.
+ * @param res The resolution of the conversion.
+ * @return The time the conversion takes in microseconds.
+ */
+uint32_t __attribute__((const)) ms5611_conversion_time(MS5611Resolution res) {
+    switch (res) {
     case ADC_RES_256:
-        usleep(900);
-        break;
+        return 900;
     case ADC_RES_512:
-        usleep(3000);
-        break;
+        return 3000;
     case ADC_RES_1024:
-        usleep(4000);
-        break;
+        return 4000;
     case ADC_RES_2048:
-        usleep(6000);
-        break;
+        return 6000;
     case ADC_RES_4096:
-        usleep(10000);
-        break;
+    default:
+        return 10000;
     }
+}
 
-    // Read D register
+/**
+ * Reads the result of the last conversion of the MS5611.
+ * @param loc The location of the MS5611 on the I2C bus.
+ * @param value The location to store the D register value in.
+ * @return Any error which occurred during the read. EOK if successful.
+ */
+errno_t ms5611_read_adc(SensorLocation *loc, uint32_t *value) {
     i2c_sendrecv_t read = {.slave = loc->addr, .stop = 1, .send_len = 1, .recv_len = 3};
     uint8_t read_cmd[sizeof(read) + 3];
     memcpy(read_cmd, &read, sizeof(read));
     read_cmd[sizeof(read)] = CMD_ADC_READ;
-    err = devctl(loc->bus, DCMD_I2C_SENDRECV, &read_cmd, sizeof(read_cmd), NULL);
+    errno_t err = devctl(loc->bus, DCMD_I2C_SENDRECV, &read_cmd, sizeof(read_cmd), NULL);
     return_err(err);
 
     *value = 0;
@@ -118,6 +119,21 @@ static errno_t ms5611_read_dreg(SensorLocation *loc, uint8_t dreg, uint32_t *val
     return err;
 }
 
+/**
+ * Reads the ADC D registers of the MS5611, waiting for the conversion.
+ * @param loc The location of the MS5611 on the I2C bus.
+ * @param dreg The D-register to read.
+ * @param res The resolution to read at.
+ * @param value The location to store the D register value in.
+ * @return Any error which occurred during the read. EOK if successful.
+ */
+static errno_t ms5611_read_dreg(SensorLocation *loc, MS5611DReg dreg, MS5611Resolution res, uint32_t *value) {
+    errno_t err = ms5611_start_conversion(loc, dreg, res);
+    return_err(err);
+    usleep(ms5611_conversion_time(res));
+    return ms5611_read_adc(loc, value);
+}
+
 /**
  * Compute the double precision calculation.
  * @param dt The temperature delta.
@@ -149,31 +165,22 @@ static void double_precision(double dt, double *off, double *sens, double *temp)
 }
 
 /**
- * Reads the specified data from the MS5611.
- * @param loc The location of the MS5611 sensor on the I2C bus.
- * @param res The resolution to read the MS5611 at.
+ * Computes the temperature, pressure and altitude from the raw values of the D registers.
  * @param ctx The context containing calibration coefficients and ground pressure.
  * @param precise True to use second order calculation for higher precision, false for quicker calculation.
+ * @param d1 The value of D register 1.
+ * @param d2 The value of D register 2.
  * @param temperature Storage location of the temperature value in degrees Celsius. NULL to skip calculation.
  * @param pressure Storage location of the pressure value in kPa. NULL to skip calculation.
  * @param altitude Storage location of the altitude value in m. NULL to skip calculation.
- * @return EOK if no error, otherwise the type of error that occurred.
  */
-errno_t ms5611_read_all(SensorLocation *loc, MS5611Resolution res, MS5611Context *ctx, bool precise,
-                        double *temperature, double *pressure, double *altitude) {
+void ms5611_compute(const MS5611Context *ctx, bool precise, uint32_t d1, uint32_t d2, double *temperature,
+                    double *pressure, double *altitude) {
 
     // Variables for calculation
     double temp;
     double pres;
 
-    // Read D registers with configured resolution
-    uint32_t d1, d2;
-    errno_t err = ms5611_read_dreg(loc, D1 + res, &d1);
-    if (err != EOK) return err;
-    err = ms5611_read_dreg(loc, D2 + res, &d2);
-    if (err != EOK) return err;
-
-    // Extract context
     // Calculate 1st order pressure and temperature (MS5607 1st order algorithm)
     double dt = d2 - ctx->coefs[5] * pow(2, 8);
     double off = ctx->coefs[2] * pow(2, 16) + dt * ctx->coefs[4] / pow(2, 7);
@@ -190,16 +197,38 @@ errno_t ms5611_read_all(SensorLocation *loc, MS5611Resolution res, MS5611Context
     }
 
     // Calculate pressure unless it's not needed for any calculation
-    if (pressure != NULL || altitude != NULL) {
-        pres = (((d1 * sens) / (pow(2, 21)) - off) / pow(2, 15)) / 1000; // kPa
-        *pressure = pres;
-    }
+    if (pressure == NULL && altitude == NULL) return;
+    pres = (((d1 * sens) / (pow(2, 21)) - off) / pow(2, 15)) / 1000; // kPa
+    if (pressure != NULL) *pressure = pres;
 
     // This calculation assumes initial altitude is 0
     if (altitude != NULL) {
         *altitude = -((R * T) / (g * M)) * log(pres / ctx->ground_pressure);
     }
+}
+
+/**
+ * Reads the specified data from the MS5611.
+ * @param loc The location of the MS5611 sensor on the I2C bus.
+ * @param res The resolution to read the MS5611 at.
+ * @param ctx The context containing calibration coefficients and ground pressure.
+ * @param precise True to use second order calculation for higher precision, false for quicker calculation.
+ * @param temperature Storage location of the temperature value in degrees Celsius. NULL to skip calculation.
+ * @param pressure Storage location of the pressure value in kPa. NULL to skip calculation.
+ * @param altitude Storage location of the altitude value in m. NULL to skip calculation.
+ * @return EOK if no error, otherwise the type of error that occurred.
+ */
+errno_t ms5611_read_all(SensorLocation *loc, MS5611Resolution res, MS5611Context *ctx, bool precise,
+                        double *temperature, double *pressure, double *altitude) {
+
+    // Read D registers with configured resolution
+    uint32_t d1, d2;
+    errno_t err = ms5611_read_dreg(loc, MS5611_D1, res, &d1);
+    if (err != EOK) return err;
+    err = ms5611_read_dreg(loc, MS5611_D2, res, &d2);
+    if (err != EOK) return err;
 
+    ms5611_compute(ctx, precise, d1, d2, temperature, pressure, altitude);
     return err;
 }
 
@@ -24,6 +24,12 @@ typedef enum ms5611_resolution_t {
     ADC_RES_4096 = 0x08, /**< ADC OSR=4096 */
 } MS5611Resolution;
 
+/** The D registers of the MS5611, which hold the raw result of a conversion. */
+typedef enum {
+    MS5611_D1 = 0x00, /**< D register 1, the digital pressure value. */
+    MS5611_D2 = 0x10, /**< D register 2, the digital temperature value. */
+} MS5611DReg;
+
 /** Contains information needed for the MS5611 between calls. */
 typedef struct {
     uint16_t coefs[MS5611_COEFFICIENT_COUNT]; /**< The calibration coefficients of the sensor. */
@@ -34,5 +40,10 @@ errno_t ms5611_reset(SensorLocation *loc);
 errno_t ms5611_read_all(SensorLocation *loc, MS5611Resolution res, MS5611Context *ctx, bool precise, double *temp,
                         double *pressure, double *altitude);
 errno_t ms5611_init_coefs(SensorLocation *loc, MS5611Context *ctx);
+errno_t ms5611_start_conversion(SensorLocation *loc, MS5611DReg dreg, MS5611Resolution res);
+errno_t ms5611_read_adc(SensorLocation *loc, uint32_t *value);
+uint32_t ms5611_conversion_time(MS5611Resolution res);
+void ms5611_compute(const MS5611Context *ctx, bool precise, uint32_t d1, uint32_t d2, double *temperature,
+                    double *pressure, double *altitude);
 
 #endif // _MS5611_H_
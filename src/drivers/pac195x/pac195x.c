@@ -74,23 +74,6 @@ static int pac195x_send_byte(SensorLocation const *loc, uint8_t addr) {
     return devctl(loc->bus, DCMD_I2C_SEND, cmd, sizeof(cmd), NULL);
 }
 
-/**
- * Writes the byte to the specified register of the PAC195X.
- * @param loc The location of the sensor on the I2C bus.
- * @param addr The register address to write to.
- * @param data The data to write.
- * @return Any error which occurred while communicating with the sensor. EOK if successful.
- */
-static int pac195x_write_byte(SensorLocation const *loc, uint8_t addr, uint8_t data) {
-    i2c_send_t hdr = {.len = 2, .stop = 1, .slave = loc->addr};
-    uint8_t cmd[sizeof(hdr) + 2];
-    memcpy(cmd, &hdr, sizeof(hdr));
-    cmd[sizeof(hdr)] = addr;
-    cmd[sizeof(hdr) + 1] = data;
-
-    return devctl(loc->bus, DCMD_I2C_SEND, cmd, sizeof(cmd), NULL);
-}
-
 /**
  * Reads a byte from the PAC195X, assuming the address pointer is already at the correct location.
  * @param loc The location of the sensor on the I2C bus.
@@ -221,46 +204,83 @@ int pac195x_refresh_g(SensorLocation const *loc) {
 int pac195x_refresh_v(SensorLocation const *loc) { return pac195x_send_byte(loc, REFRESH_V); }
 
 /**
- * Set the sampling mode for the PAC195x.
- * @param loc The location of the sensor on the I2C bus.
- * @param mode The sampling mode to set.
- * @return Any error which occurred while communicating with the sensor. EOK if successful.
+ * Empties a shadow of the CTRL register, so that nothing is staged and CTRL is read before it is partly written. Must
+ * be called before the shadow is first used.
+ * @param shadow The shadow of the CTRL register.
  */
-int pac195x_set_sample_mode(SensorLocation const *loc, pac195x_sm_e mode) {
-    uint8_t ctrl_reg;
-    int err = pac195x_read_byte(loc, CTRL, &ctrl_reg);
-    return_err(err);
+void pac195x_shadow_init(pac195x_shadow_t *shadow) { memset(shadow, 0, sizeof(*shadow)); }
 
-    ctrl_reg &= ~(0xF0); // Clear upper 4 bits
-    ctrl_reg |= mode;    // Set the mode
-    err = pac195x_write_byte(loc, CTRL, ctrl_reg);
-    return err;
+/**
+ * Stages the sampling mode for the PAC195x.
+ * @param shadow The shadow of the CTRL register.
+ * @param mode The sampling mode to set.
+ * @return EOK.
+ */
+int pac195x_set_sample_mode(pac195x_shadow_t *shadow, pac195x_sm_e mode) {
+    shadow->mask[0] |= 0xF0; // Upper 4 bits
+    shadow->value[0] = (shadow->value[0] & 0x0F) | (uint8_t)mode;
+    return EOK;
 }
 
 /**
- * Enable/disable channels for sampling on the PAC195X.
+ * Stages enabling/disabling channels for sampling on the PAC195X.
  * NOTE: Some models, like the PAC1952-2, physically do not have all channel pins. Trying to enable those channels will
  * do nothing.
- * @param loc The location of the sensor on the I2C bus.
+ * @param shadow The shadow of the CTRL register.
  * @param channel A channel or multiple channels to enable/disable. Multiple channels can be given by ORing the channels
  * together.
  * @param enable True to enable the channel(s), false to disable the channel(s).
- * @return Any error which occurred while communicating with the sensor. EOK if successful.
+ * @return EOK.
  */
-int pac195x_toggle_channel(SensorLocation const *loc, pac195x_channel_e channel, bool enable) {
-
-    uint8_t buf[sizeof(i2c_sendrecv_t) + 2];
-    int err = pac195x_block_read(loc, CTRL, 2, buf);
-    return_err(err);
+int pac195x_toggle_channel(pac195x_shadow_t *shadow, pac195x_channel_e channel, bool enable) {
+    uint8_t bits = (uint8_t)(channel << 4);
+    shadow->mask[1] |= bits;
     if (enable) {
-        buf[sizeof(i2c_sendrecv_t) + 1] &= ~(channel << 4); // Set the channels on (0 enables)
+        shadow->value[1] &= ~bits; // Set the channels on (0 enables)
     } else {
-        buf[sizeof(i2c_sendrecv_t) + 1] |= (channel << 4); // Set the channels off (1 disables)
+        shadow->value[1] |= bits; // Set the channels off (1 disables)
+    }
+    return EOK;
+}
+
+/**
+ * Writes the settings staged in the shadow to the CTRL register in one transaction, and verifies them by reading CTRL
+ * back in one more. CTRL is read first unless the shadow knows it already or it is entirely staged. The settings take
+ * effect on the next refresh.
+ * @param loc The location of the sensor on the I2C bus.
+ * @param shadow The shadow of the CTRL register.
+ * @return Any error which occurred while communicating with the sensor. EOK if successful, EIO if CTRL read back
+ * differently than it was written. On error, the settings stay staged.
+ */
+int pac195x_commit(SensorLocation const *loc, pac195x_shadow_t *shadow) {
+    if (shadow->mask[0] == 0 && shadow->mask[1] == 0) return EOK;
+
+    uint8_t buf[sizeof(i2c_sendrecv_t) + 2];
+    int err;
+    if (!shadow->known && (shadow->mask[0] != 0xFF || shadow->mask[1] != 0xFF)) {
+        err = pac195x_block_read(loc, CTRL, 2, buf);
+        return_err(err);
+        memcpy(shadow->ctrl, &buf[sizeof(i2c_sendrecv_t)], 2);
+        shadow->known = true;
     }
-    buf[sizeof(i2c_send_t) + 1] = buf[sizeof(i2c_sendrecv_t)]; // Move back because write header takes less space
-    buf[sizeof(i2c_send_t) + 2] = buf[sizeof(i2c_sendrecv_t) + 1];
+
+    uint8_t ctrl[2];
+    for (int i = 0; i < 2; i++) {
+        ctrl[i] = (shadow->ctrl[i] & ~shadow->mask[i]) | (shadow->value[i] & shadow->mask[i]);
+    }
+    memcpy(&buf[sizeof(i2c_send_t) + 1], ctrl, 2); // Data goes after the write header and the address
     err = pac195x_block_write(loc, CTRL, 2, buf);
-    return err;
+    if (err == EOK) err = pac195x_block_read(loc, CTRL, 2, buf);
+    if (err == EOK && memcmp(&buf[sizeof(i2c_sendrecv_t)], ctrl, 2) != 0) err = EIO;
+    if (err != EOK) {
+        shadow->known = false;
+        return err;
+    }
+
+    memcpy(shadow->ctrl, ctrl, 2);
+    memset(shadow->mask, 0, sizeof(shadow->mask));
+    memset(shadow->value, 0, sizeof(shadow->value));
+    return EOK;
 }
 
 /**
@@ -49,6 +49,17 @@ typedef enum {
     CHANNEL4 = 0x1, /**< Channel 4 */
 } pac195x_channel_e;
 
+/**
+ * A copy of the PAC195X's CTRL register kept by the caller. Settings are staged into it without communicating with the
+ * sensor, then written together by `pac195x_commit`, so that CTRL is not read again before each change once known.
+ */
+typedef struct {
+    uint8_t ctrl[2];  /**< The last value read from or written to CTRL, high byte first. */
+    uint8_t mask[2];  /**< The bits of CTRL which are staged to be written. */
+    uint8_t value[2]; /**< The staged value of those bits. */
+    bool known;       /**< Whether the value of CTRL in `ctrl` is known. */
+} pac195x_shadow_t;
+
 int pac195x_get_manu_id(SensorLocation const *loc, uint8_t *id);
 int pac195x_get_prod_id(SensorLocation const *loc, uint8_t *id);
 int pac195x_get_rev_id(SensorLocation const *loc, uint8_t *id);
@@ -59,8 +70,10 @@ int pac195x_get_vsensenavg(SensorLocation const *loc, uint8_t n, uint16_t *val);
 int pac195x_get_vpowern(SensorLocation const *loc, uint8_t n, uint32_t *val);
 int pac195x_get_vaccn(SensorLocation const *loc, uint8_t n, uintptr64_t *val);
 
-int pac195x_set_sample_mode(SensorLocation const *loc, pac195x_sm_e mode);
-int pac195x_toggle_channel(SensorLocation const *loc, pac195x_channel_e channel, bool enable);
+void pac195x_shadow_init(pac195x_shadow_t *shadow);
+int pac195x_set_sample_mode(pac195x_shadow_t *shadow, pac195x_sm_e mode);
+int pac195x_toggle_channel(pac195x_shadow_t *shadow, pac195x_channel_e channel, bool enable);
+int pac195x_commit(SensorLocation const *loc, pac195x_shadow_t *shadow);
 
 int pac195x_refresh(SensorLocation const *loc);
 int pac195x_refresh_v(SensorLocation const *loc);
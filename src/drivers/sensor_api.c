@@ -5,6 +5,7 @@
  * This file contains the implementations for the sensor API interface.
  */
 #include "sensor_api.h"
+#include "../formatters/formatters.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -19,19 +20,25 @@ const SensorTagData SENSOR_TAG_DATA[] = {
                       .fmt_str = "%.2f",
                       .dsize = sizeof(float),
                       .dtype = TYPE_FLOAT,
-                      .has_id = 0},
+                      .has_id = 0,
+                      .min = 1.0f,
+                      .max = 120.0f},
     [TAG_TEMPERATURE] = {.name = "Temperature",
                          .unit = "C",
                          .fmt_str = "%.2f",
                          .dsize = sizeof(float),
                          .dtype = TYPE_FLOAT,
-                         .has_id = 0},
+                         .has_id = 0,
+                         .min = -40.0f,
+                         .max = 125.0f},
     [TAG_HUMIDITY] = {.name = "Humidity",
                       .unit = "%RH",
                       .fmt_str = "%.2f",
                       .dsize = sizeof(float),
                       .dtype = TYPE_FLOAT,
-                      .has_id = 0},
+                      .has_id = 0,
+                      .min = 0.0f,
+                      .max = 100.0f},
     [TAG_TIME] =
         {.name = "Time", .unit = "ms", .fmt_str = "%u", .dsize = sizeof(uint32_t), .dtype = TYPE_U32, .has_id = 0},
     [TAG_ALTITUDE_REL] = {.name = "Altitude rel",
@@ -39,31 +46,41 @@ const SensorTagData SENSOR_TAG_DATA[] = {
                           .fmt_str = "%.2f",
                           .dsize = sizeof(float),
                           .dtype = TYPE_FLOAT,
-                          .has_id = 0},
+                          .has_id = 0,
+                          .min = -1000.0f,
+                          .max = 40000.0f},
     [TAG_ALTITUDE_SEA] = {.name = "Altitude sea level",
                           .unit = "m",
                           .fmt_str = "%.2f",
                           .dsize = sizeof(float),
                           .dtype = TYPE_FLOAT,
-                          .has_id = 0},
+                          .has_id = 0,
+                          .min = -1000.0f,
+                          .max = 40000.0f},
     [TAG_LINEAR_ACCEL_ABS] = {.name = "Absolute linear acceleration",
                               .unit = "m/s^2",
                               .fmt_str = "%.2fX, %.2fY, %.2fZ",
                               .dsize = sizeof(vec3d_t),
                               .dtype = TYPE_VEC3D,
-                              .has_id = 0},
+                              .has_id = 0,
+                              .min = -320.0f,
+                              .max = 320.0f},
     [TAG_LINEAR_ACCEL_REL] = {.name = "Relative linear acceleration",
                               .unit = "m/s^2",
                               .fmt_str = "%.2fX, %.2fY, %.2fZ",
                               .dsize = sizeof(vec3d_t),
                               .dtype = TYPE_VEC3D,
-                              .has_id = 0},
+                              .has_id = 0,
+                              .min = -320.0f,
+                              .max = 320.0f},
     [TAG_ANGULAR_VEL] = {.name = "Angular velocity",
                          .unit = "dps",
                          .fmt_str = "%.2fX, %.2fY, %.2fZ",
                          .dsize = sizeof(vec3d_t),
                          .dtype = TYPE_VEC3D,
-                         .has_id = 0},
+                         .has_id = 0,
+                         .min = -2300.0f,
+                         .max = 2300.0f},
     [TAG_COORDS] = {.name = "Lat/Long",
                     .unit = "0.1udeg",
                     .fmt_str = "%dX, %dY",
@@ -72,6 +89,72 @@ const SensorTagData SENSOR_TAG_DATA[] = {
                     .has_id = 0},
     [TAG_VOLTAGE] =
         {.name = "Voltage", .unit = "mV", .fmt_str = "%d", .dsize = sizeof(int16_t), .dtype = TYPE_I16, .has_id = 1},
+    [TAG_ALTITUDE_FUSED] = {.name = "Fused altitude",
+                            .unit = "m",
+                            .fmt_str = "%.2f",
+                            .dsize = sizeof(float),
+                            .dtype = TYPE_FLOAT,
+                            .has_id = 0},
+    [TAG_VERTICAL_VEL] = {.name = "Vertical velocity",
+                          .unit = "m/s",
+                          .fmt_str = "%.2f",
+                          .dsize = sizeof(float),
+                          .dtype = TYPE_FLOAT,
+                          .has_id = 0},
+    [TAG_FLIGHT_EVENT] = {.name = "Flight event",
+                          .unit = "us",
+                          .fmt_str = "%u",
+                          .dsize = sizeof(uint32_t),
+                          .dtype = TYPE_U32,
+                          .has_id = 1},
+    [TAG_STATS_MIN] = {.name = "Rolling minimum",
+                       .unit = "",
+                       .fmt_str = "%.2fX, %.2fY, %.2fZ",
+                       .dsize = sizeof(vec3d_t),
+                       .dtype = TYPE_VEC3D,
+                       .has_id = 1},
+    [TAG_STATS_MAX] = {.name = "Rolling maximum",
+                       .unit = "",
+                       .fmt_str = "%.2fX, %.2fY, %.2fZ",
+                       .dsize = sizeof(vec3d_t),
+                       .dtype = TYPE_VEC3D,
+                       .has_id = 1},
+    [TAG_STATS_MEAN] = {.name = "Rolling mean",
+                        .unit = "",
+                        .fmt_str = "%.2fX, %.2fY, %.2fZ",
+                        .dsize = sizeof(vec3d_t),
+                        .dtype = TYPE_VEC3D,
+                        .has_id = 1},
+    [TAG_STATS_VARIANCE] = {.name = "Rolling variance",
+                            .unit = "",
+                            .fmt_str = "%.2fX, %.2fY, %.2fZ",
+                            .dsize = sizeof(vec3d_t),
+                            .dtype = TYPE_VEC3D,
+                            .has_id = 1},
+    [TAG_STATS_RMS] = {.name = "Rolling RMS",
+                       .unit = "",
+                       .fmt_str = "%.2fX, %.2fY, %.2fZ",
+                       .dsize = sizeof(vec3d_t),
+                       .dtype = TYPE_VEC3D,
+                       .has_id = 1},
+    [TAG_VOTE_SPREAD] = {.name = "Sensor spread",
+                         .unit = "",
+                         .fmt_str = "%.2fX, %.2fY, %.2fZ",
+                         .dsize = sizeof(vec3d_t),
+                         .dtype = TYPE_VEC3D,
+                         .has_id = 1},
+    [TAG_SNAPSHOT] = {.name = "Snapshot",
+                      .unit = "",
+                      .fmt_str = "%u",
+                      .dsize = sizeof(uint32_t),
+                      .dtype = TYPE_U32,
+                      .has_id = 1},
+    [TAG_FLIGHT_PHASE] = {.name = "Flight phase",
+                          .unit = "",
+                          .fmt_str = "%u",
+                          .dsize = sizeof(uint8_t),
+                          .dtype = TYPE_U8,
+                          .has_id = 0},
     /* [TAG_SPEED] = */
     /*     {.name = "Ground speed", .unit = "cm/s", .fmt_str = "%d", .dsize = sizeof(uint32_t), .dtype = TYPE_U32}, */
     /* [TAG_COURSE] = {.name = "Course", .unit = "10udeg", .fmt_str = "%d", .dsize = sizeof(uint32_t), .dtype =
@@ -79,6 +162,9 @@ const SensorTagData SENSOR_TAG_DATA[] = {
     /* [TAG_FIX] = {.name = "Fix type", .unit = "", .fmt_str = "0x%x", .dsize = sizeof(uint8_t), .dtype = TYPE_U8}, */
 };
 
+/** The number of entries in the list of sensor tags. */
+const uint8_t SENSOR_TAG_COUNT = sizeof(SENSOR_TAG_DATA) / sizeof(SENSOR_TAG_DATA[0]);
+
 /**
  * Utility function for copying memory in big-endian format.
  * @param dest The destination buffer for data copied from src.
@@ -162,54 +248,55 @@ const char __attribute__((const)) * sensor_strtag(const SensorTag tag) { return
 /**
  * Writes sensor data in a standard format.
  * @param stream The output stream for writing sensor data.
- * @param tag The tag describing the kind of sensor data.
- * @param data A pointer to the sensor data to be printed.
+ * @param msg The message containing the sensor data to be printed.
  */
 void sensor_write_data(FILE *stream, const common_t *msg) {
+    char line[FMT_MAX_LINE];
+    fwrite(line, 1, text_fmt_line(line, msg), stream);
+}
 
-    if (SENSOR_TAG_DATA[msg->type].has_id) fprintf(stream, "ID: %u ", msg->id);
-
-    char format_str[40] = "%s: ";                           // Format specifier for data name
-    strcat(format_str, SENSOR_TAG_DATA[msg->type].fmt_str); // Format specifier for data
-    strcat(format_str, " %s\n");                            // Format specifier for unit
-
-    // Ignore GCC warning about not using string literal in printf
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-    // Decide how to cast data pointer for printing
+/**
+ * Reads every component of a message's data as a float, for processing which treats all tags alike.
+ * @param msg The message.
+ * @param values Where to store the components, which must have room for 3.
+ * @return The number of components of the message's data: 1 for scalars, 2 or 3 for vectors.
+ */
+uint8_t sensor_get_values(const common_t *msg, float *values) {
     switch (SENSOR_TAG_DATA[msg->type].dtype) {
     case TYPE_FLOAT:
-        // Ignore warning about promoting float to double since printf doesn't support float printing
-#pragma GCC diagnostic ignored "-Wdouble-promotion"
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.FLOAT, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = msg->data.FLOAT;
+        return 1;
     case TYPE_U32:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.U32, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = (float)msg->data.U32;
+        return 1;
     case TYPE_U16:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.U16, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = (float)msg->data.U16;
+        return 1;
     case TYPE_U8:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.U8, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = (float)msg->data.U8;
+        return 1;
     case TYPE_I32:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.I32, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = (float)msg->data.I32;
+        return 1;
     case TYPE_I16:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.I16, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = (float)msg->data.I16;
+        return 1;
     case TYPE_I8:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.I8, SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = (float)msg->data.I8;
+        return 1;
     case TYPE_VEC3D:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.VEC3D.x, msg->data.VEC3D.y,
-                msg->data.VEC3D.z, SENSOR_TAG_DATA[msg->type].unit);
-        break;
-    case TYPE_VEC2D:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.VEC2D.x, msg->data.VEC2D.y,
-                SENSOR_TAG_DATA[msg->type].unit);
-        break;
+        values[0] = msg->data.VEC3D.x;
+        values[1] = msg->data.VEC3D.y;
+        values[2] = msg->data.VEC3D.z;
+        return 3;
     case TYPE_VEC2D_I32:
-        fprintf(stream, format_str, SENSOR_TAG_DATA[msg->type].name, msg->data.VEC2D_I32.x, msg->data.VEC2D_I32.y,
-                SENSOR_TAG_DATA[msg->type].unit);
+        values[0] = (float)msg->data.VEC2D_I32.x;
+        values[1] = (float)msg->data.VEC2D_I32.y;
+        return 2;
+    case TYPE_VEC2D:
+        values[0] = msg->data.VEC2D.x;
+        values[1] = msg->data.VEC2D.y;
+        return 2;
     }
+    return 0;
 }
@@ -53,8 +53,44 @@ typedef enum {
     TAG_LINEAR_ACCEL_ABS = 0x8, /**< Absolute linear acceleration in meters per second squared */
     TAG_COORDS = 0x9,           /**< Latitude and longitude in degrees */
     TAG_VOLTAGE = 0xa,          /**< Voltage in volts with a unique ID. */
+    TAG_ALTITUDE_FUSED = 0xb,   /**< Altitude above launch height fused from barometer and IMU, in meters */
+    TAG_VERTICAL_VEL = 0xc,     /**< Vertical velocity fused from barometer and IMU, in meters per second */
+    TAG_FLIGHT_EVENT = 0xd,     /**< Flight event with the event as its ID, and its detection latency in microseconds */
+    TAG_STATS_MIN = 0xe,        /**< Rolling minimum of each axis of a stream, with the stream as its ID (STATS_ID) */
+    TAG_STATS_MAX = 0xf,        /**< Rolling maximum of each axis of a stream, with the stream as its ID (STATS_ID) */
+    TAG_STATS_MEAN = 0x10,      /**< Rolling mean of each axis of a stream, with the stream as its ID (STATS_ID) */
+    TAG_STATS_VARIANCE = 0x11,  /**< Rolling variance of each axis of a stream, with the stream as its ID (STATS_ID) */
+    TAG_STATS_RMS = 0x12,       /**< Rolling RMS of each axis of a stream, with the stream as its ID (STATS_ID) */
+    TAG_VOTE_SPREAD = 0x13,     /**< Spread of each axis between redundant sensors, with the vote as its ID (VOTE_ID) */
+    TAG_SNAPSHOT = 0x14,        /**< Start of a snapshot with its number of streams as its ID, and its tick number */
+    TAG_FLIGHT_PHASE = 0x15,    /**< Flight phase entered, as a number from 0 (idle) to 5 (landed) */
 } SensorTag;
 
+/** The ID of the rolling statistics of a stream: the stream's tag in the low 5 bits and its ID in the high 3 bits. */
+#define STATS_ID(tag, id) ((uint8_t)(((id) << 5) | ((tag)&0x1f)))
+
+/** The tag of the stream a rolling statistics ID belongs to. */
+#define STATS_ID_TAG(stats_id) ((uint8_t)((stats_id)&0x1f))
+
+/** The ID of the stream a rolling statistics ID belongs to, for tags which have an ID. */
+#define STATS_ID_STREAM(stats_id) ((uint8_t)((stats_id) >> 5))
+
+/** The ID of the spread of a vote: the voted tag in the low 5 bits and the number of sensors in the high 3 bits. */
+#define VOTE_ID(tag, n) STATS_ID(tag, n)
+
+/** The tag a vote's ID belongs to. */
+#define VOTE_ID_TAG(vote_id) STATS_ID_TAG(vote_id)
+
+/** The number of sensors which took part in the vote an ID belongs to. */
+#define VOTE_ID_COUNT(vote_id) STATS_ID_STREAM(vote_id)
+
+/** Describes the flight events which are published with TAG_FLIGHT_EVENT, as the message's ID. */
+typedef enum {
+    EVENT_LAUNCH = 1,  /**< The motor ignited and the rocket left the pad */
+    EVENT_BURNOUT = 2, /**< The motor stopped thrusting */
+    EVENT_APOGEE = 3,  /**< The rocket reached its highest point */
+} FlightEvent;
+
 /** Describes the data type of the data associated with a tag. */
 typedef enum {
     TYPE_FLOAT,     /**< float */
@@ -101,6 +137,10 @@ typedef struct {
     const SensorTagDType dtype;
     /** Whether or not the data type is preceded by a unique numerical ID. */
     const uint8_t has_id;
+    /** The lowest value any component can physically have. The tag has no range unless this is below `max`. */
+    const float min;
+    /** The highest value any component can physically have. */
+    const float max;
 } SensorTagData;
 
 typedef enum {
@@ -161,10 +201,14 @@ typedef struct sensor_t {
     errno_t (*read)(struct sensor_t *sensor, const SensorTag tag, void *buf, size_t *nbytes);
 } Sensor;
 
+extern const SensorTagData SENSOR_TAG_DATA[];
+extern const uint8_t SENSOR_TAG_COUNT;
+
 void memcpy_be(void *dest, const void *src, const size_t nbytes);
 size_t sensor_max_dsize(const Sensor *sensor);
 const char *sensor_strtag(const SensorTag tag);
 void sensor_write_data(FILE *stream, const common_t *msg);
+uint8_t sensor_get_values(const common_t *msg, float *values);
 
 extern void sensor_set_precision(Sensor sensor, const SensorPrecision precision);
 extern errno_t sensor_open(Sensor sensor);
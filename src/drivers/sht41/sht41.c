@@ -141,31 +141,43 @@ static float sht41_calculate_humidity(uint8_t *data) {
 }
 
 /**
- * Reads the specified data from the SHT41.
+ * Starts a measurement of temperature and humidity on the SHT41. Its result can be fetched with `sht41_fetch` once the
+ * measurement time for the precision has passed.
  * @param loc The location of the SHT41 on the I2C bus.
- * @param precision The precision to use when reading data.
- * @param temperature A pointer to store the temperature in degrees Celsius.
- * @param humidity A pointer to store the relative humidity in percentage.
- * @return Error status of reading from the sensor. EOK if successful.
+ * @param precision The precision to measure with.
+ * @return Error status of starting the measurement. EOK if successful.
  */
-int sht41_read(SensorLocation const *loc, sht41_prec_e precision, float *temperature, float *humidity) {
-
+int sht41_start(SensorLocation const *loc, sht41_prec_e precision) {
     i2c_send_t send = {.slave = loc->addr, .stop = 1, .len = 1};
     uint8_t send_cmd[sizeof(send) + 1];
     memcpy(send_cmd, &send, sizeof(send));
     send_cmd[sizeof(send)] = PRECISION_READ[precision];
 
-    int err = devctl(loc->bus, DCMD_I2C_SEND, &send_cmd, sizeof(send_cmd), NULL);
-    return_err(err);
+    return devctl(loc->bus, DCMD_I2C_SEND, &send_cmd, sizeof(send_cmd), NULL);
+}
 
-    usleep(MEASUREMENT_TIMES[precision]); // Wait for the measurement to take place, depends on precision
+/**
+ * Gets how long a measurement takes at a precision.
+ * @param precision The precision of the measurement.
+ * @return The time the measurement takes in microseconds.
+ */
+uint16_t __attribute__((const)) sht41_measurement_time(sht41_prec_e precision) {
+    return MEASUREMENT_TIMES[precision];
+}
 
-    // Read data from sensor
+/**
+ * Fetches the result of the last measurement of the SHT41.
+ * @param loc The location of the SHT41 on the I2C bus.
+ * @param temperature A pointer to store the temperature in degrees Celsius.
+ * @param humidity A pointer to store the relative humidity in percentage.
+ * @return Error status of reading from the sensor, EBADMSG if a CRC did not match. EOK if successful.
+ */
+int sht41_fetch(SensorLocation const *loc, float *temperature, float *humidity) {
     i2c_recv_t read = {.slave = loc->addr, .stop = 1, .len = 6};
     uint8_t read_cmd[sizeof(read) + 6];
     memcpy(read_cmd, &read, sizeof(read));
 
-    err = devctl(loc->bus, DCMD_I2C_RECV, &read_cmd, sizeof(read_cmd), NULL);
+    int err = devctl(loc->bus, DCMD_I2C_RECV, &read_cmd, sizeof(read_cmd), NULL);
     return_err(err);
 
     // Calculate temperature
@@ -181,6 +193,23 @@ int sht41_read(SensorLocation const *loc, sht41_prec_e precision, float *tempera
     return err;
 }
 
+/**
+ * Reads the specified data from the SHT41.
+ * @param loc The location of the SHT41 on the I2C bus.
+ * @param precision The precision to use when reading data.
+ * @param temperature A pointer to store the temperature in degrees Celsius.
+ * @param humidity A pointer to store the relative humidity in percentage.
+ * @return Error status of reading from the sensor. EOK if successful.
+ */
+int sht41_read(SensorLocation const *loc, sht41_prec_e precision, float *temperature, float *humidity) {
+    int err = sht41_start(loc, precision);
+    return_err(err);
+
+    usleep(MEASUREMENT_TIMES[precision]); // Wait for the measurement to take place, depends on precision
+
+    return sht41_fetch(loc, temperature, humidity);
+}
+
 /**
  * Resets the SHT41 sensor
  * @param loc The sensor's location on the I2C bus.
@@ -33,6 +33,9 @@ typedef enum {
 
 int sht41_reset(SensorLocation const *loc);
 int sht41_read(SensorLocation const *loc, sht41_prec_e precision, float *temperature, float *humidity);
+int sht41_start(SensorLocation const *loc, sht41_prec_e precision);
+uint16_t sht41_measurement_time(sht41_prec_e precision);
+int sht41_fetch(SensorLocation const *loc, float *temperature, float *humidity);
 int sht41_serial_no(SensorLocation const *loc, uint32_t *serial_no);
 int sht41_heat(SensorLocation const *loc, sht41_dur_e duration, sht41_wattage_e wattage, float *temperature,
                float *humidity);
@@ -0,0 +1,84 @@
+/**
+ * @file csv_fmt.c
+ * @brief Formatter for the CSV output of fetcher.
+ *
+ * Formatter for the CSV output of fetcher. Every row starts with the key of its stream, so rows of one stream can be
+ * picked out by their first field, and every row of a stream has the same columns:
+ *
+ *     <key>,time_ns,source[,id],<value columns>
+ *
+ * The schema is written as comment lines at the start of the output, one per stream, listing the stream's columns
+ * followed by the stream's name and unit.
+ */
+#include "formatters.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Writes the columns of every stream as CSV comment lines, like `# pressure,time_ns,source,value ; Pressure ; kPa`.
+ * @param out Where to write the schema.
+ * @param len The number of characters `out` has room for.
+ * @return The number of characters written. Streams which do not fit are left out.
+ */
+size_t csv_fmt_header(char *out, size_t len) {
+    size_t written = 0;
+    for (uint16_t tag = 0; tag <= UINT8_MAX; tag++) {
+        const fmt_stream_t *s = fmt_stream((uint8_t)tag);
+        if (s == NULL) continue;
+
+        char line[FMT_MAX_LINE];
+        char *cur = line;
+        memcpy(cur, "# ", 2);
+        memcpy(cur + 2, s->key, s->key_len);
+        cur += 2 + s->key_len;
+        memcpy(cur, ",time_ns,source", 15);
+        cur += 15;
+        if (s->has_id) {
+            memcpy(cur, ",id", 3);
+            cur += 3;
+        }
+        for (uint8_t i = 0; i < s->ncols; i++) {
+            *cur++ = ',';
+            cur = stpcpy(cur, s->cols[i]);
+        }
+        int n = snprintf(cur, sizeof(line) - (size_t)(cur - line), " ; %s ; %s\n", s->data->name, s->data->unit);
+        if (n < 0 || (size_t)n >= sizeof(line) - (size_t)(cur - line)) continue;
+        cur += n;
+
+        size_t line_len = (size_t)(cur - line);
+        if (written + line_len > len) break;
+        memcpy(&out[written], line, line_len);
+        written += line_len;
+    }
+    return written;
+}
+
+/**
+ * Formats a sample as a CSV row.
+ * @param out Where to write the row. Must have room for `FMT_MAX_LINE` characters. No null terminator is written.
+ * @param sample The sample to format.
+ * @return The number of characters written. Zero if the message's tag is unknown.
+ */
+size_t csv_fmt_line(char *out, const sample_t *sample) {
+    const fmt_stream_t *s = fmt_stream(sample->msg.type);
+    if (s == NULL) return 0;
+
+    char *cur = out;
+    memcpy(cur, s->key, s->key_len);
+    cur += s->key_len;
+    *cur++ = ',';
+    cur = fmt_u64(cur, sample->time);
+    *cur++ = ',';
+    cur = fmt_u64(cur, sample->source);
+    if (s->has_id) {
+        *cur++ = ',';
+        cur = fmt_u64(cur, sample->msg.id);
+    }
+    for (uint8_t i = 0; i < s->ncols; i++) {
+        *cur++ = ',';
+        cur = fmt_column(cur, &sample->msg, i);
+    }
+    *cur++ = '\n';
+
+    return (size_t)(cur - out);
+}
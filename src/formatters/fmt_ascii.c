@@ -0,0 +1,112 @@
+/**
+ * @file fmt_ascii.c
+ * @brief Specialized number to ASCII conversions used by the formatters.
+ *
+ * Specialized number to ASCII conversions used by the formatters. These produce exactly the same text as the matching
+ * `printf` conversions, without parsing a format string or going through a stream.
+ */
+#include "formatters.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/** Values at or above this many fractional units do not fit in a `uint64_t`, so are printed with `snprintf`. */
+#define FIXED_LIMIT 1000000000000000000ULL
+
+/** Powers of ten for each supported number of decimal places. */
+static const uint32_t POW10[FMT_MAX_DECIMALS + 1] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+/** The two digit decimal representation of every number from 0 to 99, back to back. */
+static const char DIGIT_PAIRS[] = "00010203040506070809"
+                                  "10111213141516171819"
+                                  "20212223242526272829"
+                                  "30313233343536373839"
+                                  "40414243444546474849"
+                                  "50515253545556575859"
+                                  "60616263646566676869"
+                                  "70717273747576777879"
+                                  "80818283848586878889"
+                                  "90919293949596979899";
+
+/**
+ * Writes an unsigned integer in decimal, equivalent to `printf("%llu")`.
+ * @param out Where to write the digits. Must have room for 20 characters.
+ * @param val The value to write.
+ * @return A pointer to the character after the last digit written.
+ */
+char *fmt_u64(char *out, uint64_t val) {
+    char digits[20];
+    char *start = digits + sizeof(digits);
+
+    // Convert two digits at a time from the least significant end
+    while (val >= 100) {
+        start -= 2;
+        memcpy(start, &DIGIT_PAIRS[(val % 100) * 2], 2);
+        val /= 100;
+    }
+    if (val >= 10) {
+        start -= 2;
+        memcpy(start, &DIGIT_PAIRS[val * 2], 2);
+    } else {
+        *(--start) = (char)('0' + val);
+    }
+
+    size_t len = (size_t)(digits + sizeof(digits) - start);
+    memcpy(out, start, len);
+    return out + len;
+}
+
+/**
+ * Writes a signed integer in decimal, equivalent to `printf("%lld")`.
+ * @param out Where to write the digits. Must have room for 20 characters.
+ * @param val The value to write.
+ * @return A pointer to the character after the last digit written.
+ */
+char *fmt_i64(char *out, int64_t val) {
+    if (val < 0) {
+        *out++ = '-';
+        return fmt_u64(out, (uint64_t)0 - (uint64_t)val);
+    }
+    return fmt_u64(out, (uint64_t)val);
+}
+
+/**
+ * Writes a float with a fixed number of decimal places, equivalent to `printf("%.*f")`.
+ * A float has at most 24 significant bits and 10^8 needs at most 19 more (its factors of two are free), so scaling a
+ * float as a double is exact. Rounding the scaled value to the nearest integer (ties to even) gives the same digits as
+ * printf.
+ * @param out Where to write the number. Must have room for 50 characters.
+ * @param val The value to write.
+ * @param decimals The number of decimal places, at most FMT_MAX_DECIMALS.
+ * @return A pointer to the character after the last character written.
+ */
+char *fmt_fixed(char *out, float val, uint8_t decimals) {
+    double scaled = (double)val * POW10[decimals];
+
+    // NaN, infinity and huge values are rare enough to leave to printf
+    if (!(fabs(scaled) < (double)FIXED_LIMIT)) {
+        char text[64];
+        int len = snprintf(text, sizeof(text), "%.*f", decimals, (double)val);
+        memcpy(out, text, (size_t)len);
+        return out + len;
+    }
+
+    if (signbit(val)) *out++ = '-'; // printf keeps the sign of negative values which round to zero
+    uint64_t units = (uint64_t)llrint(fabs(scaled));
+    if (decimals == 0) return fmt_u64(out, units);
+
+    out = fmt_u64(out, units / POW10[decimals]);
+    *out++ = '.';
+
+    // Write the fraction with its leading zeros, two digits at a time from the least significant end
+    uint32_t frac = (uint32_t)(units % POW10[decimals]);
+    char *end = out + decimals;
+    char *cur = end;
+    for (uint8_t i = decimals; i >= 2; i -= 2) {
+        cur -= 2;
+        memcpy(cur, &DIGIT_PAIRS[(frac % 100) * 2], 2);
+        frac /= 100;
+    }
+    if (cur != out) *out = (char)('0' + frac);
+    return end;
+}
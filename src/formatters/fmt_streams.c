@@ -0,0 +1,143 @@
+/**
+ * @file fmt_streams.c
+ * @brief The column layout of each stream in the CSV and NDJSON formats.
+ *
+ * The column layout of each stream in the CSV and NDJSON formats. Every tag is one stream, and its columns only depend
+ * on the tag's metadata: an optional ID column followed by one column per component of the tag's data type. Since the
+ * layout never changes while fetcher is running, tools reading the output can rely on it after reading the schema.
+ */
+#include "formatters.h"
+#include <ctype.h>
+#include <math.h>
+#include <pthread.h>
+
+/** The value column of data types with a single component. */
+static const char *const SCALAR_COLS[] = {"value"};
+
+/** The value columns of two dimensional data types. */
+static const char *const VEC2_COLS[] = {"x", "y"};
+
+/** The value columns of three dimensional data types. */
+static const char *const VEC3_COLS[] = {"x", "y", "z"};
+
+/** The column layout of every possible tag, indexed by tag. */
+static fmt_stream_t streams[UINT8_MAX + 1];
+
+/** Makes sure the column layouts are only built once. */
+static pthread_once_t streams_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Builds the column layout of every tag from the tag metadata.
+ */
+static void build_streams(void) {
+    for (uint8_t tag = 0; tag < SENSOR_TAG_COUNT; tag++) {
+        const SensorTagData *data = &SENSOR_TAG_DATA[tag];
+        if (data->name == NULL) continue; // Gap in the tag list
+
+        // The key is the name in lower case, with each run of other characters replaced by a single underscore
+        fmt_stream_t *s = &streams[tag];
+        uint8_t len = 0;
+        for (const char *c = data->name; *c != '\0' && len < FMT_KEY_MAX; c++) {
+            if (isalnum((unsigned char)*c)) {
+                s->key[len++] = (char)tolower((unsigned char)*c);
+            } else if (len > 0 && s->key[len - 1] != '_') {
+                s->key[len++] = '_';
+            }
+        }
+        if (len > 0 && s->key[len - 1] == '_') len--;
+        s->key_len = len;
+
+        s->has_id = data->has_id;
+        switch (data->dtype) {
+        case TYPE_VEC3D:
+            s->cols = VEC3_COLS;
+            s->ncols = 3;
+            break;
+        case TYPE_VEC2D:
+        case TYPE_VEC2D_I32:
+            s->cols = VEC2_COLS;
+            s->ncols = 2;
+            break;
+        default:
+            s->cols = SCALAR_COLS;
+            s->ncols = 1;
+            break;
+        }
+        s->data = data;
+    }
+}
+
+/**
+ * Gets the column layout of a stream.
+ * @param tag The tag of the stream.
+ * @return The column layout, or NULL if the tag is unknown.
+ */
+const fmt_stream_t *fmt_stream(uint8_t tag) {
+    pthread_once(&streams_once, build_streams);
+    return streams[tag].data == NULL ? NULL : &streams[tag];
+}
+
+/**
+ * Gets a floating point value column of a message.
+ * @param msg The message.
+ * @param col The index of the value column.
+ * @param val Where to store the value.
+ * @return True if the column holds a float, false if it holds an integer.
+ */
+static bool column_float(const common_t *msg, uint8_t col, float *val) {
+    switch (SENSOR_TAG_DATA[msg->type].dtype) {
+    case TYPE_FLOAT:
+        *val = msg->data.FLOAT;
+        return true;
+    case TYPE_VEC3D:
+        *val = col == 0 ? msg->data.VEC3D.x : col == 1 ? msg->data.VEC3D.y : msg->data.VEC3D.z;
+        return true;
+    case TYPE_VEC2D:
+        *val = col == 0 ? msg->data.VEC2D.x : msg->data.VEC2D.y;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Checks whether a value column of a message is a finite number. Integer columns always are.
+ * @param msg The message, whose tag must be known.
+ * @param col The index of the value column.
+ * @return False if the column is NaN or infinite, true otherwise.
+ */
+bool fmt_column_finite(const common_t *msg, uint8_t col) {
+    float val;
+    return !column_float(msg, col, &val) || isfinite(val);
+}
+
+/**
+ * Writes a value column of a message. Floats are written with `FMT_DATA_DECIMALS` decimal places.
+ * @param out Where to write the value. Must have room for 50 characters.
+ * @param msg The message, whose tag must be known.
+ * @param col The index of the value column.
+ * @return A pointer to the character after the last character written.
+ */
+char *fmt_column(char *out, const common_t *msg, uint8_t col) {
+    float val;
+    if (column_float(msg, col, &val)) return fmt_fixed(out, val, FMT_DATA_DECIMALS);
+
+    switch (SENSOR_TAG_DATA[msg->type].dtype) {
+    case TYPE_U32:
+        return fmt_u64(out, msg->data.U32);
+    case TYPE_U16:
+        return fmt_u64(out, msg->data.U16);
+    case TYPE_U8:
+        return fmt_u64(out, msg->data.U8);
+    case TYPE_I32:
+        return fmt_i64(out, msg->data.I32);
+    case TYPE_I16:
+        return fmt_i64(out, msg->data.I16);
+    case TYPE_I8:
+        return fmt_i64(out, msg->data.I8);
+    case TYPE_VEC2D_I32:
+        return fmt_i64(out, col == 0 ? msg->data.VEC2D_I32.x : msg->data.VEC2D_I32.y);
+    default:
+        return out;
+    }
+}
@@ -0,0 +1,29 @@
+/**
+ * @file formatters.c
+ * @brief Selection of fetcher's output formats by name.
+ *
+ * Selection of fetcher's output formats by name.
+ */
+#include "formatters.h"
+#include <strings.h>
+
+/** A list of the output formats that can be selected. */
+static const fmt_entry_t FORMATTERS[] = {
+    {.name = "text", .header = NULL, .line = text_fmt_sample},
+    {.name = "csv", .header = csv_fmt_header, .line = csv_fmt_line},
+    {.name = "ndjson", .header = ndjson_fmt_header, .line = ndjson_fmt_line},
+};
+
+/**
+ * Searches for an output format by name.
+ * @param name The name of the output format to find.
+ * @return The output format, or NULL if no match is found.
+ */
+const fmt_entry_t *fmt_search(const char *name) {
+    for (uint8_t i = 0; i < sizeof(FORMATTERS) / sizeof(fmt_entry_t); i++) {
+        if (!strcasecmp(name, FORMATTERS[i].name)) {
+            return &FORMATTERS[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file formatters.h
+ * @brief Functions for quickly converting sensor messages into text.
+ *
+ * Functions for quickly converting sensor messages into text. Formatters write into a caller provided buffer instead of
+ * a stream, so that many samples can be assembled into one large buffer and written all at once. Besides the plain-text
+ * format, samples can be written as CSV or NDJSON for analysis tools. Those formats give every stream (tag) a fixed set
+ * of columns derived from `SENSOR_TAG_DATA`, which is written as a schema at the start of the output.
+ */
+#ifndef _FORMATTERS_H_
+#define _FORMATTERS_H_
+
+#include "../drivers/sensor_api.h"
+#include "../pipeline/sample.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The maximum number of bytes that formatting a single message can produce. */
+#define FMT_MAX_LINE 320
+
+/** The maximum number of decimal places `fmt_fixed` supports. */
+#define FMT_MAX_DECIMALS 8
+
+/** The number of decimal places floats are written with in the CSV and NDJSON formats. */
+#define FMT_DATA_DECIMALS 6
+
+/** The maximum length of a stream's key in the CSV and NDJSON formats. */
+#define FMT_KEY_MAX 40
+
+/** Formats one sample into `out`, which has room for `FMT_MAX_LINE` characters. Returns the number written. */
+typedef size_t (*fmt_line_t)(char *out, const sample_t *sample);
+
+/** Writes the schema of the output into `out`, which has room for `len` characters. Returns the number written. */
+typedef size_t (*fmt_header_t)(char *out, size_t len);
+
+/** Output format name + functions for selecting a format by name. */
+typedef struct {
+    const char *name;          /**< The name of the output format. */
+    const fmt_header_t header; /**< Writes the schema at the start of the output, or NULL if there is none. */
+    const fmt_line_t line;     /**< Formats a single sample. */
+} fmt_entry_t;
+
+/** The fixed set of columns of one stream, derived from its tag's metadata. */
+typedef struct {
+    char key[FMT_KEY_MAX];     /**< The name's lower case letters and digits, with anything else replaced by `_`. */
+    uint8_t key_len;           /**< The length of the key. */
+    bool has_id;               /**< Whether the stream has an ID column. */
+    uint8_t ncols;             /**< The number of value columns. */
+    const char *const *cols;   /**< The names of the value columns. */
+    const SensorTagData *data; /**< The tag's metadata. */
+} fmt_stream_t;
+
+const fmt_entry_t *fmt_search(const char *name);
+
+char *fmt_u64(char *out, uint64_t val);
+char *fmt_i64(char *out, int64_t val);
+char *fmt_fixed(char *out, float val, uint8_t decimals);
+
+const fmt_stream_t *fmt_stream(uint8_t tag);
+bool fmt_column_finite(const common_t *msg, uint8_t col);
+char *fmt_column(char *out, const common_t *msg, uint8_t col);
+
+size_t text_fmt_line(char *out, const common_t *msg);
+size_t text_fmt_sample(char *out, const sample_t *sample);
+size_t csv_fmt_header(char *out, size_t len);
+size_t csv_fmt_line(char *out, const sample_t *sample);
+size_t ndjson_fmt_header(char *out, size_t len);
+size_t ndjson_fmt_line(char *out, const sample_t *sample);
+
+#endif // _FORMATTERS_H_
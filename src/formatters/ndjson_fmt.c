@@ -0,0 +1,87 @@
+/**
+ * @file ndjson_fmt.c
+ * @brief Formatter for the NDJSON output of fetcher.
+ *
+ * Formatter for the NDJSON output of fetcher. Every sample is one JSON object on its own line, and every object of a
+ * stream has the same fields in the same order:
+ *
+ *     {"stream":"<key>","time_ns":<time>,"source":<source>[,"id":<id>],<value fields>}
+ *
+ * The schema is written at the start of the output as one object per stream, which can be told apart from samples by
+ * its "schema" field. Values which are not finite are written as `null`, since JSON has no NaN or infinity.
+ */
+#include "formatters.h"
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Writes the fields of every stream as NDJSON objects, like
+ * `{"schema":"pressure","name":"Pressure","unit":"kPa","fields":["time_ns","source","value"]}`.
+ * @param out Where to write the schema.
+ * @param len The number of characters `out` has room for.
+ * @return The number of characters written. Streams which do not fit are left out.
+ */
+size_t ndjson_fmt_header(char *out, size_t len) {
+    size_t written = 0;
+    for (uint16_t tag = 0; tag <= UINT8_MAX; tag++) {
+        const fmt_stream_t *s = fmt_stream((uint8_t)tag);
+        if (s == NULL) continue;
+
+        // Names and units are fixed strings in SENSOR_TAG_DATA without quotes or backslashes, so need no escaping
+        char line[FMT_MAX_LINE];
+        int n = snprintf(line, sizeof(line), "{\"schema\":\"%.*s\",\"name\":\"%s\",\"unit\":\"%s\",\"fields\":[%s%s",
+                         s->key_len, s->key, s->data->name, s->data->unit, "\"time_ns\",\"source\"",
+                         s->has_id ? ",\"id\"" : "");
+        for (uint8_t i = 0; i < s->ncols && n > 0 && (size_t)n < sizeof(line); i++) {
+            n += snprintf(&line[n], sizeof(line) - (size_t)n, ",\"%s\"", s->cols[i]);
+        }
+        if (n > 0 && (size_t)n < sizeof(line)) n += snprintf(&line[n], sizeof(line) - (size_t)n, "]}\n");
+        if (n < 0 || (size_t)n >= sizeof(line)) continue;
+
+        if (written + (size_t)n > len) break;
+        memcpy(&out[written], line, (size_t)n);
+        written += (size_t)n;
+    }
+    return written;
+}
+
+/**
+ * Formats a sample as an NDJSON object.
+ * @param out Where to write the object. Must have room for `FMT_MAX_LINE` characters. No null terminator is written.
+ * @param sample The sample to format.
+ * @return The number of characters written. Zero if the message's tag is unknown.
+ */
+size_t ndjson_fmt_line(char *out, const sample_t *sample) {
+    const fmt_stream_t *s = fmt_stream(sample->msg.type);
+    if (s == NULL) return 0;
+
+    char *cur = out;
+    memcpy(cur, "{\"stream\":\"", 11);
+    memcpy(cur + 11, s->key, s->key_len);
+    cur += 11 + s->key_len;
+    memcpy(cur, "\",\"time_ns\":", 12);
+    cur = fmt_u64(cur + 12, sample->time);
+    memcpy(cur, ",\"source\":", 10);
+    cur = fmt_u64(cur + 10, sample->source);
+    if (s->has_id) {
+        memcpy(cur, ",\"id\":", 6);
+        cur = fmt_u64(cur + 6, sample->msg.id);
+    }
+    for (uint8_t i = 0; i < s->ncols; i++) {
+        *cur++ = ',';
+        *cur++ = '"';
+        cur = stpcpy(cur, s->cols[i]);
+        *cur++ = '"';
+        *cur++ = ':';
+        if (fmt_column_finite(&sample->msg, i)) {
+            cur = fmt_column(cur, &sample->msg, i);
+        } else {
+            memcpy(cur, "null", 4);
+            cur += 4;
+        }
+    }
+    memcpy(cur, "}\n", 2);
+    cur += 2;
+
+    return (size_t)(cur - out);
+}
@@ -0,0 +1,156 @@
+/**
+ * @file text_fmt.c
+ * @brief Formatter for the plain-text `Name: value unit` output of fetcher.
+ *
+ * Formatter for the plain-text `Name: value unit` output of fetcher. The first time it is used, an emitter is built for
+ * every tag from `SENSOR_TAG_DATA`: the name and unit are pre-assembled into a prefix and suffix, and the value is
+ * written by a function specialized for the tag's data type. Formatting a message is then a couple of copies and a
+ * number conversion.
+ */
+#include "formatters.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/** The maximum length of the pre-assembled `Name: ` prefix. */
+#define TEXT_PREFIX_MAX 48
+
+/** The maximum length of the pre-assembled ` unit\n` suffix. */
+#define TEXT_SUFFIX_MAX 24
+
+/** Writes the value of a message. Returns a pointer to the character after the last one written. */
+typedef char *(*value_emitter_t)(char *out, const common_t *msg);
+
+/** Everything needed to print the data of one tag. */
+typedef struct {
+    char prefix[TEXT_PREFIX_MAX]; /**< The tag's name followed by `: ` */
+    char suffix[TEXT_SUFFIX_MAX]; /**< A space, the tag's unit and a newline. */
+    uint8_t prefix_len;           /**< The length of the prefix. */
+    uint8_t suffix_len;           /**< The length of the suffix. */
+    bool has_id;                  /**< Whether the message's ID is printed before the name. */
+    value_emitter_t value;        /**< Writes the value, or NULL if the tag is unknown. */
+} text_emitter_t;
+
+/** The emitter for every possible tag, indexed by tag. */
+static text_emitter_t emitters[UINT8_MAX + 1];
+
+/** Makes sure the emitters are only built once. */
+static pthread_once_t emitters_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Value emitters for each data type. Floats are printed with two decimal places and vectors with an axis letter after
+ * each component, matching the format strings in `SENSOR_TAG_DATA`.
+ */
+
+/** Writes a `TYPE_FLOAT` value like "%.2f". */
+static char *emit_float(char *out, const common_t *msg) { return fmt_fixed(out, msg->data.FLOAT, 2); }
+
+/** Writes a `TYPE_U32` value like "%u". */
+static char *emit_u32(char *out, const common_t *msg) { return fmt_u64(out, msg->data.U32); }
+
+/** Writes a `TYPE_U16` value like "%u". */
+static char *emit_u16(char *out, const common_t *msg) { return fmt_u64(out, msg->data.U16); }
+
+/** Writes a `TYPE_U8` value like "%u". */
+static char *emit_u8(char *out, const common_t *msg) { return fmt_u64(out, msg->data.U8); }
+
+/** Writes a `TYPE_I32` value like "%d". */
+static char *emit_i32(char *out, const common_t *msg) { return fmt_i64(out, msg->data.I32); }
+
+/** Writes a `TYPE_I16` value like "%d". */
+static char *emit_i16(char *out, const common_t *msg) { return fmt_i64(out, msg->data.I16); }
+
+/** Writes a `TYPE_I8` value like "%d". */
+static char *emit_i8(char *out, const common_t *msg) { return fmt_i64(out, msg->data.I8); }
+
+/** Writes a `TYPE_VEC3D` value like "%.2fX, %.2fY, %.2fZ". */
+static char *emit_vec3d(char *out, const common_t *msg) {
+    out = fmt_fixed(out, msg->data.VEC3D.x, 2);
+    memcpy(out, "X, ", 3);
+    out = fmt_fixed(out + 3, msg->data.VEC3D.y, 2);
+    memcpy(out, "Y, ", 3);
+    out = fmt_fixed(out + 3, msg->data.VEC3D.z, 2);
+    *out = 'Z';
+    return out + 1;
+}
+
+/** Writes a `TYPE_VEC2D` value like "%.2fX, %.2fY". */
+static char *emit_vec2d(char *out, const common_t *msg) {
+    out = fmt_fixed(out, msg->data.VEC2D.x, 2);
+    memcpy(out, "X, ", 3);
+    out = fmt_fixed(out + 3, msg->data.VEC2D.y, 2);
+    *out = 'Y';
+    return out + 1;
+}
+
+/** Writes a `TYPE_VEC2D_I32` value like "%dX, %dY". */
+static char *emit_vec2d_i32(char *out, const common_t *msg) {
+    out = fmt_i64(out, msg->data.VEC2D_I32.x);
+    memcpy(out, "X, ", 3);
+    out = fmt_i64(out + 3, msg->data.VEC2D_I32.y);
+    *out = 'Y';
+    return out + 1;
+}
+
+/** The value emitter for each data type. */
+static const value_emitter_t VALUE_EMITTERS[] = {
+    [TYPE_FLOAT] = emit_float, [TYPE_U32] = emit_u32,     [TYPE_U16] = emit_u16,
+    [TYPE_U8] = emit_u8,       [TYPE_I32] = emit_i32,     [TYPE_I16] = emit_i16,
+    [TYPE_I8] = emit_i8,       [TYPE_VEC3D] = emit_vec3d, [TYPE_VEC2D_I32] = emit_vec2d_i32,
+    [TYPE_VEC2D] = emit_vec2d,
+};
+
+/**
+ * Builds the emitter of every tag from the tag metadata.
+ */
+static void build_emitters(void) {
+    for (uint8_t tag = 0; tag < SENSOR_TAG_COUNT; tag++) {
+        const SensorTagData *data = &SENSOR_TAG_DATA[tag];
+        if (data->name == NULL) continue; // Gap in the tag list
+
+        // Names and units which do not fit are cut short rather than overflowing the line
+        text_emitter_t *e = &emitters[tag];
+        int len = snprintf(e->prefix, sizeof(e->prefix), "%s: ", data->name);
+        e->prefix_len = (uint8_t)(len < TEXT_PREFIX_MAX ? len : TEXT_PREFIX_MAX - 1);
+        len = snprintf(e->suffix, sizeof(e->suffix), " %s\n", data->unit);
+        e->suffix_len = (uint8_t)(len < TEXT_SUFFIX_MAX ? len : TEXT_SUFFIX_MAX - 1);
+        e->has_id = data->has_id;
+        e->value = VALUE_EMITTERS[data->dtype];
+    }
+}
+
+/**
+ * Formats a message in the plain-text format `[ID: <id> ]<name>: <value> <unit>\n`.
+ * @param out Where to write the text. Must have room for `FMT_MAX_LINE` characters. No null terminator is written.
+ * @param msg The message to format.
+ * @return The number of characters written. Zero if the message's tag is unknown.
+ */
+size_t text_fmt_line(char *out, const common_t *msg) {
+    pthread_once(&emitters_once, build_emitters);
+
+    const text_emitter_t *e = &emitters[msg->type];
+    if (e->value == NULL) return 0;
+
+    char *cur = out;
+    if (e->has_id) {
+        memcpy(cur, "ID: ", 4);
+        cur = fmt_u64(cur + 4, msg->id);
+        *cur++ = ' ';
+    }
+
+    memcpy(cur, e->prefix, e->prefix_len);
+    cur = e->value(cur + e->prefix_len, msg);
+    memcpy(cur, e->suffix, e->suffix_len);
+    cur += e->suffix_len;
+
+    return (size_t)(cur - out);
+}
+
+/**
+ * Formats a sample in the plain-text format. Only the message is printed, the same as `text_fmt_line`.
+ * @param out Where to write the text. Must have room for `FMT_MAX_LINE` characters. No null terminator is written.
+ * @param sample The sample to format.
+ * @return The number of characters written. Zero if the message's tag is unknown.
+ */
+size_t text_fmt_sample(char *out, const sample_t *sample) { return text_fmt_line(out, &sample->msg); }
@@ -9,17 +9,26 @@
 #include "collectors/collectors.h"
 #include "drivers/m24c0x/m24c0x.h"
 #include "drivers/sensor_api.h"
+#include "pipeline/pipeline.h"
+#include "realtime/realtime.h"
+#include "replay/replay.h"
+#include "sinks/sinks.h"
+#include "stages/stages.h"
 #include <devctl.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
 #include <hw/i2c.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <time.h>
+#include <unistd.h>
 
 /** Size of the buffer to read input data. */
 #define BUFFER_SIZE 100
@@ -39,20 +48,303 @@
 /** The name of the system clock collector. */
 #define SYSCLOCK_NAME "sysclock"
 
+/** The maximum number of threads whose scheduling can be selected. */
+#define MAX_SCHED_RULES 16
+
+/** The maximum number of CPUs a thread can be bound to. */
+#define MAX_CPUS 32
+
+/** The maximum number of sensors whose rates can be selected. */
+#define MAX_RATE_RULES 16
+
 /** Whether or not to print data to stdout. */
 bool print_output = false;
 
+/** Whether or not to publish data to shared memory. */
+bool shm_output = false;
+
+/** The path of the file to log data to, or null if data should not be logged to a file. */
+char *log_file = NULL;
+
+/** The name of the format to print and log data in. */
+const char *output_format = "text";
+
+/** How the flight recorder is set up. The recorder is only enabled if a directory is selected. */
+rec_config_t rec_config = {
+    .dir = NULL,
+    .segment_len = REC_DEFAULT_SEGMENT_LEN,
+    .sync_ms = REC_DEFAULT_SYNC_MS,
+    .sync_bytes = REC_DEFAULT_SYNC_BYTES,
+    .index_ms = REC_DEFAULT_INDEX_MS,
+    .encoding = REC_ENCODING_PACKED,
+};
+
 /** The name of a single sensor to enable, or null if no sensor was selected */
 char *select_sensor = NULL;
 
+/** Whether the collectors run as tasks of the acquisition engine on one thread instead of in a thread each. */
+bool engine_loop = false;
+
 /** Stores the thread IDs of all the collector threads. */
 pthread_t collector_threads[MAX_SENSORS];
 
 /** Stores the collector arguments of all the collector threads. */
 collector_args_t collector_args[MAX_SENSORS];
 
-/** Space for recieving messages from the message queue if print mode is selected. */
-static common_t recv_msg;
+/** The collector run by each collector thread. */
+collector_t collectors[MAX_SENSORS];
+
+/** The name of the sensor read by each collector thread, which selects its scheduling and names it in reports. */
+char collector_names[MAX_SENSORS][MAX_SENSOR_NAME];
+
+/** The number of collector threads which have not stopped. */
+atomic_uint running_collectors;
+
+/** How a thread of fetcher is scheduled. */
+typedef struct {
+    const char *thread; /**< The thread: a sensor name, `dispatcher`, a sink name or `engine`. */
+    rt_config_t config; /**< How the thread is scheduled. */
+} sched_rule_t;
+
+/** How the threads of fetcher are scheduled. Threads without a rule keep the scheduling they inherit. */
+sched_rule_t sched_rules[MAX_SCHED_RULES];
+
+/** The number of scheduling rules. */
+uint8_t nsched_rules = 0;
+
+/** Whether the memory of the process is locked at startup. */
+bool lock_memory = false;
+
+/** The rates at which a kind of sensor is read and its tags are published. */
+typedef struct {
+    char sensor[MAX_SENSOR_NAME]; /**< The name of the sensor. */
+    clctr_rates_t rates;          /**< The rates of each collector of the sensor. */
+} rate_rule_t;
+
+/** The rates of the sensors. Sensors without a rule are read at the default rates of their collectors. */
+rate_rule_t rate_rules[MAX_RATE_RULES];
+
+/** The number of rate rules. */
+uint8_t nrate_rules = 0;
+
+/** How the IMUs filter their samples and sample in flight. Zeroed, the collectors' defaults are used. */
+clctr_imu_t imu_filter = {0};
+
+/** The sink which publishes data on the sensor message queue. */
+static sink_t mq_sink;
+static mq_sink_ctx_t mq_sink_ctx;
+
+/** The sink which prints data to stdout if print mode is selected. */
+static sink_t stdout_sink;
+static file_sink_ctx_t stdout_sink_ctx;
+
+/** The sink which publishes data to shared memory if shared memory mode is selected. */
+static sink_t shm_sink;
+static shm_sink_ctx_t shm_sink_ctx;
+
+/** The sink which logs data to a file if a log file is selected. */
+static sink_t file_sink;
+static file_sink_ctx_t file_sink_ctx;
+
+/** The sink which records data in the flight recorder if a recording directory is selected. */
+static sink_t recorder_sink;
+static recorder_sink_ctx_t recorder_sink_ctx;
+
+/** Whether the altitude fusion stage is enabled. */
+bool fusion_enabled = false;
+
+/** How the altitude fusion stage is set up. */
+fusion_config_t fusion_config = {
+    .axis = 2,
+    .invert = false,
+    .accel_sd = FUSION_DEFAULT_ACCEL_SD,
+    .baro_sd = FUSION_DEFAULT_BARO_SD,
+    .bias_sd = FUSION_DEFAULT_BIAS_SD,
+};
+
+/** The stage which fuses barometric altitude and vertical acceleration if fusion is enabled. */
+static stage_t fusion_stage;
+static fusion_stage_ctx_t fusion_stage_ctx;
+
+/** Whether the flight event detection stage is enabled. */
+bool events_enabled = false;
+
+/** How the flight event detection stage is set up. */
+events_config_t events_config = {
+    .axis = 2,
+    .invert = false,
+    .launch_accel = EVENTS_DEFAULT_LAUNCH_ACCEL,
+    .burnout_accel = EVENTS_DEFAULT_BURNOUT_ACCEL,
+    .hold_ms = EVENTS_DEFAULT_HOLD_MS,
+    .filter_ms = EVENTS_DEFAULT_FILTER_MS,
+    .apogee_vel = EVENTS_DEFAULT_APOGEE_VEL,
+    .apogee_drop = EVENTS_DEFAULT_APOGEE_DROP,
+};
+
+/** The stage which detects flight events if event detection is enabled. */
+static stage_t events_stage;
+static events_stage_ctx_t events_stage_ctx;
+
+/** Whether the flight phase stage is enabled. */
+bool phase_enabled = false;
+
+/** How the flight phase stage is set up. */
+phase_config_t phase_config = {
+    .arm_accel = PHASE_DEFAULT_ARM_ACCEL,
+    .disarm_ms = PHASE_DEFAULT_DISARM_MS,
+    .landed_alt = PHASE_DEFAULT_LANDED_ALT,
+    .landed_ms = PHASE_DEFAULT_LANDED_MS,
+};
+
+/** The stage which decides the phase of the flight if the flight phase stage is enabled. */
+static stage_t phase_stage;
+static phase_stage_ctx_t phase_stage_ctx;
+
+/** Whether the glitch rejection stage is enabled. */
+bool glitch_enabled = false;
+
+/** How the glitch rejection stage is set up. Without rules, the barometer and hygrometer streams are checked. */
+glitch_config_t glitch_config = {
+    .rules =
+        {
+            {.tag = TAG_PRESSURE, .median_len = 5, .median_dev = 5.0f, .max_slew = 100.0f},
+            {.tag = TAG_ALTITUDE_REL, .median_len = 5, .median_dev = 500.0f, .max_slew = 1000.0f},
+            {.tag = TAG_TEMPERATURE, .median_len = 5, .median_dev = 10.0f, .max_slew = 0},
+            {.tag = TAG_HUMIDITY, .median_len = 5, .median_dev = 20.0f, .max_slew = 0},
+        },
+    .nrules = 4,
+};
+
+/** The stage which rejects glitches if glitch rejection is enabled. */
+static stage_t glitch_stage;
+static glitch_stage_ctx_t glitch_stage_ctx;
+
+/** Whether the voting stage is enabled. */
+bool vote_enabled = false;
+
+/** How the voting stage is set up. Redundant sensors listed in the board ID are added as groups once known. */
+vote_config_t vote_config = {
+    .method = VOTE_MEDIAN,
+    .tags = {TAG_PRESSURE, TAG_ALTITUDE_REL, TAG_HUMIDITY, TAG_LINEAR_ACCEL_REL, TAG_ANGULAR_VEL},
+    .ntags = 5,
+    .stale_ms = VOTE_DEFAULT_STALE_MS,
+    .ngroups = 0,
+};
+
+_Static_assert(MAX_ADDR_PER_SENSOR <= VOTE_MAX_MEMBERS, "Every address of a sensor must fit in its voting group");
+
+/** The stage which votes on the streams of redundant sensors if voting is enabled. */
+static stage_t vote_stage;
+static vote_stage_ctx_t vote_stage_ctx;
+
+/** Whether the statistics stage is enabled. */
+bool stats_enabled = false;
+
+/** How the statistics stage is set up. Without rules, the IMU streams and voltages are summarized. */
+stats_config_t stats_config = {
+    .rules =
+        {
+            {.tag = TAG_LINEAR_ACCEL_REL, .window_ms = STATS_DEFAULT_WINDOW_MS},
+            {.tag = TAG_ANGULAR_VEL, .window_ms = STATS_DEFAULT_WINDOW_MS},
+            {.tag = TAG_VOLTAGE, .window_ms = STATS_DEFAULT_WINDOW_MS},
+        },
+    .nrules = 3,
+    .interval_ms = STATS_DEFAULT_INTERVAL_MS,
+};
+
+/** The stage which keeps rolling statistics of streams if statistics are enabled. */
+static stage_t stats_stage;
+static stats_stage_ctx_t stats_stage_ctx;
+
+/** Whether the resampling stage is enabled. */
+bool resample_enabled = false;
+
+/** How the resampling stage is set up. Without fields, the flight state and the environment are resampled. */
+resample_config_t resample_config = {
+    .fields =
+        {
+            {.tag = TAG_ALTITUDE_FUSED, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_VERTICAL_VEL, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_ALTITUDE_REL, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_PRESSURE, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_TEMPERATURE, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_HUMIDITY, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_LINEAR_ACCEL_REL, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_ANGULAR_VEL, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_LINEAR},
+            {.tag = TAG_COORDS, .source = RESAMPLE_ANY_SOURCE, .method = RESAMPLE_HOLD},
+        },
+    .nfields = 9,
+    .rate_hz = RESAMPLE_DEFAULT_RATE,
+    .delay_ms = RESAMPLE_DEFAULT_DELAY_MS,
+};
+
+/** The stage which resamples streams onto a common time grid if resampling is enabled. */
+static stage_t resample_stage;
+static resample_stage_ctx_t resample_stage_ctx;
+
+/** Whether the decimation stage is enabled. */
+bool decim_enabled = false;
+
+/** How the decimation stage is set up. Without rules, the IMU streams are decimated by the default factor. */
+decim_config_t decim_config = {
+    .rules =
+        {
+            {.tag = TAG_LINEAR_ACCEL_REL, .filter = DECIM_FIR, .factor = DECIM_DEFAULT_FACTOR, .order = 0},
+            {.tag = TAG_ANGULAR_VEL, .filter = DECIM_FIR, .factor = DECIM_DEFAULT_FACTOR, .order = 0},
+        },
+    .nrules = 2,
+};
+
+/** The stage which decimates streams for the message queue, shared memory and stdout if decimation is enabled. */
+static stage_t decim_stage;
+static decim_stage_ctx_t decim_stage_ctx;
+
+/** The path of the recording segment to replay, or null to acquire data from the sensors. */
+char *replay_path = NULL;
+
+/** How many times faster than recorded to replay, or REPLAY_MAX_SPEED for as fast as possible. */
+double replay_speed = 1;
+
+/** Identifiers of the options which only have a long form. */
+enum {
+    OPT_REPLAY = 256,
+    OPT_SPEED,
+    OPT_FUSION,
+    OPT_EVENTS,
+    OPT_PHASE,
+    OPT_DECIMATE,
+    OPT_STATS,
+    OPT_GLITCH,
+    OPT_VOTE,
+    OPT_RESAMPLE,
+    OPT_ENGINE,
+    OPT_SCHED,
+    OPT_MLOCK,
+    OPT_RATES,
+    OPT_RATE_FILE,
+    OPT_IMU_FILTER,
+};
+
+/** The options which only have a long form. */
+static const struct option LONG_OPTIONS[] = {
+    {.name = "replay", .has_arg = required_argument, .flag = NULL, .val = OPT_REPLAY},
+    {.name = "speed", .has_arg = required_argument, .flag = NULL, .val = OPT_SPEED},
+    {.name = "fusion", .has_arg = optional_argument, .flag = NULL, .val = OPT_FUSION},
+    {.name = "events", .has_arg = optional_argument, .flag = NULL, .val = OPT_EVENTS},
+    {.name = "phase", .has_arg = optional_argument, .flag = NULL, .val = OPT_PHASE},
+    {.name = "decimate", .has_arg = optional_argument, .flag = NULL, .val = OPT_DECIMATE},
+    {.name = "stats", .has_arg = optional_argument, .flag = NULL, .val = OPT_STATS},
+    {.name = "glitch", .has_arg = optional_argument, .flag = NULL, .val = OPT_GLITCH},
+    {.name = "vote", .has_arg = optional_argument, .flag = NULL, .val = OPT_VOTE},
+    {.name = "resample", .has_arg = optional_argument, .flag = NULL, .val = OPT_RESAMPLE},
+    {.name = "engine", .has_arg = required_argument, .flag = NULL, .val = OPT_ENGINE},
+    {.name = "sched", .has_arg = required_argument, .flag = NULL, .val = OPT_SCHED},
+    {.name = "mlock", .has_arg = no_argument, .flag = NULL, .val = OPT_MLOCK},
+    {.name = "rates", .has_arg = required_argument, .flag = NULL, .val = OPT_RATES},
+    {.name = "rate-file", .has_arg = required_argument, .flag = NULL, .val = OPT_RATE_FILE},
+    {.name = "imu-filter", .has_arg = required_argument, .flag = NULL, .val = OPT_IMU_FILTER},
+    {0},
+};
 
 /** Device descriptor of the I2C bus. */
 char *i2c_bus = NULL;
@@ -60,20 +352,870 @@ char *i2c_bus = NULL;
 /** A buffer for the contents of the board ID EEPROM. */
 char board_id[M24C02_CAP + 1] = {0};
 
+/**
+ * Parses the comma separated sub-options of the flight recorder (like `segment_mb=64,sync_ms=100`) into `rec_config`.
+ * @param opts The sub-options. Modified while parsing.
+ * @return True if all the sub-options were valid, false otherwise.
+ */
+static bool parse_recorder_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(opt, '=');
+        if (value == NULL) return false;
+        *value++ = '\0';
+
+        char *end;
+        unsigned long num = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0') return false;
+
+        if (!strcmp(opt, "segment_mb")) {
+            if (num == 0 || num > UINT32_MAX / (1024 * 1024)) return false;
+            rec_config.segment_len = (uint32_t)num * 1024 * 1024;
+        } else if (!strcmp(opt, "sync_ms")) {
+            if (num > UINT32_MAX) return false;
+            rec_config.sync_ms = (uint32_t)num;
+        } else if (!strcmp(opt, "sync_kb")) {
+            if (num > UINT32_MAX / 1024) return false;
+            rec_config.sync_bytes = (uint32_t)num * 1024;
+        } else if (!strcmp(opt, "index_ms")) {
+            if (num > UINT32_MAX) return false;
+            rec_config.index_ms = (uint32_t)num;
+        } else if (!strcmp(opt, "packed")) {
+            if (num > 1) return false;
+            rec_config.encoding = num ? REC_ENCODING_PACKED : REC_ENCODING_RAW;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parses an accelerometer axis along the rocket, like `z` or `-x`.
+ * @param value The axis, with an optional sign for whether it points towards the nose (+) or the tail (-).
+ * @param axis Where to store the index of the axis: 0 for x, 1 for y or 2 for z.
+ * @param invert Where to store whether the axis points towards the tail.
+ * @return True if the axis was valid, false otherwise.
+ */
+static bool parse_axis(const char *value, uint8_t *axis, bool *invert) {
+    *invert = *value == '-';
+    if (*value == '-' || *value == '+') value++;
+    if (value[0] < 'x' || value[0] > 'z' || value[1] != '\0') return false;
+    *axis = (uint8_t)(value[0] - 'x');
+    return true;
+}
+
+/**
+ * Parses the comma separated sub-options of the altitude fusion stage (like `axis=-x,baro_sd=0.3`) into
+ * `fusion_config`.
+ * @param opts The sub-options. Modified while parsing.
+ * @return True if all the sub-options were valid, false otherwise.
+ */
+static bool parse_fusion_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(opt, '=');
+        if (value == NULL) return false;
+        *value++ = '\0';
+
+        if (!strcmp(opt, "axis")) {
+            if (!parse_axis(value, &fusion_config.axis, &fusion_config.invert)) return false;
+            continue;
+        }
+
+        char *end;
+        float num = strtof(value, &end);
+        if (*value == '\0' || *end != '\0' || !(num > 0)) return false;
+
+        if (!strcmp(opt, "accel_sd")) {
+            fusion_config.accel_sd = num;
+        } else if (!strcmp(opt, "baro_sd")) {
+            fusion_config.baro_sd = num;
+        } else if (!strcmp(opt, "bias_sd")) {
+            fusion_config.bias_sd = num;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parses the comma separated sub-options of the flight event detection stage (like `axis=-x,launch_accel=40`) into
+ * `events_config`.
+ * @param opts The sub-options. Modified while parsing.
+ * @return True if all the sub-options were valid, false otherwise.
+ */
+static bool parse_events_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(opt, '=');
+        if (value == NULL) return false;
+        *value++ = '\0';
+
+        if (!strcmp(opt, "axis")) {
+            if (!parse_axis(value, &events_config.axis, &events_config.invert)) return false;
+            continue;
+        }
+
+        char *end;
+        uint32_t *ms = NULL;
+        if (!strcmp(opt, "hold_ms")) {
+            ms = &events_config.hold_ms;
+        } else if (!strcmp(opt, "filter_ms")) {
+            ms = &events_config.filter_ms;
+        }
+        if (ms != NULL) {
+            unsigned long num = strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || num > UINT32_MAX) return false;
+            *ms = (uint32_t)num;
+            continue;
+        }
+
+        float num = strtof(value, &end);
+        if (*value == '\0' || *end != '\0' || !(num > 0)) return false;
+
+        if (!strcmp(opt, "launch_accel")) {
+            events_config.launch_accel = num;
+        } else if (!strcmp(opt, "burnout_accel")) {
+            events_config.burnout_accel = num;
+        } else if (!strcmp(opt, "apogee_vel")) {
+            events_config.apogee_vel = num;
+        } else if (!strcmp(opt, "apogee_drop")) {
+            events_config.apogee_drop = num;
+        } else {
+            return false;
+        }
+    }
+    return events_config.burnout_accel < events_config.launch_accel;
+}
+
+/**
+ * Parses the comma separated sub-options of the flight phase stage (like `arm_accel=3,landed_ms=5000`) into
+ * `phase_config`.
+ * @param opts The sub-options. Modified while parsing.
+ * @return True if all the sub-options were valid, false otherwise.
+ */
+static bool parse_phase_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(opt, '=');
+        if (value == NULL) return false;
+        *value++ = '\0';
+
+        char *end;
+        uint32_t *ms = NULL;
+        if (!strcmp(opt, "disarm_ms")) {
+            ms = &phase_config.disarm_ms;
+        } else if (!strcmp(opt, "landed_ms")) {
+            ms = &phase_config.landed_ms;
+        }
+        if (ms != NULL) {
+            unsigned long num = strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || num > UINT32_MAX) return false;
+            *ms = (uint32_t)num;
+            continue;
+        }
+
+        float num = strtof(value, &end);
+        if (*value == '\0' || *end != '\0' || !(num > 0)) return false;
+
+        if (!strcmp(opt, "arm_accel")) {
+            phase_config.arm_accel = num;
+        } else if (!strcmp(opt, "landed_alt")) {
+            phase_config.landed_alt = num;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parses the comma separated rules of the decimation stage (like `7:fir:10,0x6:cic:8:4`) into `decim_config`. Each rule
+ * is a tag, a filter, a decimation factor and optionally the number of FIR taps or CIC stages, separated by colons.
+ * @param opts The rules. Modified while parsing.
+ * @return True if all the rules were valid, false otherwise.
+ */
+static bool parse_decim_opts(char *opts) {
+    char *save;
+    decim_config.nrules = 0;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        if (decim_config.nrules == DECIM_MAX_RULES) return false;
+        decim_rule_t *rule = &decim_config.rules[decim_config.nrules++];
+
+        char *end;
+        unsigned long tag = strtoul(opt, &end, 0);
+        if (end == opt || *end != ':' || tag >= SENSOR_TAG_COUNT) return false;
+        rule->tag = (uint8_t)tag;
+
+        char *filter = end + 1;
+        if (!strncmp(filter, "fir:", 4)) {
+            rule->filter = DECIM_FIR;
+        } else if (!strncmp(filter, "cic:", 4)) {
+            rule->filter = DECIM_CIC;
+        } else {
+            return false;
+        }
+
+        char *value = filter + 4;
+        unsigned long factor = strtoul(value, &end, 10);
+        if (end == value || factor > UINT16_MAX || (*end != '\0' && *end != ':')) return false;
+        rule->factor = (uint16_t)factor;
+        rule->order = 0;
+        if (*end == '\0') continue;
+
+        value = end + 1;
+        unsigned long order = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || order == 0 || order > UINT16_MAX) return false;
+        rule->order = (uint16_t)order;
+    }
+    return decim_config.nrules > 0;
+}
+
+/**
+ * Parses the comma separated options of the statistics stage (like `7:500,0xa:2000,interval_ms=250`) into
+ * `stats_config`. Each rule is a tag and the length of its window in ms, separated by a colon. If any rules are given,
+ * they replace the default ones.
+ * @param opts The options. Modified while parsing.
+ * @return True if all the options were valid, false otherwise.
+ */
+static bool parse_stats_opts(char *opts) {
+    char *save;
+    bool has_rules = false;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *end;
+        if (!strncmp(opt, "interval_ms=", 12)) {
+            char *value = opt + 12;
+            unsigned long interval = strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || interval == 0 || interval > UINT32_MAX) return false;
+            stats_config.interval_ms = (uint32_t)interval;
+            continue;
+        }
+
+        if (!has_rules) stats_config.nrules = 0;
+        has_rules = true;
+        if (stats_config.nrules == STATS_MAX_RULES) return false;
+        stats_rule_t *rule = &stats_config.rules[stats_config.nrules++];
+
+        unsigned long tag = strtoul(opt, &end, 0);
+        if (end == opt || *end != ':' || tag >= SENSOR_TAG_COUNT) return false;
+        rule->tag = (uint8_t)tag;
+
+        char *value = end + 1;
+        unsigned long window = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || window == 0 || window > UINT32_MAX) return false;
+        rule->window_ms = (uint32_t)window;
+    }
+    return true;
+}
+
+/**
+ * Parses the comma separated rules of the glitch rejection stage (like `1:5:2.5:100,0x2`) into `glitch_config`. Each
+ * rule is a tag, optionally followed by the length of the running median and the largest distance from it, then
+ * optionally the largest slew rate, separated by colons.
+ * @param opts The rules. Modified while parsing.
+ * @return True if all the rules were valid, false otherwise.
+ */
+static bool parse_glitch_opts(char *opts) {
+    char *save;
+    glitch_config.nrules = 0;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        if (glitch_config.nrules == GLITCH_MAX_RULES) return false;
+        glitch_rule_t *rule = &glitch_config.rules[glitch_config.nrules++];
+        memset(rule, 0, sizeof(*rule));
+
+        char *end;
+        unsigned long tag = strtoul(opt, &end, 0);
+        if (end == opt || (*end != '\0' && *end != ':') || tag >= SENSOR_TAG_COUNT) return false;
+        rule->tag = (uint8_t)tag;
+        if (*end == '\0') continue;
+
+        char *value = end + 1;
+        unsigned long len = strtoul(value, &end, 10);
+        if (end == value || *end != ':' || len > GLITCH_MAX_MEDIAN) return false;
+        rule->median_len = (uint8_t)len;
+
+        value = end + 1;
+        rule->median_dev = strtof(value, &end);
+        if (end == value || (*end != '\0' && *end != ':')) return false;
+        if (*end == '\0') continue;
+
+        value = end + 1;
+        rule->max_slew = strtof(value, &end);
+        if (end == value || *end != '\0') return false;
+    }
+    return glitch_config.nrules > 0;
+}
+
+/**
+ * Parses a list of numbers separated by plus signs (like `0+1+0x2`).
+ * @param list The list.
+ * @param nums Where to store the numbers.
+ * @param max The most numbers the list may hold.
+ * @param limit The numbers must be below this limit.
+ * @return The number of numbers in the list, or 0 if the list is invalid.
+ */
+static uint8_t parse_num_list(char *list, uint8_t *nums, uint8_t max, unsigned long limit) {
+    uint8_t n = 0;
+    for (char *cur = list;; cur++) {
+        char *end;
+        unsigned long num = strtoul(cur, &end, 0);
+        if (end == cur || num >= limit || n == max) return 0;
+        nums[n++] = (uint8_t)num;
+        if (*end == '\0') return n;
+        if (*end != '+') return 0;
+        cur = end;
+    }
+}
+
+/**
+ * Parses the comma separated options of the voting stage (like `method=weighted,tags=1+7,group=0+1`) into
+ * `vote_config`.
+ * @param opts The options. Modified while parsing.
+ * @return True if all the options were valid, false otherwise.
+ */
+static bool parse_vote_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(opt, '=');
+        if (value == NULL) return false;
+        *value++ = '\0';
+
+        if (!strcmp(opt, "method")) {
+            if (!strcmp(value, "median")) {
+                vote_config.method = VOTE_MEDIAN;
+            } else if (!strcmp(value, "weighted")) {
+                vote_config.method = VOTE_WEIGHTED;
+            } else {
+                return false;
+            }
+        } else if (!strcmp(opt, "tags")) {
+            vote_config.ntags = parse_num_list(value, vote_config.tags, VOTE_MAX_TAGS, SENSOR_TAG_COUNT);
+            if (vote_config.ntags == 0) return false;
+        } else if (!strcmp(opt, "group")) {
+            if (vote_config.ngroups == VOTE_MAX_GROUPS) return false;
+            vote_group_t *group = &vote_config.groups[vote_config.ngroups++];
+            group->n = parse_num_list(value, group->sources, VOTE_MAX_MEMBERS, UINT8_MAX + 1);
+            if (group->n < 2) return false;
+        } else if (!strcmp(opt, "stale_ms")) {
+            char *end;
+            unsigned long ms = strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || ms == 0 || ms > UINT32_MAX) return false;
+            vote_config.stale_ms = (uint32_t)ms;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Parses the comma separated options of the resampling stage (like `rate=50,delay_ms=20,7,9:hold,0xa:linear:1`) into
+ * `resample_config`. Each field is a tag, optionally followed by how it is resampled (`linear` or `hold`) and then by
+ * the ID of its stream, separated by colons. If any fields are given, they replace the default ones.
+ * @param opts The options. Modified while parsing.
+ * @return True if all the options were valid, false otherwise.
+ */
+static bool parse_resample_opts(char *opts) {
+    char *save;
+    bool has_fields = false;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *end;
+        if (!strncmp(opt, "rate=", 5)) {
+            char *value = opt + 5;
+            unsigned long rate = strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || rate == 0 || rate > UINT16_MAX) return false;
+            resample_config.rate_hz = (uint16_t)rate;
+            continue;
+        }
+        if (!strncmp(opt, "delay_ms=", 9)) {
+            char *value = opt + 9;
+            unsigned long delay = strtoul(value, &end, 10);
+            if (*value == '\0' || *end != '\0' || delay > UINT32_MAX) return false;
+            resample_config.delay_ms = (uint32_t)delay;
+            continue;
+        }
+
+        if (!has_fields) resample_config.nfields = 0;
+        has_fields = true;
+        if (resample_config.nfields == RESAMPLE_MAX_FIELDS) return false;
+        resample_field_t *field = &resample_config.fields[resample_config.nfields++];
+        memset(field, 0, sizeof(*field));
+        field->source = RESAMPLE_ANY_SOURCE;
+
+        unsigned long tag = strtoul(opt, &end, 0);
+        if (end == opt || (*end != '\0' && *end != ':') || tag >= SENSOR_TAG_COUNT) return false;
+        field->tag = (uint8_t)tag;
+        SensorTagDType dtype = SENSOR_TAG_DATA[tag].dtype;
+        bool floats = dtype == TYPE_FLOAT || dtype == TYPE_VEC2D || dtype == TYPE_VEC3D;
+        field->method = floats ? RESAMPLE_LINEAR : RESAMPLE_HOLD;
+        if (*end == '\0') continue;
+
+        char *method = end + 1;
+        if (!strncmp(method, "linear", 6)) {
+            field->method = RESAMPLE_LINEAR;
+            end = method + 6;
+        } else if (!strncmp(method, "hold", 4)) {
+            field->method = RESAMPLE_HOLD;
+            end = method + 4;
+        } else {
+            return false;
+        }
+        if (*end == '\0') continue;
+        if (*end != ':') return false;
+
+        char *value = end + 1;
+        unsigned long id = strtoul(value, &end, 0);
+        if (*value == '\0' || *end != '\0' || id > UINT8_MAX) return false;
+        field->id = (uint8_t)id;
+    }
+    return true;
+}
+
+/**
+ * Parses the comma separated scheduling rules of fetcher's threads (like `lsm6dso32=fifo:40@1,dispatcher=rr:30`) into
+ * `sched_rules`. Each rule is the name of a thread, then a scheduling policy (`fifo`, `rr` or `other`) and a priority
+ * separated by a colon, then optionally the CPUs the thread may run on after an `@`, separated by plus signs. Either
+ * the policy or the CPUs may be left out.
+ * @param opts The rules. Modified while parsing.
+ * @return True if all the rules were valid, false otherwise.
+ */
+static bool parse_sched_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *spec = strchr(opt, '=');
+        if (spec == NULL || nsched_rules == MAX_SCHED_RULES) return false;
+        *spec++ = '\0';
+        sched_rule_t *rule = &sched_rules[nsched_rules++];
+        memset(rule, 0, sizeof(*rule));
+        rule->thread = opt;
+
+        char *cpus = strchr(spec, '@');
+        if (cpus != NULL) {
+            *cpus++ = '\0';
+            uint8_t list[MAX_CPUS];
+            uint8_t n = parse_num_list(cpus, list, MAX_CPUS, MAX_CPUS);
+            if (n == 0) return false;
+            for (uint8_t i = 0; i < n; i++) {
+                rule->config.cpus |= 1u << list[i];
+            }
+        }
+        if (*spec == '\0') {
+            if (cpus == NULL) return false;
+            continue;
+        }
+
+        char *priority = strchr(spec, ':');
+        if (priority == NULL) return false;
+        *priority++ = '\0';
+        if (!strcmp(spec, "fifo")) {
+            rule->config.policy = SCHED_FIFO;
+        } else if (!strcmp(spec, "rr")) {
+            rule->config.policy = SCHED_RR;
+        } else if (!strcmp(spec, "other")) {
+            rule->config.policy = SCHED_OTHER;
+        } else {
+            return false;
+        }
+
+        char *end;
+        long prio = strtol(priority, &end, 10);
+        if (*priority == '\0' || *end != '\0' || prio < sched_get_priority_min(rule->config.policy) ||
+            prio > sched_get_priority_max(rule->config.policy)) {
+            return false;
+        }
+        rule->config.scheduled = true;
+        rule->config.priority = (int)prio;
+    }
+    return true;
+}
+
+/**
+ * Finds how a thread of fetcher is scheduled.
+ * @param thread The name of the thread, ignoring case.
+ * @return The scheduling of the thread, or NULL if it keeps the scheduling it inherits.
+ */
+static const rt_config_t *sched_search(const char *thread) {
+    for (uint8_t i = 0; i < nsched_rules; i++) {
+        if (!strcasecmp(sched_rules[i].thread, thread)) return &sched_rules[i].config;
+    }
+    return NULL;
+}
+
+/**
+ * Selects how the writer thread of a sink is scheduled, if a rule was given for it.
+ * @param sink The sink, whose name selects the rule.
+ */
+static void set_sink_sched(sink_t *sink) {
+    const rt_config_t *sched = sched_search(sink->name);
+    if (sched != NULL) sink->sched = *sched;
+}
+
+/**
+ * Finds the rates of a kind of sensor.
+ * @param sensor The name of the sensor, ignoring case.
+ * @return The rates of the sensor, or NULL if it is read at the default rates of its collector.
+ */
+static clctr_rates_t *rates_search(const char *sensor) {
+    for (uint8_t i = 0; i < nrate_rules; i++) {
+        if (!strcasecmp(rate_rules[i].sensor, sensor)) return &rate_rules[i].rates;
+    }
+    return NULL;
+}
+
+/**
+ * Parses the comma separated rate rules of the sensors (like `sht41=2,lsm6dso32:1/100,ms5611:0x1/10`). A rule is
+ * either the name of a sensor and the rate it is read at in Hz, separated by `=`, or the name of a sensor, a tag and a
+ * divider `n` separated by `:` and `/`, which publishes only one of every `n` readings of the tag. Later rules for the
+ * same sensor and tag override earlier ones.
+ * @param opts The rules. Modified while parsing.
+ * @return True if all the rules were valid, false otherwise.
+ */
+static bool parse_rate_opts(char *opts) {
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *spec = opt + strcspn(opt, "=:");
+        if (*spec == '\0') return false;
+        char kind = *spec;
+        *spec++ = '\0';
+        if (strlen(opt) >= MAX_SENSOR_NAME || collector_search(opt) == NULL) return false;
+
+        clctr_rates_t *rates = rates_search(opt);
+        if (rates == NULL) {
+            if (nrate_rules == MAX_RATE_RULES) return false;
+            rate_rule_t *rule = &rate_rules[nrate_rules++];
+            memset(rule, 0, sizeof(*rule));
+            strcpy(rule->sensor, opt);
+            rates = &rule->rates;
+        }
+
+        char *end;
+        if (kind == '=') {
+            double hz = strtod(spec, &end);
+            if (end == spec || *end != '\0' || !(hz > 0)) return false;
+            double period = 1000000 / hz;
+            if (period < 1 || period > UINT32_MAX) return false;
+            rates->period_us = (uint32_t)period;
+            continue;
+        }
+
+        unsigned long tag = strtoul(spec, &end, 0);
+        if (end == spec || *end != '/' || tag >= SENSOR_TAG_COUNT) return false;
+        char *value = end + 1;
+        unsigned long n = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0' || n == 0 || n > UINT16_MAX) return false;
+
+        clctr_divider_t *divider = NULL;
+        for (uint8_t i = 0; i < rates->ndividers; i++) {
+            if (rates->dividers[i].tag == tag) divider = &rates->dividers[i];
+        }
+        if (divider == NULL) {
+            if (rates->ndividers == CLCTR_MAX_DIVIDERS) return false;
+            divider = &rates->dividers[rates->ndividers++];
+        }
+        *divider = (clctr_divider_t){.tag = (uint8_t)tag, .n = (uint16_t)n};
+    }
+    return true;
+}
+
+/**
+ * Reads the rate rules of the sensors from a file, which holds rules like those of `--rates`, one or more per line.
+ * Empty lines and everything after a `#` are ignored.
+ * @param path The path of the file.
+ * @return EOK if successful, EINVAL if a rule was invalid, otherwise the error from reading the file.
+ */
+static int read_rate_file(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return errno;
+
+    char line[BUFFER_SIZE];
+    unsigned lineno = 0;
+    int err = EOK;
+    while (err == EOK && fgets(line, sizeof(line), file) != NULL) {
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+
+        // Drop the spaces around and between the rules
+        char *end = line;
+        for (char *cur = line; *cur != '\0'; cur++) {
+            if (*cur != ' ' && *cur != '\t') *end++ = *cur;
+        }
+        *end = '\0';
+
+        if (line[0] != '\0' && !parse_rate_opts(line)) {
+            log_print(stderr, LOG_ERROR, "Invalid rate rule on line %u of '%s'", lineno, path);
+            err = EINVAL;
+        }
+    }
+    if (err == EOK && ferror(file)) err = EIO;
+    fclose(file);
+    return err;
+}
+
+/**
+ * Checks whether a value is one of a list of allowed values.
+ * @param value The value.
+ * @param allowed The allowed values.
+ * @param n The number of allowed values.
+ * @return True if the value is allowed, false otherwise.
+ */
+static bool is_one_of(unsigned long value, const uint16_t *allowed, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (value == allowed[i]) return true;
+    }
+    return false;
+}
+
+/**
+ * Parses the comma separated sub-options of the IMU's digital filters (like `odr=833,accel_lpf=4`) into `imu_filter`.
+ * @param opts The sub-options. Modified while parsing.
+ * @return True if all the sub-options were valid, false otherwise.
+ */
+static bool parse_imu_filter_opts(char *opts) {
+    static const uint16_t ODRS[] = {26, 52, 104, 208, 416, 833, 1666, 3332, 6664};
+    static const uint16_t DIVISORS[] = {4, 10, 20, 45, 100, 200, 400, 800};
+    static const uint16_t GYRO_HPFS[] = {16, 65, 260, 1040};
+
+    char *save;
+    for (char *opt = strtok_r(opts, ",", &save); opt != NULL; opt = strtok_r(NULL, ",", &save)) {
+        char *value = strchr(opt, '=');
+        if (value == NULL) return false;
+        *value++ = '\0';
+
+        char *end;
+        unsigned long num = strtoul(value, &end, 10);
+        if (*value == '\0' || *end != '\0') return false;
+
+        if (!strcmp(opt, "odr")) {
+            if (!is_one_of(num, ODRS, sizeof(ODRS) / sizeof(ODRS[0]))) return false;
+            imu_filter.odr_hz = (uint16_t)num;
+        } else if (!strcmp(opt, "accel_lpf")) {
+            if (!is_one_of(num, DIVISORS, sizeof(DIVISORS) / sizeof(DIVISORS[0]))) return false;
+            imu_filter.accel_lpf = (uint16_t)num;
+        } else if (!strcmp(opt, "accel_hpf")) {
+            if (!is_one_of(num, DIVISORS, sizeof(DIVISORS) / sizeof(DIVISORS[0]))) return false;
+            imu_filter.accel_hpf = (uint16_t)num;
+        } else if (!strcmp(opt, "gyro_lpf")) {
+            if (num > 7) return false;
+            imu_filter.gyro_lpf_on = true;
+            imu_filter.gyro_lpf = (uint8_t)num;
+        } else if (!strcmp(opt, "gyro_hpf")) {
+            if (!is_one_of(num, GYRO_HPFS, sizeof(GYRO_HPFS) / sizeof(GYRO_HPFS[0]))) return false;
+            imu_filter.gyro_hpf = (uint16_t)num;
+        } else {
+            return false;
+        }
+    }
+
+    // LPF2 and the high-pass filter are alternative paths
+    return imu_filter.accel_lpf == 0 || imu_filter.accel_hpf == 0;
+}
+
+/**
+ * Thread which schedules itself as selected for its sensor, then runs the sensor's collector. The wake-up latency of
+ * the collector's sleeps is measured for the periodic reports.
+ * @param arg The arguments of the collector in `collector_args`.
+ * @return What the collector returned.
+ */
+static void *collector_thread(void *arg) {
+    uint8_t i = (uint8_t)((collector_args_t *)arg - collector_args);
+
+    const rt_config_t *sched = sched_search(collector_names[i]);
+    if (sched != NULL) {
+        int err = rt_apply(sched);
+        if (err != EOK) {
+            log_print(stderr, LOG_WARN, "Could not schedule the %s collector: %s", collector_names[i], strerror(err));
+        }
+    }
+    int err = rt_register(collector_names[i]);
+    if (err != EOK) {
+        log_print(stderr, LOG_WARN, "Cannot measure the wake-up latency of the %s collector: %s", collector_names[i],
+                  strerror(err));
+    }
+
+    void *ret = collectors[i](arg);
+    atomic_fetch_sub(&running_collectors, 1);
+    return ret;
+}
+
+/**
+ * Starts a collector, in its own thread or as a task of the acquisition engine, at the rates selected for its sensor
+ * and with the IMU filters.
+ * @param sensor_name The name of the sensor to collect data from.
+ * @param i The index of the collector, which must already have its location and index in `collector_args`.
+ * @return EOK if successful, ENOSYS if the sensor has no collector, otherwise the error which occurred.
+ */
+static int start_collector(const char *sensor_name, uint8_t i) {
+    const clctr_rates_t *rates = rates_search(sensor_name);
+    if (rates != NULL) collector_args[i].rates = *rates;
+    collector_args[i].imu = imu_filter;
+
+    if (engine_loop) {
+        collector_task_t task_init = collector_task_search(sensor_name);
+        if (task_init == NULL) return ENOSYS;
+        task_t *task = task_init(&collector_args[i]);
+        if (task == NULL) return ENOSPC;
+        startup_begin(i, sensor_name);
+        return engine_add(task);
+    }
+
+    collector_t collector = collector_search(sensor_name);
+    if (collector == NULL) return ENOSYS;
+    collectors[i] = collector;
+    strncpy(collector_names[i], sensor_name, MAX_SENSOR_NAME - 1);
+    atomic_fetch_add(&running_collectors, 1);
+    startup_begin(i, sensor_name);
+    int err = pthread_create(&collector_threads[i], NULL, collector_thread, &collector_args[i]);
+    if (err != EOK) atomic_fetch_sub(&running_collectors, 1);
+    return err;
+}
+
 int main(int argc, char **argv) {
 
+    startup_init(); // The boot timeline counts from here
+
     int c; // Holder for choice
     opterr = 0;
 
     /* Get command line options. */
-    while ((c = getopt(argc, argv, ":ps:")) != -1) {
+    while ((c = getopt_long(argc, argv, ":pml:o:r:R:s:", LONG_OPTIONS, NULL)) != -1) {
         switch (c) {
         case 'p':
             print_output = true;
             break;
+        case 'm':
+            shm_output = true;
+            break;
+        case 'l':
+            log_file = optarg;
+            break;
+        case 'o':
+            output_format = optarg;
+            break;
+        case 'r':
+            rec_config.dir = optarg;
+            break;
+        case 'R':
+            if (!parse_recorder_opts(optarg)) {
+                fprintf(stderr, "Invalid recorder options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         case 's':
             select_sensor = optarg;
             break;
+        case OPT_REPLAY:
+            replay_path = optarg;
+            break;
+        case OPT_SPEED:
+            if (!strcasecmp(optarg, "max")) {
+                replay_speed = REPLAY_MAX_SPEED;
+            } else {
+                char *end;
+                replay_speed = strtod(optarg, &end);
+                if (*end != '\0' || !(replay_speed > 0)) {
+                    fprintf(stderr, "Replay speed must be a positive number or 'max'.\n");
+                    exit(EXIT_FAILURE);
+                }
+            }
+            break;
+        case OPT_FUSION:
+            fusion_enabled = true;
+            if (optarg != NULL && !parse_fusion_opts(optarg)) {
+                fprintf(stderr, "Invalid fusion options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_EVENTS:
+            events_enabled = true;
+            if (optarg != NULL && !parse_events_opts(optarg)) {
+                fprintf(stderr, "Invalid event options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_PHASE:
+            phase_enabled = true;
+            events_enabled = true; // Launch, burnout and apogee start the flight phases
+            if (optarg != NULL && !parse_phase_opts(optarg)) {
+                fprintf(stderr, "Invalid flight phase options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_DECIMATE:
+            decim_enabled = true;
+            if (optarg != NULL && !parse_decim_opts(optarg)) {
+                fprintf(stderr, "Invalid decimation rules. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_GLITCH:
+            glitch_enabled = true;
+            if (optarg != NULL && !parse_glitch_opts(optarg)) {
+                fprintf(stderr, "Invalid glitch rules. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_VOTE:
+            vote_enabled = true;
+            if (optarg != NULL && !parse_vote_opts(optarg)) {
+                fprintf(stderr, "Invalid voting options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_RESAMPLE:
+            resample_enabled = true;
+            if (optarg != NULL && !parse_resample_opts(optarg)) {
+                fprintf(stderr, "Invalid resampling options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_STATS:
+            stats_enabled = true;
+            if (optarg != NULL && !parse_stats_opts(optarg)) {
+                fprintf(stderr, "Invalid statistics options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_ENGINE:
+            if (!strcasecmp(optarg, "loop")) {
+                engine_loop = true;
+            } else if (!strcasecmp(optarg, "threads")) {
+                engine_loop = false;
+            } else {
+                fprintf(stderr, "Engine must be 'threads' or 'loop'.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_SCHED:
+            if (!parse_sched_opts(optarg)) {
+                fprintf(stderr, "Invalid scheduling rules. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_MLOCK:
+            lock_memory = true;
+            break;
+        case OPT_RATES:
+            if (!parse_rate_opts(optarg)) {
+                fprintf(stderr, "Invalid rate rules. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case OPT_RATE_FILE: {
+            int err = read_rate_file(optarg);
+            if (err != EOK) {
+                fprintf(stderr, "Could not read rate file '%s': %s\n", optarg, strerror(err));
+                exit(EXIT_FAILURE);
+            }
+            break;
+        }
+        case OPT_IMU_FILTER:
+            if (!parse_imu_filter_opts(optarg)) {
+                fprintf(stderr, "Invalid IMU filter options. Please check 'use fetcher' to see example usage.\n");
+                exit(EXIT_FAILURE);
+            }
+            break;
         case ':':
             fprintf(stderr, "Option -%c requires an argument.\n", optopt);
             exit(EXIT_FAILURE);
@@ -86,38 +1228,218 @@ int main(int argc, char **argv) {
         }
     }
 
-    /* Positional argument for device descriptor. */
-    if (optind >= argc) {
+    /* Positional argument for device descriptor, which is not needed when replaying a recording. */
+    if (optind >= argc && replay_path == NULL) {
         fprintf(stderr, "I2C bus device descriptor is required.\n");
         exit(EXIT_FAILURE);
     }
     i2c_bus = argv[optind];
 
+    const fmt_entry_t *fmt = fmt_search(output_format);
+    if (fmt == NULL) {
+        fprintf(stderr, "Unknown output format '%s'.\n", output_format);
+        exit(EXIT_FAILURE);
+    }
+
+    /* Lock memory before any thread starts, so that none of them ever waits for a page fault. */
+    if (lock_memory) {
+        int err = rt_lock_memory();
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not lock memory: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
     /*
-     * Open/create the message queue.
-     * Main thread can only read incoming messages from sensors.
-     * Other threads (collectors) can only write.
+     * Set up the pipeline which fans data out from the collectors to every output. Each output gets its own buffer, so
+     * printing to stdout no longer takes messages away from the message queue.
      */
-    struct mq_attr q_attr = {
-        .mq_flags = 0,
-        .mq_maxmsg = 30,
-        .mq_msgsize = sizeof(recv_msg),
-    };
-    mqd_t sensor_q = mq_open(SENSOR_QUEUE, O_CREAT | O_RDONLY, S_IWOTH | S_IRUSR, &q_attr);
-    if (sensor_q == -1) {
+    int err = pipeline_init();
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Could not initialize pipeline: %s", strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    // A replay may have no packager reading the queue, so it must not wait for one
+    mq_sink_init(&mq_sink, &mq_sink_ctx, replay_path != NULL);
+
+    set_sink_sched(&mq_sink);
+    err = pipeline_add_sink(&mq_sink);
+    if (err != EOK) {
         log_print(stderr, LOG_ERROR, "Could not create internal queue '%s' with error: '%s'", SENSOR_QUEUE,
-                  strerror(errno));
+                  strerror(err));
         exit(EXIT_FAILURE);
     }
 
-    // Get message queue attributes since it's necessary to know max message size for receiving
-    struct mq_attr sensor_q_attr;
-    if (mq_getattr(sensor_q, &sensor_q_attr) == -1) {
-        log_print(stderr, LOG_ERROR, "Failed to get attributes of message queue '%s': '%s'", SENSOR_QUEUE,
-                  strerror(errno));
+    if (print_output) {
+        stdout_sink_init(&stdout_sink, &stdout_sink_ctx, fmt);
+        set_sink_sched(&stdout_sink);
+        err = pipeline_add_sink(&stdout_sink);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not print to stdout: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (shm_output) {
+        shm_sink_init(&shm_sink, &shm_sink_ctx);
+        set_sink_sched(&shm_sink);
+        err = pipeline_add_sink(&shm_sink);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not create shared memory '%s': %s", SENSOR_SHM, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (log_file != NULL) {
+        file_sink_init(&file_sink, &file_sink_ctx, log_file, fmt);
+        set_sink_sched(&file_sink);
+        err = pipeline_add_sink(&file_sink);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not open log file '%s': %s", log_file, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (rec_config.dir != NULL) {
+        recorder_sink_init(&recorder_sink, &recorder_sink_ctx, &rec_config);
+        set_sink_sched(&recorder_sink);
+        err = pipeline_add_sink(&recorder_sink);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not start recording in '%s': %s", rec_config.dir, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added first so that glitches never reach the other stages or the outputs. */
+    if (glitch_enabled) {
+        err = glitch_stage_init(&glitch_stage, &glitch_stage_ctx, &glitch_config);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Invalid glitch rule: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+        err = pipeline_add_stage(&glitch_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add glitch rejection stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added after glitch rejection so that glitches do not count as disagreements, and before the stages which use the
+     * consensus. */
+    if (vote_enabled) {
+        err = vote_stage_init(&vote_stage, &vote_stage_ctx, &vote_config);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Invalid voting options: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+        err = pipeline_add_stage(&vote_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add voting stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (fusion_enabled) {
+        fusion_stage_init(&fusion_stage, &fusion_stage_ctx, &fusion_config);
+        err = pipeline_add_stage(&fusion_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add fusion stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added after the fusion stage so that apogee is detected from the fused vertical velocity. */
+    if (events_enabled) {
+        events_stage_init(&events_stage, &events_stage_ctx, &events_config);
+        err = pipeline_add_stage(&events_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add event detection stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added after event detection, whose events start the flight phases, and before the collectors start. */
+    if (phase_enabled) {
+        phase_stage_init(&phase_stage, &phase_stage_ctx, &phase_config);
+        err = pipeline_add_stage(&phase_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add flight phase stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added before the decimation stage so that the statistics are computed over the full rate samples. */
+    if (stats_enabled) {
+        err = stats_stage_init(&stats_stage, &stats_stage_ctx, &stats_config);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Invalid statistics rule: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+        err = pipeline_add_stage(&stats_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add statistics stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added after every stage whose output it can resample, and before decimation so that it gets full rate samples. */
+    if (resample_enabled) {
+        err = resample_stage_init(&resample_stage, &resample_stage_ctx, &resample_config);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Invalid resampling field: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+        err = pipeline_add_stage(&resample_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add resampling stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* Added last, since the stages before it need the full rate samples it passes through. */
+    if (decim_enabled) {
+        err = decim_stage_init(&decim_stage, &decim_stage_ctx, &decim_config);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Invalid decimation rule: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+        err = pipeline_add_stage(&decim_stage);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not add decimation stage: %s", strerror(err));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Replaying as fast as possible is only meaningful if no samples are dropped along the way
+    pipeline_set_lossless(replay_path != NULL && replay_speed <= REPLAY_MAX_SPEED);
+
+    const rt_config_t *dispatcher_sched = sched_search("dispatcher");
+    if (dispatcher_sched != NULL) pipeline_set_sched(dispatcher_sched);
+
+    err = pipeline_start();
+    if (err != EOK) {
+        log_print(stderr, LOG_ERROR, "Could not start pipeline: %s", strerror(err));
         exit(EXIT_FAILURE);
     }
 
+    /* Republish a recording through the same outputs instead of reading the sensors. */
+    if (replay_path != NULL) {
+        replay_stats_t stats;
+        err = replay_run(replay_path, replay_speed, &stats);
+        pipeline_close();
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Could not replay '%s': %s", replay_path, strerror(err));
+            exit(EXIT_FAILURE);
+        }
+
+        pipeline_report(stderr);
+        double seconds = (double)stats.elapsed_ns / 1000000000;
+        log_print(stderr, LOG_INFO, "Replayed %llu samples from %u segments in %.3f s (%.0f samples/s)",
+                  (unsigned long long)stats.samples, stats.segments, seconds, (double)stats.samples / seconds);
+        return EXIT_SUCCESS;
+    }
+
     /* Open I2C. */
     int bus = open(i2c_bus, O_RDWR);
     if (bus < 0) {
@@ -127,7 +1449,7 @@ int main(int argc, char **argv) {
 
     /* Set I2C bus speed. */
     uint32_t speed = BUS_SPEED;
-    int err = devctl(bus, DCMD_I2C_SET_BUS_SPEED, &speed, sizeof(speed), NULL);
+    err = devctl(bus, DCMD_I2C_SET_BUS_SPEED, &speed, sizeof(speed), NULL);
     if (err) {
         log_print(stderr, LOG_ERROR, "Failed to set bus speed to %u with error %s", speed, strerror(err));
         exit(EXIT_FAILURE);
@@ -172,15 +1494,28 @@ int main(int argc, char **argv) {
                 log_print(stderr, LOG_INFO, "Found sensor %s, starting...", select_sensor);
             }
         }
+
+        // Redundant sensors of one kind are voted on as a group, which must be known before any of them publishes
+        if (vote_enabled && naddrs > 1 && collector_search(sensor_name) != NULL) {
+            vote_group_t group = {.n = naddrs};
+            for (uint8_t i = 0; i < naddrs; i++) {
+                group.sources[i] = (uint8_t)(num_sensors + i);
+            }
+            err = vote_stage_add_group(&vote_stage_ctx, &group);
+            if (err != EOK) {
+                log_print(stderr, LOG_WARN, "Could not vote on the %u %s sensors: %s", naddrs, sensor_name,
+                          strerror(err));
+            }
+        }
+
         for (uint8_t i = 0; i < naddrs; i++) {
             /* Create sensor data collection threads. */
-            collector_t collector = collector_search(sensor_name);
-            if (collector == NULL) {
+            collector_args[num_sensors] = (collector_args_t){.bus = bus, .addr = addresses[i], .source = num_sensors};
+            err = start_collector(sensor_name, num_sensors);
+            if (err == ENOSYS) {
                 log_print(stderr, LOG_ERROR, "Collector not implemented for sensor %s", sensor_name);
                 continue; // Just don't create thread
             }
-            collector_args[num_sensors] = (collector_args_t){.bus = bus, .addr = addresses[i]};
-            err = pthread_create(&collector_threads[num_sensors], NULL, collector, &collector_args[num_sensors]);
             if (err != EOK) {
                 log_print(stderr, LOG_ERROR, "Could not create %s collector: %s", sensor_name, strerror(err));
                 exit(EXIT_FAILURE);
@@ -191,28 +1526,39 @@ int main(int argc, char **argv) {
     // Only start the sysclock if we're not debugging a single sensor or if this is the sensor that was selected
     if (select_sensor == NULL || !strcasecmp(select_sensor, SYSCLOCK_NAME)) {
         /* Add sysclock sensor because it won't be specified in board ID. */
-        collector_t sysclock = collector_search(SYSCLOCK_NAME);
-        err = pthread_create(&collector_threads[num_sensors], NULL, sysclock, NULL);
+        collector_args[num_sensors] = (collector_args_t){.bus = bus, .source = num_sensors};
+        err = start_collector(SYSCLOCK_NAME, num_sensors);
         num_sensors++;
     }
 
     /* Add PAC1952 sensor because it won't be specified in board ID. */
     if (select_sensor == NULL || !strcasecmp(select_sensor, "pac1952-2")) {
-        collector_t pac1952 = collector_search("pac1952-2");
-        collector_args[num_sensors] = (collector_args_t){.bus = bus, .addr = 0x17};
-        err = pthread_create(&collector_threads[num_sensors], NULL, pac1952, &collector_args[num_sensors]);
+        collector_args[num_sensors] = (collector_args_t){.bus = bus, .addr = 0x17, .source = num_sensors};
+        err = start_collector("pac1952-2", num_sensors);
         num_sensors++;
     }
 
-    /* Constantly receive from sensors on message queue and print data. */
-    while (print_output) {
-        if (mq_receive(sensor_q, (char *)&recv_msg, sensor_q_attr.mq_msgsize, NULL) == -1) {
-            // Handle error without exiting
-            log_print(stderr, LOG_ERROR, "Failed to receive message on queue '%s': %s", SENSOR_QUEUE, strerror(errno));
-            continue;
+    /* Log how long each sensor took to start once they have all published. */
+    err = startup_watch(STARTUP_REPORT_TIMEOUT);
+    if (err != EOK) log_print(stderr, LOG_WARN, "Cannot report the startup of the sensors: %s", strerror(err));
+
+    /* Run the collector tasks on this thread until they have all stopped. */
+    if (engine_loop) {
+        const rt_config_t *engine_sched = sched_search("engine");
+        if (engine_sched != NULL) {
+            err = rt_apply(engine_sched);
+            if (err != EOK) log_print(stderr, LOG_WARN, "Could not schedule the engine: %s", strerror(err));
         }
-        // Successfully received data, print it to output stream
-        sensor_write_data(stdout, &recv_msg);
+        engine_run();
+        engine_report(stderr);
+        pipeline_close();
+        return 0;
+    }
+
+    /* Report the wake-up latency of the collector threads periodically until they have all stopped. */
+    while (atomic_load(&running_collectors) > 0) {
+        sleep(RT_REPORT_PERIOD);
+        rt_report(stderr);
     }
 
     /* Wait for collectors to terminate before terminating. */
@@ -220,5 +1566,6 @@ int main(int argc, char **argv) {
         pthread_join(collector_threads[i], NULL);
     }
 
+    pipeline_close();
     return 0;
 }
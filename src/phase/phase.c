@@ -0,0 +1,86 @@
+/**
+ * @file phase.c
+ * @brief Implementation of the flight phase shared between the phase controller and the collectors.
+ *
+ * Implementation of the flight phase shared between the phase controller and the collectors.
+ */
+#include "phase.h"
+#include "../logging-utils/logging.h"
+#include "../pipeline/pipeline.h"
+#include <pthread.h>
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The names of the flight phases, for logging. */
+static const char *PHASE_NAMES[PHASE_COUNT] = {
+    [PHASE_IDLE] = "idle",
+    [PHASE_ARMED] = "armed",
+    [PHASE_BOOST] = "boost",
+    [PHASE_COAST] = "coast",
+    [PHASE_DESCENT] = "descent",
+    [PHASE_LANDED] = "landed",
+};
+
+/** The current phase, as the collectors see it. */
+static phase_view_t current = {.phase = PHASE_ARMED};
+
+/** Protects the current phase. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Gets the name of a flight phase.
+ * @param phase The phase.
+ * @return The name of the phase, like "boost".
+ */
+const char __attribute__((const)) * phase_name(phase_e phase) { return PHASE_NAMES[phase]; }
+
+/**
+ * Enters a flight phase. The collectors reconfigure their sensors for it at the start of their next period.
+ * @param phase The phase.
+ * @param trigger The time of the sample which triggered the transition, on the pipeline's clock.
+ */
+void phase_set(phase_e phase, uint64_t trigger) {
+    pthread_mutex_lock(&lock);
+    current.phase = phase;
+    current.generation++;
+    current.time = pipeline_time();
+    current.trigger = trigger;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Gets the current flight phase, to configure a sensor for it when its collector starts.
+ * @param view Set to the current phase.
+ */
+void phase_get(phase_view_t *view) {
+    pthread_mutex_lock(&lock);
+    *view = current;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Checks whether the flight entered another phase since a collector last configured its sensor.
+ * @param view The phase the collector's sensor is configured for. Set to the current phase if it changed.
+ * @return True if the phase changed, so the sensor must be reconfigured, false otherwise.
+ */
+bool phase_poll(phase_view_t *view) {
+    pthread_mutex_lock(&lock);
+    bool changed = view->generation != current.generation;
+    if (changed) *view = current;
+    pthread_mutex_unlock(&lock);
+    return changed;
+}
+
+/**
+ * Logs how long a collector took to reconfigure its sensor for a new phase. Must be called once the sensor is
+ * reconfigured.
+ * @param view The phase the sensor was reconfigured for, as returned by `phase_poll`.
+ * @param name The name of the sensor.
+ */
+void phase_applied(const phase_view_t *view, const char *name) {
+    uint64_t now = pipeline_time();
+    log_print(stderr, LOG_INFO, "%s reconfigured for %s %.1f ms after the transition, %.1f ms after its trigger", name,
+              phase_name(view->phase), (double)(now - view->time) / NS_PER_MS,
+              (double)(now - view->trigger) / NS_PER_MS);
+}
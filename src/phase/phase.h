@@ -0,0 +1,46 @@
+/**
+ * @file phase.h
+ * @brief Types and function prototypes for sharing the flight phase between the phase controller and the collectors.
+ *
+ * The flight is split into phases, from sitting on the pad to lying on the ground after landing. The phase controller
+ * (the phase stage of the pipeline) decides which phase the flight is in from the samples streaming by, and sets it
+ * here. Each collector checks for a new phase at the start of each of its periods, and reconfigures its sensor for it
+ * (like a lower output data rate while idle). How long after the transition each collector finished reconfiguring is
+ * logged, with how long after the sample which triggered the transition.
+ *
+ * Without a phase controller, the phase stays PHASE_ARMED, in which every sensor is read at its flight rate.
+ */
+#ifndef _PHASE_H_
+#define _PHASE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** The phases of a flight, in the order they follow each other. */
+typedef enum {
+    PHASE_IDLE,    /**< On the pad, where nothing is expected to happen for a long time. */
+    PHASE_ARMED,   /**< The rocket is being handled or could be launched at any time. */
+    PHASE_BOOST,   /**< The motor is thrusting. */
+    PHASE_COAST,   /**< The motor burnt out and the rocket coasts up to apogee. */
+    PHASE_DESCENT, /**< The rocket passed apogee and is coming back down. */
+    PHASE_LANDED,  /**< The rocket is back on the ground. */
+} phase_e;
+
+/** The number of flight phases. */
+#define PHASE_COUNT 6
+
+/** The phase a collector configured its sensor for. */
+typedef struct {
+    phase_e phase;       /**< The phase. */
+    uint32_t generation; /**< The number of transitions which led to the phase. */
+    uint64_t time;       /**< When the controller entered the phase, on the pipeline's clock. */
+    uint64_t trigger;    /**< The time of the sample which triggered the transition, on the pipeline's clock. */
+} phase_view_t;
+
+const char *phase_name(phase_e phase);
+void phase_set(phase_e phase, uint64_t trigger);
+void phase_get(phase_view_t *view);
+bool phase_poll(phase_view_t *view);
+void phase_applied(const phase_view_t *view, const char *name);
+
+#endif // _PHASE_H_
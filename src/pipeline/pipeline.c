@@ -0,0 +1,394 @@
+/**
+ * @file pipeline.c
+ * @brief Implementation of the pipeline which fans samples out from the collectors to every registered sink.
+ *
+ * Implementation of the pipeline which fans samples out from the collectors to every registered sink.
+ */
+#include "pipeline.h"
+#include "../logging-utils/logging.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** Samples published by the collectors which have not been dispatched yet. */
+static sample_ring_t ingest;
+
+/** Storage for the ingest ring buffer. */
+static sample_t ingest_storage[INGEST_BUFFER_LEN];
+
+/** The number of ingest samples which were dropped at the last drop report. */
+static uint64_t ingest_reported_drops = 0;
+
+/** The sinks registered with the pipeline. */
+static sink_t *sinks[PIPELINE_MAX_SINKS];
+
+/** The number of sinks registered with the pipeline. */
+static uint8_t nsinks = 0;
+
+/** The processing stages registered with the pipeline, in the order they run. */
+static stage_t *stages[PIPELINE_MAX_STAGES];
+
+/** The number of processing stages registered with the pipeline. */
+static uint8_t nstages = 0;
+
+/** The outputs of the processing stages. Consecutive stages alternate between the two. */
+static sample_t stage_storage[2][STAGE_BATCH_LEN];
+
+/** The samples of a batch which go to the full rate sinks and to the decimated sinks, if they differ. */
+static sample_t route_storage[2][STAGE_BATCH_LEN];
+
+/** The time at which the pipeline was initialized. */
+static struct timespec start_time;
+
+/** When each source's first sample was published plus one, or zero if it has not published yet. */
+static atomic_uint_fast64_t first_samples[UINT8_MAX + 1];
+
+/** Whether samples wait for room in full buffers instead of being dropped. */
+static bool lossless = false;
+
+/** The thread which moves samples from the ingest buffer to the sinks. */
+static pthread_t dispatcher_thread;
+
+/** How the dispatcher thread is scheduled. */
+static rt_config_t dispatcher_sched;
+
+/**
+ * Gets the time elapsed since the pipeline was initialized.
+ * @return The elapsed time in nanoseconds.
+ */
+uint64_t pipeline_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start_time.tv_sec) * NS_PER_SEC + (uint64_t)now.tv_nsec -
+           (uint64_t)start_time.tv_nsec;
+}
+
+/**
+ * Initializes the pipeline. Must be called before any sinks are added or samples are published.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+int pipeline_init(void) {
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    return sample_ring_init(&ingest, ingest_storage, INGEST_BUFFER_LEN);
+}
+
+/**
+ * Opens a sink and registers it to receive every published sample.
+ * @param sink The sink to register. Its name, context, open and write methods must already be set.
+ * @return EOK if successful, ENOSPC if too many sinks are registered, otherwise the error from opening the sink.
+ */
+int pipeline_add_sink(sink_t *sink) {
+    if (nsinks == PIPELINE_MAX_SINKS) return ENOSPC;
+
+    int err = sample_ring_init(&sink->ring, sink->storage, SINK_BUFFER_LEN);
+    if (err != EOK) return err;
+
+    err = sink->open(sink);
+    if (err != EOK) return err;
+
+    atomic_init(&sink->output_drops, 0);
+    atomic_init(&sink->stalled, false);
+    sink->reported_drops = 0;
+    sinks[nsinks++] = sink;
+    return EOK;
+}
+
+/**
+ * Registers a processing stage to run on every sample before the sinks receive it. Stages run in the order they are
+ * registered. Must be called before the pipeline is started.
+ * @param stage The stage to register. Its name, context and process method must already be set.
+ * @return EOK if successful, ENOSPC if too many stages are registered.
+ */
+int pipeline_add_stage(stage_t *stage) {
+    if (nstages == PIPELINE_MAX_STAGES) return ENOSPC;
+
+    stage->source = (uint8_t)(STAGE_SOURCE_BASE + nstages);
+    stage->dropped = 0;
+    stage->reported_drops = 0;
+    stages[nstages++] = stage;
+    return EOK;
+}
+
+/**
+ * Outputs a sample from a processing stage. If the output is full, the sample is dropped and counted.
+ * @param out The output of the stage.
+ * @param sample The sample to output.
+ */
+void pipeline_emit(stage_out_t *out, const sample_t *sample) {
+    if (out->len == out->max) {
+        (*out->dropped)++;
+        return;
+    }
+    out->samples[out->len++] = *sample;
+}
+
+/**
+ * Runs a batch of samples through every processing stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param len Where to store the number of samples output by the last stage.
+ * @return The samples output by the last stage, which is the input itself if there are no stages.
+ */
+static const sample_t *run_stages(const sample_t *samples, size_t n, size_t *len) {
+    for (uint8_t i = 0; i < nstages; i++) {
+        stage_out_t out = {
+            .samples = stage_storage[i % 2],
+            .len = 0,
+            .max = STAGE_BATCH_LEN,
+            .dropped = &stages[i]->dropped,
+        };
+        stages[i]->process(stages[i], samples, n, &out);
+        samples = out.samples;
+        n = out.len;
+    }
+    *len = n;
+    return samples;
+}
+
+/**
+ * Copies the samples of a batch which do not have a flag.
+ * @param samples The samples of the batch.
+ * @param n The number of samples in the batch.
+ * @param skip The flag of the samples to leave out.
+ * @param dest Where to copy the samples. Must have room for `n` samples.
+ * @return The number of samples copied.
+ */
+static size_t route(const sample_t *samples, size_t n, uint8_t skip, sample_t *dest) {
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!(samples[i].flags & skip)) dest[len++] = samples[i];
+    }
+    return len;
+}
+
+/**
+ * Marks a sink as stalled, so that lossless mode and draining no longer wait for it.
+ * @param sink The sink which made no progress for SINK_STALL_TIMEOUT.
+ */
+static void stall(sink_t *sink) {
+    if (atomic_exchange(&sink->stalled, true)) return;
+    log_print(stderr, LOG_WARN, "Sink '%s' made no progress for %d s, no longer waiting for it", sink->name,
+              SINK_STALL_TIMEOUT);
+}
+
+/**
+ * Thread which writes the samples buffered for a sink to its output.
+ * @param arg The sink to write to.
+ * @return Never returns.
+ */
+static void *sink_writer(void *arg) {
+    sink_t *sink = arg;
+    sample_t batch[PIPELINE_BATCH_LEN];
+
+    int err = rt_apply(&sink->sched);
+    if (err != EOK) {
+        log_print(stderr, LOG_WARN, "Could not schedule the writer of sink '%s': %s", sink->name, strerror(err));
+    }
+
+    for (;;) {
+        size_t n = sample_ring_pop(&sink->ring, batch, PIPELINE_BATCH_LEN);
+        err = sink->write(sink, batch, n);
+        if (err != EOK) {
+            log_print(stderr, LOG_ERROR, "Sink '%s' failed to write %zu samples: %s", sink->name, n, strerror(err));
+        }
+        sample_ring_done(&sink->ring, n);
+    }
+    return NULL;
+}
+
+/**
+ * Thread which runs samples from the ingest buffer through the processing stages, then fans them out into the buffer of
+ * every sink.
+ * @param arg Unused.
+ * @return Never returns.
+ */
+static void *dispatcher(void *arg) {
+    (void)(arg);
+    static sample_t batch[PIPELINE_BATCH_LEN];
+    uint64_t next_report = pipeline_time() + DROP_REPORT_PERIOD * NS_PER_SEC;
+
+    int err = rt_apply(&dispatcher_sched);
+    if (err != EOK) {
+        log_print(stderr, LOG_WARN, "Could not schedule the dispatcher: %s", strerror(err));
+    }
+
+    for (;;) {
+        size_t n = sample_ring_pop(&ingest, batch, PIPELINE_BATCH_LEN);
+        for (size_t i = 0; i < n; i++) {
+            atomic_uint_fast64_t *first = &first_samples[batch[i].source];
+            if (atomic_load_explicit(first, memory_order_relaxed) == 0) {
+                atomic_store_explicit(first, batch[i].time + 1, memory_order_relaxed);
+            }
+        }
+        size_t len;
+        const sample_t *out = run_stages(batch, n, &len);
+
+        // Only split the batch between full rate and decimated sinks if a stage flagged some of its samples
+        uint8_t flags = 0;
+        for (size_t i = 0; i < len; i++) {
+            flags |= out[i].flags;
+        }
+        const sample_t *full = out;
+        const sample_t *decimated = out;
+        size_t full_len = len;
+        size_t decimated_len = len;
+        if (flags & (SAMPLE_FULL_RATE | SAMPLE_DECIMATED)) {
+            full_len = route(out, len, SAMPLE_DECIMATED, route_storage[0]);
+            full = route_storage[0];
+            decimated_len = route(out, len, SAMPLE_FULL_RATE, route_storage[1]);
+            decimated = route_storage[1];
+        }
+
+        for (uint8_t i = 0; i < nsinks; i++) {
+            const sample_t *samples = sinks[i]->decimated ? decimated : full;
+            size_t count = sinks[i]->decimated ? decimated_len : full_len;
+            if (lossless && !atomic_load(&sinks[i]->stalled)) {
+                if (sample_ring_push_wait(&sinks[i]->ring, samples, count, SINK_STALL_TIMEOUT * NS_PER_SEC) < count) {
+                    stall(sinks[i]);
+                }
+            } else {
+                sample_ring_push(&sinks[i]->ring, samples, count);
+            }
+        }
+        sample_ring_done(&ingest, n);
+
+        if (pipeline_time() >= next_report) {
+            pipeline_report(stderr);
+            next_report += DROP_REPORT_PERIOD * NS_PER_SEC;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Selects whether samples wait for room in full buffers instead of being dropped. Must be called before the pipeline is
+ * started. Meant for replaying recordings as fast as possible, where dropping samples would defeat the purpose.
+ * @param enable True to wait for room, false to drop samples which do not fit (the default).
+ */
+void pipeline_set_lossless(bool enable) { lossless = enable; }
+
+/**
+ * Selects how the dispatcher thread is scheduled. Must be called before the pipeline is started. The writer threads of
+ * the sinks are scheduled through their `sched` field instead.
+ * @param config How the dispatcher thread is scheduled.
+ */
+void pipeline_set_sched(const rt_config_t *config) { dispatcher_sched = *config; }
+
+/**
+ * Starts the dispatcher and the writer threads of all registered sinks.
+ * @return EOK if successful, otherwise the error which occurred creating a thread.
+ */
+int pipeline_start(void) {
+    for (uint8_t i = 0; i < nsinks; i++) {
+        int err = pthread_create(&sinks[i]->thread, NULL, sink_writer, sinks[i]);
+        if (err != EOK) return err;
+    }
+    return pthread_create(&dispatcher_thread, NULL, dispatcher, NULL);
+}
+
+/**
+ * Publishes a message to every sink. Never blocks; if the pipeline is backed up the sample is dropped and counted.
+ * @param source The index of the collector which produced the message.
+ * @param msg The message to publish.
+ * @param prio The message queue priority of the message.
+ */
+void pipeline_publish(uint8_t source, const common_t *msg, uint8_t prio) {
+    sample_t sample = {.time = pipeline_time(), .msg = *msg, .source = source, .prio = prio};
+    sample_ring_push(&ingest, &sample, 1);
+}
+
+/**
+ * Publishes samples which already have a timestamp and source, such as samples read back from a recording. Blocks until
+ * all the samples fit in lossless mode, otherwise samples which do not fit are dropped and counted.
+ * @param samples The samples to publish.
+ * @param n The number of samples to publish.
+ */
+void pipeline_inject(const sample_t *samples, size_t n) {
+    if (lossless) {
+        sample_ring_push_wait(&ingest, samples, n, 0);
+    } else {
+        sample_ring_push(&ingest, samples, n);
+    }
+}
+
+/**
+ * Gets when a source published its first sample, as seen by the dispatcher, for following how long each sensor took to
+ * start.
+ * @param source The source.
+ * @param time Set to the time of the first sample on the pipeline's clock, if it has been dispatched.
+ * @return True if the source's first sample has been dispatched, false otherwise.
+ */
+bool pipeline_first_sample(uint8_t source, uint64_t *time) {
+    uint64_t first = atomic_load_explicit(&first_samples[source], memory_order_relaxed);
+    if (first == 0) return false;
+    *time = first - 1;
+    return true;
+}
+
+/**
+ * Waits until every sample published so far has been dispatched and written by every sink, except for the sinks which
+ * have stalled.
+ */
+void pipeline_drain(void) {
+    // The dispatcher never waits on a stalled sink for long, so it always gets through the ingest buffer
+    sample_ring_drain(&ingest, 0);
+    for (uint8_t i = 0; i < nsinks; i++) {
+        if (atomic_load(&sinks[i]->stalled)) continue;
+        if (sample_ring_drain(&sinks[i]->ring, SINK_STALL_TIMEOUT * NS_PER_SEC) == ETIMEDOUT) stall(sinks[i]);
+    }
+}
+
+/**
+ * Waits until every sample published so far has been written, then closes the output of every sink. Must only be called
+ * once nothing publishes samples anymore. Sinks which have stalled are not closed, since their writer is still busy
+ * with them.
+ */
+void pipeline_close(void) {
+    pipeline_drain();
+    for (uint8_t i = 0; i < nsinks; i++) {
+        sink_t *sink = sinks[i];
+        if (sink->close == NULL) continue;
+        if (atomic_load(&sink->stalled)) {
+            log_print(stderr, LOG_WARN, "Not closing sink '%s', which has stalled", sink->name);
+            continue;
+        }
+        int err = sink->close(sink);
+        if (err != EOK) log_print(stderr, LOG_ERROR, "Could not close sink '%s': %s", sink->name, strerror(err));
+    }
+}
+
+/**
+ * Logs the number of samples dropped by the ingest buffer, by each stage and by each sink since the last report.
+ * Nothing is logged for buffers which have not dropped anything new.
+ * @param stream The stream to log to.
+ */
+void pipeline_report(FILE *stream) {
+    uint64_t dropped = sample_ring_dropped(&ingest);
+    if (dropped != ingest_reported_drops) {
+        log_print(stream, LOG_WARN, "Pipeline dropped %llu samples before dispatch (%llu total)",
+                  (unsigned long long)(dropped - ingest_reported_drops), (unsigned long long)dropped);
+        ingest_reported_drops = dropped;
+    }
+
+    for (uint8_t i = 0; i < nstages; i++) {
+        dropped = stages[i]->dropped;
+        if (dropped != stages[i]->reported_drops) {
+            log_print(stream, LOG_WARN, "Stage '%s' dropped %llu samples (%llu total)", stages[i]->name,
+                      (unsigned long long)(dropped - stages[i]->reported_drops), (unsigned long long)dropped);
+            stages[i]->reported_drops = dropped;
+        }
+    }
+
+    for (uint8_t i = 0; i < nsinks; i++) {
+        dropped = sample_ring_dropped(&sinks[i]->ring) + atomic_load(&sinks[i]->output_drops);
+        if (dropped != sinks[i]->reported_drops) {
+            log_print(stream, LOG_WARN, "Sink '%s' dropped %llu samples (%llu total)", sinks[i]->name,
+                      (unsigned long long)(dropped - sinks[i]->reported_drops), (unsigned long long)dropped);
+            sinks[i]->reported_drops = dropped;
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ * @file pipeline.h
+ * @brief Types and function prototypes for the pipeline which delivers samples from collectors to output sinks.
+ *
+ * Collectors publish samples into a bounded ingest buffer. A dispatcher thread takes samples off of the ingest buffer
+ * and fans each one out to every registered sink. Each sink has its own buffer, drop accounting and thread, so a slow
+ * sink (like a terminal) never holds back the other sinks or the collectors.
+ *
+ * Before fanning out, the dispatcher runs each batch through the registered processing stages in order. A stage sees
+ * every sample that reaches it and decides what comes out: it can pass samples through, drop them, or emit derived
+ * samples (like a fused altitude) which later stages and every sink receive as if a collector had published them.
+ *
+ * A stage can also split a stream in two by flagging its samples: full rate samples (SAMPLE_FULL_RATE) only go to the
+ * sinks which keep everything, like the log file and the flight recorder, while a decimated copy (SAMPLE_DECIMATED)
+ * goes to the sinks marked as `decimated`, like the message queue.
+ *
+ * Samples which were already timestamped, like those of a replayed recording, can be injected into the pipeline
+ * directly. In lossless mode, injecting and dispatching wait for room instead of dropping samples, so the pipeline runs
+ * at the pace of its slowest sink. A sink which makes no progress for SINK_STALL_TIMEOUT is marked as stalled: lossless
+ * mode and draining stop waiting for it, and it drops what does not fit like in normal mode.
+ */
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include "../realtime/realtime.h"
+#include "ring.h"
+#include "sample.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The maximum number of sinks that can be registered with the pipeline. */
+#define PIPELINE_MAX_SINKS 8
+
+/** The number of samples that can wait between the collectors and the dispatcher. */
+#define INGEST_BUFFER_LEN 4096
+
+/** The number of samples each sink can buffer before it starts dropping samples. */
+#define SINK_BUFFER_LEN 2048
+
+/** The maximum number of samples handed to a sink or the dispatcher at once. */
+#define PIPELINE_BATCH_LEN 256
+
+/** The number of seconds between reports of dropped samples. */
+#define DROP_REPORT_PERIOD 5
+
+/** How long a sink can go without making progress before lossless mode and draining stop waiting for it, in seconds. */
+#define SINK_STALL_TIMEOUT 2
+
+/** The maximum number of processing stages that can be registered with the pipeline. */
+#define PIPELINE_MAX_STAGES 8
+
+/** The maximum number of samples a stage can output for one batch, including the samples it passes through. */
+#define STAGE_BATCH_LEN (4 * PIPELINE_BATCH_LEN)
+
+/** The source of the samples emitted by the first stage. Each following stage gets the next source. */
+#define STAGE_SOURCE_BASE 0xf0
+
+/** Where a stage puts the samples it outputs for a batch. */
+typedef struct {
+    sample_t *samples; /**< Storage for the output samples. */
+    size_t len;        /**< The number of samples output so far. */
+    size_t max;        /**< The number of samples `samples` has room for. */
+    uint64_t *dropped; /**< Counts the samples which did not fit. */
+} stage_out_t;
+
+/** A processing step which the dispatcher runs on every sample before the sinks receive it. */
+typedef struct stage_t {
+    /** The name of the stage, used for reporting. */
+    const char *name;
+    /** Stage specific state. The memory must be provided by the user. */
+    void *ctx;
+    /**
+     * Function responsible for processing a batch of samples.
+     * @param stage The stage who this process method belongs to.
+     * @param samples The samples to process, in the order they were published.
+     * @param n The number of samples to process.
+     * @param out Where to output samples with `pipeline_emit`, including the input samples which should pass through.
+     */
+    void (*process)(struct stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out);
+    /** The source of the samples the stage emits, assigned when it is registered. */
+    uint8_t source;
+    /** The number of samples which did not fit in the stage's output. */
+    uint64_t dropped;
+    /** The number of samples which were dropped at the last drop report. */
+    uint64_t reported_drops;
+} stage_t;
+
+/** An output which receives every sample published by the collectors. */
+typedef struct sink_t {
+    /** The name of the sink, used for reporting. */
+    const char *name;
+    /** Sink specific state. The memory must be provided by the user. */
+    void *ctx;
+    /**
+     * Function responsible for opening the output of the sink.
+     * @param sink The sink who this open method belongs to.
+     * @return Error status of opening the sink. EOK if successful.
+     */
+    int (*open)(struct sink_t *sink);
+    /**
+     * Function responsible for writing a batch of samples to the output of the sink.
+     * @param sink The sink who this write method belongs to.
+     * @param samples The samples to write, in the order they were published.
+     * @param n The number of samples to write.
+     * @return Error status of writing the samples. EOK if successful.
+     */
+    int (*write)(struct sink_t *sink, const sample_t *samples, size_t n);
+    /**
+     * Function responsible for closing the output of the sink once every sample was written, or NULL if it has nothing
+     * to close.
+     * @param sink The sink who this close method belongs to.
+     * @return Error status of closing the sink. EOK if successful.
+     */
+    int (*close)(struct sink_t *sink);
+    /** The samples waiting to be written by the sink. */
+    sample_ring_t ring;
+    /** Storage for the sink's ring buffer. */
+    sample_t storage[SINK_BUFFER_LEN];
+    /** The thread which writes samples to the sink's output. */
+    pthread_t thread;
+    /** How the sink's writer thread is scheduled. Zeroed, it keeps the scheduling of the thread which starts it. */
+    rt_config_t sched;
+    /** Whether the sink receives the decimated copies of streams instead of their full rate samples. */
+    bool decimated;
+    /** The number of samples the sink's output could not take, counted by its write method. */
+    atomic_uint_fast64_t output_drops;
+    /** Whether the sink stopped making progress, so that lossless mode and draining no longer wait for it. */
+    atomic_bool stalled;
+    /** The number of samples which were dropped at the last drop report. */
+    uint64_t reported_drops;
+} sink_t;
+
+int pipeline_init(void);
+int pipeline_add_sink(sink_t *sink);
+int pipeline_add_stage(stage_t *stage);
+void pipeline_emit(stage_out_t *out, const sample_t *sample);
+void pipeline_set_lossless(bool enable);
+void pipeline_set_sched(const rt_config_t *config);
+int pipeline_start(void);
+void pipeline_publish(uint8_t source, const common_t *msg, uint8_t prio);
+void pipeline_inject(const sample_t *samples, size_t n);
+void pipeline_drain(void);
+void pipeline_close(void);
+uint64_t pipeline_time(void);
+bool pipeline_first_sample(uint8_t source, uint64_t *time);
+void pipeline_report(FILE *stream);
+
+#endif // _PIPELINE_H_
@@ -0,0 +1,191 @@
+/**
+ * @file ring.c
+ * @brief Implementation of the bounded sample ring buffer.
+ *
+ * Implementation of the bounded sample ring buffer.
+ */
+#include "ring.h"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/**
+ * Initializes a ring buffer to use the caller provided storage.
+ * @param ring The ring buffer to initialize.
+ * @param buf Storage for `cap` samples.
+ * @param cap The number of samples which fit in `buf`.
+ * @return EOK if successful, otherwise the error which occurred initializing the synchronization primitives.
+ */
+int sample_ring_init(sample_ring_t *ring, sample_t *buf, size_t cap) {
+    ring->buf = buf;
+    ring->cap = cap;
+    ring->head = 0;
+    ring->len = 0;
+    ring->pushed = 0;
+    ring->dropped = 0;
+    ring->done = 0;
+
+    int err = pthread_mutex_init(&ring->lock, NULL);
+    if (err != EOK) return err;
+    err = pthread_cond_init(&ring->nonempty, NULL);
+    if (err != EOK) return err;
+
+    // Waits for progress time out on the monotonic clock, so that changing the system time does not stretch them
+    pthread_condattr_t attr;
+    err = pthread_condattr_init(&attr);
+    if (err != EOK) return err;
+    err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    if (err == EOK) err = pthread_cond_init(&ring->progress, &attr);
+    pthread_condattr_destroy(&attr);
+    return err;
+}
+
+/**
+ * Waits for the consumer to make progress. The ring's lock must be held.
+ * @param ring The ring buffer to wait on.
+ * @param stall_ns How long to wait in nanoseconds, or zero to wait for as long as it takes.
+ * @return EOK if the consumer may have made progress, ETIMEDOUT if it made none for `stall_ns`.
+ */
+static int wait_progress(sample_ring_t *ring, uint64_t stall_ns) {
+    if (stall_ns == 0) return pthread_cond_wait(&ring->progress, &ring->lock);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t nsec = (uint64_t)deadline.tv_nsec + stall_ns;
+    deadline.tv_sec += (time_t)(nsec / NS_PER_SEC);
+    deadline.tv_nsec = (long)(nsec % NS_PER_SEC);
+    return pthread_cond_timedwait(&ring->progress, &ring->lock, &deadline);
+}
+
+/**
+ * Copies as many samples as fit into the ring. The ring's lock must be held.
+ * @param ring The ring buffer to copy into.
+ * @param samples The samples to copy.
+ * @param n The number of samples to copy.
+ * @return The number of samples that were copied.
+ */
+static size_t ring_store(sample_ring_t *ring, const sample_t *samples, size_t n) {
+    size_t room = ring->cap - ring->len;
+    size_t accepted = n < room ? n : room;
+
+    // Copy in at most two contiguous chunks, since the free space may wrap around the end of the buffer
+    size_t tail = (ring->head + ring->len) % ring->cap;
+    size_t first = accepted < ring->cap - tail ? accepted : ring->cap - tail;
+    memcpy(&ring->buf[tail], samples, first * sizeof(sample_t));
+    memcpy(&ring->buf[0], &samples[first], (accepted - first) * sizeof(sample_t));
+
+    ring->len += accepted;
+    ring->pushed += accepted;
+    if (accepted > 0) pthread_cond_signal(&ring->nonempty);
+    return accepted;
+}
+
+/**
+ * Copies samples into the ring without ever blocking on the consumer. Samples which do not fit are dropped and counted.
+ * @param ring The ring buffer to push into.
+ * @param samples The samples to push.
+ * @param n The number of samples to push.
+ * @return The number of samples that were accepted.
+ */
+size_t sample_ring_push(sample_ring_t *ring, const sample_t *samples, size_t n) {
+    pthread_mutex_lock(&ring->lock);
+    size_t accepted = ring_store(ring, samples, n);
+    ring->dropped += n - accepted;
+    pthread_mutex_unlock(&ring->lock);
+    return accepted;
+}
+
+/**
+ * Copies samples into the ring, waiting for the consumer to make room instead of dropping samples. If the consumer
+ * stalls, the samples which do not fit are dropped and counted instead.
+ * @param ring The ring buffer to push into.
+ * @param samples The samples to push.
+ * @param n The number of samples to push.
+ * @param stall_ns How long the consumer may go without making progress in nanoseconds, or zero to wait for as long as
+ * it takes.
+ * @return The number of samples that were accepted, which is `n` unless the consumer stalled.
+ */
+size_t sample_ring_push_wait(sample_ring_t *ring, const sample_t *samples, size_t n, uint64_t stall_ns) {
+    pthread_mutex_lock(&ring->lock);
+    size_t accepted = ring_store(ring, samples, n);
+    while (accepted < n) {
+        if (wait_progress(ring, stall_ns) == ETIMEDOUT) {
+            ring->dropped += n - accepted;
+            break;
+        }
+        accepted += ring_store(ring, &samples[accepted], n - accepted);
+    }
+    pthread_mutex_unlock(&ring->lock);
+    return accepted;
+}
+
+/**
+ * Removes the oldest samples from the ring, waiting until at least one sample is available.
+ * @param ring The ring buffer to pop from.
+ * @param samples Storage for at least `max` samples.
+ * @param max The maximum number of samples to pop.
+ * @return The number of samples that were popped.
+ */
+size_t sample_ring_pop(sample_ring_t *ring, sample_t *samples, size_t max) {
+    pthread_mutex_lock(&ring->lock);
+    while (ring->len == 0) {
+        pthread_cond_wait(&ring->nonempty, &ring->lock);
+    }
+
+    size_t n = ring->len < max ? ring->len : max;
+    size_t first = n < ring->cap - ring->head ? n : ring->cap - ring->head;
+    memcpy(samples, &ring->buf[ring->head], first * sizeof(sample_t));
+    memcpy(&samples[first], &ring->buf[0], (n - first) * sizeof(sample_t));
+
+    ring->head = (ring->head + n) % ring->cap;
+    ring->len -= n;
+
+    pthread_cond_broadcast(&ring->progress);
+    pthread_mutex_unlock(&ring->lock);
+    return n;
+}
+
+/**
+ * Reports that the consumer has finished handling samples it popped.
+ * @param ring The ring buffer the samples were popped from.
+ * @param n The number of samples which were finished.
+ */
+void sample_ring_done(sample_ring_t *ring, size_t n) {
+    pthread_mutex_lock(&ring->lock);
+    ring->done += n;
+    pthread_cond_broadcast(&ring->progress);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/**
+ * Waits until the consumer has finished handling every sample accepted into the ring so far.
+ * @param ring The ring buffer to wait on.
+ * @param stall_ns How long the consumer may go without making progress in nanoseconds, or zero to wait for as long as
+ * it takes.
+ * @return EOK once every sample was handled, ETIMEDOUT if the consumer stalled first.
+ */
+int sample_ring_drain(sample_ring_t *ring, uint64_t stall_ns) {
+    int err = EOK;
+    pthread_mutex_lock(&ring->lock);
+    while (ring->done < ring->pushed && err != ETIMEDOUT) {
+        err = wait_progress(ring, stall_ns);
+    }
+    if (ring->done >= ring->pushed) err = EOK;
+    pthread_mutex_unlock(&ring->lock);
+    return err;
+}
+
+/**
+ * Gets the number of samples the ring has dropped so far.
+ * @param ring The ring buffer to check.
+ * @return The number of samples that were dropped because the ring was full.
+ */
+uint64_t sample_ring_dropped(sample_ring_t *ring) {
+    pthread_mutex_lock(&ring->lock);
+    uint64_t dropped = ring->dropped;
+    pthread_mutex_unlock(&ring->lock);
+    return dropped;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file ring.h
+ * @brief Bounded, thread safe ring buffer of samples used to decouple producers from consumers.
+ *
+ * Bounded, thread safe ring buffer of samples used to decouple producers from consumers. Pushing never blocks: when the
+ * ring is full, the samples that do not fit are dropped and counted. Storage for the ring is provided by the caller.
+ *
+ * Producers which must not lose samples (like replaying a recording as fast as possible) can instead wait for room.
+ * Consumers report when they have finished with the samples they popped, so that a producer can wait until everything
+ * it pushed has been fully handled. Either wait can be bounded, so that a consumer which stalls (like a message queue
+ * nobody reads) does not hold its producer up forever.
+ */
+#ifndef _RING_H_
+#define _RING_H_
+
+#include "sample.h"
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** A bounded ring buffer of samples. */
+typedef struct {
+    sample_t *buf;           /**< Storage for the samples, provided by the caller. */
+    size_t cap;              /**< The number of samples that fit in `buf`. */
+    size_t head;             /**< Index of the oldest sample in the ring. */
+    size_t len;              /**< The number of samples currently in the ring. */
+    uint64_t pushed;         /**< The number of samples that were accepted into the ring. */
+    uint64_t dropped;        /**< The number of samples that were dropped because the ring was full. */
+    uint64_t done;           /**< The number of samples the consumer has finished handling. */
+    pthread_mutex_t lock;    /**< Protects all the fields of the ring. */
+    pthread_cond_t nonempty; /**< Signalled when samples are pushed into the ring. */
+    pthread_cond_t progress; /**< Broadcast when samples are popped from the ring or finished by the consumer. */
+} sample_ring_t;
+
+int sample_ring_init(sample_ring_t *ring, sample_t *buf, size_t cap);
+size_t sample_ring_push(sample_ring_t *ring, const sample_t *samples, size_t n);
+size_t sample_ring_push_wait(sample_ring_t *ring, const sample_t *samples, size_t n, uint64_t stall_ns);
+size_t sample_ring_pop(sample_ring_t *ring, sample_t *samples, size_t max);
+void sample_ring_done(sample_ring_t *ring, size_t n);
+int sample_ring_drain(sample_ring_t *ring, uint64_t stall_ns);
+uint64_t sample_ring_dropped(sample_ring_t *ring);
+
+#endif // _RING_H_
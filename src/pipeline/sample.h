@@ -0,0 +1,35 @@
+/**
+ * @file sample.h
+ * @brief The envelope in which sensor messages travel through fetcher's pipeline.
+ *
+ * Collectors produce `common_t` messages, which is the format shared with packager over the message queue. Inside of
+ * fetcher, each message is wrapped in a sample that also records when it was acquired and which collector produced it.
+ */
+#ifndef _SAMPLE_H_
+#define _SAMPLE_H_
+
+#include "../drivers/sensor_api.h"
+#include <stdint.h>
+
+/**
+ * The sample belongs to a stream which is replaced downstream, by a decimated copy or by the consensus of redundant
+ * sensors, so only full rate sinks receive it.
+ */
+#define SAMPLE_FULL_RATE 0x01
+
+/** The sample belongs to the decimated copy of a full rate stream, so only decimated sinks receive it. */
+#define SAMPLE_DECIMATED 0x02
+
+/** The sample is part of a snapshot of streams resampled onto a common time grid, which later stages leave alone. */
+#define SAMPLE_SNAPSHOT 0x04
+
+/** A sensor message along with the information needed to route it through the pipeline. */
+typedef struct {
+    uint64_t time;  /**< Acquisition time in nanoseconds since the pipeline was started (CLOCK_MONOTONIC). */
+    common_t msg;   /**< The message as it is sent on the sensor message queue. */
+    uint8_t source; /**< The index of the collector which produced the sample. */
+    uint8_t prio;   /**< The message queue priority of the sample. */
+    uint8_t flags;  /**< How the sample is routed (SAMPLE_FULL_RATE, ...), 0 for every sink and stage. */
+} sample_t;
+
+#endif // _SAMPLE_H_
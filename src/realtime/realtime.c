@@ -0,0 +1,217 @@
+/**
+ * @file realtime.c
+ * @brief Implementation of the real-time scheduling of fetcher's threads.
+ *
+ * Implementation of the real-time scheduling of fetcher's threads and of the measurement of their wake-up latency.
+ */
+#include "realtime.h"
+#include "../logging-utils/logging.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/neutrino.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The number of nanoseconds in a microsecond. */
+#define NS_PER_US 1000ULL
+
+/** The wake-up latencies of every registered thread. */
+static rt_stats_t stats[RT_MAX_THREADS];
+
+/** The number of registered threads. */
+static uint8_t nstats = 0;
+
+/** Protects the registration of threads. */
+static pthread_mutex_t register_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** The wake-up latencies of the calling thread, or NULL if it is not registered. */
+static __thread rt_stats_t *current = NULL;
+
+/**
+ * Gets the current time on the clock of the periodic schedules of threads.
+ * @return The current time in nanoseconds on the monotonic clock.
+ */
+uint64_t rt_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Applies a scheduling configuration to the calling thread.
+ * @param config How the thread is scheduled.
+ * @return EOK if successful, otherwise the error which occurred (EINVAL for a priority outside of the policy's range,
+ * EPERM without the privilege to raise it).
+ */
+int rt_apply(const rt_config_t *config) {
+    if (config->scheduled) {
+        struct sched_param param = {.sched_priority = config->priority};
+        int err = pthread_setschedparam(pthread_self(), config->policy, &param);
+        if (err != EOK) return err;
+    }
+    if (config->cpus != 0) {
+        if (ThreadCtl(_NTO_TCTL_RUNMASK, (void *)(uintptr_t)config->cpus) == -1) return errno;
+    }
+    return EOK;
+}
+
+/**
+ * Locks every current and future page of the process in memory, so that no thread has to wait for a page fault.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+int rt_lock_memory(void) {
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) return errno;
+    return EOK;
+}
+
+/**
+ * Starts measuring the wake-up latency of the calling thread's sleeps through `rt_usleep`.
+ * @param name The name of the thread, used for reporting. Must outlive the thread.
+ * @return EOK if successful, ENOSPC if too many threads were registered.
+ */
+int rt_register(const char *name) {
+    pthread_mutex_lock(&register_lock);
+    if (nstats == RT_MAX_THREADS) {
+        pthread_mutex_unlock(&register_lock);
+        return ENOSPC;
+    }
+    current = &stats[nstats++];
+    pthread_mutex_unlock(&register_lock);
+
+    memset(current, 0, sizeof(*current));
+    current->name = name;
+    return EOK;
+}
+
+/**
+ * Sleeps for a number of microseconds, recording how late the sleep ended if the calling thread is registered.
+ * @param us The time to sleep in microseconds.
+ */
+void rt_usleep(uint32_t us) {
+    if (current == NULL) {
+        usleep(us);
+        return;
+    }
+
+    uint64_t due = rt_now() + us * NS_PER_US;
+    usleep(us);
+    uint64_t now = rt_now();
+    uint64_t late = now > due ? now - due : 0;
+
+    rt_stats_record(current, late);
+}
+
+/**
+ * Starts a schedule of deadlines a fixed period apart.
+ * @param periodic The schedule.
+ * @param period_us The time between two deadlines in microseconds.
+ * @param overrun What to do when a deadline passed by more than a period.
+ * @param start The first deadline in nanoseconds, on the clock the schedule is used with (`rt_now` for
+ * `rt_periodic_wait`).
+ */
+void rt_periodic_init(rt_periodic_t *periodic, uint32_t period_us, rt_overrun_e overrun, uint64_t start) {
+    periodic->period = period_us * NS_PER_US;
+    periodic->next = start;
+    periodic->overrun = overrun;
+}
+
+/**
+ * Moves a schedule on to the deadline after the one which is due.
+ * @param periodic The schedule.
+ * @param now The current time in nanoseconds, on the clock the schedule was started with.
+ * @return The number of deadlines which had already passed: skipped, or left due at once to catch up.
+ */
+uint64_t rt_periodic_advance(rt_periodic_t *periodic, uint64_t now) {
+    periodic->next += periodic->period;
+    if (periodic->next > now) return 0;
+
+    if (periodic->overrun == RT_CATCH_UP) return 1;
+    uint64_t missed = (now - periodic->next) / periodic->period + 1;
+    periodic->next += missed * periodic->period;
+    return missed;
+}
+
+/**
+ * Sleeps until the next deadline of a schedule started with `rt_now`, then moves the schedule on to the following one.
+ * If the calling thread is registered, how late the sleep ended and any missed deadlines are recorded.
+ * @param periodic The schedule.
+ */
+void rt_periodic_wait(rt_periodic_t *periodic) {
+    struct timespec deadline = {.tv_sec = periodic->next / NS_PER_SEC, .tv_nsec = periodic->next % NS_PER_SEC};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+
+    uint64_t now = rt_now();
+    uint64_t late = now > periodic->next ? now - periodic->next : 0;
+    uint64_t missed = rt_periodic_advance(periodic, now);
+    if (current != NULL) {
+        rt_stats_record(current, late);
+        current->overruns += missed;
+    }
+}
+
+/**
+ * Records how late a sleep ended.
+ * @param s The wake-up latencies of the thread which slept.
+ * @param late How late the sleep ended, in nanoseconds.
+ */
+void rt_stats_record(rt_stats_t *s, uint64_t late) {
+    s->wakeups++;
+    s->late_sum += late;
+    if (late > s->late_max) s->late_max = late;
+    uint64_t bin = late / (RT_BIN_US * NS_PER_US);
+    s->histogram[bin < RT_HISTOGRAM_BINS ? bin : RT_HISTOGRAM_BINS - 1]++;
+}
+
+/**
+ * Finds the 99th percentile of how late the sleeps of a thread ended.
+ * @param s The wake-up latencies of the thread.
+ * @return The upper edge of the histogram bin holding the percentile in microseconds, or 0 if it is later than that.
+ */
+static uint32_t percentile_99(const rt_stats_t *s) {
+    uint64_t count = 0;
+    for (uint32_t b = 0; b < RT_HISTOGRAM_BINS - 1; b++) {
+        count += s->histogram[b];
+        if (count * 100 >= s->wakeups * 99) return (b + 1) * RT_BIN_US;
+    }
+    return 0;
+}
+
+/**
+ * Logs how late the sleeps of a thread or task ended: the mean, the 99th percentile and the maximum, and the number of
+ * missed deadlines. Nothing is logged before the first sleep.
+ * @param stream The stream to log to.
+ * @param kind What slept, like "Thread", followed by its name in the log.
+ * @param s The wake-up latencies.
+ */
+void rt_stats_log(FILE *stream, const char *kind, const rt_stats_t *s) {
+    if (s->wakeups == 0) return;
+    double mean = (double)s->late_sum / (double)s->wakeups / NS_PER_US;
+    uint32_t p99 = percentile_99(s);
+    log_print(stream, LOG_INFO,
+              "%s %s: %llu wake-ups, %.1f us late on average, 99%% within %s%u us, %.1f us at most, %llu overruns",
+              kind, s->name, (unsigned long long)s->wakeups, mean, p99 == 0 ? ">" : "",
+              p99 == 0 ? (RT_HISTOGRAM_BINS - 1) * RT_BIN_US : p99, (double)s->late_max / NS_PER_US,
+              (unsigned long long)s->overruns);
+}
+
+/**
+ * Logs how late the sleeps of every registered thread ended since it was registered. The counts are read while the
+ * threads keep sleeping, so a report may miss the wake-ups in progress.
+ * @param stream The stream to log to.
+ */
+void rt_report(FILE *stream) {
+    pthread_mutex_lock(&register_lock);
+    uint8_t n = nstats;
+    pthread_mutex_unlock(&register_lock);
+
+    for (uint8_t i = 0; i < n; i++) {
+        rt_stats_log(stream, "Thread", &stats[i]);
+    }
+}
@@ -0,0 +1,79 @@
+/**
+ * @file realtime.h
+ * @brief Types and function prototypes for the real-time scheduling of fetcher's threads.
+ *
+ * Each thread of fetcher (a collector, the dispatcher or the writer of a sink) can be given its own scheduling policy,
+ * priority and set of CPUs, which it applies to itself when it starts. The memory of the process can also be locked, so
+ * that no thread ever waits for a page to be faulted back in.
+ *
+ * Threads which read a sensor at a fixed rate wait for each period with `rt_periodic_wait`, which sleeps until an
+ * absolute deadline on the monotonic clock. The deadlines are a whole number of periods apart no matter how long the
+ * work between them takes, so the rate does not drift below nominal and the timing error does not accumulate. A
+ * thread which falls more than a period behind either runs the missed periods back to back or skips them.
+ *
+ * To show whether a thread meets its deadlines, how late each of its periods (or other sleeps through `rt_usleep`)
+ * started is kept per thread in a histogram and reported periodically, with the number of missed deadlines.
+ */
+#ifndef _REALTIME_H_
+#define _REALTIME_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The maximum number of threads whose wake-up latency can be measured. */
+#define RT_MAX_THREADS 16
+
+/** The width of a bin of the wake-up latency histograms, in microseconds. */
+#define RT_BIN_US 10
+
+/** The number of bins of the wake-up latency histograms. Later wake-ups go in the last bin. */
+#define RT_HISTOGRAM_BINS 200
+
+/** The number of seconds between reports of the wake-up latencies. */
+#define RT_REPORT_PERIOD 10
+
+/** How a thread is scheduled. Zeroed, the thread keeps the scheduling it inherited. */
+typedef struct {
+    bool scheduled; /**< Whether to set the policy and priority of the thread. */
+    int policy;     /**< The scheduling policy, like SCHED_FIFO or SCHED_RR. */
+    int priority;   /**< The priority of the thread under its policy. */
+    uint32_t cpus;  /**< A bit mask of the CPUs the thread may run on, or 0 for any CPU. */
+} rt_config_t;
+
+/** What a periodic schedule does when its deadline passed by more than a period. */
+typedef enum {
+    RT_CATCH_UP, /**< Run the missed periods back to back, so that no period is lost. */
+    RT_SKIP,     /**< Skip the missed periods, keeping the deadlines on the original grid. */
+} rt_overrun_e;
+
+/** A schedule of deadlines a fixed period apart. */
+typedef struct {
+    uint64_t period;      /**< The time between two deadlines in nanoseconds. */
+    uint64_t next;        /**< The next deadline in nanoseconds. */
+    rt_overrun_e overrun; /**< What to do when the deadline passed by more than a period. */
+} rt_periodic_t;
+
+/** The wake-up latencies measured on a thread. */
+typedef struct {
+    const char *name;                      /**< The name of the thread, used for reporting. */
+    uint64_t wakeups;                      /**< The number of sleeps which ended. */
+    uint64_t overruns;                     /**< The number of periodic deadlines which were missed. */
+    uint64_t late_sum;                     /**< The sum of how late the sleeps ended, in nanoseconds. */
+    uint64_t late_max;                     /**< The latest a sleep ended, in nanoseconds. */
+    uint32_t histogram[RT_HISTOGRAM_BINS]; /**< How many sleeps ended how late. */
+} rt_stats_t;
+
+uint64_t rt_now(void);
+int rt_apply(const rt_config_t *config);
+int rt_lock_memory(void);
+int rt_register(const char *name);
+void rt_usleep(uint32_t us);
+void rt_periodic_init(rt_periodic_t *periodic, uint32_t period_us, rt_overrun_e overrun, uint64_t start);
+uint64_t rt_periodic_advance(rt_periodic_t *periodic, uint64_t now);
+void rt_periodic_wait(rt_periodic_t *periodic);
+void rt_stats_record(rt_stats_t *s, uint64_t late);
+void rt_stats_log(FILE *stream, const char *kind, const rt_stats_t *s);
+void rt_report(FILE *stream);
+
+#endif // _REALTIME_H_
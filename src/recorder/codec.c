@@ -0,0 +1,446 @@
+/**
+ * @file codec.c
+ * @brief Lossless compression of the samples in a recorder block.
+ *
+ * Lossless compression of the samples in a recorder block. The encoder appends each sample straight to the block's
+ * payload in the segment mapping, so a block costs no more copies than a raw one. Bits are gathered in a 64 bit
+ * accumulator and stored a byte at a time; the decoder refills its accumulator a byte at a time and takes up to 32 bits
+ * per read. See codec.h for the layout of the bit stream.
+ */
+#include "codec.h"
+#include <string.h>
+
+/** Marks the window of a float component as not set yet. */
+#define NO_WINDOW 0xff
+
+/**
+ * Gets the number of bits needed to store every stream index of a block, plus the index announcing a new stream.
+ * @param nstreams The number of streams in the block so far.
+ * @return The width of a stream index in bits.
+ */
+static inline unsigned index_width(uint8_t nstreams) {
+    return nstreams == 0 ? 0 : 32 - (unsigned)__builtin_clz(nstreams);
+}
+
+/**
+ * Gets the number of components a tag's data is encoded as, and whether they are floats. Data of unknown tags is
+ * encoded as three 32 bit integers, so that it survives unchanged.
+ * @param type The tag.
+ * @param is_float Where to store whether the components are floats.
+ * @return The number of components.
+ */
+static unsigned components(uint8_t type, bool *is_float) {
+    *is_float = false;
+    if (type >= SENSOR_TAG_COUNT) return 3;
+
+    switch (SENSOR_TAG_DATA[type].dtype) {
+    case TYPE_FLOAT:
+        *is_float = true;
+        return 1;
+    case TYPE_VEC2D:
+        *is_float = true;
+        return 2;
+    case TYPE_VEC3D:
+        *is_float = true;
+        return 3;
+    case TYPE_VEC2D_I32:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * Gets the bits of one component of a message's data. Narrow integers are extended to 32 bits according to their sign.
+ * @param msg The message.
+ * @param c The index of the component.
+ * @return The bits of the component.
+ */
+static uint32_t component_get(const common_t *msg, unsigned c) {
+    SensorTagDType dtype = msg->type < SENSOR_TAG_COUNT ? SENSOR_TAG_DATA[msg->type].dtype : TYPE_U32;
+    switch (dtype) {
+    case TYPE_U16:
+        return msg->data.U16;
+    case TYPE_U8:
+        return msg->data.U8;
+    case TYPE_I16:
+        return (uint32_t)(int32_t)msg->data.I16;
+    case TYPE_I8:
+        return (uint32_t)(int32_t)msg->data.I8;
+    default: {
+        uint32_t bits;
+        memcpy(&bits, (const uint8_t *)&msg->data + c * sizeof(bits), sizeof(bits));
+        return bits;
+    }
+    }
+}
+
+/**
+ * Sets one component of a message's data from its bits.
+ * @param msg The message, whose type must already be set.
+ * @param c The index of the component.
+ * @param bits The bits of the component.
+ */
+static void component_set(common_t *msg, unsigned c, uint32_t bits) {
+    SensorTagDType dtype = msg->type < SENSOR_TAG_COUNT ? SENSOR_TAG_DATA[msg->type].dtype : TYPE_U32;
+    switch (dtype) {
+    case TYPE_U16:
+        msg->data.U16 = (uint16_t)bits;
+        break;
+    case TYPE_U8:
+        msg->data.U8 = (uint8_t)bits;
+        break;
+    case TYPE_I16:
+        msg->data.I16 = (int16_t)bits;
+        break;
+    case TYPE_I8:
+        msg->data.I8 = (int8_t)bits;
+        break;
+    default:
+        memcpy((uint8_t *)&msg->data + c * sizeof(bits), &bits, sizeof(bits));
+        break;
+    }
+}
+
+/**
+ * Appends bits to the payload.
+ * @param enc The encoder.
+ * @param bits The bits to append, in the low bits. Higher bits are ignored.
+ * @param n The number of bits to append, at most 32.
+ */
+static inline void put_bits(rec_encoder_t *enc, uint64_t bits, unsigned n) {
+    if (n == 0) return;
+    enc->acc = (enc->acc << n) | (bits & ((1ULL << n) - 1));
+    enc->nbits = (uint8_t)(enc->nbits + n);
+    while (enc->nbits >= 8) {
+        enc->nbits -= 8;
+        enc->buf[enc->len++] = (uint8_t)(enc->acc >> enc->nbits);
+    }
+}
+
+/**
+ * Appends a time as the difference between its delta from the stream's previous time and the previous delta.
+ * @param enc The encoder.
+ * @param stream The stream the time belongs to.
+ * @param time The time.
+ */
+static void put_time(rec_encoder_t *enc, rec_codec_stream_t *stream, uint64_t time) {
+    uint64_t delta = time - stream->time;
+    uint64_t dod = delta - stream->delta;
+    uint64_t zz = (dod << 1) ^ (uint64_t)((int64_t)dod >> 63);
+    stream->time = time;
+    stream->delta = delta;
+
+    if (zz == 0) {
+        put_bits(enc, 0x0, 1);
+    } else if (zz < (1ULL << 10)) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, zz, 10);
+    } else if (zz < (1ULL << 16)) {
+        put_bits(enc, 0x6, 3);
+        put_bits(enc, zz, 16);
+    } else if (zz < (1ULL << 24)) {
+        put_bits(enc, 0xe, 4);
+        put_bits(enc, zz, 24);
+    } else {
+        put_bits(enc, 0xf, 4);
+        put_bits(enc, zz >> 32, 32);
+        put_bits(enc, zz, 32);
+    }
+}
+
+/**
+ * Appends a float component as the XOR with the stream's previous value of the component.
+ * @param enc The encoder.
+ * @param stream The stream the component belongs to.
+ * @param c The index of the component.
+ * @param bits The bits of the component.
+ */
+static void put_float(rec_encoder_t *enc, rec_codec_stream_t *stream, unsigned c, uint32_t bits) {
+    uint32_t x = bits ^ stream->value[c];
+    stream->value[c] = bits;
+    if (x == 0) {
+        put_bits(enc, 0x0, 1);
+        return;
+    }
+
+    unsigned leading = (unsigned)__builtin_clz(x);
+    unsigned trailing = (unsigned)__builtin_ctz(x);
+    if (stream->leading[c] != NO_WINDOW && leading >= stream->leading[c] && trailing >= stream->trailing[c]) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, x >> stream->trailing[c], 32 - stream->leading[c] - stream->trailing[c]);
+        return;
+    }
+
+    unsigned len = 32 - leading - trailing;
+    put_bits(enc, 0x3, 2);
+    put_bits(enc, leading, 5);
+    put_bits(enc, len - 1, 5);
+    put_bits(enc, x >> trailing, len);
+    stream->leading[c] = (uint8_t)leading;
+    stream->trailing[c] = (uint8_t)trailing;
+}
+
+/**
+ * Appends an integer component as the difference from the stream's previous value of the component.
+ * @param enc The encoder.
+ * @param stream The stream the component belongs to.
+ * @param c The index of the component.
+ * @param bits The bits of the component.
+ */
+static void put_int(rec_encoder_t *enc, rec_codec_stream_t *stream, unsigned c, uint32_t bits) {
+    uint32_t delta = bits - stream->value[c];
+    uint32_t zz = (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+    stream->value[c] = bits;
+
+    if (zz == 0) {
+        put_bits(enc, 0x0, 1);
+    } else if (zz < (1U << 8)) {
+        put_bits(enc, 0x2, 2);
+        put_bits(enc, zz, 8);
+    } else if (zz < (1U << 16)) {
+        put_bits(enc, 0x6, 3);
+        put_bits(enc, zz, 16);
+    } else {
+        put_bits(enc, 0x7, 3);
+        put_bits(enc, zz, 32);
+    }
+}
+
+/**
+ * Starts a new block.
+ * @param enc The encoder.
+ * @param buf Where to write the payload. Must have room for REC_CODEC_MAX_SAMPLE bytes per sample added.
+ * @param first_time The time of the block's first sample.
+ */
+void rec_encoder_begin(rec_encoder_t *enc, uint8_t *buf, uint64_t first_time) {
+    enc->buf = buf;
+    enc->len = 0;
+    enc->acc = 0;
+    enc->nbits = 0;
+    enc->first_time = first_time;
+    enc->nstreams = 0;
+}
+
+/**
+ * Appends a sample to the block.
+ * @param enc The encoder.
+ * @param sample The sample to append.
+ * @return True if the sample was appended, false if it belongs to a new stream and the block has no room for more
+ * streams. The block is left unchanged in that case.
+ */
+bool rec_encoder_add(rec_encoder_t *enc, const sample_t *sample) {
+    const common_t *msg = &sample->msg;
+    unsigned width = index_width(enc->nstreams);
+
+    uint8_t i = 0;
+    while (i < enc->nstreams) {
+        const rec_codec_stream_t *s = &enc->streams[i];
+        if (s->source == sample->source && s->type == msg->type && s->id == msg->id && s->prio == sample->prio) break;
+        i++;
+    }
+
+    if (i == REC_CODEC_STREAMS) return false;
+
+    rec_codec_stream_t *stream = &enc->streams[i];
+    put_bits(enc, i, width);
+    if (i == enc->nstreams) {
+        enc->nstreams++;
+
+        *stream = (rec_codec_stream_t){
+            .source = sample->source,
+            .type = msg->type,
+            .id = msg->id,
+            .prio = sample->prio,
+            .time = enc->first_time,
+            .leading = {NO_WINDOW, NO_WINDOW, NO_WINDOW},
+        };
+        put_bits(enc, ((uint32_t)stream->source << 24) | ((uint32_t)stream->type << 16) | ((uint32_t)stream->id << 8) |
+                          stream->prio,
+                 32);
+    }
+
+    put_time(enc, stream, sample->time);
+
+    bool is_float;
+    unsigned n = components(msg->type, &is_float);
+    for (unsigned c = 0; c < n; c++) {
+        if (is_float) {
+            put_float(enc, stream, c, component_get(msg, c));
+        } else {
+            put_int(enc, stream, c, component_get(msg, c));
+        }
+    }
+    return true;
+}
+
+/**
+ * Finishes the block by padding the last byte with zeros.
+ * @param enc The encoder.
+ * @return The length of the payload in bytes.
+ */
+size_t rec_encoder_finish(rec_encoder_t *enc) {
+    if (enc->nbits > 0) put_bits(enc, 0, 8 - enc->nbits);
+    return enc->len;
+}
+
+/** Reads bits back from a payload. */
+typedef struct {
+    const uint8_t *buf; /**< The payload. */
+    size_t len;         /**< The length of the payload in bytes. */
+    size_t pos;         /**< The number of bytes moved into the accumulator, including zeros read past the end. */
+    uint64_t acc;       /**< Bits which have not been read yet, in the low bits. */
+    unsigned nbits;     /**< The number of bits in `acc`. */
+} bit_reader_t;
+
+/**
+ * Reads bits from the payload. Reading past the end of the payload returns zeros.
+ * @param reader The bit reader.
+ * @param n The number of bits to read, at most 32.
+ * @return The bits read, in the low bits.
+ */
+static inline uint32_t get_bits(bit_reader_t *reader, unsigned n) {
+    if (n == 0) return 0;
+    if (reader->nbits < n) {
+        while (reader->nbits <= 56) {
+            uint8_t byte = reader->pos < reader->len ? reader->buf[reader->pos] : 0;
+            reader->pos++;
+            reader->acc = (reader->acc << 8) | byte;
+            reader->nbits += 8;
+        }
+    }
+    reader->nbits -= n;
+    return (uint32_t)(reader->acc >> reader->nbits) & (uint32_t)((1ULL << n) - 1);
+}
+
+/**
+ * Reads a time stored by `put_time`.
+ * @param reader The bit reader.
+ * @param stream The stream the time belongs to.
+ * @return The time.
+ */
+static uint64_t get_time(bit_reader_t *reader, rec_codec_stream_t *stream) {
+    uint64_t zz;
+    if (get_bits(reader, 1) == 0) {
+        zz = 0;
+    } else if (get_bits(reader, 1) == 0) {
+        zz = get_bits(reader, 10);
+    } else if (get_bits(reader, 1) == 0) {
+        zz = get_bits(reader, 16);
+    } else if (get_bits(reader, 1) == 0) {
+        zz = get_bits(reader, 24);
+    } else {
+        zz = (uint64_t)get_bits(reader, 32) << 32;
+        zz |= get_bits(reader, 32);
+    }
+
+    uint64_t dod = (zz >> 1) ^ (0 - (zz & 1));
+    stream->delta += dod;
+    stream->time += stream->delta;
+    return stream->time;
+}
+
+/**
+ * Reads a float component stored by `put_float`.
+ * @param reader The bit reader.
+ * @param stream The stream the component belongs to.
+ * @param c The index of the component.
+ * @return The bits of the component.
+ */
+static uint32_t get_float(bit_reader_t *reader, rec_codec_stream_t *stream, unsigned c) {
+    if (get_bits(reader, 1) == 0) return stream->value[c];
+
+    if (get_bits(reader, 1) == 0) {
+        unsigned len = 32 - stream->leading[c] - stream->trailing[c];
+        stream->value[c] ^= get_bits(reader, len) << stream->trailing[c];
+        return stream->value[c];
+    }
+
+    unsigned leading = get_bits(reader, 5);
+    unsigned len = get_bits(reader, 5) + 1;
+    if (leading + len > 32) len = 32 - leading; // Only a malformed payload has a window past the end of the word
+    unsigned trailing = 32 - leading - len;
+    stream->value[c] ^= get_bits(reader, len) << trailing;
+    stream->leading[c] = (uint8_t)leading;
+    stream->trailing[c] = (uint8_t)trailing;
+    return stream->value[c];
+}
+
+/**
+ * Reads an integer component stored by `put_int`.
+ * @param reader The bit reader.
+ * @param stream The stream the component belongs to.
+ * @param c The index of the component.
+ * @return The bits of the component.
+ */
+static uint32_t get_int(bit_reader_t *reader, rec_codec_stream_t *stream, unsigned c) {
+    uint32_t zz;
+    if (get_bits(reader, 1) == 0) {
+        zz = 0;
+    } else if (get_bits(reader, 1) == 0) {
+        zz = get_bits(reader, 8);
+    } else if (get_bits(reader, 1) == 0) {
+        zz = get_bits(reader, 16);
+    } else {
+        zz = get_bits(reader, 32);
+    }
+
+    stream->value[c] += (zz >> 1) ^ (0 - (zz & 1));
+    return stream->value[c];
+}
+
+/**
+ * Decodes the payload of a `REC_ENCODING_PACKED` block.
+ * @param payload The payload.
+ * @param len The length of the payload in bytes.
+ * @param count The number of samples in the payload.
+ * @param first_time The time of the block's first sample.
+ * @param samples Where to store the samples. Must have room for `count` samples.
+ * @return True if successful, false if the payload is malformed.
+ */
+bool rec_decode_packed(const uint8_t *payload, size_t len, uint32_t count, uint64_t first_time, sample_t *samples) {
+    rec_codec_stream_t streams[REC_CODEC_STREAMS];
+    uint8_t nstreams = 0;
+    bit_reader_t reader = {.buf = payload, .len = len};
+
+    for (uint32_t i = 0; i < count; i++) {
+        sample_t *sample = &samples[i];
+        uint32_t index = get_bits(&reader, index_width(nstreams));
+        if (index > nstreams || index == REC_CODEC_STREAMS) return false;
+
+        rec_codec_stream_t *stream = &streams[index];
+        if (index == nstreams) {
+            nstreams++;
+            uint32_t desc = get_bits(&reader, 32);
+            // The encoder sets a window before it reuses one, so the windows can start out zeroed
+            *stream = (rec_codec_stream_t){
+                .source = (uint8_t)(desc >> 24),
+                .type = (uint8_t)(desc >> 16),
+                .id = (uint8_t)(desc >> 8),
+                .prio = (uint8_t)desc,
+                .time = first_time,
+            };
+        }
+
+        sample->source = stream->source;
+        sample->prio = stream->prio;
+        sample->flags = 0;
+        sample->msg.type = stream->type;
+        sample->msg.id = stream->id;
+        sample->time = get_time(&reader, stream);
+        memset(&sample->msg.data, 0, sizeof(sample->msg.data));
+
+        bool is_float;
+        unsigned n = components(stream->type, &is_float);
+        for (unsigned c = 0; c < n; c++) {
+            if (is_float) {
+                component_set(&sample->msg, c, get_float(&reader, stream, c));
+            } else {
+                component_set(&sample->msg, c, get_int(&reader, stream, c));
+            }
+        }
+    }
+
+    // Everything read must have come from the payload rather than the zeros past its end
+    return reader.pos * 8 - reader.nbits <= len * 8;
+}
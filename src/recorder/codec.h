@@ -0,0 +1,62 @@
+/**
+ * @file codec.h
+ * @brief Lossless compression of the samples in a recorder block.
+ *
+ * Lossless compression of the samples in a recorder block (`REC_ENCODING_PACKED`). The payload is a bit stream written
+ * most significant bit first. Each sample starts with the index of its stream in the block's table of streams, using
+ * just enough bits to also represent one more index; that extra index means a new stream follows, described by its
+ * source, tag, ID and priority. Then, using the state of the stream's previous sample in the block:
+ *
+ * - The time is stored as the zig-zag encoded difference between this and the previous time delta (delta-of-delta),
+ *   which is zero for perfectly periodic samples. The first sample of a stream is relative to the block's first time.
+ * - Float components are XORed with the previous value. Equal values take one bit, and other values only store the
+ *   bits between the leading and trailing zeros of the XOR, reusing the previous window when it fits (Gorilla).
+ * - Integer components store the zig-zag encoded difference from the previous value in 0, 8, 16 or 32 bits.
+ *
+ * Every block starts with empty stream state, so blocks can be decoded on their own. Only the bytes of the message data
+ * used by the tag's data type are stored; the rest of the data is zero after decoding.
+ */
+#ifndef _CODEC_H_
+#define _CODEC_H_
+
+#include "../pipeline/sample.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The maximum number of streams in one packed block. */
+#define REC_CODEC_STREAMS 32
+
+/** The maximum number of bytes a single packed sample can take, including a new stream's description. */
+#define REC_CODEC_MAX_SAMPLE 48
+
+/** The state of one stream within a block, shared by the encoder and the decoder. */
+typedef struct {
+    uint8_t source;      /**< The index of the collector which produced the stream. */
+    uint8_t type;        /**< The tag of the stream. */
+    uint8_t id;          /**< The sensor ID byte of the stream's messages. */
+    uint8_t prio;        /**< The message queue priority of the stream's messages. */
+    uint64_t time;       /**< The time of the previous sample. */
+    uint64_t delta;      /**< The difference between the times of the previous two samples. */
+    uint32_t value[3];   /**< The bits of each component of the previous sample. */
+    uint8_t leading[3];  /**< The leading zeros of the window used for each float component, or 0xff if unset. */
+    uint8_t trailing[3]; /**< The trailing zeros of the window used for each float component. */
+} rec_codec_stream_t;
+
+/** Packs samples into the payload of a block. */
+typedef struct {
+    uint8_t *buf;                                   /**< Where the payload is written. */
+    size_t len;                                     /**< The number of whole bytes written to `buf`. */
+    uint64_t acc;                                   /**< Bits which do not make up a whole byte yet, in the low bits. */
+    uint8_t nbits;                                  /**< The number of bits in `acc`. */
+    uint64_t first_time;                            /**< The time of the block's first sample. */
+    uint8_t nstreams;                               /**< The number of streams in the block so far. */
+    rec_codec_stream_t streams[REC_CODEC_STREAMS];  /**< The state of each stream in the block. */
+} rec_encoder_t;
+
+void rec_encoder_begin(rec_encoder_t *enc, uint8_t *buf, uint64_t first_time);
+bool rec_encoder_add(rec_encoder_t *enc, const sample_t *sample);
+size_t rec_encoder_finish(rec_encoder_t *enc);
+bool rec_decode_packed(const uint8_t *payload, size_t len, uint32_t count, uint64_t first_time, sample_t *samples);
+
+#endif // _CODEC_H_
@@ -0,0 +1,240 @@
+/**
+ * @file reader.c
+ * @brief Reads samples back from the segment files of the flight recorder.
+ *
+ * Reads samples back from the segment files of the flight recorder. A segment and its index are memory mapped, so
+ * seeking is a binary search over the index followed by a jump straight to the block where the requested stream
+ * continues. Blocks are checked against their CRC before their samples are handed out, and reading stops at the first
+ * block which does not check out.
+ */
+#include "recorder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Maps a whole file for reading.
+ * @param path The path of the file.
+ * @param len Where to store the length of the file.
+ * @return The read-only mapping, or NULL if the file could not be mapped (`errno` is set) or is empty.
+ */
+static void *map_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // The mapping stays valid without the descriptor
+    if (map == MAP_FAILED) return NULL;
+    *len = (size_t)st.st_size;
+    return map;
+}
+
+/**
+ * Opens a segment of a recording, along with its index if there is one, and prepares to read all of its samples.
+ * @param reader Storage for the state of the reader.
+ * @param path The path of the segment file.
+ * @return EOK if successful, EINVAL if the file is not a valid segment, otherwise the error from mapping the file.
+ */
+int rec_reader_open(rec_reader_t *reader, const char *path) {
+    generate_crc32_lookup(&reader->crc, REC_CRC32_POLY);
+
+    reader->map = map_file(path, &reader->len);
+    if (reader->map == NULL) return errno;
+
+    reader->hdr = (const rec_segment_hdr_t *)reader->map;
+    const rec_segment_hdr_t *hdr = reader->hdr;
+    if (reader->len < sizeof(*hdr) || hdr->magic != REC_SEGMENT_MAGIC || hdr->version != REC_VERSION ||
+        hdr->hdr_len < sizeof(*hdr) || hdr->hdr_len > reader->len ||
+        ~calculate_crc32(reader->map, offsetof(rec_segment_hdr_t, crc), &reader->crc, UINT32_MAX) != hdr->crc) {
+        munmap(reader->map, reader->len);
+        return EINVAL;
+    }
+
+    // The index is named like the segment, with the extension swapped; without one, seeking scans the segment
+    char index_path[REC_PATH_MAX];
+    const char *ext = strrchr(path, '.');
+    size_t stem = ext == NULL ? strlen(path) : (size_t)(ext - path);
+    reader->index = NULL;
+    reader->nindex = 0;
+    if (stem + sizeof(".idx") <= sizeof(index_path)) {
+        memcpy(index_path, path, stem);
+        memcpy(&index_path[stem], ".idx", sizeof(".idx"));
+        reader->index = map_file(index_path, &reader->index_len);
+        if (reader->index != NULL) reader->nindex = reader->index_len / sizeof(rec_index_entry_t);
+    }
+
+    rec_reader_seek(reader, NULL, 0, UINT64_MAX);
+    return EOK;
+}
+
+/**
+ * Closes a segment and its index.
+ * @param reader The reader.
+ */
+void rec_reader_close(rec_reader_t *reader) {
+    munmap(reader->map, reader->len);
+    if (reader->index != NULL) munmap(reader->index, reader->index_len);
+}
+
+/**
+ * Checks whether a sample belongs to a stream.
+ * @param sample The sample.
+ * @param stream The stream.
+ * @return True if the sample belongs to the stream, false otherwise.
+ */
+static bool in_stream(const sample_t *sample, const rec_stream_t *stream) {
+    rec_stream_t s = rec_stream_of(sample);
+    return s.source == stream->source && s.type == stream->type && s.id == stream->id;
+}
+
+/**
+ * Uses the index to find the block where reading a stream from a given time should start.
+ * @param reader The reader.
+ * @param stream The stream to read, or NULL for all streams.
+ * @param start The time to start reading from.
+ * @return The offset of the block to start reading from.
+ */
+static size_t index_find(const rec_reader_t *reader, const rec_stream_t *stream, uint64_t start) {
+    // Find the first entry at or after the start time, so the entries just before it are the latest usable checkpoint.
+    // A checkpoint's time is the latest of the samples before it, so those at the start time may still come before it.
+    size_t lo = 0;
+    size_t hi = reader->nindex;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (reader->index[mid].time < start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == 0) return reader->hdr->hdr_len;
+
+    // Within the checkpoint, prefer the stream's own entry, which also covers its samples from before the checkpoint.
+    // Without one, the stream has no samples before the checkpoint in this segment.
+    uint64_t time = reader->index[lo - 1].time;
+    size_t offset = reader->hdr->hdr_len;
+    for (size_t i = lo; i > 0 && reader->index[i - 1].time == time; i--) {
+        const rec_index_entry_t *entry = &reader->index[i - 1];
+        if (entry->flags & REC_INDEX_ALL) {
+            offset = entry->offset;
+            if (stream == NULL) break;
+        } else if (stream != NULL && entry->source == stream->source && entry->type == stream->type &&
+                   entry->id == stream->id) {
+            offset = entry->offset;
+            break;
+        }
+    }
+
+    // An index left behind by a crash may point past the valid blocks; scan from the start rather than read nothing
+    if (offset < reader->hdr->hdr_len || offset >= reader->len || offset % REC_ALIGN != 0) {
+        return reader->hdr->hdr_len;
+    }
+    return offset;
+}
+
+/**
+ * Positions the reader at the start of a time range. Subsequent reads return the samples in the range, optionally only
+ * those of one stream.
+ * @param reader The reader.
+ * @param stream The stream to read, or NULL to read all streams.
+ * @param start The time (nanoseconds since the pipeline started) of the first samples to read.
+ * @param end The time of the last samples to read.
+ */
+void rec_reader_seek(rec_reader_t *reader, const rec_stream_t *stream, uint64_t start, uint64_t end) {
+    reader->filter = stream != NULL;
+    if (stream != NULL) reader->stream = *stream;
+    reader->start = start;
+    reader->end = end;
+    reader->count = 0;
+    reader->pos = 0;
+    reader->offset = index_find(reader, stream, start);
+}
+
+/**
+ * Checks and decodes the next block into the reader's sample buffer. Blocks whose samples are all outside the time
+ * range are skipped without being decoded, and the range ends with the first block whose samples are all more than
+ * REC_MAX_LATE_NS after it.
+ * @param reader The reader.
+ * @return True if a block was loaded, false if there are no more valid blocks in the range.
+ */
+static bool load_block(rec_reader_t *reader) {
+    for (;;) {
+        if (reader->offset + sizeof(rec_block_hdr_t) > reader->len) return false;
+
+        const rec_block_hdr_t *block = (const rec_block_hdr_t *)&reader->map[reader->offset];
+        const uint8_t *payload = &reader->map[reader->offset + sizeof(*block)];
+        if (block->magic != REC_BLOCK_MAGIC || block->len > REC_BLOCK_MAX || block->count > REC_BLOCK_SAMPLES ||
+            block->len > reader->len - reader->offset - sizeof(*block)) {
+            return false;
+        }
+        // Samples up to REC_MAX_LATE_NS late may still follow a block which is past the range
+        if (block->min_time > reader->end && block->min_time - reader->end > REC_MAX_LATE_NS) return false;
+
+        size_t next = rec_align(reader->offset + sizeof(*block) + block->len);
+        if (block->max_time < reader->start || block->min_time > reader->end) {
+            reader->offset = next;
+            continue;
+        }
+
+        const uint8_t *hdr = (const uint8_t *)block;
+        uint32_t crc = calculate_crc32(hdr, offsetof(rec_block_hdr_t, crc), &reader->crc, UINT32_MAX);
+        if (~calculate_crc32(payload, block->len, &reader->crc, crc) != block->crc) return false;
+
+        if (block->encoding == REC_ENCODING_PACKED) {
+            if (!rec_decode_packed(payload, block->len, block->count, block->first_time, reader->samples)) return false;
+        } else if (block->encoding == REC_ENCODING_RAW && block->len == block->count * sizeof(rec_raw_t)) {
+            const rec_raw_t *raw = (const rec_raw_t *)payload;
+            for (uint32_t i = 0; i < block->count; i++) {
+                rec_decode_raw(&reader->samples[i], &raw[i]);
+            }
+        } else {
+            return false;
+        }
+
+        reader->count = block->count;
+        reader->pos = 0;
+        reader->offset = next;
+        return true;
+    }
+}
+
+/**
+ * Reads the next samples in the range the reader was positioned at.
+ * @param reader The reader.
+ * @param samples Where to store the samples.
+ * @param max The maximum number of samples to read.
+ * @return The number of samples read. Less than `max` only once the range or the valid part of the segment has ended.
+ */
+size_t rec_reader_read(rec_reader_t *reader, sample_t *samples, size_t max) {
+    size_t n = 0;
+    while (n < max) {
+        if (reader->pos == reader->count) {
+            if (!load_block(reader)) break;
+            continue;
+        }
+
+        const sample_t *sample = &reader->samples[reader->pos++];
+        if (reader->filter && !in_stream(sample, &reader->stream)) continue;
+        // Samples published late can follow later ones, so the range only ends with a block well past it
+        if (sample->time < reader->start || sample->time > reader->end) continue;
+        samples[n++] = *sample;
+    }
+    return n;
+}
@@ -0,0 +1,442 @@
+/**
+ * @file recorder.c
+ * @brief Writes samples into the preallocated, memory mapped segment files of the flight recorder.
+ *
+ * Writes samples into the preallocated, memory mapped segment files of the flight recorder. Samples are encoded
+ * straight into the payload of the open block in the mapping, either raw or packed by the codec. When the block is
+ * full, or when the sync policy says so, the block is sealed by writing its header and CRC in front of the payload, and
+ * the sealed blocks are synced to storage with `msync`. A new segment is started when the current one has no room left
+ * for another sample.
+ *
+ * The index costs one table lookup per sample to remember the block holding each stream's latest sample. Every
+ * `index_ms` those offsets are appended to a buffer as a checkpoint. The buffer is written to the index file on each
+ * sync, so the index normally only points at data which has been synced.
+ */
+#include "recorder.h"
+#include "../logging-utils/logging.h"
+#include "../pipeline/pipeline.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+_Static_assert(sizeof(rec_raw_t) == 24, "Raw samples must be packed into 24 bytes");
+_Static_assert(sizeof(rec_index_entry_t) == 16, "Index entries must be packed into 16 bytes");
+_Static_assert(sizeof(((rec_raw_t *)0)->data) == sizeof(((common_t *)0)->data), "Raw samples must fit any message");
+
+/**
+ * Encodes a sample as a raw sample.
+ * @param raw Where to store the raw sample.
+ * @param sample The sample to encode.
+ */
+void rec_encode_raw(rec_raw_t *raw, const sample_t *sample) {
+    raw->time = sample->time;
+    raw->source = sample->source;
+    raw->prio = sample->prio;
+    raw->type = sample->msg.type;
+    raw->id = sample->msg.id;
+    memcpy(raw->data, &sample->msg.data, sizeof(raw->data));
+}
+
+/**
+ * Decodes a raw sample.
+ * @param sample Where to store the decoded sample.
+ * @param raw The raw sample to decode.
+ */
+void rec_decode_raw(sample_t *sample, const rec_raw_t *raw) {
+    sample->time = raw->time;
+    sample->source = raw->source;
+    sample->prio = raw->prio;
+    sample->flags = 0;
+    sample->msg.type = raw->type;
+    sample->msg.id = raw->id;
+    memcpy(&sample->msg.data, raw->data, sizeof(raw->data));
+}
+
+/**
+ * Gets the stream a sample belongs to. The ID is only part of the stream for tags which have IDs, since it is not set
+ * for other tags.
+ * @param sample The sample.
+ * @return The stream of the sample.
+ */
+rec_stream_t rec_stream_of(const sample_t *sample) {
+    uint8_t type = sample->msg.type;
+    bool has_id = type < SENSOR_TAG_COUNT && SENSOR_TAG_DATA[type].has_id;
+    return (rec_stream_t){.source = sample->source, .type = type, .id = has_id ? sample->msg.id : 0};
+}
+
+/**
+ * Writes the entire buffer to a file descriptor, continuing after partial writes.
+ * @param fd The file descriptor to write to.
+ * @param buf The data to write.
+ * @param nbytes The number of bytes to write.
+ * @return EOK if successful, otherwise the error from writing.
+ */
+static int write_all(int fd, const void *buf, size_t nbytes) {
+    const uint8_t *cur = buf;
+    while (nbytes > 0) {
+        ssize_t written = write(fd, cur, nbytes);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        cur += written;
+        nbytes -= (size_t)written;
+    }
+    return EOK;
+}
+
+/**
+ * Writes the buffered index entries to the index file.
+ * @param rec The recorder.
+ * @return EOK if successful, otherwise the error from writing.
+ */
+static int index_flush(recorder_t *rec) {
+    if (rec->index_fd == -1 || rec->nindex == 0) return EOK;
+    int err = write_all(rec->index_fd, rec->index, rec->nindex * sizeof(rec_index_entry_t));
+    rec->nindex = 0;
+    return err;
+}
+
+/**
+ * Finds the slot of a stream, claiming a free slot if the stream has not been seen before.
+ * @param rec The recorder.
+ * @param stream The stream to find.
+ * @return The stream's slot, or NULL if the stream is new and no more streams can be tracked.
+ */
+static rec_index_slot_t *index_slot(recorder_t *rec, rec_stream_t stream) {
+    uint32_t key = (((uint32_t)stream.source << 16) | ((uint32_t)stream.type << 8) | stream.id) + 1;
+    uint32_t i = (key * 2654435761U) >> 25; // Fibonacci hashing into the 7 bits of REC_INDEX_SLOTS
+    for (;;) {
+        rec_index_slot_t *slot = &rec->slots[i];
+        if (slot->key == key) return slot;
+        if (slot->key == 0) {
+            if (rec->nstreams == REC_INDEX_STREAMS) return NULL;
+            slot->key = key;
+            slot->in_segment = false;
+            rec->streams[rec->nstreams++] = (uint8_t)i;
+            return slot;
+        }
+        i = (i + 1) % REC_INDEX_SLOTS;
+    }
+}
+
+/**
+ * Adds a checkpoint to the index for the samples written so far.
+ * @param rec The recorder.
+ * @param time The time of the checkpoint, which must not be before any sample written so far.
+ * @return EOK if successful, otherwise the error from writing buffered entries to make room.
+ */
+static int index_checkpoint(recorder_t *rec, uint64_t time) {
+    if (rec->nindex + rec->nstreams + 1 > REC_INDEX_BUFFER_LEN) {
+        int err = index_flush(rec);
+        if (err != EOK) return err;
+    }
+
+    // Any sample after the checkpoint is at or after the block the next sample goes into
+    rec->index[rec->nindex++] =
+        (rec_index_entry_t){.time = time, .offset = (uint32_t)rec->offset, .flags = REC_INDEX_ALL};
+
+    for (uint8_t i = 0; i < rec->nstreams; i++) {
+        const rec_index_slot_t *slot = &rec->slots[rec->streams[i]];
+        if (!slot->in_segment) continue;
+
+        uint32_t key = slot->key - 1;
+        rec->index[rec->nindex++] = (rec_index_entry_t){
+            .time = time,
+            .offset = slot->offset,
+            .source = (uint8_t)(key >> 16),
+            .type = (uint8_t)(key >> 8),
+            .id = (uint8_t)key,
+        };
+    }
+    return EOK;
+}
+
+/**
+ * Creates, preallocates and maps the next segment file, then writes its header.
+ * @param rec The recorder.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int segment_create(recorder_t *rec) {
+    // Skip sequence numbers which are taken, so that earlier recordings are never overwritten
+    for (;;) {
+        int len = snprintf(rec->path, sizeof(rec->path), "%s/fetcher-%06u.rec", rec->config.dir, rec->seq);
+        if (len < 0 || (size_t)len >= sizeof(rec->path)) return ENAMETOOLONG;
+
+        rec->fd = open(rec->path, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (rec->fd != -1) break;
+        if (errno != EEXIST) return errno;
+        rec->seq++;
+    }
+    if (rec->first_seq == UINT32_MAX) rec->first_seq = rec->seq;
+
+    // Reserve the whole segment up front, so writing through the mapping can never run out of space mid-flight
+    int err = posix_fallocate(rec->fd, 0, rec->config.segment_len);
+    if (err == EINVAL || err == EOPNOTSUPP) {
+        err = ftruncate(rec->fd, rec->config.segment_len) == -1 ? errno : EOK;
+    }
+    if (err == EOK) {
+        rec->map = mmap(NULL, rec->config.segment_len, PROT_READ | PROT_WRITE, MAP_SHARED, rec->fd, 0);
+        if (rec->map == MAP_FAILED) err = errno;
+    }
+    if (err != EOK) {
+        close(rec->fd);
+        unlink(rec->path);
+        rec->fd = -1;
+        return err;
+    }
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    rec_segment_hdr_t hdr = {
+        .magic = REC_SEGMENT_MAGIC,
+        .version = REC_VERSION,
+        .hdr_len = sizeof(rec_segment_hdr_t),
+        .seq = rec->seq,
+        .first_seq = rec->first_seq,
+        .mono_time = pipeline_time(),
+        .wall_time = (int64_t)wall.tv_sec * (int64_t)NS_PER_SEC + wall.tv_nsec,
+    };
+    hdr.crc = ~calculate_crc32((const uint8_t *)&hdr, offsetof(rec_segment_hdr_t, crc), &rec->crc, UINT32_MAX);
+    memcpy(rec->map, &hdr, sizeof(hdr));
+
+    rec->offset = rec_align(sizeof(hdr));
+    rec->synced = 0;
+    for (uint8_t i = 0; i < rec->nstreams; i++) {
+        rec->slots[rec->streams[i]].in_segment = false;
+    }
+    if (rec->config.index_ms == 0) return EOK;
+
+    // The index is named like the segment, with the extension swapped
+    char index_path[REC_PATH_MAX];
+    memcpy(index_path, rec->path, sizeof(index_path));
+    memcpy(strrchr(index_path, '.'), ".idx", 4);
+    rec->index_fd = open(index_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (rec->index_fd == -1) {
+        // Readers can still scan the segment, so losing the index is not worth losing the recording
+        log_print(stderr, LOG_WARN, "Could not create index '%s': %s", index_path, strerror(errno));
+    }
+    return EOK;
+}
+
+/**
+ * Gets the most bytes one more sample can add to a block.
+ * @param rec The recorder.
+ * @return The most bytes one sample can take in the configured encoding.
+ */
+static size_t sample_max_len(const recorder_t *rec) {
+    return rec->config.encoding == REC_ENCODING_PACKED ? REC_CODEC_MAX_SAMPLE : sizeof(rec_raw_t);
+}
+
+/**
+ * Seals the open block by writing its header in front of its payload. Does nothing if no block is open.
+ * @param rec The recorder.
+ */
+static void block_seal(recorder_t *rec) {
+    rec_block_hdr_t *block = &rec->block;
+    if (block->count == 0) return;
+
+    block->magic = REC_BLOCK_MAGIC;
+    block->encoding = rec->config.encoding;
+    if (block->encoding == REC_ENCODING_PACKED) block->len = (uint32_t)rec_encoder_finish(&rec->enc);
+    uint32_t crc = calculate_crc32((const uint8_t *)block, offsetof(rec_block_hdr_t, crc), &rec->crc, UINT32_MAX);
+    crc = calculate_crc32(&rec->map[rec->offset + sizeof(rec_block_hdr_t)], block->len, &rec->crc, crc);
+    block->crc = ~crc;
+    memcpy(&rec->map[rec->offset], block, sizeof(*block));
+
+    rec->offset = rec_align(rec->offset + sizeof(rec_block_hdr_t) + block->len);
+    uint64_t dropped = block->dropped;
+    memset(block, 0, sizeof(*block));
+    block->dropped = dropped;
+}
+
+/**
+ * Appends a sample to the open block, opening a block if there is none. The block must have room for the sample.
+ * @param rec The recorder.
+ * @param sample The sample to append.
+ * @return True if the sample was appended, false if the block has no room for another stream.
+ */
+static bool block_append(recorder_t *rec, const sample_t *sample) {
+    rec_block_hdr_t *block = &rec->block;
+    uint8_t *payload = &rec->map[rec->offset + sizeof(rec_block_hdr_t)];
+    if (block->count == 0) {
+        block->first_time = sample->time;
+        block->min_time = sample->time;
+        block->max_time = sample->time;
+        if (rec->config.encoding == REC_ENCODING_PACKED) rec_encoder_begin(&rec->enc, payload, sample->time);
+    }
+
+    if (rec->config.encoding == REC_ENCODING_PACKED) {
+        if (!rec_encoder_add(&rec->enc, sample)) return false;
+        block->len = (uint32_t)rec->enc.len;
+    } else {
+        rec_encode_raw((rec_raw_t *)&payload[block->len], sample);
+        block->len += sizeof(rec_raw_t);
+    }
+    if (sample->time < block->min_time) block->min_time = sample->time;
+    if (sample->time > block->max_time) block->max_time = sample->time;
+    block->count++;
+    return true;
+}
+
+/**
+ * Seals the open block and syncs everything written to the segment since the last sync.
+ * @param rec The recorder.
+ * @return EOK if successful, otherwise the error from syncing.
+ */
+int recorder_sync(recorder_t *rec) {
+    if (rec->fd == -1) return EOK;
+    block_seal(rec);
+    rec->last_sync = pipeline_time();
+    if (rec->offset == rec->synced) return EOK;
+
+    // msync needs a page aligned address, so start from the page holding the first unsynced byte
+    size_t start = rec->synced & ~((size_t)sysconf(_SC_PAGESIZE) - 1);
+    if (msync(&rec->map[start], rec->offset - start, MS_SYNC) == -1) return errno;
+    rec->synced = rec->offset;
+    return index_flush(rec);
+}
+
+/**
+ * Syncs and closes the current segment, giving back the preallocated space it did not use.
+ * @param rec The recorder.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int segment_close(recorder_t *rec) {
+    int err = recorder_sync(rec);
+    munmap(rec->map, rec->config.segment_len);
+    if (ftruncate(rec->fd, (off_t)rec->offset) == -1 && err == EOK) err = errno;
+    close(rec->fd);
+    rec->fd = -1;
+    if (rec->index_fd != -1) {
+        close(rec->index_fd);
+        rec->index_fd = -1;
+    }
+    return err;
+}
+
+/**
+ * Closes the current segment and creates the next one.
+ * @param rec The recorder.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+static int segment_rotate(recorder_t *rec) {
+    int err = segment_close(rec);
+    if (err != EOK) return err;
+
+    rec->seq++;
+    return segment_create(rec);
+}
+
+/**
+ * Ends the recording, syncing and closing the current segment.
+ * @param rec The recorder.
+ * @return EOK if successful, otherwise the error which occurred.
+ */
+int recorder_close(recorder_t *rec) {
+    if (rec->fd == -1) return EOK;
+    return segment_close(rec);
+}
+
+/**
+ * Starts a recording in the first unused segment of the configured directory.
+ * @param rec Storage for the state of the recording.
+ * @param config How the recorder is set up. Copied into the recorder.
+ * @return EOK if successful, EINVAL if the encoding is unknown or segments are too small to hold a block, otherwise the
+ * error from creating the first segment.
+ */
+int recorder_open(recorder_t *rec, const rec_config_t *config) {
+    if (config->encoding != REC_ENCODING_RAW && config->encoding != REC_ENCODING_PACKED) return EINVAL;
+    if (config->segment_len < sizeof(rec_segment_hdr_t) + sizeof(rec_block_hdr_t) + REC_CODEC_MAX_SAMPLE) {
+        return EINVAL;
+    }
+
+    rec->config = *config;
+    generate_crc32_lookup(&rec->crc, REC_CRC32_POLY);
+    rec->fd = -1;
+    rec->index_fd = -1;
+    rec->seq = 0;
+    rec->first_seq = UINT32_MAX;
+    memset(&rec->block, 0, sizeof(rec->block));
+    rec->last_sync = pipeline_time();
+    rec->max_time = 0;
+    rec->late = 0;
+    rec->next_checkpoint = 0;
+    memset(rec->slots, 0, sizeof(rec->slots));
+    rec->nstreams = 0;
+    rec->nindex = 0;
+    return segment_create(rec);
+}
+
+/**
+ * Appends samples to the recording, then syncs if the sync policy says so.
+ * @param rec The recorder.
+ * @param samples The samples to record, in the order they were published.
+ * @param n The number of samples to record.
+ * @param dropped The total number of samples dropped before reaching the recorder, which is stored with each block.
+ * @return EOK if successful, otherwise the error from syncing or starting a new segment. If a new segment could not be
+ * started, the samples are lost and the next write tries again.
+ */
+int recorder_write(recorder_t *rec, const sample_t *samples, size_t n, uint64_t dropped) {
+    // Starting a new segment failed last time, so try again
+    if (rec->fd == -1) {
+        int err = segment_create(rec);
+        if (err != EOK) return err;
+    }
+    rec->block.dropped = dropped;
+
+    size_t max_len = sample_max_len(rec);
+    for (size_t i = 0; i < n; i++) {
+        // Retried with a new block when a packed block has no room for another stream
+        for (bool appended = false; !appended;) {
+            size_t payload_end = rec->offset + sizeof(rec_block_hdr_t) + rec->block.len + max_len;
+            if (rec->block.count == REC_BLOCK_SAMPLES || rec->block.len + max_len > REC_BLOCK_MAX ||
+                payload_end > rec->config.segment_len) {
+                block_seal(rec);
+                if (rec->offset + sizeof(rec_block_hdr_t) + max_len > rec->config.segment_len) {
+                    int err = segment_rotate(rec);
+                    if (err != EOK) return err;
+                }
+            }
+
+            if (rec->config.index_ms != 0 && samples[i].time >= rec->next_checkpoint) {
+                int err = index_checkpoint(rec, rec->max_time);
+                if (err != EOK) return err;
+                rec->next_checkpoint = samples[i].time + rec->config.index_ms * NS_PER_MS;
+            }
+
+            appended = block_append(rec, &samples[i]);
+            if (!appended) block_seal(rec);
+        }
+        if (samples[i].time > rec->max_time) {
+            rec->max_time = samples[i].time;
+        } else if (rec->max_time - samples[i].time > REC_MAX_LATE_NS && rec->late++ == 0) {
+            log_print(stderr, LOG_WARN, "Recorded a sample %llu ms late, reads of its time range may miss it",
+                      (unsigned long long)((rec->max_time - samples[i].time) / NS_PER_MS));
+        }
+
+        rec_index_slot_t *slot = index_slot(rec, rec_stream_of(&samples[i]));
+        if (slot != NULL) {
+            slot->offset = (uint32_t)rec->offset;
+            slot->in_segment = true;
+        }
+    }
+
+    size_t unsynced = rec->offset - rec->synced + rec->block.len;
+    bool bytes_due = rec->config.sync_bytes != 0 && unsynced >= rec->config.sync_bytes;
+    bool time_due = rec->config.sync_ms != 0 && pipeline_time() - rec->last_sync >= rec->config.sync_ms * NS_PER_MS;
+    if (bytes_due || time_due) return recorder_sync(rec);
+    return EOK;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file recorder.h
+ * @brief The on-disk format of fetcher's flight recorder, and functions for writing and reading it.
+ *
+ * The flight recorder stores samples in a series of segment files named `fetcher-<seq>.rec`. Each segment is
+ * preallocated and memory mapped, so that appending samples is a copy into memory and no disk space has to be found
+ * mid-flight. A segment starts with a `rec_segment_hdr_t`, followed by blocks of samples. Every block starts with a
+ * `rec_block_hdr_t` whose CRC covers the header and the payload. Blocks are synced to storage according to the sync
+ * policy, so a power cut loses at most the samples after the last synced block. Readers stop at the first block whose
+ * magic or CRC does not match, which is where the recording ended.
+ *
+ * Next to each segment, a sparse index `fetcher-<seq>.idx` is written so that readers can seek to a time range without
+ * scanning the segment. Every `index_ms` a checkpoint is appended to the index: one `REC_INDEX_ALL` entry holding the
+ * offset of the block the next sample goes into, followed by one entry per stream (collector, tag and ID) holding the
+ * offset of the block with the stream's latest sample. All entries of a checkpoint share its time, which is the latest
+ * time of the samples written before it. Checkpoints are thus in time order even though samples published late are
+ * not, so a reader finds the checkpoint before a time with a binary search. Each block also records the earliest and
+ * latest time of its samples, so readers can skip blocks outside a time range. A sample may be recorded after samples
+ * up to REC_MAX_LATE_NS newer than itself, so a read of a time range only ends at a block whose samples are all more
+ * than that past the range. The index is only a shortcut; a missing
+ * or short index just means more of the segment is scanned.
+ *
+ * All fields are stored in the byte order of the host, which is little endian on every target fetcher runs on.
+ */
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include "../crc-utils/crc.h"
+#include "../pipeline/sample.h"
+#include "codec.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Identifies a recorder segment file ("FREC"). */
+#define REC_SEGMENT_MAGIC 0x43455246
+
+/** Marks the start of a block of samples ("BLCK"). */
+#define REC_BLOCK_MAGIC 0x4b434c42
+
+/** The version of the recorder format. */
+#define REC_VERSION 1
+
+/** The maximum length of a segment file's path. */
+#define REC_PATH_MAX 256
+
+/** The maximum number of payload bytes in one block. */
+#define REC_BLOCK_MAX (64 * 1024)
+
+/** Blocks start on multiples of this many bytes, so that headers and samples can be accessed in place. */
+#define REC_ALIGN 8
+
+/** Rounds a segment offset up to the next block boundary. */
+#define rec_align(offset) (((offset) + REC_ALIGN - 1) & ~(size_t)(REC_ALIGN - 1))
+
+/** The reversed polynomial of the CRC-32 protecting every block. */
+#define REC_CRC32_POLY 0xedb88320
+
+/** The default size of each segment in bytes. */
+#define REC_DEFAULT_SEGMENT_LEN (64 * 1024 * 1024)
+
+/** The default maximum time between syncs in milliseconds. */
+#define REC_DEFAULT_SYNC_MS 100
+
+/** The default maximum number of bytes written between syncs. */
+#define REC_DEFAULT_SYNC_BYTES (256 * 1024)
+
+/** The default time between index checkpoints in milliseconds. */
+#define REC_DEFAULT_INDEX_MS 100
+
+/** The maximum number of streams that get their own index entries. Other streams rely on `REC_INDEX_ALL` entries. */
+#define REC_INDEX_STREAMS 64
+
+/** The number of slots in the table of streams. A power of two, larger than REC_INDEX_STREAMS. */
+#define REC_INDEX_SLOTS 128
+
+/** The number of index entries buffered before they are written to the index file. */
+#define REC_INDEX_BUFFER_LEN 512
+
+/** Marks the entry of a checkpoint which applies to every stream, rather than to a single one. */
+#define REC_INDEX_ALL 0x01
+
+/** How the samples in a block's payload are encoded. */
+typedef enum {
+    REC_ENCODING_RAW = 0,    /**< An array of `rec_raw_t`. */
+    REC_ENCODING_PACKED = 1, /**< Compressed per stream, as described in codec.h. */
+} rec_encoding_e;
+
+/** The header at the start of every segment file. */
+typedef struct {
+    uint32_t magic;     /**< Always REC_SEGMENT_MAGIC. */
+    uint16_t version;   /**< The version of the format, REC_VERSION. */
+    uint16_t hdr_len;   /**< The length of this header, which is where the first block starts. */
+    uint32_t seq;       /**< The sequence number of the segment, which is also in its file name. */
+    uint32_t first_seq; /**< The sequence number of the first segment of the same recording. */
+    uint64_t mono_time; /**< The sample time (nanoseconds since the pipeline started) when the segment was created. */
+    int64_t wall_time;  /**< CLOCK_REALTIME in nanoseconds at the same moment as `mono_time`. */
+    uint32_t reserved2; /**< Zero. */
+    uint32_t crc;       /**< The CRC-32 of all the bytes before this field. */
+} rec_segment_hdr_t;
+
+/** The header at the start of every block. */
+typedef struct {
+    uint32_t magic;      /**< Always REC_BLOCK_MAGIC. */
+    uint32_t len;        /**< The number of payload bytes following the header. */
+    uint32_t count;      /**< The number of samples in the payload. */
+    uint16_t encoding;   /**< How the payload is encoded, one of `rec_encoding_e`. */
+    uint16_t reserved;   /**< Zero. */
+    uint64_t dropped;    /**< The number of samples the recorder had dropped when the block was written. */
+    uint64_t first_time; /**< The time of the first sample in the block, which packed payloads are encoded from. */
+    uint64_t min_time;   /**< The earliest time of the samples in the block. */
+    uint64_t max_time;   /**< The latest time of the samples in the block. */
+    uint32_t reserved2;  /**< Zero. */
+    uint32_t crc;        /**< The CRC-32 of all the bytes of the header before this field, followed by the payload. */
+} rec_block_hdr_t;
+
+/** One sample as stored in a `REC_ENCODING_RAW` payload. */
+typedef struct {
+    uint64_t time;    /**< Acquisition time in nanoseconds since the pipeline was started. */
+    uint8_t source;   /**< The index of the collector which produced the sample. */
+    uint8_t prio;     /**< The message queue priority of the sample. */
+    uint8_t type;     /**< The tag of the message. */
+    uint8_t id;       /**< The sensor ID of the message. */
+    uint8_t data[12]; /**< The data of the message, as laid out in `common_t`. */
+} rec_raw_t;
+
+/**
+ * How much older than the latest sample recorded before it a sample may be, in nanoseconds. Readers look this far past
+ * the end of a time range for samples published late. Later samples are still recorded, but reads of a time range
+ * which ends before the latest sample recorded ahead of them can miss them.
+ */
+#define REC_MAX_LATE_NS (2000 * 1000000ULL)
+
+/** The maximum number of samples in one block, which bounds the memory a reader needs to decode it. */
+#define REC_BLOCK_SAMPLES 4096
+
+/** Identifies a stream of samples: one tag from one collector, and one sensor ID for tags which have IDs. */
+typedef struct {
+    uint8_t source; /**< The index of the collector which produces the stream. */
+    uint8_t type;   /**< The tag of the stream. */
+    uint8_t id;     /**< The sensor ID of the stream, or 0 if the tag has no IDs. */
+} rec_stream_t;
+
+/** One entry of a segment's index. */
+typedef struct {
+    uint64_t time;   /**< The time of the checkpoint this entry belongs to. */
+    uint32_t offset; /**< The offset in the segment of the block where reading the stream should start. */
+    uint8_t source;  /**< The source of the stream, unless this is a REC_INDEX_ALL entry. */
+    uint8_t type;    /**< The tag of the stream, unless this is a REC_INDEX_ALL entry. */
+    uint8_t id;      /**< The sensor ID of the stream, unless this is a REC_INDEX_ALL entry. */
+    uint8_t flags;   /**< REC_INDEX_ALL, or 0 for the entry of a single stream. */
+} rec_index_entry_t;
+
+/** What the recorder knows about one stream while writing the index. */
+typedef struct {
+    uint32_t key;    /**< The stream's source, type and ID packed together plus one, or 0 if the slot is free. */
+    uint32_t offset; /**< The offset of the block with the stream's latest sample in the current segment. */
+    bool in_segment; /**< Whether the stream has a sample in the current segment. */
+} rec_index_slot_t;
+
+/** How the recorder is set up. */
+typedef struct {
+    const char *dir;      /**< The directory to create segment files in. */
+    uint32_t segment_len; /**< The size each segment file is preallocated to, in bytes. */
+    uint32_t sync_ms;     /**< The maximum time between syncs in milliseconds, or 0 to only sync by size. */
+    uint32_t sync_bytes;  /**< The maximum number of bytes written between syncs, or 0 to only sync by time. */
+    uint32_t index_ms;    /**< The time between index checkpoints in milliseconds, or 0 to not write an index. */
+    uint16_t encoding;    /**< How block payloads are encoded, one of `rec_encoding_e`. */
+} rec_config_t;
+
+/** The state of a recording. The memory must be provided by the user. */
+typedef struct {
+    /** How the recorder is set up. */
+    rec_config_t config;
+    /** The lookup table for block CRCs. */
+    CRC32LookupTable crc;
+    /** The path of the current segment file. */
+    char path[REC_PATH_MAX];
+    /** The file descriptor of the current segment, or -1 if there is none. */
+    int fd;
+    /** The sequence number of the current segment. */
+    uint32_t seq;
+    /** The sequence number of the first segment of the recording, or UINT32_MAX before it is created. */
+    uint32_t first_seq;
+    /** The mapping of the current segment. */
+    uint8_t *map;
+    /** The offset in the segment where the open block (or the next block) starts. */
+    size_t offset;
+    /** The offset in the segment up to which everything has been synced. */
+    size_t synced;
+    /** The header of the open block, whose payload is being written. */
+    rec_block_hdr_t block;
+    /** Packs the samples of the open block, if blocks are packed. */
+    rec_encoder_t enc;
+    /** The time of the last sync, in nanoseconds since the pipeline started. */
+    uint64_t last_sync;
+    /** The latest time of the samples written so far. */
+    uint64_t max_time;
+    /** The number of samples written more than REC_MAX_LATE_NS older than the latest sample written before them. */
+    uint64_t late;
+    /** The file descriptor of the current segment's index, or -1 if there is none. */
+    int index_fd;
+    /** The sample time at which the next checkpoint is due. */
+    uint64_t next_checkpoint;
+    /** The streams seen so far, found by hashing their key. */
+    rec_index_slot_t slots[REC_INDEX_SLOTS];
+    /** The slots of the streams seen so far, in order of appearance. */
+    uint8_t streams[REC_INDEX_STREAMS];
+    /** The number of streams seen so far. */
+    uint8_t nstreams;
+    /** Index entries waiting to be written to the index file. */
+    rec_index_entry_t index[REC_INDEX_BUFFER_LEN];
+    /** The number of index entries waiting to be written. */
+    size_t nindex;
+} recorder_t;
+
+/** Reads samples back from one segment of a recording. The memory must be provided by the user. */
+typedef struct {
+    CRC32LookupTable crc;                /**< The lookup table for block CRCs. */
+    uint8_t *map;                        /**< The read-only mapping of the segment. */
+    size_t len;                          /**< The length of the segment. */
+    const rec_segment_hdr_t *hdr;        /**< The header of the segment. */
+    rec_index_entry_t *index;            /**< The read-only mapping of the segment's index, or NULL if it has none. */
+    size_t nindex;                       /**< The number of entries in the index. */
+    size_t index_len;                    /**< The length of the index mapping. */
+    size_t offset;                       /**< The offset of the next block to read. */
+    sample_t samples[REC_BLOCK_SAMPLES]; /**< The samples of the current block. */
+    size_t count;                        /**< The number of samples in the current block. */
+    size_t pos;                          /**< The position of the next sample to read in the current block. */
+    bool filter;                         /**< Whether only the samples of `stream` are read. */
+    rec_stream_t stream;                 /**< The stream to read, if `filter` is set. */
+    uint64_t start;                      /**< Samples before this time are skipped. */
+    uint64_t end;                        /**< Reading stops at the first sample after this time. */
+} rec_reader_t;
+
+int recorder_open(recorder_t *rec, const rec_config_t *config);
+int recorder_write(recorder_t *rec, const sample_t *samples, size_t n, uint64_t dropped);
+int recorder_sync(recorder_t *rec);
+int recorder_close(recorder_t *rec);
+void rec_encode_raw(rec_raw_t *raw, const sample_t *sample);
+void rec_decode_raw(sample_t *sample, const rec_raw_t *raw);
+rec_stream_t rec_stream_of(const sample_t *sample);
+
+int rec_reader_open(rec_reader_t *reader, const char *path);
+void rec_reader_close(rec_reader_t *reader);
+void rec_reader_seek(rec_reader_t *reader, const rec_stream_t *stream, uint64_t start, uint64_t end);
+size_t rec_reader_read(rec_reader_t *reader, sample_t *samples, size_t max);
+
+#endif // _RECORDER_H_
@@ -0,0 +1,131 @@
+/**
+ * @file replay.c
+ * @brief Replays flight recordings through the pipeline at the recorded pace, a multiple of it, or as fast as possible.
+ *
+ * Replays flight recordings through the pipeline at the recorded pace, a multiple of it, or as fast as possible. The
+ * replay starts at the given segment and continues with the following segments of the same recording. When paced,
+ * each sample is published once its recorded offset from the first sample (divided by the speed) has elapsed; samples
+ * which are already due are published together in one batch.
+ */
+#include "replay.h"
+#include "../pipeline/pipeline.h"
+#include "../recorder/recorder.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The reader of the segment being replayed. */
+static rec_reader_t reader;
+
+/** Samples read from the segment which are waiting to be published. */
+static sample_t batch[PIPELINE_BATCH_LEN];
+
+/**
+ * Gets the time elapsed since a starting point on the monotonic clock.
+ * @param start The starting point.
+ * @return The elapsed time in nanoseconds.
+ */
+static uint64_t elapsed_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - start->tv_sec) * NS_PER_SEC + (uint64_t)now.tv_nsec - (uint64_t)start->tv_nsec;
+}
+
+/**
+ * Sleeps until a point in time relative to a starting point on the monotonic clock.
+ * @param start The starting point.
+ * @param offset The time after the starting point to sleep until, in nanoseconds.
+ */
+static void sleep_until(const struct timespec *start, uint64_t offset) {
+    uint64_t ns = (uint64_t)start->tv_nsec + offset;
+    struct timespec deadline = {
+        .tv_sec = start->tv_sec + (time_t)(ns / NS_PER_SEC),
+        .tv_nsec = (long)(ns % NS_PER_SEC),
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+        ;
+}
+
+/**
+ * Builds the path of another segment in the same directory as a given segment.
+ * @param path Where to store the path. Must have room for REC_PATH_MAX characters.
+ * @param segment The path of the given segment.
+ * @param seq The sequence number of the other segment.
+ * @return EOK if successful, ENAMETOOLONG if the path does not fit.
+ */
+static int segment_path(char *path, const char *segment, uint32_t seq) {
+    const char *slash = strrchr(segment, '/');
+    int dir_len = slash == NULL ? 0 : (int)(slash - segment + 1);
+    int len = snprintf(path, REC_PATH_MAX, "%.*sfetcher-%06u.rec", dir_len, segment, seq);
+    return len < 0 || len >= REC_PATH_MAX ? ENAMETOOLONG : EOK;
+}
+
+/**
+ * Replays a recording through the pipeline, starting with the given segment and continuing with the following segments
+ * of the same recording. The pipeline must already be started; in lossless mode, a replay as fast as possible runs at
+ * the pace of the slowest sink. Returns once every replayed sample has been written by every sink.
+ * @param path The path of the segment to start with.
+ * @param speed How many times faster than recorded to replay, or REPLAY_MAX_SPEED to replay as fast as possible.
+ * @param stats Where to store statistics about the replay.
+ * @return EOK if successful, otherwise the error from opening the first segment.
+ */
+int replay_run(const char *path, double speed, replay_stats_t *stats) {
+    int err = rec_reader_open(&reader, path);
+    if (err != EOK) return err;
+
+    memset(stats, 0, sizeof(*stats));
+    uint32_t recording = reader.hdr->first_seq;
+    bool paced = speed > REPLAY_MAX_SPEED;
+    bool started = false;
+    uint64_t first_time = 0;
+    uint64_t now = 0;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (;;) {
+        stats->segments++;
+        size_t n;
+        while ((n = rec_reader_read(&reader, batch, PIPELINE_BATCH_LEN)) > 0) {
+            if (!started) {
+                first_time = batch[0].time;
+                started = true;
+            }
+
+            // Publish the samples which are due together, and sleep before each sample which is not due yet
+            size_t due = 0;
+            for (size_t i = 0; paced && i < n; i++) {
+                uint64_t recorded = batch[i].time > first_time ? batch[i].time - first_time : 0;
+                uint64_t offset = (uint64_t)((double)recorded / speed);
+                if (offset <= now) continue;
+                now = elapsed_since(&start);
+                if (offset <= now) continue;
+
+                pipeline_inject(&batch[due], i - due);
+                due = i;
+                sleep_until(&start, offset);
+                now = offset;
+            }
+            pipeline_inject(&batch[due], n - due);
+            stats->samples += n;
+        }
+
+        // Continue with the next segment, as long as it belongs to the same recording
+        uint32_t seq = reader.hdr->seq + 1;
+        rec_reader_close(&reader);
+        char next[REC_PATH_MAX];
+        if (segment_path(next, path, seq) != EOK || rec_reader_open(&reader, next) != EOK) break;
+        if (reader.hdr->first_seq != recording) {
+            rec_reader_close(&reader);
+            break;
+        }
+    }
+
+    pipeline_drain();
+    stats->elapsed_ns = elapsed_since(&start);
+    return EOK;
+}
@@ -0,0 +1,25 @@
+/**
+ * @file replay.h
+ * @brief Function prototypes for replaying flight recordings through the pipeline.
+ *
+ * Function prototypes for replaying flight recordings through the pipeline. Replayed samples keep the time and source
+ * they were recorded with, and reach every sink exactly like samples from live acquisition.
+ */
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include <stdint.h>
+
+/** The replay speed which replays samples as fast as the sinks accept them, instead of at the recorded pace. */
+#define REPLAY_MAX_SPEED 0
+
+/** Statistics about a finished replay. */
+typedef struct {
+    uint64_t samples;    /**< The number of samples replayed. */
+    uint32_t segments;   /**< The number of segments replayed. */
+    uint64_t elapsed_ns; /**< The time taken to replay every sample and for the sinks to write them. */
+} replay_stats_t;
+
+int replay_run(const char *path, double speed, replay_stats_t *stats);
+
+#endif // _REPLAY_H_
@@ -0,0 +1,121 @@
+/**
+ * @file file_sink.c
+ * @brief Sinks which print samples to standard output or to a log file.
+ *
+ * Sinks which print samples to standard output or to a log file, in plain-text, CSV or NDJSON. A whole batch of samples
+ * is formatted into one buffer and handed to the operating system with a single write.
+ */
+#include "sinks.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Writes the entire buffer to a file descriptor, continuing after partial writes.
+ * @param fd The file descriptor to write to.
+ * @param buf The data to write.
+ * @param nbytes The number of bytes to write.
+ * @return EOK if successful, otherwise the error from writing.
+ */
+static int write_all(int fd, const char *buf, size_t nbytes) {
+    while (nbytes > 0) {
+        ssize_t written = write(fd, buf, nbytes);
+        if (written == -1) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        buf += written;
+        nbytes -= (size_t)written;
+    }
+    return EOK;
+}
+
+/**
+ * Opens the log file for appending, unless the sink writes to an already open file descriptor. Then writes the schema
+ * of the output format, if it has one.
+ * @param sink The file sink.
+ * @return EOK if successful, otherwise the error from opening the file or writing the schema.
+ */
+static int file_sink_open(sink_t *sink) {
+    file_sink_ctx_t *ctx = sink->ctx;
+    if (ctx->path != NULL) {
+        ctx->fd = open(ctx->path, O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (ctx->fd == -1) return errno;
+    }
+
+    if (ctx->fmt->header == NULL) return EOK;
+    return write_all(ctx->fd, ctx->buf, ctx->fmt->header(ctx->buf, sizeof(ctx->buf)));
+}
+
+/**
+ * Formats a batch of samples and writes them all at once.
+ * @param sink The file sink.
+ * @param samples The samples to print.
+ * @param n The number of samples to print.
+ * @return EOK if successful, otherwise the error from writing.
+ */
+static int file_sink_write(sink_t *sink, const sample_t *samples, size_t n) {
+    file_sink_ctx_t *ctx = sink->ctx;
+    size_t len = 0;
+    for (size_t i = 0; i < n; i++) {
+        // Only happens if the batch is larger than the pipeline's batch size
+        if (len + FMT_MAX_LINE > sizeof(ctx->buf)) {
+            int err = write_all(ctx->fd, ctx->buf, len);
+            if (err != EOK) return err;
+            len = 0;
+        }
+        len += ctx->fmt->line(&ctx->buf[len], &samples[i]);
+    }
+    return write_all(ctx->fd, ctx->buf, len);
+}
+
+/**
+ * Closes the log file. Standard output is left open.
+ * @param sink The file sink.
+ * @return EOK if successful, otherwise the error from closing the file.
+ */
+static int file_sink_close(sink_t *sink) {
+    file_sink_ctx_t *ctx = sink->ctx;
+    if (ctx->path == NULL || ctx->fd == -1) return EOK;
+    int err = close(ctx->fd) == -1 ? errno : EOK;
+    ctx->fd = -1;
+    return err;
+}
+
+/**
+ * Sets up a sink which prints samples to standard output. It prints the decimated copy of decimated streams.
+ * @param sink The sink to set up.
+ * @param ctx Storage for the sink's context.
+ * @param fmt The format to print samples in.
+ */
+void stdout_sink_init(sink_t *sink, file_sink_ctx_t *ctx, const fmt_entry_t *fmt) {
+    ctx->path = NULL;
+    ctx->fd = STDOUT_FILENO;
+    ctx->fmt = fmt;
+    sink->name = "stdout";
+    sink->ctx = ctx;
+    sink->open = file_sink_open;
+    sink->write = file_sink_write;
+    sink->close = file_sink_close;
+    sink->decimated = true;
+}
+
+/**
+ * Sets up a sink which appends samples to a log file. It logs decimated streams at full rate.
+ * @param sink The sink to set up.
+ * @param ctx Storage for the sink's context.
+ * @param path The path of the log file.
+ * @param fmt The format to log samples in.
+ */
+void file_sink_init(sink_t *sink, file_sink_ctx_t *ctx, const char *path, const fmt_entry_t *fmt) {
+    ctx->path = path;
+    ctx->fd = -1;
+    ctx->fmt = fmt;
+    sink->name = "file";
+    sink->ctx = ctx;
+    sink->open = file_sink_open;
+    sink->write = file_sink_write;
+    sink->close = file_sink_close;
+    sink->decimated = false;
+}
@@ -0,0 +1,85 @@
+/**
+ * @file mq_sink.c
+ * @brief Sink which publishes samples on the sensor message queue read by packager.
+ *
+ * Sink which publishes samples on the sensor message queue read by packager. The queue is normally written with
+ * blocking sends, so that a reader which falls behind holds the sink back and nothing is lost until the sink's own
+ * buffer is full. During a replay, which may have no reader at all, the queue is written without blocking instead:
+ * messages which do not fit in the queue are dropped and counted.
+ */
+#include "sinks.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+/**
+ * Opens (and creates if necessary) the sensor message queue.
+ * @param sink The message queue sink.
+ * @return EOK if successful, otherwise the error from opening the queue.
+ */
+static int mq_sink_open(sink_t *sink) {
+    mq_sink_ctx_t *ctx = sink->ctx;
+    struct mq_attr q_attr = {
+        .mq_flags = 0,
+        .mq_maxmsg = SENSOR_QUEUE_LEN,
+        .mq_msgsize = sizeof(common_t),
+    };
+
+    int flags = O_CREAT | O_WRONLY | (ctx->nonblocking ? O_NONBLOCK : 0);
+    ctx->queue = mq_open(SENSOR_QUEUE, flags, S_IWOTH | S_IRUSR, &q_attr);
+    if (ctx->queue == -1) return errno;
+    return EOK;
+}
+
+/**
+ * Sends each sample's message on the sensor message queue with the sample's priority. Without blocking, messages which
+ * do not fit in the queue are dropped and counted.
+ * @param sink The message queue sink.
+ * @param samples The samples to send.
+ * @param n The number of samples to send.
+ * @return EOK if every message was sent or dropped because the queue was full, otherwise the last error that occurred.
+ */
+static int mq_sink_write(sink_t *sink, const sample_t *samples, size_t n) {
+    mq_sink_ctx_t *ctx = sink->ctx;
+    int err = EOK;
+    uint64_t dropped = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (mq_send(ctx->queue, (const char *)&samples[i].msg, sizeof(common_t), samples[i].prio) == -1) {
+            if (errno == EAGAIN) {
+                dropped++;
+            } else {
+                err = errno;
+            }
+        }
+    }
+    if (dropped > 0) atomic_fetch_add(&sink->output_drops, dropped);
+    return err;
+}
+
+/**
+ * Closes the sensor message queue. The queue itself stays, so that readers can still take the messages left on it.
+ * @param sink The message queue sink.
+ * @return EOK if successful, otherwise the error from closing the queue.
+ */
+static int mq_sink_close(sink_t *sink) {
+    mq_sink_ctx_t *ctx = sink->ctx;
+    if (mq_close(ctx->queue) == -1) return errno;
+    return EOK;
+}
+
+/**
+ * Sets up a sink which publishes samples on the sensor message queue. It publishes the decimated copy of decimated
+ * streams.
+ * @param sink The sink to set up.
+ * @param ctx Storage for the sink's context.
+ * @param nonblocking Whether to drop messages which do not fit in the queue rather than wait for the reader.
+ */
+void mq_sink_init(sink_t *sink, mq_sink_ctx_t *ctx, bool nonblocking) {
+    ctx->nonblocking = nonblocking;
+    sink->name = "mq";
+    sink->ctx = ctx;
+    sink->open = mq_sink_open;
+    sink->write = mq_sink_write;
+    sink->close = mq_sink_close;
+    sink->decimated = true;
+}
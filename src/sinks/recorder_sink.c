@@ -0,0 +1,57 @@
+/**
+ * @file recorder_sink.c
+ * @brief Sink which records every sample into the flight recorder's segment files.
+ *
+ * Sink which records every sample into the flight recorder's segment files. Like every sink, the recorder is fed from
+ * its own bounded buffer by its own thread, so syncing to slow storage never blocks acquisition; if the storage falls
+ * too far behind, samples are dropped and the drop count is stored with the next block that is written.
+ */
+#include "sinks.h"
+
+/**
+ * Starts the recording.
+ * @param sink The recorder sink.
+ * @return EOK if successful, otherwise the error from creating the first segment.
+ */
+static int recorder_sink_open(sink_t *sink) {
+    recorder_sink_ctx_t *ctx = sink->ctx;
+    return recorder_open(&ctx->rec, &ctx->config);
+}
+
+/**
+ * Records a batch of samples.
+ * @param sink The recorder sink.
+ * @param samples The samples to record.
+ * @param n The number of samples to record.
+ * @return EOK if successful, otherwise the error from writing the recording.
+ */
+static int recorder_sink_write(sink_t *sink, const sample_t *samples, size_t n) {
+    recorder_sink_ctx_t *ctx = sink->ctx;
+    return recorder_write(&ctx->rec, samples, n, sample_ring_dropped(&sink->ring));
+}
+
+/**
+ * Ends the recording, so that the last block is written and the segment gives back the space it did not use.
+ * @param sink The recorder sink.
+ * @return EOK if successful, otherwise the error from closing the segment.
+ */
+static int recorder_sink_close(sink_t *sink) {
+    recorder_sink_ctx_t *ctx = sink->ctx;
+    return recorder_close(&ctx->rec);
+}
+
+/**
+ * Sets up a sink which records samples with the flight recorder. It records decimated streams at full rate.
+ * @param sink The sink to set up.
+ * @param ctx Storage for the sink's context.
+ * @param config How the recorder is set up.
+ */
+void recorder_sink_init(sink_t *sink, recorder_sink_ctx_t *ctx, const rec_config_t *config) {
+    ctx->config = *config;
+    sink->name = "recorder";
+    sink->ctx = ctx;
+    sink->open = recorder_sink_open;
+    sink->write = recorder_sink_write;
+    sink->close = recorder_sink_close;
+    sink->decimated = false;
+}
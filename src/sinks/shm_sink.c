@@ -0,0 +1,86 @@
+/**
+ * @file shm_sink.c
+ * @brief Sink which publishes samples into a shared memory ring that any number of readers can follow.
+ *
+ * Sink which publishes samples into a shared memory ring that any number of readers can follow. See
+ * `shm_sample_buffer_t` for how readers should consume the ring.
+ */
+#include "sinks.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Creates and maps the shared memory object.
+ * @param sink The shared memory sink.
+ * @return EOK if successful, otherwise the error from creating or mapping the object.
+ */
+static int shm_sink_open(sink_t *sink) {
+    shm_sink_ctx_t *ctx = sink->ctx;
+
+    int fd = shm_open(SENSOR_SHM, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd == -1) return errno;
+
+    if (ftruncate(fd, sizeof(shm_sample_buffer_t)) == -1) {
+        int err = errno;
+        close(fd);
+        return err;
+    }
+
+    void *mem = mmap(NULL, sizeof(shm_sample_buffer_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // The mapping stays valid without the descriptor
+    if (mem == MAP_FAILED) return errno;
+
+    // Carry on from the samples written by a previous run, so that the count never goes back for readers. The slots
+    // were written by the same numbering, so their sequence numbers stay right.
+    ctx->buf = mem;
+    bool resume = __atomic_load_n(&ctx->buf->magic, __ATOMIC_ACQUIRE) == SENSOR_SHM_MAGIC &&
+                  ctx->buf->capacity == SENSOR_SHM_LEN;
+    if (!resume) {
+        __atomic_store_n(&ctx->buf->magic, 0, __ATOMIC_RELAXED);
+        memset(ctx->buf->slots, 0, sizeof(ctx->buf->slots));
+        ctx->buf->capacity = SENSOR_SHM_LEN;
+        __atomic_store_n(&ctx->buf->head, 0, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ctx->buf->magic, SENSOR_SHM_MAGIC, __ATOMIC_RELEASE);
+    return EOK;
+}
+
+/**
+ * Copies the samples into the shared memory ring and then publishes the new head. Each slot's sequence number is odd
+ * while it is rewritten, so that a reader copying it at the same time can tell.
+ * @param sink The shared memory sink.
+ * @param samples The samples to write.
+ * @param n The number of samples to write.
+ * @return EOK; writing to shared memory cannot fail.
+ */
+static int shm_sink_write(sink_t *sink, const sample_t *samples, size_t n) {
+    shm_sink_ctx_t *ctx = sink->ctx;
+    uint64_t head = ctx->buf->head;
+    for (size_t i = 0; i < n; i++) {
+        shm_slot_t *slot = &ctx->buf->slots[(head + i) % SENSOR_SHM_LEN];
+        __atomic_store_n(&slot->seq, 2 * (head + i) + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE); // The odd sequence number is seen before any of the new sample
+        slot->sample = samples[i];
+        __atomic_store_n(&slot->seq, 2 * (head + i) + 2, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&ctx->buf->head, head + n, __ATOMIC_RELEASE);
+    return EOK;
+}
+
+/**
+ * Sets up a sink which publishes samples to shared memory. It publishes the decimated copy of decimated streams.
+ * @param sink The sink to set up.
+ * @param ctx Storage for the sink's context.
+ */
+void shm_sink_init(sink_t *sink, shm_sink_ctx_t *ctx) {
+    sink->name = "shm";
+    sink->ctx = ctx;
+    sink->open = shm_sink_open;
+    sink->write = shm_sink_write;
+    sink->close = NULL; // Readers keep their mapping, and ours goes away with the process
+    sink->decimated = true;
+}
@@ -0,0 +1,92 @@
+/**
+ * @file sinks.h
+ * @brief Sinks which fetcher's pipeline can deliver samples to.
+ *
+ * Sinks which fetcher's pipeline can deliver samples to. Each `*_sink_init` function fills in a `sink_t` so it can be
+ * registered with `pipeline_add_sink`. The sink specific context must be provided by the caller.
+ */
+#ifndef _SINKS_H_
+#define _SINKS_H_
+
+#include "../formatters/formatters.h"
+#include "../pipeline/pipeline.h"
+#include "../recorder/recorder.h"
+#include <mqueue.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** The name of the message queue which sensor data is published to. */
+#define SENSOR_QUEUE "fetcher/sensors"
+
+/** The maximum number of messages waiting on the sensor message queue. */
+#define SENSOR_QUEUE_LEN 30
+
+/** The name of the shared memory object which sensor data is published to. */
+#define SENSOR_SHM "/fetcher-sensors"
+
+/** The number of samples held in the shared memory object. */
+#define SENSOR_SHM_LEN 4096
+
+/** Identifies a shared memory object as one written by fetcher ("FTCH"). */
+#define SENSOR_SHM_MAGIC 0x48435446
+
+/**
+ * A slot of the shared memory ring. While sample number `n` is being written into the slot, `seq` is `2 * n + 1`, and
+ * once it is written `seq` is `2 * n + 2`.
+ */
+typedef struct {
+    volatile uint64_t seq; /**< Odd while the slot is being written, otherwise twice the sample's number plus two. */
+    sample_t sample;       /**< The sample. */
+} shm_slot_t;
+
+/**
+ * The layout of the shared memory object. Unlike the message queue, readers do not take samples away from each other.
+ * Each reader keeps its own count of the samples it has read; sample number `n` is stored in `slots[n % capacity]`,
+ * and is readable once `head` is past `n`. A reader which falls more than `capacity` samples behind `head` has lost
+ * the samples in between, and the slot it copies may be rewritten while it does so. To get sample `n`, a reader loads
+ * the slot's `seq` (acquire), copies the sample, then loads `seq` again after an acquire fence. The copy is sample `n`
+ * only if both loads are `2 * n + 2`; otherwise the sample was overwritten and is lost. `head` carries on from where
+ * the previous run of fetcher left it, so it never goes back for a reader which stays attached.
+ */
+typedef struct {
+    uint32_t magic;                   /**< Always SENSOR_SHM_MAGIC once the object is ready to be read. */
+    uint32_t capacity;                /**< The number of slots in `slots`. */
+    volatile uint64_t head;           /**< The total number of samples written so far. */
+    shm_slot_t slots[SENSOR_SHM_LEN]; /**< The most recently written samples. */
+} shm_sample_buffer_t;
+
+/** Context for the message queue sink. */
+typedef struct {
+    mqd_t queue;      /**< The sensor message queue. */
+    bool nonblocking; /**< Whether messages which do not fit in the queue are dropped rather than waited for. */
+} mq_sink_ctx_t;
+
+/** Context for the shared memory sink. */
+typedef struct {
+    shm_sample_buffer_t *buf; /**< The mapped shared memory object. */
+} shm_sink_ctx_t;
+
+/** The size of the buffer a batch of formatted samples is assembled in. Large enough for a full batch. */
+#define FILE_SINK_BUFFER_LEN (PIPELINE_BATCH_LEN * FMT_MAX_LINE)
+
+/** Context for the sinks which write formatted samples to a file descriptor. */
+typedef struct {
+    const char *path;               /**< The path of the file to write to, or NULL to write to `fd` directly. */
+    int fd;                         /**< The file descriptor to write to. */
+    const fmt_entry_t *fmt;         /**< The format samples are written in. */
+    char buf[FILE_SINK_BUFFER_LEN]; /**< Where a batch of samples is formatted before being written at once. */
+} file_sink_ctx_t;
+
+/** Context for the flight recorder sink. */
+typedef struct {
+    rec_config_t config; /**< How the recorder is set up. */
+    recorder_t rec;      /**< The state of the recording. */
+} recorder_sink_ctx_t;
+
+void mq_sink_init(sink_t *sink, mq_sink_ctx_t *ctx, bool nonblocking);
+void shm_sink_init(sink_t *sink, shm_sink_ctx_t *ctx);
+void stdout_sink_init(sink_t *sink, file_sink_ctx_t *ctx, const fmt_entry_t *fmt);
+void file_sink_init(sink_t *sink, file_sink_ctx_t *ctx, const char *path, const fmt_entry_t *fmt);
+void recorder_sink_init(sink_t *sink, recorder_sink_ctx_t *ctx, const rec_config_t *config);
+
+#endif // _SINKS_H_
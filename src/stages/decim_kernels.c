@@ -0,0 +1,249 @@
+/**
+ * @file decim_kernels.c
+ * @brief Inner loops of the decimation filters, vectorized for the target's instruction set.
+ *
+ * Inner loops of the decimation filters, vectorized for the target's instruction set. The FIR dot product runs across
+ * the taps, DECIM_FIR_LANES at a time in several accumulators, so the vectorized versions add in a different order than
+ * the scalar one and may differ from it in the last bits. The CIC stages run across the axes of a vector and are exact
+ * in every version, since they only add and subtract integers.
+ */
+#include "decim_kernels.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Computes the dot product of FIR taps and a window of input samples, one tap at a time.
+ * @param taps The taps.
+ * @param window The input samples, oldest first, lined up with the taps.
+ * @param n The number of taps. Must be a multiple of DECIM_FIR_LANES.
+ * @return The dot product.
+ */
+float decim_dot_scalar(const float *taps, const float *window, size_t n) {
+    float sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        sum += taps[i] * window[i];
+    }
+    return sum;
+}
+
+/**
+ * Runs a value through the integrators of a CIC filter, one channel at a time.
+ * @param integ The state of each integrator, first to last.
+ * @param order The number of integrators.
+ * @param in The value to integrate, for every channel.
+ */
+void decim_cic_integrate_scalar(decim_cic_lanes_t *integ, uint8_t order, const decim_cic_lanes_t in) {
+    for (uint8_t c = 0; c < DECIM_CIC_LANES; c++) {
+        uint64_t value = in[c];
+        for (uint8_t k = 0; k < order; k++) {
+            integ[k][c] += value;
+            value = integ[k][c];
+        }
+    }
+}
+
+/**
+ * Runs the output of the integrators through the combs of a CIC filter, one channel at a time.
+ * @param comb The previous input of each comb, first to last.
+ * @param order The number of combs.
+ * @param value The output of the integrators, replaced with the output of the filter, for every channel.
+ */
+void decim_cic_comb_scalar(decim_cic_lanes_t *comb, uint8_t order, decim_cic_lanes_t value) {
+    for (uint8_t c = 0; c < DECIM_CIC_LANES; c++) {
+        for (uint8_t k = 0; k < order; k++) {
+            uint64_t prev = comb[k][c];
+            comb[k][c] = value[c];
+            value[c] -= prev;
+        }
+    }
+}
+
+#if defined(__ARM_NEON)
+
+/** The instruction set the vectorized kernels were built for. */
+const char *const DECIM_KERNEL_ISA = "NEON";
+
+/**
+ * Computes the dot product of FIR taps and a window of input samples with NEON, in two accumulators of four lanes.
+ * @param taps The taps.
+ * @param window The input samples, oldest first, lined up with the taps.
+ * @param n The number of taps. Must be a multiple of DECIM_FIR_LANES.
+ * @return The dot product.
+ */
+float decim_dot(const float *taps, const float *window, size_t n) {
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    for (size_t i = 0; i < n; i += DECIM_FIR_LANES) {
+        acc0 = vfmaq_f32(acc0, vld1q_f32(&taps[i]), vld1q_f32(&window[i]));
+        acc1 = vfmaq_f32(acc1, vld1q_f32(&taps[i + 4]), vld1q_f32(&window[i + 4]));
+    }
+    return vaddvq_f32(vaddq_f32(acc0, acc1));
+}
+
+/**
+ * Runs a value through the integrators of a CIC filter with NEON, two channels per register.
+ * @param integ The state of each integrator, first to last.
+ * @param order The number of integrators.
+ * @param in The value to integrate, for every channel.
+ */
+void decim_cic_integrate(decim_cic_lanes_t *integ, uint8_t order, const decim_cic_lanes_t in) {
+    uint64x2_t lo = vld1q_u64(&in[0]);
+    uint64x2_t hi = vld1q_u64(&in[2]);
+    for (uint8_t k = 0; k < order; k++) {
+        lo = vaddq_u64(lo, vld1q_u64(&integ[k][0]));
+        hi = vaddq_u64(hi, vld1q_u64(&integ[k][2]));
+        vst1q_u64(&integ[k][0], lo);
+        vst1q_u64(&integ[k][2], hi);
+    }
+}
+
+/**
+ * Runs the output of the integrators through the combs of a CIC filter with NEON, two channels per register.
+ * @param comb The previous input of each comb, first to last.
+ * @param order The number of combs.
+ * @param value The output of the integrators, replaced with the output of the filter, for every channel.
+ */
+void decim_cic_comb(decim_cic_lanes_t *comb, uint8_t order, decim_cic_lanes_t value) {
+    uint64x2_t lo = vld1q_u64(&value[0]);
+    uint64x2_t hi = vld1q_u64(&value[2]);
+    for (uint8_t k = 0; k < order; k++) {
+        uint64x2_t prev_lo = vld1q_u64(&comb[k][0]);
+        uint64x2_t prev_hi = vld1q_u64(&comb[k][2]);
+        vst1q_u64(&comb[k][0], lo);
+        vst1q_u64(&comb[k][2], hi);
+        lo = vsubq_u64(lo, prev_lo);
+        hi = vsubq_u64(hi, prev_hi);
+    }
+    vst1q_u64(&value[0], lo);
+    vst1q_u64(&value[2], hi);
+}
+
+#elif defined(__SSE2__)
+
+#if defined(__AVX__)
+
+/** The instruction set the vectorized kernels were built for. */
+const char *const DECIM_KERNEL_ISA = "AVX";
+
+/**
+ * Computes the dot product of FIR taps and a window of input samples with AVX, in one accumulator of eight lanes.
+ * @param taps The taps.
+ * @param window The input samples, oldest first, lined up with the taps.
+ * @param n The number of taps. Must be a multiple of DECIM_FIR_LANES.
+ * @return The dot product.
+ */
+float decim_dot(const float *taps, const float *window, size_t n) {
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t i = 0; i < n; i += DECIM_FIR_LANES) {
+        acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(&taps[i]), _mm256_loadu_ps(&window[i])));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#else
+
+/** The instruction set the vectorized kernels were built for. */
+const char *const DECIM_KERNEL_ISA = "SSE2";
+
+/**
+ * Computes the dot product of FIR taps and a window of input samples with SSE, in two accumulators of four lanes.
+ * @param taps The taps.
+ * @param window The input samples, oldest first, lined up with the taps.
+ * @param n The number of taps. Must be a multiple of DECIM_FIR_LANES.
+ * @return The dot product.
+ */
+float decim_dot(const float *taps, const float *window, size_t n) {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (size_t i = 0; i < n; i += DECIM_FIR_LANES) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&taps[i]), _mm_loadu_ps(&window[i])));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&taps[i + 4]), _mm_loadu_ps(&window[i + 4])));
+    }
+    __m128 sum = _mm_add_ps(acc0, acc1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+#endif // __AVX__
+
+/**
+ * Runs a value through the integrators of a CIC filter with SSE2, two channels per register.
+ * @param integ The state of each integrator, first to last.
+ * @param order The number of integrators.
+ * @param in The value to integrate, for every channel.
+ */
+void decim_cic_integrate(decim_cic_lanes_t *integ, uint8_t order, const decim_cic_lanes_t in) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)&in[0]);
+    __m128i hi = _mm_loadu_si128((const __m128i *)&in[2]);
+    for (uint8_t k = 0; k < order; k++) {
+        lo = _mm_add_epi64(lo, _mm_loadu_si128((const __m128i *)&integ[k][0]));
+        hi = _mm_add_epi64(hi, _mm_loadu_si128((const __m128i *)&integ[k][2]));
+        _mm_storeu_si128((__m128i *)&integ[k][0], lo);
+        _mm_storeu_si128((__m128i *)&integ[k][2], hi);
+    }
+}
+
+/**
+ * Runs the output of the integrators through the combs of a CIC filter with SSE2, two channels per register.
+ * @param comb The previous input of each comb, first to last.
+ * @param order The number of combs.
+ * @param value The output of the integrators, replaced with the output of the filter, for every channel.
+ */
+void decim_cic_comb(decim_cic_lanes_t *comb, uint8_t order, decim_cic_lanes_t value) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)&value[0]);
+    __m128i hi = _mm_loadu_si128((const __m128i *)&value[2]);
+    for (uint8_t k = 0; k < order; k++) {
+        __m128i prev_lo = _mm_loadu_si128((const __m128i *)&comb[k][0]);
+        __m128i prev_hi = _mm_loadu_si128((const __m128i *)&comb[k][2]);
+        _mm_storeu_si128((__m128i *)&comb[k][0], lo);
+        _mm_storeu_si128((__m128i *)&comb[k][2], hi);
+        lo = _mm_sub_epi64(lo, prev_lo);
+        hi = _mm_sub_epi64(hi, prev_hi);
+    }
+    _mm_storeu_si128((__m128i *)&value[0], lo);
+    _mm_storeu_si128((__m128i *)&value[2], hi);
+}
+
+#else
+
+/** The instruction set the vectorized kernels were built for. */
+const char *const DECIM_KERNEL_ISA = "scalar";
+
+/**
+ * Computes the dot product of FIR taps and a window of input samples. There is no vectorized version for this target.
+ * @param taps The taps.
+ * @param window The input samples, oldest first, lined up with the taps.
+ * @param n The number of taps. Must be a multiple of DECIM_FIR_LANES.
+ * @return The dot product.
+ */
+float decim_dot(const float *taps, const float *window, size_t n) { return decim_dot_scalar(taps, window, n); }
+
+/**
+ * Runs a value through the integrators of a CIC filter. There is no vectorized version for this target.
+ * @param integ The state of each integrator, first to last.
+ * @param order The number of integrators.
+ * @param in The value to integrate, for every channel.
+ */
+void decim_cic_integrate(decim_cic_lanes_t *integ, uint8_t order, const decim_cic_lanes_t in) {
+    decim_cic_integrate_scalar(integ, order, in);
+}
+
+/**
+ * Runs the output of the integrators through the combs of a CIC filter. There is no vectorized version for this target.
+ * @param comb The previous input of each comb, first to last.
+ * @param order The number of combs.
+ * @param value The output of the integrators, replaced with the output of the filter, for every channel.
+ */
+void decim_cic_comb(decim_cic_lanes_t *comb, uint8_t order, decim_cic_lanes_t value) {
+    decim_cic_comb_scalar(comb, order, value);
+}
+
+#endif
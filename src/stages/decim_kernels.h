@@ -0,0 +1,36 @@
+/**
+ * @file decim_kernels.h
+ * @brief Inner loops of the decimation filters, vectorized for the target's instruction set.
+ *
+ * Inner loops of the decimation filters, vectorized for the target's instruction set. NEON is used on aarch64, AVX or
+ * SSE2 on x86 (whichever the compiler is allowed to use) and plain C everywhere else. The plain C versions are always
+ * available as `*_scalar` so the vectorized ones can be checked and benchmarked against them.
+ */
+#ifndef _DECIM_KERNELS_H_
+#define _DECIM_KERNELS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of FIR taps processed at once. FIR lengths are padded with zero taps to a multiple of this. */
+#define DECIM_FIR_LANES 8
+
+/** The number of CIC channels processed at once: the three axes of a vector, plus one unused lane. */
+#define DECIM_CIC_LANES 4
+
+/** The maximum number of integrator and comb stages of a CIC filter. */
+#define DECIM_CIC_MAX_ORDER 6
+
+/** The state of one CIC stage for every channel. The arithmetic wraps around, as CIC filters rely on. */
+typedef uint64_t decim_cic_lanes_t[DECIM_CIC_LANES];
+
+extern const char *const DECIM_KERNEL_ISA;
+
+float decim_dot(const float *taps, const float *window, size_t n);
+float decim_dot_scalar(const float *taps, const float *window, size_t n);
+void decim_cic_integrate(decim_cic_lanes_t *integ, uint8_t order, const decim_cic_lanes_t in);
+void decim_cic_integrate_scalar(decim_cic_lanes_t *integ, uint8_t order, const decim_cic_lanes_t in);
+void decim_cic_comb(decim_cic_lanes_t *comb, uint8_t order, decim_cic_lanes_t value);
+void decim_cic_comb_scalar(decim_cic_lanes_t *comb, uint8_t order, decim_cic_lanes_t value);
+
+#endif // _DECIM_KERNELS_H_
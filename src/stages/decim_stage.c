@@ -0,0 +1,299 @@
+/**
+ * @file decim_stage.c
+ * @brief Stage which decimates streams for the downstream sinks, behind an anti-aliasing filter.
+ *
+ * Stage which decimates streams for the downstream sinks, behind an anti-aliasing filter. Each stream of a decimated
+ * tag (each source and ID separately) passes through at full rate for the sinks which keep everything, and a filtered
+ * copy with one sample out of every `factor` is emitted for the decimated sinks. Simply dropping samples would fold
+ * everything above the new Nyquist frequency, like motor vibration, back into the band that is kept.
+ *
+ * Two filters are available. The FIR filter is a windowed-sinc low-pass with its cutoff at 40% of the output rate. It
+ * only computes the outputs that are kept, which is what a polyphase decimator does: each input sample costs
+ * `taps / factor` multiplications per axis. The CIC filter (a cascade of integrators and combs) costs a few integer
+ * additions per sample whatever the factor, but its passband droops. It runs in 64 bit fixed point with wrap-around
+ * arithmetic, so its integrators never lose precision however long fetcher runs.
+ *
+ * A decimated sample carries the time of the input samples it is centered on, i.e. the time of the newest input minus
+ * the filter's group delay. The stage must run after every stage which uses the full rate samples.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+/** The cutoff of the FIR filters as a fraction of the output sample rate. */
+#define FIR_CUTOFF 0.4f
+
+/** Pi, as a float. */
+#define PI_F 3.14159265f
+
+/** The largest input magnitude the CIC filters represent without overflowing, as a power of two. */
+#define CIC_RANGE_BITS 20
+
+/** The most fractional bits of the CIC filters' fixed point input. */
+#define CIC_MAX_SHIFT 24
+
+/** The fewest fractional bits of the CIC filters' fixed point input, below which a rule is rejected. */
+#define CIC_MIN_SHIFT 8
+
+/** How quickly the average input period follows changes, as a power of two of samples. */
+#define PERIOD_SMOOTHING 4
+
+_Static_assert(sizeof(((common_t *)0)->data) >= 3 * sizeof(float), "Messages must have room for three floats");
+
+/**
+ * Designs a windowed-sinc low-pass FIR filter with a Blackman window and unit gain at DC.
+ * @param taps Where to store the taps. The padding taps come first and are zero.
+ * @param len The number of taps of the filter.
+ * @param padded The number of taps to store, including the padding.
+ * @param factor The decimation factor the filter is for.
+ */
+static void design_fir(float *taps, uint16_t len, uint16_t padded, uint16_t factor) {
+    float fc = FIR_CUTOFF / factor;
+    float *h = &taps[padded - len];
+    float sum = 0;
+
+    memset(taps, 0, padded * sizeof(*taps));
+    for (uint16_t i = 0; i < len; i++) {
+        float x = (float)i - (float)(len - 1) / 2;
+        float sinc = 2 * i == len - 1 ? 2 * fc : sinf(2 * PI_F * fc * x) / (PI_F * x);
+        float phase = len == 1 ? 0 : 2 * PI_F * (float)i / (float)(len - 1);
+        h[i] = sinc * (0.42f - 0.5f * cosf(phase) + 0.08f * cosf(2 * phase));
+        sum += h[i];
+    }
+    for (uint16_t i = 0; i < len; i++) {
+        h[i] /= sum;
+    }
+}
+
+/**
+ * Checks a rule and works out its filter.
+ * @param ctx The stage context.
+ * @param r The index of the rule.
+ * @return EOK if successful, EINVAL if the rule is invalid.
+ */
+static int setup_rule(decim_stage_ctx_t *ctx, uint8_t r) {
+    decim_rule_t *rule = &ctx->config.rules[r];
+    if (rule->tag >= SENSOR_TAG_COUNT || rule->factor < 2) return EINVAL;
+
+    switch (SENSOR_TAG_DATA[rule->tag].dtype) {
+    case TYPE_FLOAT:
+        ctx->axes[r] = 1;
+        break;
+    case TYPE_VEC3D:
+        ctx->axes[r] = 3;
+        break;
+    default:
+        return EINVAL;
+    }
+
+    if (rule->filter == DECIM_FIR) {
+        if (rule->order == 0) rule->order = (uint16_t)(DECIM_DEFAULT_TAPS_PER_PHASE * rule->factor);
+        if (rule->order > DECIM_MAX_TAPS) rule->order = DECIM_MAX_TAPS;
+        ctx->ntaps[r] = (uint16_t)((rule->order + DECIM_FIR_LANES - 1) / DECIM_FIR_LANES * DECIM_FIR_LANES);
+        design_fir(ctx->taps[r], rule->order, ctx->ntaps[r], rule->factor);
+        ctx->delay[r] = (float)(rule->order - 1) / 2;
+        return EOK;
+    }
+
+    // The output of a CIC filter is its input times factor^order, which must fit in 63 bits along with the input range
+    if (rule->order == 0) rule->order = DECIM_DEFAULT_CIC_ORDER;
+    if (rule->order > DECIM_CIC_MAX_ORDER) return EINVAL;
+    uint64_t gain = 1;
+    for (uint16_t k = 0; k < rule->order; k++) {
+        if (gain > UINT64_MAX / rule->factor) return EINVAL;
+        gain *= rule->factor;
+    }
+    int growth = 64 - __builtin_clzll(gain);
+    int shift = 63 - CIC_RANGE_BITS - growth;
+    if (shift < CIC_MIN_SHIFT) return EINVAL;
+    ctx->shift[r] = (uint8_t)(shift > CIC_MAX_SHIFT ? CIC_MAX_SHIFT : shift);
+    ctx->scale[r] = 1 / ((float)gain * (float)(1ULL << ctx->shift[r]));
+    ctx->delay[r] = (float)(rule->order * (rule->factor - 1)) / 2;
+    return EOK;
+}
+
+/**
+ * Finds the state of the stream a sample belongs to, starting a new stream if needed.
+ * @param ctx The stage context.
+ * @param sample The sample.
+ * @param rule The rule for the sample's tag.
+ * @return The state of the stream, or null if there is no room for another stream.
+ */
+static decim_stream_t *find_stream(decim_stage_ctx_t *ctx, const sample_t *sample, uint8_t rule) {
+    uint8_t id = SENSOR_TAG_DATA[sample->msg.type].has_id ? sample->msg.id : 0;
+    for (uint8_t i = 0; i < ctx->nstreams; i++) {
+        decim_stream_t *stream = &ctx->streams[i];
+        if (stream->source == sample->source && stream->type == sample->msg.type && stream->id == id) return stream;
+    }
+    if (ctx->nstreams == DECIM_MAX_STREAMS) return NULL;
+
+    decim_stream_t *stream = &ctx->streams[ctx->nstreams++];
+    memset(stream, 0, sizeof(*stream));
+    stream->source = sample->source;
+    stream->type = sample->msg.type;
+    stream->id = id;
+    stream->rule = rule;
+    stream->last_time = sample->time;
+    stream->warmup = ctx->config.rules[rule].order;
+
+    // Start the FIR history as if the first value had been there all along, so the first outputs are not ramps
+    if (ctx->config.rules[rule].filter == DECIM_FIR) {
+        float data[3];
+        memcpy(data, &sample->msg.data, sizeof(data));
+        for (uint8_t a = 0; a < ctx->axes[rule]; a++) {
+            for (uint16_t i = 0; i < 2 * ctx->ntaps[rule]; i++) {
+                stream->hist[a][i] = data[a];
+            }
+        }
+        stream->warmup = 0;
+    }
+    return stream;
+}
+
+/**
+ * Feeds a sample to the filter of its stream.
+ * @param ctx The stage context.
+ * @param stream The stream the sample belongs to.
+ * @param data The floats of the sample's data, one per axis.
+ * @param out Where to store the filtered floats, one per axis, if an output is due.
+ * @return True if an output is due, false otherwise.
+ */
+static bool filter(decim_stage_ctx_t *ctx, decim_stream_t *stream, const float *data, float *out) {
+    uint8_t r = stream->rule;
+    const decim_rule_t *rule = &ctx->config.rules[r];
+
+    // A value which is not a finite number has no fixed point value, so the sample is left out of a CIC filter entirely
+    if (rule->filter != DECIM_FIR) {
+        for (uint8_t a = 0; a < ctx->axes[r]; a++) {
+            if (isfinite(data[a])) continue;
+            if (!ctx->skipped) {
+                log_print(stderr, LOG_WARN, "Samples of tag %u which are not finite were left out of the CIC filter",
+                          stream->type);
+                ctx->skipped = true;
+            }
+            return false;
+        }
+    }
+
+    bool due = ++stream->count == rule->factor;
+    if (due) stream->count = 0;
+
+    if (rule->filter == DECIM_FIR) {
+        uint16_t n = ctx->ntaps[r];
+        for (uint8_t a = 0; a < ctx->axes[r]; a++) {
+            stream->hist[a][stream->pos] = data[a];
+            stream->hist[a][stream->pos + n] = data[a];
+        }
+        stream->pos = (uint16_t)(stream->pos + 1 == n ? 0 : stream->pos + 1);
+        if (!due) return false;
+        for (uint8_t a = 0; a < ctx->axes[r]; a++) {
+            out[a] = decim_dot(ctx->taps[r], &stream->hist[a][stream->pos], n);
+        }
+        return true;
+    }
+
+    decim_cic_lanes_t in = {0};
+    float limit = (float)(1UL << CIC_RANGE_BITS);
+    float one = (float)(1UL << ctx->shift[r]);
+    for (uint8_t a = 0; a < ctx->axes[r]; a++) {
+        // Clamped to the range the fixed point input can hold, so the cast is always defined
+        float value = data[a] > limit ? limit : data[a] < -limit ? -limit : data[a];
+        in[a] = (uint64_t)(int64_t)(value * one);
+    }
+    decim_cic_integrate(stream->cic.integ, (uint8_t)rule->order, in);
+    if (!due) return false;
+
+    decim_cic_lanes_t value;
+    memcpy(value, stream->cic.integ[rule->order - 1], sizeof(value));
+    decim_cic_comb(stream->cic.comb, (uint8_t)rule->order, value);
+    for (uint8_t a = 0; a < ctx->axes[r]; a++) {
+        out[a] = (float)(int64_t)value[a] * ctx->scale[r];
+    }
+    if (stream->warmup > 0) {
+        stream->warmup--;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Passes every sample through, flagging the samples of decimated streams as full rate and emitting a decimated copy of
+ * those streams.
+ * @param stage The decimation stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void decim_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    decim_stage_ctx_t *ctx = stage->ctx;
+
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        uint8_t rule = ctx->rule_of[sample->msg.type];
+        if (rule == DECIM_MAX_RULES || sample->flags != 0) {
+            pipeline_emit(out, sample);
+            continue;
+        }
+
+        decim_stream_t *stream = find_stream(ctx, sample, rule);
+        if (stream == NULL) {
+            if (!ctx->full) {
+                log_print(stderr, LOG_WARN, "Too many streams to decimate, passing the rest through at full rate");
+                ctx->full = true;
+            }
+            pipeline_emit(out, sample);
+            continue;
+        }
+
+        sample_t full = *sample;
+        full.flags = SAMPLE_FULL_RATE;
+        pipeline_emit(out, &full);
+
+        if (sample->time > stream->last_time) {
+            float period = (float)(sample->time - stream->last_time);
+            stream->period += stream->period > 0 ? (period - stream->period) / (1 << PERIOD_SMOOTHING) : period;
+        }
+        stream->last_time = sample->time;
+
+        // The data union always has room for three floats, and copying a fixed size is much cheaper
+        float data[3];
+        float filtered[3] = {0};
+        memcpy(data, &sample->msg.data, sizeof(data));
+        if (!filter(ctx, stream, data, filtered)) continue;
+
+        sample_t decimated = full;
+        memcpy(&decimated.msg.data, filtered, sizeof(filtered));
+        uint64_t delay = (uint64_t)(ctx->delay[rule] * stream->period);
+        decimated.time = sample->time > delay ? sample->time - delay : 0;
+        decimated.flags = SAMPLE_DECIMATED;
+        pipeline_emit(out, &decimated);
+    }
+}
+
+/**
+ * Sets up a stage which decimates streams for the decimated sinks.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up. Rules which leave the number of CIC stages or FIR taps at 0 get the default.
+ * @return EOK if successful, EINVAL if a rule is invalid: its tag is not made of floats, it decimates by less than 2,
+ * or its CIC filter has so many stages that its gain does not fit in 64 bits.
+ */
+int decim_stage_init(stage_t *stage, decim_stage_ctx_t *ctx, const decim_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    memset(ctx->rule_of, DECIM_MAX_RULES, sizeof(ctx->rule_of));
+    if (config->nrules > DECIM_MAX_RULES) return EINVAL;
+
+    for (uint8_t r = 0; r < config->nrules; r++) {
+        int err = setup_rule(ctx, r);
+        if (err != EOK) return err;
+        ctx->rule_of[config->rules[r].tag] = r;
+    }
+
+    stage->name = "decimate";
+    stage->ctx = ctx;
+    stage->process = decim_stage_process;
+    return EOK;
+}
@@ -0,0 +1,216 @@
+/**
+ * @file events_stage.c
+ * @brief Stage which detects launch, burnout and apogee as the samples stream by.
+ *
+ * Stage which detects launch, burnout and apogee as the samples stream by. The events are detected one after another,
+ * each by an incremental detector which only looks at the latest sample:
+ * - Launch: the acceleration along the rocket stays above a threshold for a hold time.
+ * - Burnout: the acceleration along the rocket stays below a threshold for a hold time.
+ * - Apogee: the vertical velocity (from the fusion stage) turns negative and keeps falling past a hysteresis. Without a
+ *   vertical velocity, the barometric altitude dropping a set distance below its highest point is used instead.
+ *
+ * The acceleration goes through a first order low-pass filter first, so motor vibration does not interrupt the hold
+ * time. Each event is published as a `TAG_FLIGHT_EVENT` sample with the event as its ID, right after the sample which
+ * confirmed it and with that sample's time. Its data is the detection latency: how long before it the sample which
+ * triggered the event (the first sample past the threshold, or the top of the trajectory) was acquired.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <string.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The number of nanoseconds in a microsecond. */
+#define NS_PER_US 1000ULL
+
+/** The message queue priority of flight events, above every collector's. */
+#define EVENT_PRIO 4
+
+/** The names of the flight events, for logging. */
+static const char *EVENT_NAMES[] = {
+    [EVENT_LAUNCH] = "launch",
+    [EVENT_BURNOUT] = "burnout",
+    [EVENT_APOGEE] = "apogee",
+};
+
+/**
+ * Tracks whether the condition of the next event has held for the hold time.
+ * @param ctx The stage context.
+ * @param condition Whether the condition holds for the current sample.
+ * @param time The time of the current sample.
+ * @return True if the condition has held for at least the hold time, false otherwise.
+ */
+static bool held(events_stage_ctx_t *ctx, bool condition, uint64_t time) {
+    if (!condition) {
+        ctx->pending = false;
+        return false;
+    }
+    if (!ctx->pending) {
+        ctx->pending = true;
+        ctx->onset = time;
+    }
+    return time - ctx->onset >= (uint64_t)ctx->config.hold_ms * NS_PER_MS;
+}
+
+/**
+ * Publishes the next event, which was triggered at `ctx->onset`, and moves on to detecting the following one.
+ * @param stage The event detection stage.
+ * @param out The output of the stage.
+ * @param time The time of the sample which confirmed the event.
+ */
+static void detect(stage_t *stage, stage_out_t *out, uint64_t time) {
+    events_stage_ctx_t *ctx = stage->ctx;
+    uint8_t event = ctx->next;
+    uint64_t latency = time - ctx->onset;
+    uint64_t latency_us = latency / NS_PER_US;
+
+    sample_t sample = {.time = time, .source = stage->source, .prio = EVENT_PRIO};
+    sample.msg.type = TAG_FLIGHT_EVENT;
+    sample.msg.id = event;
+    sample.msg.data.U32 = latency_us > UINT32_MAX ? UINT32_MAX : (uint32_t)latency_us;
+    pipeline_emit(out, &sample);
+
+    ctx->onsets[event] = ctx->onset;
+    ctx->latency[event] = latency;
+    ctx->next = event == EVENT_APOGEE ? 0 : (uint8_t)(event + 1);
+    ctx->pending = false;
+    log_print(stderr, LOG_INFO, "Detected %s at %.3f s, %.1f ms after its triggering sample", EVENT_NAMES[event],
+              (double)time / NS_PER_SEC, (double)latency / NS_PER_MS);
+}
+
+/**
+ * Filters an acceleration sample and checks it for launch or burnout.
+ * @param stage The event detection stage.
+ * @param out The output of the stage.
+ * @param sample The acceleration sample.
+ */
+static void process_accel(stage_t *stage, stage_out_t *out, const sample_t *sample) {
+    events_stage_ctx_t *ctx = stage->ctx;
+    const vec3d_t *v = &sample->msg.data.VEC3D;
+    float axes[3] = {v->x, v->y, v->z};
+    float accel = ctx->config.invert ? -axes[ctx->config.axis] : axes[ctx->config.axis];
+
+    if (!ctx->have_imu) {
+        ctx->imu_source = sample->source;
+        ctx->accel = accel;
+        ctx->have_imu = true;
+    } else if (sample->source != ctx->imu_source) {
+        return;
+    } else if (ctx->config.filter_ms == 0) {
+        ctx->accel = accel;
+    } else if (sample->time > ctx->last_time) {
+        float dt = (float)(sample->time - ctx->last_time);
+        ctx->accel += dt / (dt + (float)(ctx->config.filter_ms * NS_PER_MS)) * (accel - ctx->accel);
+    }
+    ctx->last_time = sample->time;
+
+    if (ctx->next == EVENT_LAUNCH && held(ctx, ctx->accel > ctx->config.launch_accel, sample->time)) {
+        detect(stage, out, sample->time);
+    } else if (ctx->next == EVENT_BURNOUT && held(ctx, ctx->accel < ctx->config.burnout_accel, sample->time)) {
+        detect(stage, out, sample->time);
+    }
+}
+
+/**
+ * Checks a vertical velocity sample for apogee. The event is triggered by the first sample of a run of velocities at or
+ * below zero, and confirmed once the velocity falls below the hysteresis.
+ * @param stage The event detection stage.
+ * @param out The output of the stage.
+ * @param sample The vertical velocity sample.
+ */
+static void process_vel(stage_t *stage, stage_out_t *out, const sample_t *sample) {
+    events_stage_ctx_t *ctx = stage->ctx;
+    if (!ctx->have_vel) {
+        ctx->vel_source = sample->source;
+        ctx->have_vel = true;
+    }
+    if (sample->source != ctx->vel_source || ctx->next != EVENT_APOGEE) return;
+
+    float vel = sample->msg.data.FLOAT;
+    if (vel > 0) {
+        ctx->pending = false;
+        return;
+    }
+    if (!ctx->pending) {
+        ctx->pending = true;
+        ctx->onset = sample->time;
+    }
+    if (vel < -ctx->config.apogee_vel) detect(stage, out, sample->time);
+}
+
+/**
+ * Checks a barometric altitude sample for apogee, if there is no vertical velocity to check instead. The event is
+ * triggered by the highest altitude since burnout, and confirmed once the altitude drops far enough below it.
+ * @param stage The event detection stage.
+ * @param out The output of the stage.
+ * @param sample The barometric altitude sample.
+ */
+static void process_alt(stage_t *stage, stage_out_t *out, const sample_t *sample) {
+    events_stage_ctx_t *ctx = stage->ctx;
+    if (!ctx->have_baro) {
+        ctx->baro_source = sample->source;
+        ctx->have_baro = true;
+    }
+    if (sample->source != ctx->baro_source || ctx->next != EVENT_APOGEE || ctx->have_vel) return;
+
+    float alt = sample->msg.data.FLOAT;
+    if (!ctx->pending || alt > ctx->max_alt) {
+        ctx->pending = true;
+        ctx->max_alt = alt;
+        ctx->onset = sample->time;
+    } else if (alt < ctx->max_alt - ctx->config.apogee_drop) {
+        detect(stage, out, sample->time);
+    }
+}
+
+/**
+ * Passes every sample through, checking accelerations, vertical velocities and altitudes for the next flight event and
+ * emitting the event right after the sample which confirmed it. The first source of each input is the one which is
+ * checked.
+ * @param stage The event detection stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void events_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        pipeline_emit(out, sample);
+
+        // Raw copies of voted sensors: their consensus follows separately
+        if (sample->flags != 0) continue;
+
+        switch (sample->msg.type) {
+        case TAG_LINEAR_ACCEL_REL:
+            process_accel(stage, out, sample);
+            break;
+        case TAG_VERTICAL_VEL:
+            process_vel(stage, out, sample);
+            break;
+        case TAG_ALTITUDE_REL:
+            process_alt(stage, out, sample);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Sets up a stage which detects launch, burnout and apogee.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ */
+void events_stage_init(stage_t *stage, events_stage_ctx_t *ctx, const events_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    ctx->next = EVENT_LAUNCH;
+    stage->name = "events";
+    stage->ctx = ctx;
+    stage->process = events_stage_process;
+}
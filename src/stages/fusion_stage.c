@@ -0,0 +1,192 @@
+/**
+ * @file fusion_stage.c
+ * @brief Stage which fuses barometric altitude with vertical acceleration into altitude and vertical velocity.
+ *
+ * Stage which fuses barometric altitude with vertical acceleration into altitude and vertical velocity. A three state
+ * Kalman filter tracks altitude, vertical velocity and the bias of the accelerometer. Every IMU sample predicts the
+ * state forward using the measured acceleration along the rocket's axis minus gravity, and every barometer sample
+ * corrects it. The fused altitude (`TAG_ALTITUDE_FUSED`) and vertical velocity (`TAG_VERTICAL_VEL`) are emitted right
+ * after each IMU sample with the same time, so they come at IMU rate and add no delay of their own. Each sample costs a
+ * fixed number of operations on 3x3 matrices.
+ *
+ * The filter assumes the rocket's axis stays close to vertical, which holds from the pad until apogee. The bias state
+ * absorbs a constant error in the accelerometer's scale of gravity.
+ */
+#include "stages.h"
+#include <string.h>
+
+/** Standard gravity in m/s^2. */
+#define GRAVITY 9.80665f
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The initial uncertainty of the vertical velocity in m/s, which is small because the rocket starts on the pad. */
+#define INITIAL_VEL_SD 0.5f
+
+/** The initial uncertainty of the accelerometer bias in m/s^2. */
+#define INITIAL_BIAS_SD 1.0f
+
+/**
+ * Starts the filter at a barometric altitude, with the rocket at rest.
+ * @param ctx The stage context.
+ * @param altitude The barometric altitude.
+ */
+static void filter_reset(fusion_stage_ctx_t *ctx, float altitude) {
+    memset(ctx->p, 0, sizeof(ctx->p));
+    ctx->x[0] = altitude;
+    ctx->x[1] = 0;
+    ctx->x[2] = 0;
+    ctx->p[0][0] = ctx->config.baro_sd * ctx->config.baro_sd;
+    ctx->p[1][1] = INITIAL_VEL_SD * INITIAL_VEL_SD;
+    ctx->p[2][2] = INITIAL_BIAS_SD * INITIAL_BIAS_SD;
+    ctx->ready = true;
+}
+
+/**
+ * Predicts the state forward by one IMU sample.
+ * @param ctx The stage context.
+ * @param accel The measured vertical acceleration, without gravity.
+ * @param dt The time since the previous IMU sample in seconds.
+ */
+static void filter_predict(fusion_stage_ctx_t *ctx, float accel, float dt) {
+    float *x = ctx->x;
+    float(*p)[3] = ctx->p;
+    float dt2 = dt * dt / 2;
+
+    float a = accel - x[2];
+    x[0] += x[1] * dt + a * dt2;
+    x[1] += a * dt;
+
+    // P = F P F' + Q, where F = [1 dt -dt^2/2; 0 1 -dt; 0 0 1]
+    float f[3][3] = {{1, dt, -dt2}, {0, 1, -dt}, {0, 0, 1}};
+    float fp[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            fp[i][j] = f[i][0] * p[0][j] + f[i][1] * p[1][j] + f[i][2] * p[2][j];
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = i; j < 3; j++) {
+            p[i][j] = fp[i][0] * f[j][0] + fp[i][1] * f[j][1] + fp[i][2] * f[j][2];
+            p[j][i] = p[i][j];
+        }
+    }
+
+    // The acceleration noise enters through G = [dt^2/2; dt; 0], and the bias drifts as a random walk
+    float qa = ctx->config.accel_sd * ctx->config.accel_sd;
+    p[0][0] += qa * dt2 * dt2;
+    p[0][1] += qa * dt2 * dt;
+    p[1][0] += qa * dt2 * dt;
+    p[1][1] += qa * dt * dt;
+    p[2][2] += ctx->config.bias_sd * ctx->config.bias_sd * dt;
+}
+
+/**
+ * Corrects the state with a barometric altitude.
+ * @param ctx The stage context.
+ * @param altitude The barometric altitude.
+ */
+static void filter_update(fusion_stage_ctx_t *ctx, float altitude) {
+    float *x = ctx->x;
+    float(*p)[3] = ctx->p;
+
+    float s = p[0][0] + ctx->config.baro_sd * ctx->config.baro_sd;
+    float k[3] = {p[0][0] / s, p[1][0] / s, p[2][0] / s};
+    float y = altitude - x[0];
+    for (int i = 0; i < 3; i++) {
+        x[i] += k[i] * y;
+    }
+
+    // P = (I - K H) P, where H = [1 0 0], keeping P symmetric
+    float row[3] = {p[0][0], p[0][1], p[0][2]};
+    for (int i = 0; i < 3; i++) {
+        for (int j = i; j < 3; j++) {
+            p[i][j] -= k[i] * row[j];
+            p[j][i] = p[i][j];
+        }
+    }
+}
+
+/**
+ * Emits a fused value.
+ * @param stage The fusion stage.
+ * @param out The output of the stage.
+ * @param time The time of the IMU sample the value belongs to.
+ * @param type The tag of the value.
+ * @param value The value.
+ */
+static void emit(stage_t *stage, stage_out_t *out, uint64_t time, uint8_t type, float value) {
+    sample_t sample = {.time = time, .source = stage->source, .prio = 2};
+    sample.msg.type = type;
+    sample.msg.id = 0;
+    sample.msg.data.FLOAT = value;
+    pipeline_emit(out, &sample);
+}
+
+/**
+ * Passes every sample through, feeding accelerations and altitudes to the filter and emitting the fused altitude and
+ * vertical velocity after each IMU sample. The first collector to publish each input is the one which is fused.
+ * @param stage The fusion stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void fusion_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    fusion_stage_ctx_t *ctx = stage->ctx;
+
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        pipeline_emit(out, sample);
+
+        // Raw copies of voted sensors: their consensus follows separately
+        if (sample->flags != 0) continue;
+
+        if (sample->msg.type == TAG_ALTITUDE_REL) {
+            if (!ctx->have_baro) {
+                ctx->baro_source = sample->source;
+                ctx->have_baro = true;
+            }
+            if (sample->source != ctx->baro_source) continue;
+
+            if (ctx->ready) {
+                filter_update(ctx, sample->msg.data.FLOAT);
+            } else {
+                filter_reset(ctx, sample->msg.data.FLOAT);
+            }
+        } else if (sample->msg.type == TAG_LINEAR_ACCEL_REL) {
+            if (!ctx->have_imu) {
+                ctx->imu_source = sample->source;
+                ctx->last_time = sample->time;
+                ctx->have_imu = true;
+            }
+            if (sample->source != ctx->imu_source) continue;
+
+            float dt = sample->time > ctx->last_time ? (float)(sample->time - ctx->last_time) / NS_PER_SEC : 0;
+            ctx->last_time = sample->time;
+            if (!ctx->ready) continue;
+
+            const vec3d_t *v = &sample->msg.data.VEC3D;
+            float axes[3] = {v->x, v->y, v->z};
+            float accel = ctx->config.invert ? -axes[ctx->config.axis] : axes[ctx->config.axis];
+            filter_predict(ctx, accel - GRAVITY, dt < FUSION_MAX_DT ? dt : FUSION_MAX_DT);
+
+            emit(stage, out, sample->time, TAG_ALTITUDE_FUSED, ctx->x[0]);
+            emit(stage, out, sample->time, TAG_VERTICAL_VEL, ctx->x[1]);
+        }
+    }
+}
+
+/**
+ * Sets up a stage which fuses barometric altitude and vertical acceleration.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ */
+void fusion_stage_init(stage_t *stage, fusion_stage_ctx_t *ctx, const fusion_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    stage->name = "fusion";
+    stage->ctx = ctx;
+    stage->process = fusion_stage_process;
+}
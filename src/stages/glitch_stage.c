@@ -0,0 +1,213 @@
+/**
+ * @file glitch_stage.c
+ * @brief Stage which drops samples that cannot be real measurements, like the wild values read after a bus error.
+ *
+ * Stage which drops samples that cannot be real measurements, like the wild values read after a bus error, before they
+ * reach the other stages or any output. Each stream of a checked tag (each source and ID separately) goes through up
+ * to three tests, and a sample is rejected if any value of any axis fails one:
+ * - Range: the value must be finite and within the physical range of its tag (`SensorTagData.min` and `max`).
+ * - Slew: the value may not have changed faster than `max_slew` per second since the last accepted sample. Since the
+ *   allowed change grows with the time since then, a genuine step is only held back briefly.
+ * - Median: the value may not be further than `median_dev` from the median of the last `median_len` samples. The
+ *   window holds every sample which passed the other tests, accepted or not, so an isolated glitch barely moves the
+ *   median while a genuine step becomes the median after half the window.
+ *
+ * Each test costs a bounded amount of work per sample: the median's window is also kept in sorted order, so a new
+ * sample only moves the values between the position of the sample it replaces and its own. Rejections are counted per
+ * stream and test, and the new ones are logged every GLITCH_REPORT_PERIOD seconds.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/**
+ * Finds the state of the stream a sample belongs to, starting a new stream if needed.
+ * @param ctx The stage context.
+ * @param sample The sample.
+ * @param rule The rule for the sample's tag.
+ * @return The state of the stream, or null if there is no room for another stream.
+ */
+static glitch_stream_t *find_stream(glitch_stage_ctx_t *ctx, const sample_t *sample, uint8_t rule) {
+    uint8_t id = SENSOR_TAG_DATA[sample->msg.type].has_id ? sample->msg.id : 0;
+    for (uint8_t i = 0; i < ctx->nstreams; i++) {
+        glitch_stream_t *stream = &ctx->streams[i];
+        if (stream->source == sample->source && stream->type == sample->msg.type && stream->id == id) return stream;
+    }
+    if (ctx->nstreams == GLITCH_MAX_STREAMS) return NULL;
+
+    glitch_stream_t *stream = &ctx->streams[ctx->nstreams++];
+    memset(stream, 0, sizeof(*stream));
+    stream->source = sample->source;
+    stream->type = sample->msg.type;
+    stream->id = id;
+    stream->rule = rule;
+    return stream;
+}
+
+/**
+ * Adds a sample to the running median's window of a stream, replacing the oldest sample if the window is full.
+ * @param stream The stream.
+ * @param n The length of the window.
+ * @param values The values of the sample, one per axis.
+ */
+static void window_push(glitch_stream_t *stream, uint8_t n, const float *values) {
+    for (uint8_t a = 0; a < stream->axes; a++) {
+        float *sorted = stream->sorted[a];
+        uint8_t len = stream->len;
+
+        // Take the oldest value out of the sorted window: it is the first one which is not below it
+        if (len == n) {
+            float oldest = stream->window[a][stream->head];
+            uint8_t i = 0;
+            while (sorted[i] < oldest) i++;
+            for (len--; i < len; i++) sorted[i] = sorted[i + 1];
+            stream->window[a][stream->head] = values[a];
+        } else {
+            stream->window[a][len] = values[a];
+        }
+
+        uint8_t i = len;
+        for (; i > 0 && sorted[i - 1] > values[a]; i--) sorted[i] = sorted[i - 1];
+        sorted[i] = values[a];
+    }
+
+    if (stream->len == n) {
+        stream->head = (uint8_t)(stream->head + 1 == n ? 0 : stream->head + 1);
+    } else {
+        stream->len++;
+    }
+}
+
+/**
+ * Runs a sample through the tests of its stream, and adds it to the running median's window if it passed the others.
+ * @param rule The rule of the stream.
+ * @param stream The stream.
+ * @param time The time of the sample.
+ * @param values The values of the sample, one per axis.
+ * @return The first test the sample failed, or GLITCH_REASONS if it passed them all.
+ */
+static glitch_reason_t check(const glitch_rule_t *rule, glitch_stream_t *stream, uint64_t time, const float *values) {
+    const SensorTagData *tag = &SENSOR_TAG_DATA[stream->type];
+    bool ranged = tag->min < tag->max;
+    for (uint8_t a = 0; a < stream->axes; a++) {
+        if (!isfinite(values[a]) || (ranged && (values[a] < tag->min || values[a] > tag->max))) return GLITCH_RANGE;
+    }
+
+    glitch_reason_t reason = GLITCH_REASONS;
+    if (rule->max_slew > 0 && stream->accepted) {
+        float limit = rule->max_slew * (float)(time - stream->last_time) / (float)NS_PER_SEC;
+        for (uint8_t a = 0; a < stream->axes; a++) {
+            if (fabsf(values[a] - stream->last[a]) > limit) reason = GLITCH_SLEW;
+        }
+    }
+
+    if (rule->median_len > 0) {
+        if (reason == GLITCH_REASONS && stream->len == rule->median_len) {
+            for (uint8_t a = 0; a < stream->axes; a++) {
+                if (fabsf(values[a] - stream->sorted[a][stream->len / 2]) > rule->median_dev) reason = GLITCH_MEDIAN;
+            }
+        }
+        if (reason != GLITCH_SLEW) window_push(stream, rule->median_len, values);
+    }
+    return reason;
+}
+
+/**
+ * Logs the streams which had samples rejected since the last report.
+ * @param ctx The stage context.
+ */
+static void report(glitch_stage_ctx_t *ctx) {
+    for (uint8_t i = 0; i < ctx->nstreams; i++) {
+        glitch_stream_t *stream = &ctx->streams[i];
+        const uint64_t *rejected = stream->rejected;
+        uint64_t total = rejected[GLITCH_RANGE] + rejected[GLITCH_SLEW] + rejected[GLITCH_MEDIAN];
+        if (total == stream->reported) continue;
+        log_print(stderr, LOG_WARN,
+                  "Rejected %llu '%s' samples from source %u as glitches (%llu out of range, %llu too fast, %llu off "
+                  "the median in total)",
+                  (unsigned long long)(total - stream->reported), SENSOR_TAG_DATA[stream->type].name, stream->source,
+                  (unsigned long long)rejected[GLITCH_RANGE], (unsigned long long)rejected[GLITCH_SLEW],
+                  (unsigned long long)rejected[GLITCH_MEDIAN]);
+        stream->reported = total;
+    }
+}
+
+/**
+ * Passes through every sample except those of checked streams which fail a test, and counts the rejected samples.
+ * @param stage The glitch rejection stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void glitch_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    glitch_stage_ctx_t *ctx = stage->ctx;
+
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        uint8_t rule = ctx->rule_of[sample->msg.type];
+        if (rule == GLITCH_MAX_RULES) {
+            pipeline_emit(out, sample);
+            continue;
+        }
+
+        glitch_stream_t *stream = find_stream(ctx, sample, rule);
+        if (stream == NULL) {
+            if (!ctx->full) {
+                log_print(stderr, LOG_WARN, "Too many streams to check for glitches, passing the rest through");
+                ctx->full = true;
+            }
+            pipeline_emit(out, sample);
+            continue;
+        }
+
+        float values[3];
+        stream->axes = sensor_get_values(&sample->msg, values);
+        glitch_reason_t reason = check(&ctx->config.rules[rule], stream, sample->time, values);
+        if (reason != GLITCH_REASONS) {
+            stream->rejected[reason]++;
+            continue;
+        }
+
+        memcpy(stream->last, values, sizeof(stream->last));
+        stream->last_time = sample->time;
+        stream->accepted = true;
+        pipeline_emit(out, sample);
+    }
+
+    if (n > 0 && samples[n - 1].time >= ctx->next_report) {
+        report(ctx);
+        ctx->next_report = samples[n - 1].time + GLITCH_REPORT_PERIOD * NS_PER_SEC;
+    }
+}
+
+/**
+ * Sets up a stage which rejects glitches.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ * @return EOK if successful, EINVAL if a tag or a test's parameter is invalid.
+ */
+int glitch_stage_init(stage_t *stage, glitch_stage_ctx_t *ctx, const glitch_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    memset(ctx->rule_of, GLITCH_MAX_RULES, sizeof(ctx->rule_of));
+    if (config->nrules > GLITCH_MAX_RULES) return EINVAL;
+
+    for (uint8_t r = 0; r < config->nrules; r++) {
+        const glitch_rule_t *rule = &config->rules[r];
+        if (rule->tag >= SENSOR_TAG_COUNT || rule->median_len > GLITCH_MAX_MEDIAN) return EINVAL;
+        if (rule->median_len > 0 && (rule->median_len % 2 == 0 || !(rule->median_dev > 0))) return EINVAL;
+        if (!(rule->max_slew >= 0) || isinf(rule->max_slew)) return EINVAL;
+        ctx->rule_of[rule->tag] = r;
+    }
+
+    stage->name = "glitch";
+    stage->ctx = ctx;
+    stage->process = glitch_stage_process;
+    return EOK;
+}
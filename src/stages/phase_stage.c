@@ -0,0 +1,184 @@
+/**
+ * @file phase_stage.c
+ * @brief Stage which decides the phase of the flight from the samples streaming by, so the sensors follow it.
+ *
+ * Stage which decides the phase of the flight from the samples streaming by, so that the collectors can read their
+ * sensors only as fast and as precisely as each phase needs. The phases follow each other in order:
+ * - Idle: on the pad, where the flight computer starts.
+ * - Armed: the acceleration deviated from 1 g past a threshold, because the rocket is being handled or launched. Goes
+ *   back to idle if there is no such acceleration and no launch for a while.
+ * - Boost, coast and descent: entered on the launch, burnout and apogee events of the event detection stage, which
+ *   must come before this stage.
+ * - Landed: the barometric altitude stayed within a small band for a while during descent.
+ *
+ * Each transition is set for the collectors with `phase_set`, logged, and published as a `TAG_FLIGHT_PHASE` sample
+ * right after the sample which triggered it and with that sample's time.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <math.h>
+#include <string.h>
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The acceleration of 1 g in m/s^2, which the accelerometer reads at rest. */
+#define GRAVITY 9.80665f
+
+/** The message queue priority of flight phases, above every collector's. */
+#define PHASE_PRIO 4
+
+/**
+ * Enters a new phase: sets it for the collectors, publishes it and logs it.
+ * @param stage The flight phase stage.
+ * @param out The output of the stage.
+ * @param phase The phase.
+ * @param time The time of the sample which triggered the transition.
+ */
+static void enter(stage_t *stage, stage_out_t *out, phase_e phase, uint64_t time) {
+    phase_stage_ctx_t *ctx = stage->ctx;
+    phase_e from = ctx->phase;
+    ctx->phase = phase;
+    ctx->entered[phase] = time;
+    phase_set(phase, time);
+
+    sample_t sample = {.time = time, .source = stage->source, .prio = PHASE_PRIO};
+    sample.msg.type = TAG_FLIGHT_PHASE;
+    sample.msg.data.U8 = (uint8_t)phase;
+    pipeline_emit(out, &sample);
+
+    log_print(stderr, LOG_INFO, "Flight phase %s -> %s at %.3f s", phase_name(from), phase_name(phase),
+              (double)time / NS_PER_SEC);
+}
+
+/**
+ * Checks an acceleration sample for movement which arms the flight computer, or for the lack of it which disarms it.
+ * @param stage The flight phase stage.
+ * @param out The output of the stage.
+ * @param sample The acceleration sample.
+ */
+static void process_accel(stage_t *stage, stage_out_t *out, const sample_t *sample) {
+    phase_stage_ctx_t *ctx = stage->ctx;
+    if (!ctx->have_imu) {
+        ctx->imu_source = sample->source;
+        ctx->have_imu = true;
+    }
+    if (sample->source != ctx->imu_source) return;
+
+    // Whichever way the rocket lies, it reads 1 g at rest
+    const vec3d_t *v = &sample->msg.data.VEC3D;
+    float magnitude = sqrtf(v->x * v->x + v->y * v->y + v->z * v->z);
+    if (fabsf(magnitude - GRAVITY) > ctx->config.arm_accel) {
+        ctx->last_motion = sample->time;
+        if (ctx->phase == PHASE_IDLE) enter(stage, out, PHASE_ARMED, sample->time);
+    } else if (ctx->phase == PHASE_ARMED &&
+               sample->time - ctx->last_motion >= (uint64_t)ctx->config.disarm_ms * NS_PER_MS) {
+        enter(stage, out, PHASE_IDLE, sample->time);
+    }
+}
+
+/**
+ * Moves on to the phase a flight event starts. Events only ever move the flight forward.
+ * @param stage The flight phase stage.
+ * @param out The output of the stage.
+ * @param sample The flight event sample.
+ */
+static void process_event(stage_t *stage, stage_out_t *out, const sample_t *sample) {
+    phase_stage_ctx_t *ctx = stage->ctx;
+    phase_e phase;
+    switch (sample->msg.id) {
+    case EVENT_LAUNCH:
+        phase = PHASE_BOOST;
+        break;
+    case EVENT_BURNOUT:
+        phase = PHASE_COAST;
+        break;
+    case EVENT_APOGEE:
+        phase = PHASE_DESCENT;
+        break;
+    default:
+        return;
+    }
+    if (phase > ctx->phase) enter(stage, out, phase, sample->time);
+}
+
+/**
+ * Checks a barometric altitude sample during descent for landing: the altitude staying within a band for a while.
+ * @param stage The flight phase stage.
+ * @param out The output of the stage.
+ * @param sample The barometric altitude sample.
+ */
+static void process_alt(stage_t *stage, stage_out_t *out, const sample_t *sample) {
+    phase_stage_ctx_t *ctx = stage->ctx;
+    if (!ctx->have_baro) {
+        ctx->baro_source = sample->source;
+        ctx->have_baro = true;
+    }
+    if (sample->source != ctx->baro_source || ctx->phase != PHASE_DESCENT) return;
+
+    float alt = sample->msg.data.FLOAT;
+    if (ctx->settling) {
+        if (alt < ctx->alt_min) ctx->alt_min = alt;
+        if (alt > ctx->alt_max) ctx->alt_max = alt;
+    }
+    if (!ctx->settling || ctx->alt_max - ctx->alt_min > ctx->config.landed_alt) {
+        // Start a new band at this altitude
+        ctx->settling = true;
+        ctx->settle_start = sample->time;
+        ctx->alt_min = alt;
+        ctx->alt_max = alt;
+    } else if (sample->time - ctx->settle_start >= (uint64_t)ctx->config.landed_ms * NS_PER_MS) {
+        enter(stage, out, PHASE_LANDED, ctx->settle_start);
+    }
+}
+
+/**
+ * Passes every sample through, checking accelerations, flight events and altitudes for the next phase and emitting the
+ * phase right after the sample which triggered it. The first source of each input is the one which is checked.
+ * @param stage The flight phase stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void phase_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        pipeline_emit(out, sample);
+
+        // Raw copies of voted sensors: their consensus follows separately
+        if (sample->flags != 0) continue;
+
+        switch (sample->msg.type) {
+        case TAG_LINEAR_ACCEL_REL:
+            process_accel(stage, out, sample);
+            break;
+        case TAG_FLIGHT_EVENT:
+            process_event(stage, out, sample);
+            break;
+        case TAG_ALTITUDE_REL:
+            process_alt(stage, out, sample);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * Sets up a stage which decides the phase of the flight, and starts the flight idle.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ */
+void phase_stage_init(stage_t *stage, phase_stage_ctx_t *ctx, const phase_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    ctx->phase = PHASE_IDLE;
+    phase_set(PHASE_IDLE, pipeline_time());
+    stage->name = "phase";
+    stage->ctx = ctx;
+    stage->process = phase_stage_process;
+}
@@ -0,0 +1,278 @@
+/**
+ * @file resample_stage.c
+ * @brief Stage which resamples streams of different rates onto a common time grid, as one snapshot per tick.
+ *
+ * Stage which resamples streams of different rates onto a common time grid, as one snapshot per tick. The sensors
+ * publish at very different rates (the IMU at about 1 kHz, the barometer at 50 Hz, the GPS a few times a second), so a
+ * consumer which wants a consistent state would otherwise have to match samples up itself. The ticks fall on multiples
+ * of the grid's period since the pipeline started, and the value of each stream at a tick is interpolated linearly
+ * between its samples before and after the tick, or held from the sample before it for discrete data like a GPS fix.
+ *
+ * A tick is emitted once every interpolated stream has published a sample at or after it, or once any stream is
+ * `delay_ms` past it, whichever comes first; the streams which have not caught up hold their last value. This bounds
+ * how late a snapshot comes out when a sensor is slow or silent. Held streams are not waited for, and a stream which
+ * stopped publishing for more than RESAMPLE_MAX_GAP_MS is left out of the snapshots until it comes back. Each stream
+ * only keeps the samples which bracket a tick, so its history covers many ticks whatever its rate.
+ *
+ * A snapshot is a `TAG_SNAPSHOT` sample with the number of streams which follow as its ID and the tick's number (its
+ * time divided by the period) as its value, followed by the value of each stream with its own tag and ID. Every sample
+ * of a snapshot has the tick's time, the stage's source, the same message queue priority and SAMPLE_SNAPSHOT set, so
+ * the snapshot stays together on every output and the later stages leave it alone.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <errno.h>
+#include <string.h>
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The number of nanoseconds in a second. */
+#define NS_PER_SEC 1000000000ULL
+
+/** The message queue priority of every sample of a snapshot. */
+#define SNAPSHOT_PRIO 0
+
+/** The mask which turns a position into an index in a stream's history. */
+#define HISTORY_MASK (RESAMPLE_HISTORY_LEN - 1)
+
+_Static_assert((RESAMPLE_HISTORY_LEN & HISTORY_MASK) == 0, "The history length must be a power of two");
+
+/**
+ * Finds the first tick at or after a time.
+ * @param ctx The stage context.
+ * @param time The time.
+ * @return The time of the tick.
+ */
+static uint64_t tick_after(const resample_stage_ctx_t *ctx, uint64_t time) {
+    return (time + ctx->period - 1) / ctx->period * ctx->period;
+}
+
+/**
+ * Gets the time of a sample in a stream's history.
+ * @param history The history of the stream.
+ * @param k The position of the sample, 0 for the oldest.
+ * @return The time of the sample.
+ */
+static uint64_t time_at(const resample_history_t *history, uint8_t k) {
+    return history->times[(history->head + k) & HISTORY_MASK];
+}
+
+/**
+ * Adds a sample to a stream's history. The newest sample held is replaced rather than kept if no tick at or after the
+ * time of the sample before it comes before the new sample, since it can then neither precede nor follow a tick.
+ * @param ctx The stage context.
+ * @param history The history of the stream. Must not be full.
+ * @param sample The sample.
+ */
+static void history_push(const resample_stage_ctx_t *ctx, resample_history_t *history, const sample_t *sample) {
+    if (history->len > 0) {
+        uint64_t before = time_at(history, history->len > 1 ? history->len - 2 : 0);
+        if (tick_after(ctx, before) >= sample->time) history->len--;
+    }
+    uint8_t slot = (uint8_t)((history->head + history->len) & HISTORY_MASK);
+    history->times[slot] = sample->time;
+    history->msgs[slot] = sample->msg;
+    history->len++;
+}
+
+/**
+ * Drops the samples of a stream's history which come before its last sample at or before a tick.
+ * @param history The history of the stream.
+ * @param tick The time of the tick.
+ */
+static void history_trim(resample_history_t *history, uint64_t tick) {
+    while (history->len > 1 && time_at(history, 1) <= tick) {
+        history->head = (uint8_t)((history->head + 1) & HISTORY_MASK);
+        history->len--;
+    }
+}
+
+/**
+ * Computes the value of a stream at a tick.
+ * @param field The stream.
+ * @param history The history of the stream.
+ * @param tick The time of the tick.
+ * @param msg Set to the value, with the tag and ID of the stream.
+ * @return Whether the stream has a value at the tick: false if it started after the tick or stopped long before it.
+ */
+static bool value_at(const resample_field_t *field, const resample_history_t *history, uint64_t tick, common_t *msg) {
+    uint8_t before = RESAMPLE_HISTORY_LEN;
+    uint8_t after = RESAMPLE_HISTORY_LEN;
+    for (uint8_t k = 0; k < history->len; k++) {
+        uint8_t slot = (uint8_t)((history->head + k) & HISTORY_MASK);
+        if (history->times[slot] > tick) {
+            after = slot;
+            break;
+        }
+        before = slot;
+    }
+    if (before == RESAMPLE_HISTORY_LEN || history->times[before] + RESAMPLE_MAX_GAP_MS * NS_PER_MS < tick) return false;
+
+    *msg = history->msgs[before];
+    if (field->method == RESAMPLE_HOLD || after == RESAMPLE_HISTORY_LEN || history->times[before] == tick) return true;
+
+    float from[3], to[3];
+    uint8_t axes = sensor_get_values(&history->msgs[before], from);
+    sensor_get_values(&history->msgs[after], to);
+    float fraction = (float)(tick - history->times[before]) / (float)(history->times[after] - history->times[before]);
+    for (uint8_t a = 0; a < axes; a++) {
+        from[a] += (to[a] - from[a]) * fraction;
+    }
+
+    switch (SENSOR_TAG_DATA[msg->type].dtype) {
+    case TYPE_VEC3D:
+        msg->data.VEC3D = (vec3d_t){.x = from[0], .y = from[1], .z = from[2]};
+        break;
+    case TYPE_VEC2D:
+        msg->data.VEC2D = (vec2d_t){.x = from[0], .y = from[1]};
+        break;
+    default:
+        msg->data.FLOAT = from[0];
+        break;
+    }
+    return true;
+}
+
+/**
+ * Emits the snapshot of the next tick, and moves on to the tick after it.
+ * @param stage The resampling stage.
+ * @param out The output of the stage.
+ */
+static void emit_snapshot(stage_t *stage, stage_out_t *out) {
+    resample_stage_ctx_t *ctx = stage->ctx;
+    uint64_t tick = ctx->next_tick;
+
+    common_t values[RESAMPLE_MAX_FIELDS];
+    uint8_t n = 0;
+    for (uint8_t f = 0; f < ctx->config.nfields; f++) {
+        resample_history_t *history = &ctx->histories[f];
+        if (value_at(&ctx->config.fields[f], history, tick, &values[n])) n++;
+        history_trim(history, tick);
+    }
+
+    if (n > 0) {
+        sample_t sample = {.time = tick, .source = stage->source, .prio = SNAPSHOT_PRIO, .flags = SAMPLE_SNAPSHOT};
+        sample.msg.type = TAG_SNAPSHOT;
+        sample.msg.id = n;
+        sample.msg.data.U32 = (uint32_t)(tick / ctx->period);
+        pipeline_emit(out, &sample);
+        for (uint8_t i = 0; i < n; i++) {
+            sample.msg = values[i];
+            pipeline_emit(out, &sample);
+        }
+    }
+    ctx->next_tick += ctx->period;
+}
+
+/**
+ * Checks whether every interpolated stream which is still publishing has a sample at or after the next tick.
+ * @param ctx The stage context.
+ * @return Whether the next tick can be emitted without waiting any longer.
+ */
+static bool caught_up(const resample_stage_ctx_t *ctx) {
+    for (uint8_t f = 0; f < ctx->config.nfields; f++) {
+        const resample_history_t *history = &ctx->histories[f];
+        if (ctx->config.fields[f].method == RESAMPLE_HOLD || history->len == 0) continue;
+        uint64_t last = time_at(history, (uint8_t)(history->len - 1));
+        if (last < ctx->next_tick && last + RESAMPLE_MAX_GAP_MS * NS_PER_MS >= ctx->newest) return false;
+    }
+    return true;
+}
+
+/**
+ * Passes through every sample, and emits the snapshot of each tick as soon as the streams have caught up with it or it
+ * has waited for `delay_ms`.
+ * @param stage The resampling stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void resample_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    resample_stage_ctx_t *ctx = stage->ctx;
+
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        pipeline_emit(out, sample);
+        // Flagged samples are raw copies of voted sensors or already part of a snapshot
+        if (!ctx->resampled[sample->msg.type] || sample->flags != 0 || sample->source == stage->source) continue;
+
+        uint8_t id = SENSOR_TAG_DATA[sample->msg.type].has_id ? sample->msg.id : 0;
+        bool matched = false;
+        for (uint8_t f = 0; f < ctx->config.nfields; f++) {
+            const resample_field_t *field = &ctx->config.fields[f];
+            resample_history_t *history = &ctx->histories[f];
+            if (field->tag != sample->msg.type || field->id != id) continue;
+            if (field->source != RESAMPLE_ANY_SOURCE && field->source != sample->source) continue;
+            if (!history->heard) {
+                history->source = sample->source;
+                history->heard = true;
+            } else if (history->source != sample->source) {
+                continue;
+            }
+
+            if (!ctx->started) {
+                ctx->next_tick = tick_after(ctx, sample->time);
+                ctx->started = true;
+            }
+            if (sample->time > ctx->newest) ctx->newest = sample->time;
+
+            // Fill in no more than a gap's worth of ticks after the samples stopped, like between replayed segments
+            if (ctx->newest > ctx->next_tick + RESAMPLE_MAX_GAP_MS * NS_PER_MS) {
+                uint64_t restart = tick_after(ctx, ctx->newest - ctx->delay);
+                ctx->skipped += (restart - ctx->next_tick) / ctx->period;
+                ctx->next_tick = restart;
+                log_print(stderr, LOG_WARN, "Resampled streams stopped for more than %u ms, restarting the time grid",
+                          RESAMPLE_MAX_GAP_MS);
+            }
+
+            // A full history cannot wait for the slower streams any longer
+            while (history->len == RESAMPLE_HISTORY_LEN) {
+                ctx->forced++;
+                emit_snapshot(stage, out);
+            }
+            history_push(ctx, history, sample);
+            matched = true;
+        }
+        if (!matched) continue;
+
+        for (;;) {
+            if (ctx->next_tick > ctx->newest) break;
+            if (!caught_up(ctx)) {
+                if (ctx->next_tick + ctx->delay > ctx->newest) break;
+                ctx->forced++;
+            }
+            emit_snapshot(stage, out);
+        }
+    }
+}
+
+/**
+ * Sets up a stage which resamples streams onto a common time grid.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ * @return EOK if successful, EINVAL if the rate or a stream is invalid.
+ */
+int resample_stage_init(stage_t *stage, resample_stage_ctx_t *ctx, const resample_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    if (config->nfields > RESAMPLE_MAX_FIELDS || config->rate_hz == 0) return EINVAL;
+    ctx->period = NS_PER_SEC / config->rate_hz;
+    ctx->delay = config->delay_ms * NS_PER_MS;
+
+    for (uint8_t f = 0; f < config->nfields; f++) {
+        const resample_field_t *field = &config->fields[f];
+        if (field->tag >= SENSOR_TAG_COUNT || field->tag == TAG_SNAPSHOT) return EINVAL;
+        if (!SENSOR_TAG_DATA[field->tag].has_id && field->id != 0) return EINVAL;
+        SensorTagDType dtype = SENSOR_TAG_DATA[field->tag].dtype;
+        bool floats = dtype == TYPE_FLOAT || dtype == TYPE_VEC2D || dtype == TYPE_VEC3D;
+        if (field->method == RESAMPLE_LINEAR && !floats) return EINVAL;
+        ctx->resampled[field->tag] = true;
+    }
+
+    stage->name = "resample";
+    stage->ctx = ctx;
+    stage->process = resample_stage_process;
+    return EOK;
+}
@@ -0,0 +1,481 @@
+/**
+ * @file stages.h
+ * @brief Processing stages which fetcher's pipeline can run samples through before they reach the sinks.
+ *
+ * Processing stages which fetcher's pipeline can run samples through before they reach the sinks. Each `*_stage_init`
+ * function fills in a `stage_t` so it can be registered with `pipeline_add_stage`. The stage specific context must be
+ * provided by the caller.
+ */
+#ifndef _STAGES_H_
+#define _STAGES_H_
+
+#include "../phase/phase.h"
+#include "../pipeline/pipeline.h"
+#include "decim_kernels.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/** The default standard deviation of the vertical acceleration noise in m/s^2, which includes vibration. */
+#define FUSION_DEFAULT_ACCEL_SD 1.0f
+
+/** The default standard deviation of the barometric altitude noise in meters. */
+#define FUSION_DEFAULT_BARO_SD 0.5f
+
+/** The default rate at which the accelerometer bias is allowed to drift, in m/s^2 per square root of a second. */
+#define FUSION_DEFAULT_BIAS_SD 0.05f
+
+/** The longest gap between IMU samples which is integrated over, in seconds. Longer gaps are treated as this long. */
+#define FUSION_MAX_DT 0.1f
+
+/** How the altitude fusion stage is set up. */
+typedef struct {
+    uint8_t axis;   /**< The accelerometer axis along the rocket: 0 for x, 1 for y or 2 for z. */
+    bool invert;    /**< Whether the axis points towards the tail of the rocket rather than the nose. */
+    float accel_sd; /**< The standard deviation of the vertical acceleration noise in m/s^2. */
+    float baro_sd;  /**< The standard deviation of the barometric altitude noise in meters. */
+    float bias_sd;  /**< The rate at which the accelerometer bias drifts, in m/s^2 per square root of a second. */
+} fusion_config_t;
+
+/** Context for the altitude fusion stage. */
+typedef struct {
+    fusion_config_t config; /**< How the stage is set up. */
+    bool ready;             /**< Whether the filter has been initialized from a barometer sample. */
+    bool have_imu;          /**< Whether an IMU sample has been seen, so that `imu_source` and `last_time` are set. */
+    bool have_baro;         /**< Whether a barometer sample has been seen, so that `baro_source` is set. */
+    uint8_t imu_source;     /**< The collector whose acceleration is fused. */
+    uint8_t baro_source;    /**< The collector whose altitude is fused. */
+    uint64_t last_time;     /**< The time of the last IMU sample. */
+    float x[3];             /**< The state: altitude (m), vertical velocity (m/s) and accelerometer bias (m/s^2). */
+    float p[3][3];          /**< The covariance of the state. */
+} fusion_stage_ctx_t;
+
+/** The default acceleration along the rocket above which launch is detected, in m/s^2 (3 g, with gravity). */
+#define EVENTS_DEFAULT_LAUNCH_ACCEL 29.4f
+
+/** The default acceleration along the rocket below which burnout is detected, in m/s^2 (0.5 g, with gravity). */
+#define EVENTS_DEFAULT_BURNOUT_ACCEL 4.9f
+
+/** The default time the acceleration must stay past a threshold before launch or burnout is detected, in ms. */
+#define EVENTS_DEFAULT_HOLD_MS 50
+
+/** The default time constant of the low-pass filter which removes motor vibration from the acceleration, in ms. */
+#define EVENTS_DEFAULT_FILTER_MS 10
+
+/** The default downwards vertical velocity which confirms apogee, in m/s. */
+#define EVENTS_DEFAULT_APOGEE_VEL 0.5f
+
+/** The default drop below the highest barometric altitude which confirms apogee without a vertical velocity, in m. */
+#define EVENTS_DEFAULT_APOGEE_DROP 5.0f
+
+/** How the flight event detection stage is set up. */
+typedef struct {
+    uint8_t axis;        /**< The accelerometer axis along the rocket: 0 for x, 1 for y or 2 for z. */
+    bool invert;         /**< Whether the axis points towards the tail of the rocket rather than the nose. */
+    float launch_accel;  /**< The acceleration along the rocket above which launch is detected, in m/s^2. */
+    float burnout_accel; /**< The acceleration along the rocket below which burnout is detected, in m/s^2. */
+    uint32_t hold_ms;    /**< How long the acceleration must stay past a threshold to detect launch or burnout. */
+    uint32_t filter_ms;  /**< The time constant of the acceleration low-pass filter in ms, 0 for no filter. */
+    float apogee_vel;    /**< The downwards vertical velocity which confirms apogee, in m/s. */
+    float apogee_drop;   /**< The drop below the highest altitude which confirms apogee without a velocity, in m. */
+} events_config_t;
+
+/** Context for the flight event detection stage. */
+typedef struct {
+    events_config_t config;             /**< How the stage is set up. */
+    bool have_imu;                      /**< Whether an IMU sample has been seen, so `imu_source` is set. */
+    bool have_baro;                     /**< Whether a barometer sample has been seen, so `baro_source` is set. */
+    bool have_vel;                      /**< Whether a vertical velocity has been seen, so `vel_source` is set. */
+    uint8_t imu_source;                 /**< The collector whose acceleration is used. */
+    uint8_t baro_source;                /**< The collector whose altitude is used if there is no vertical velocity. */
+    uint8_t vel_source;                 /**< The stage whose vertical velocity is used. */
+    uint8_t next;                       /**< The next event to detect, or 0 once apogee has been detected. */
+    uint64_t last_time;                 /**< The time of the last IMU sample. */
+    float accel;                        /**< The low-pass filtered acceleration along the rocket, in m/s^2. */
+    bool pending;                       /**< Whether the condition of the next event has held since `onset`. */
+    uint64_t onset;                     /**< The time of the sample which triggered the pending event. */
+    float max_alt;                      /**< The highest barometric altitude since burnout, reached at `onset`. */
+    uint64_t onsets[EVENT_APOGEE + 1];  /**< The time of the sample which triggered each detected event. */
+    uint64_t latency[EVENT_APOGEE + 1]; /**< How long after its triggering sample each event was detected, in ns. */
+} events_stage_ctx_t;
+
+/** The default deviation of the acceleration from 1 g which arms the flight computer, in m/s^2. */
+#define PHASE_DEFAULT_ARM_ACCEL 2.0f
+
+/** The default time without launch or movement after which the flight computer goes back to idle, in ms. */
+#define PHASE_DEFAULT_DISARM_MS 60000
+
+/** The default band the barometric altitude must stay within to detect landing, in m. */
+#define PHASE_DEFAULT_LANDED_ALT 2.0f
+
+/** The default time the barometric altitude must stay within the band to detect landing, in ms. */
+#define PHASE_DEFAULT_LANDED_MS 10000
+
+/** How the flight phase stage is set up. */
+typedef struct {
+    float arm_accel;    /**< The deviation of the acceleration from 1 g which arms the flight computer, in m/s^2. */
+    uint32_t disarm_ms; /**< The time without launch or movement after which the computer goes back to idle. */
+    float landed_alt;   /**< The band the barometric altitude must stay within to detect landing, in m. */
+    uint32_t landed_ms; /**< The time the barometric altitude must stay within the band to detect landing. */
+} phase_config_t;
+
+/** Context for the flight phase stage. */
+typedef struct {
+    phase_config_t config;         /**< How the stage is set up. */
+    phase_e phase;                 /**< The current phase. */
+    bool have_imu;                 /**< Whether an IMU sample has been seen, so `imu_source` is set. */
+    bool have_baro;                /**< Whether a barometer sample has been seen, so `baro_source` is set. */
+    uint8_t imu_source;            /**< The collector whose acceleration arms the computer. */
+    uint8_t baro_source;           /**< The collector whose altitude detects landing. */
+    uint64_t last_motion;          /**< The time of the last acceleration past the arming threshold. */
+    bool settling;                 /**< Whether the altitude has stayed within the band since `settle_start`. */
+    uint64_t settle_start;         /**< The time of the first altitude of the band. */
+    float alt_min;                 /**< The lowest altitude since `settle_start`. */
+    float alt_max;                 /**< The highest altitude since `settle_start`. */
+    uint64_t entered[PHASE_COUNT]; /**< The time of the sample which triggered each phase, or 0. */
+} phase_stage_ctx_t;
+
+/** The maximum number of tags the decimation stage can be set up to decimate. */
+#define DECIM_MAX_RULES 4
+
+/** The maximum number of streams the decimation stage can decimate. Further streams pass through at full rate. */
+#define DECIM_MAX_STREAMS 8
+
+/** The maximum number of taps of a FIR decimation filter, after padding to a multiple of DECIM_FIR_LANES. */
+#define DECIM_MAX_TAPS 512
+
+/** The default decimation factor, which takes the IMU from about 1 kHz down to 100 Hz. */
+#define DECIM_DEFAULT_FACTOR 10
+
+/** The default number of stages of a CIC decimation filter. */
+#define DECIM_DEFAULT_CIC_ORDER 3
+
+/** The default number of taps of a FIR decimation filter per unit of decimation factor. */
+#define DECIM_DEFAULT_TAPS_PER_PHASE 8
+
+/** The filters the decimation stage can use. */
+typedef enum {
+    DECIM_CIC, /**< Cascaded integrator-comb filter: cheap, but its passband droops and its stopband has gaps. */
+    DECIM_FIR, /**< Windowed-sinc low-pass FIR filter, computed in polyphase form: flat passband, steep cutoff. */
+} decim_filter_t;
+
+/** How the samples of one tag are decimated. */
+typedef struct {
+    uint8_t tag;           /**< The tag to decimate. Its data must be a float or a vector of floats. */
+    decim_filter_t filter; /**< The anti-aliasing filter. */
+    uint16_t factor;       /**< The decimation factor: one sample comes out for every `factor` samples in. */
+    uint16_t order;        /**< The number of CIC stages or of FIR taps, or 0 for the default. */
+} decim_rule_t;
+
+/** How the decimation stage is set up. */
+typedef struct {
+    decim_rule_t rules[DECIM_MAX_RULES]; /**< How each tag is decimated. */
+    uint8_t nrules;                      /**< The number of tags to decimate. */
+} decim_config_t;
+
+/** The state of one decimated stream. */
+typedef struct {
+    uint8_t source;     /**< The source of the stream. */
+    uint8_t type;       /**< The tag of the stream. */
+    uint8_t id;         /**< The ID of the stream, for tags which have IDs. */
+    uint8_t rule;       /**< The rule the stream is decimated with. */
+    uint16_t count;     /**< The number of samples in since the last sample out. */
+    uint16_t pos;       /**< Where the next sample goes in the FIR history. */
+    uint16_t warmup;    /**< The number of CIC outputs left before the filter has settled. */
+    uint64_t last_time; /**< The time of the last sample in. */
+    float period;       /**< The average time between samples in, in nanoseconds. */
+    /** The state of the filter, depending on the rule's filter. */
+    union {
+        struct {
+            decim_cic_lanes_t integ[DECIM_CIC_MAX_ORDER]; /**< The CIC integrators. */
+            decim_cic_lanes_t comb[DECIM_CIC_MAX_ORDER];  /**< The CIC combs. */
+        } cic;
+        float hist[3][2 * DECIM_MAX_TAPS]; /**< The FIR history of each axis, stored twice so windows are contiguous. */
+    };
+} decim_stream_t;
+
+/** Context for the decimation stage. */
+typedef struct {
+    decim_config_t config;                       /**< How the stage is set up. */
+    uint8_t rule_of[256];                        /**< The rule for each tag, or DECIM_MAX_RULES for none. */
+    uint8_t axes[DECIM_MAX_RULES];               /**< The number of floats in the data of each rule's tag. */
+    uint16_t ntaps[DECIM_MAX_RULES];             /**< The number of FIR taps of each rule, with padding. */
+    uint8_t shift[DECIM_MAX_RULES];              /**< The fractional bits of each CIC rule's fixed point input. */
+    float scale[DECIM_MAX_RULES];                /**< What each CIC rule's output is multiplied by to undo its gain. */
+    float delay[DECIM_MAX_RULES];                /**< The group delay of each rule's filter, in samples in. */
+    float taps[DECIM_MAX_RULES][DECIM_MAX_TAPS]; /**< The FIR taps of each rule, with the padding first. */
+    decim_stream_t streams[DECIM_MAX_STREAMS];   /**< The decimated streams. */
+    uint8_t nstreams;                            /**< The number of decimated streams. */
+    bool full;                                   /**< Whether a stream was left at full rate for lack of room. */
+    bool skipped;                                /**< Whether a value which is not finite skipped a CIC filter. */
+} decim_stage_ctx_t;
+
+/** The maximum number of tags the statistics stage can be set up to track. */
+#define STATS_MAX_RULES 8
+
+/** The maximum number of streams the statistics stage can track. Further streams are ignored. */
+#define STATS_MAX_STREAMS 8
+
+/**
+ * The maximum number of samples in a window. Must be a power of two. Older samples leave a full window early, so a
+ * window longer than this many samples at its stream's rate (2.4 s of the IMU at its default 833 Hz) is cut short.
+ */
+#define STATS_WINDOW_LEN 2048
+
+/** The default length of a statistics window, in ms. */
+#define STATS_DEFAULT_WINDOW_MS 1000
+
+/** The default time between two publications of a stream's statistics, in ms. */
+#define STATS_DEFAULT_INTERVAL_MS 1000
+
+/** How the samples of one tag are summarized. */
+typedef struct {
+    uint8_t tag;        /**< The tag to summarize. */
+    uint32_t window_ms; /**< The length of the window the statistics are computed over, in ms. */
+} stats_rule_t;
+
+/** How the statistics stage is set up. */
+typedef struct {
+    stats_rule_t rules[STATS_MAX_RULES]; /**< How each tag is summarized. */
+    uint8_t nrules;                      /**< The number of tags to summarize. */
+    uint32_t interval_ms;                /**< The time between two publications of a stream's statistics, in ms. */
+} stats_config_t;
+
+/** A monotonic deque of the sequence numbers of the samples in a window, for its minimum or maximum. */
+typedef struct {
+    uint32_t seq[STATS_WINDOW_LEN]; /**< The sequence numbers, the front being the extremum of the window. */
+    uint16_t head;                  /**< The index of the front. */
+    uint16_t len;                   /**< The number of sequence numbers. */
+} stats_deque_t;
+
+/** The state of one summarized stream. */
+typedef struct {
+    uint8_t source;                    /**< The source of the stream. */
+    uint8_t type;                      /**< The tag of the stream. */
+    uint8_t id;                        /**< The ID of the stream, or 0 if its tag has none. */
+    uint8_t rule;                      /**< The index of the rule for the stream's tag. */
+    uint8_t axes;                      /**< The number of values per sample. */
+    bool truncated;                    /**< Whether the window was ever cut short for lack of room. */
+    uint64_t next_publish;             /**< The time at which the statistics are next published. */
+    uint32_t seq;                      /**< The sequence number of the next sample. */
+    uint16_t len;                      /**< The number of samples in the window. */
+    uint64_t times[STATS_WINDOW_LEN];  /**< The time of each sample, by sequence number. */
+    float values[STATS_WINDOW_LEN][3]; /**< The values of each sample, by sequence number. */
+    double mean[3];                    /**< The mean of each axis over the window. */
+    double m2[3];                      /**< The sum of squared differences from the mean of each axis. */
+    stats_deque_t min[3];              /**< The candidates for the minimum of each axis. */
+    stats_deque_t max[3];              /**< The candidates for the maximum of each axis. */
+} stats_stream_t;
+
+/** Context for the statistics stage. */
+typedef struct {
+    stats_config_t config;                     /**< How the stage is set up. */
+    uint8_t rule_of[256];                      /**< The rule for each tag, or STATS_MAX_RULES if none. */
+    stats_stream_t streams[STATS_MAX_STREAMS]; /**< The summarized streams. */
+    uint8_t nstreams;                          /**< The number of summarized streams. */
+    bool full;                                 /**< Whether a stream was ignored because there was no room left. */
+} stats_stage_ctx_t;
+
+/** The maximum number of tags the glitch rejection stage can be set up to check. */
+#define GLITCH_MAX_RULES 8
+
+/** The maximum number of streams the glitch rejection stage can check. Further streams pass through unchecked. */
+#define GLITCH_MAX_STREAMS 16
+
+/** The maximum number of samples in a running median. */
+#define GLITCH_MAX_MEDIAN 15
+
+/** How often the glitch rejection stage reports new rejections, in seconds. */
+#define GLITCH_REPORT_PERIOD 10
+
+/** The tests a sample can fail, for counting rejections. */
+typedef enum {
+    GLITCH_RANGE,  /**< A value is outside the physical range of its tag. */
+    GLITCH_SLEW,   /**< A value changed faster than allowed since the last accepted sample. */
+    GLITCH_MEDIAN, /**< A value is too far from the running median of the stream. */
+    GLITCH_REASONS /**< The number of tests. */
+} glitch_reason_t;
+
+/** How the samples of one tag are checked. Each test is skipped if its parameter is 0. */
+typedef struct {
+    uint8_t tag;        /**< The tag to check. Samples outside the tag's physical range are always rejected. */
+    uint8_t median_len; /**< The number of samples in the running median, odd. */
+    float median_dev;   /**< The largest distance from the running median, in the tag's unit. */
+    float max_slew;     /**< The largest rate of change from the last accepted sample, in the tag's unit per second. */
+} glitch_rule_t;
+
+/** How the glitch rejection stage is set up. */
+typedef struct {
+    glitch_rule_t rules[GLITCH_MAX_RULES]; /**< How each tag is checked. */
+    uint8_t nrules;                        /**< The number of tags to check. */
+} glitch_config_t;
+
+/** The state of one checked stream. */
+typedef struct {
+    uint8_t source;                     /**< The source of the stream. */
+    uint8_t type;                       /**< The tag of the stream. */
+    uint8_t id;                         /**< The ID of the stream, or 0 if its tag has none. */
+    uint8_t rule;                       /**< The index of the rule for the stream's tag. */
+    uint8_t axes;                       /**< The number of values per sample. */
+    uint8_t len;                        /**< The number of samples in the running median's window. */
+    uint8_t head;                       /**< The index of the oldest sample in the window. */
+    bool accepted;                      /**< Whether any sample of the stream was accepted yet. */
+    uint64_t last_time;                 /**< The time of the last accepted sample. */
+    float last[3];                      /**< The values of the last accepted sample. */
+    float window[3][GLITCH_MAX_MEDIAN]; /**< The last samples of each axis which passed the range and slew tests. */
+    float sorted[3][GLITCH_MAX_MEDIAN]; /**< The same samples of each axis, in ascending order. */
+    uint64_t rejected[GLITCH_REASONS];  /**< The number of samples rejected by each test. */
+    uint64_t reported;                  /**< The number of rejected samples at the last report. */
+} glitch_stream_t;
+
+/** Context for the glitch rejection stage. */
+typedef struct {
+    glitch_config_t config;                      /**< How the stage is set up. */
+    uint8_t rule_of[256];                        /**< The rule for each tag, or GLITCH_MAX_RULES if none. */
+    glitch_stream_t streams[GLITCH_MAX_STREAMS]; /**< The checked streams. */
+    uint8_t nstreams;                            /**< The number of checked streams. */
+    bool full;                                   /**< Whether a stream was left unchecked because there was no room. */
+    uint64_t next_report;                        /**< The time at which new rejections are next reported. */
+} glitch_stage_ctx_t;
+
+/** The maximum number of groups of redundant sensors the voting stage can hold. */
+#define VOTE_MAX_GROUPS 4
+
+/** The maximum number of sensors in a group, which is the most addresses the board ID lists for one sensor. */
+#define VOTE_MAX_MEMBERS 5
+
+/** The maximum number of tags the voting stage can be set up to vote on. */
+#define VOTE_MAX_TAGS 8
+
+/** The maximum number of voted streams (one per group, tag and ID). Further streams are not voted on. */
+#define VOTE_MAX_STREAMS 16
+
+/** The most samples of one sensor which can wait for the other sensors of its group. Must be a power of two. */
+#define VOTE_QUEUE_LEN 32
+
+/** The default time after which a sensor which stopped publishing is left out of the votes, in ms. */
+#define VOTE_DEFAULT_STALE_MS 100
+
+/** How the values of redundant sensors are combined. */
+typedef enum {
+    VOTE_MEDIAN,   /**< The median of each axis, or the mean of the two middle values for an even count. */
+    VOTE_WEIGHTED, /**< The mean of each axis, weighted by how closely each sensor recently followed the median. */
+} vote_method_t;
+
+/** A group of redundant sensors which measure the same quantities. */
+typedef struct {
+    uint8_t sources[VOTE_MAX_MEMBERS]; /**< The sources of the sensors. */
+    uint8_t n;                         /**< The number of sensors. */
+} vote_group_t;
+
+/** How the voting stage is set up. */
+typedef struct {
+    vote_method_t method;                 /**< How the values of the sensors are combined. */
+    uint8_t tags[VOTE_MAX_TAGS];          /**< The tags to vote on. Their data must be a float or a 3D vector. */
+    uint8_t ntags;                        /**< The number of tags to vote on. */
+    uint32_t stale_ms;                    /**< The time after which a silent sensor is left out of the votes, in ms. */
+    vote_group_t groups[VOTE_MAX_GROUPS]; /**< The groups known in advance, like those of a recording. */
+    uint8_t ngroups;                      /**< The number of groups known in advance. */
+} vote_config_t;
+
+/** The state of one voted stream: one tag and ID of one group. */
+typedef struct {
+    uint8_t group;                                     /**< The group of the stream. */
+    uint8_t type;                                      /**< The tag of the stream. */
+    uint8_t id;                                        /**< The ID of the stream, or 0 if its tag has none. */
+    uint8_t axes;                                      /**< The number of values per sample. */
+    bool passthrough;                                  /**< Whether another group already votes on this tag. */
+    uint8_t heard;                                     /**< The sensors which ever published, one bit each. */
+    uint64_t last[VOTE_MAX_MEMBERS];                   /**< The time of each sensor's latest sample. */
+    uint8_t head[VOTE_MAX_MEMBERS];                    /**< Where each sensor's oldest waiting sample is. */
+    uint8_t len[VOTE_MAX_MEMBERS];                     /**< The number of samples each sensor has waiting. */
+    uint64_t times[VOTE_MAX_MEMBERS][VOTE_QUEUE_LEN];  /**< The times of each sensor's waiting samples. */
+    float values[VOTE_MAX_MEMBERS][VOTE_QUEUE_LEN][3]; /**< The values of each sensor's waiting samples. */
+    float variance[VOTE_MAX_MEMBERS][3];               /**< The recent mean squared distance from the median. */
+} vote_stream_t;
+
+/** Context for the voting stage. */
+typedef struct {
+    vote_config_t config;                    /**< How the stage is set up, including every group added since. */
+    uint8_t group_of[256];                   /**< The group of each source, or VOTE_MAX_GROUPS if none. */
+    uint8_t member_of[256];                  /**< The index of each source in its group. */
+    bool voted[256];                         /**< Whether each tag is voted on. */
+    vote_stream_t streams[VOTE_MAX_STREAMS]; /**< The voted streams. */
+    uint8_t nstreams;                        /**< The number of voted streams. */
+    bool full;                               /**< Whether a stream was not voted on because there was no room left. */
+} vote_stage_ctx_t;
+
+/** The maximum number of streams in a snapshot of the resampling stage. */
+#define RESAMPLE_MAX_FIELDS 12
+
+/** The most samples of one stream the resampling stage holds while it waits for the others. Must be a power of two. */
+#define RESAMPLE_HISTORY_LEN 64
+
+/** The default rate of the common time grid in Hz. */
+#define RESAMPLE_DEFAULT_RATE 100
+
+/** The default longest time a tick waits for a stream to publish a sample at or after it, in ms. */
+#define RESAMPLE_DEFAULT_DELAY_MS 50
+
+/** A gap in the samples longer than this restarts the time grid after it instead of filling it in, in ms. */
+#define RESAMPLE_MAX_GAP_MS 1000
+
+/** Resample the stream of a tag from the first source which publishes it. */
+#define RESAMPLE_ANY_SOURCE UINT8_MAX
+
+/** How a stream's value at a tick is computed from its samples around it. */
+typedef enum {
+    RESAMPLE_LINEAR, /**< Interpolated between the samples before and after the tick. For float data only. */
+    RESAMPLE_HOLD,   /**< The value of the last sample at or before the tick, for discrete data like a GPS fix. */
+} resample_method_t;
+
+/** A stream which the resampling stage puts in every snapshot. */
+typedef struct {
+    uint8_t tag;              /**< The tag of the stream. */
+    uint8_t id;               /**< The ID of the stream, for tags which have IDs. */
+    uint8_t source;           /**< The source of the stream, or RESAMPLE_ANY_SOURCE. */
+    resample_method_t method; /**< How the stream's value at a tick is computed. */
+} resample_field_t;
+
+/** How the resampling stage is set up. */
+typedef struct {
+    resample_field_t fields[RESAMPLE_MAX_FIELDS]; /**< The streams in a snapshot, in the order they are emitted. */
+    uint8_t nfields;                              /**< The number of streams in a snapshot. */
+    uint16_t rate_hz;                             /**< The rate of the common time grid in Hz. */
+    uint32_t delay_ms;                            /**< The longest time a tick waits for the streams, in ms. */
+} resample_config_t;
+
+/** The recent samples of one resampled stream. */
+typedef struct {
+    uint8_t source;                       /**< The source of the stream, once known. */
+    bool heard;                           /**< Whether the stream has published, so `source` is known. */
+    uint8_t head;                         /**< Where the oldest sample held is. */
+    uint8_t len;                          /**< The number of samples held. */
+    uint64_t times[RESAMPLE_HISTORY_LEN]; /**< The times of the samples held. */
+    common_t msgs[RESAMPLE_HISTORY_LEN];  /**< The samples held. */
+} resample_history_t;
+
+/** Context for the resampling stage. */
+typedef struct {
+    resample_config_t config;                          /**< How the stage is set up. */
+    uint64_t period;                                   /**< The time between two ticks in ns. */
+    uint64_t delay;                                    /**< The longest time a tick waits for the streams, in ns. */
+    bool resampled[256];                               /**< Whether any stream of each tag is resampled. */
+    bool started;                                      /**< Whether a stream has published, so `next_tick` is set. */
+    uint64_t next_tick;                                /**< The time of the next snapshot. */
+    uint64_t newest;                                   /**< The time of the newest sample of any resampled stream. */
+    uint64_t forced;                                   /**< The ticks emitted before every stream caught up. */
+    uint64_t skipped;                                  /**< The ticks skipped over gaps in the samples. */
+    resample_history_t histories[RESAMPLE_MAX_FIELDS]; /**< The recent samples of each resampled stream. */
+} resample_stage_ctx_t;
+
+void fusion_stage_init(stage_t *stage, fusion_stage_ctx_t *ctx, const fusion_config_t *config);
+void events_stage_init(stage_t *stage, events_stage_ctx_t *ctx, const events_config_t *config);
+int decim_stage_init(stage_t *stage, decim_stage_ctx_t *ctx, const decim_config_t *config);
+int stats_stage_init(stage_t *stage, stats_stage_ctx_t *ctx, const stats_config_t *config);
+int glitch_stage_init(stage_t *stage, glitch_stage_ctx_t *ctx, const glitch_config_t *config);
+int vote_stage_init(stage_t *stage, vote_stage_ctx_t *ctx, const vote_config_t *config);
+int vote_stage_add_group(vote_stage_ctx_t *ctx, const vote_group_t *group);
+int resample_stage_init(stage_t *stage, resample_stage_ctx_t *ctx, const resample_config_t *config);
+void phase_stage_init(stage_t *stage, phase_stage_ctx_t *ctx, const phase_config_t *config);
+
+#endif // _STAGES_H_
@@ -0,0 +1,274 @@
+/**
+ * @file stats_stage.c
+ * @brief Stage which keeps rolling statistics of streams and publishes them at a low rate.
+ *
+ * Stage which keeps rolling statistics of streams and publishes them at a low rate, so that health monitoring and
+ * ground displays do not each have to re-read the full rate streams. Each stream of a summarized tag (each source and
+ * ID separately) has its own window holding the samples of the last `window_ms` milliseconds. Every axis of the window
+ * is summarized by its minimum, maximum, mean, variance and RMS.
+ *
+ * Each sample costs O(1), however long the window:
+ * - The mean and variance use Welford's algorithm, which adds the newest value and removes the oldest one with an
+ *   update of the running mean and sum of squared differences. They are kept in double precision so that the small
+ *   rounding errors of removals do not build up.
+ * - The minimum and maximum use monotonic deques: the sequence numbers of the samples which could still become the
+ *   extremum of the window, in order. A new value first drops every candidate it beats from the back, so the front is
+ *   always the extremum, and each sample enters and leaves a deque at most once.
+ *
+ * Every `interval_ms`, the statistics of a stream are published right after one of its samples, as one sample per
+ * statistic (`TAG_STATS_MIN` to `TAG_STATS_RMS`) with the stream's source and an ID made from its tag and ID
+ * (`STATS_ID`). Each holds a vector with one value per axis of the stream; the unused axes are zero.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** The mask which turns a sequence number into an index in a window. */
+#define WINDOW_MASK (STATS_WINDOW_LEN - 1)
+
+/** The message queue priority of statistics, below every collector's. */
+#define STATS_PRIO 0
+
+_Static_assert((STATS_WINDOW_LEN & WINDOW_MASK) == 0, "The window length must be a power of two");
+
+/**
+ * Finds the state of the stream a sample belongs to, starting a new stream if needed.
+ * @param ctx The stage context.
+ * @param sample The sample.
+ * @param rule The rule for the sample's tag.
+ * @return The state of the stream, or null if there is no room for another stream.
+ */
+static stats_stream_t *find_stream(stats_stage_ctx_t *ctx, const sample_t *sample, uint8_t rule) {
+    uint8_t id = SENSOR_TAG_DATA[sample->msg.type].has_id ? sample->msg.id : 0;
+    for (uint8_t i = 0; i < ctx->nstreams; i++) {
+        stats_stream_t *stream = &ctx->streams[i];
+        if (stream->source == sample->source && stream->type == sample->msg.type && stream->id == id) return stream;
+    }
+    if (ctx->nstreams == STATS_MAX_STREAMS) return NULL;
+
+    stats_stream_t *stream = &ctx->streams[ctx->nstreams++];
+    memset(stream, 0, sizeof(*stream));
+    stream->source = sample->source;
+    stream->type = sample->msg.type;
+    stream->id = id;
+    stream->rule = rule;
+    stream->next_publish = sample->time + ctx->config.interval_ms * NS_PER_MS;
+    return stream;
+}
+
+/**
+ * Gets a value of the sample with a sequence number.
+ * @param stream The stream.
+ * @param seq The sequence number of the sample, which must be in the window.
+ * @param axis The axis.
+ * @return The value.
+ */
+static float value_of(const stats_stream_t *stream, uint32_t seq, uint8_t axis) {
+    return stream->values[seq & WINDOW_MASK][axis];
+}
+
+/**
+ * Adds the newest sample of a window to a monotonic deque, after dropping the candidates it beats from the back.
+ * @param stream The stream.
+ * @param deque The deque of the minimum or maximum of an axis.
+ * @param axis The axis.
+ * @param is_min True if the deque is for the minimum, false if it is for the maximum.
+ */
+static void deque_push(stats_stream_t *stream, stats_deque_t *deque, uint8_t axis, bool is_min) {
+    float value = value_of(stream, stream->seq, axis);
+    while (deque->len > 0) {
+        float back = value_of(stream, deque->seq[(deque->head + deque->len - 1) & WINDOW_MASK], axis);
+        if (is_min ? back < value : back > value) break;
+        deque->len--;
+    }
+    deque->seq[(deque->head + deque->len) & WINDOW_MASK] = stream->seq;
+    deque->len++;
+}
+
+/**
+ * Removes the oldest sample of a window from a monotonic deque, if it is still the deque's front.
+ * @param deque The deque of the minimum or maximum of an axis.
+ * @param seq The sequence number of the oldest sample.
+ */
+static void deque_expire(stats_deque_t *deque, uint32_t seq) {
+    if (deque->len == 0 || deque->seq[deque->head] != seq) return;
+    deque->head = (uint16_t)((deque->head + 1) & WINDOW_MASK);
+    deque->len--;
+}
+
+/**
+ * Removes the oldest sample from the window of a stream.
+ * @param stream The stream, whose window must not be empty.
+ */
+static void remove_oldest(stats_stream_t *stream) {
+    uint32_t oldest = stream->seq - stream->len;
+    stream->len--;
+    double inv_len = stream->len > 0 ? 1 / (double)stream->len : 0;
+    for (uint8_t a = 0; a < stream->axes; a++) {
+        double value = (double)value_of(stream, oldest, a);
+        if (stream->len == 0) {
+            stream->mean[a] = 0;
+            stream->m2[a] = 0;
+        } else {
+            double delta = value - stream->mean[a];
+            stream->mean[a] -= delta * inv_len;
+            stream->m2[a] -= delta * (value - stream->mean[a]);
+        }
+        deque_expire(&stream->min[a], oldest);
+        deque_expire(&stream->max[a], oldest);
+    }
+}
+
+/**
+ * Adds a sample to the window of a stream, removing the oldest sample first if the window is full.
+ * @param stream The stream.
+ * @param time The time of the sample.
+ * @param values The values of the sample, one per axis.
+ */
+static void add_newest(stats_stream_t *stream, uint64_t time, const float *values) {
+    if (stream->len == STATS_WINDOW_LEN) {
+        remove_oldest(stream);
+        if (!stream->truncated) {
+            log_print(stderr, LOG_WARN, "Statistics window of tag %u is full, summarizing only its last %u samples",
+                      stream->type, STATS_WINDOW_LEN);
+            stream->truncated = true;
+        }
+    }
+
+    uint32_t index = stream->seq & WINDOW_MASK;
+    stream->times[index] = time;
+    memcpy(stream->values[index], values, sizeof(stream->values[index]));
+    stream->len++;
+    double inv_len = 1 / (double)stream->len;
+    for (uint8_t a = 0; a < stream->axes; a++) {
+        double delta = (double)values[a] - stream->mean[a];
+        stream->mean[a] += delta * inv_len;
+        stream->m2[a] += delta * ((double)values[a] - stream->mean[a]);
+        deque_push(stream, &stream->min[a], a, true);
+        deque_push(stream, &stream->max[a], a, false);
+    }
+    stream->seq++;
+}
+
+/**
+ * Emits one statistic of a stream.
+ * @param out The output of the stage.
+ * @param stream The stream.
+ * @param type The tag of the statistic.
+ * @param values The statistic of each axis.
+ * @param time The time of the statistic.
+ */
+static void emit(stage_out_t *out, const stats_stream_t *stream, uint8_t type, const float *values, uint64_t time) {
+    sample_t sample = {.time = time, .source = stream->source, .prio = STATS_PRIO};
+    sample.msg.type = type;
+    sample.msg.id = STATS_ID(stream->type, stream->id);
+    sample.msg.data.VEC3D = (vec3d_t){.x = values[0], .y = values[1], .z = values[2]};
+    pipeline_emit(out, &sample);
+}
+
+/**
+ * Emits the statistics of the window of a stream.
+ * @param out The output of the stage.
+ * @param stream The stream, whose window must not be empty.
+ * @param time The time of the statistics.
+ */
+static void publish(stage_out_t *out, const stats_stream_t *stream, uint64_t time) {
+    float min[3] = {0};
+    float max[3] = {0};
+    float mean[3] = {0};
+    float variance[3] = {0};
+    float rms[3] = {0};
+
+    for (uint8_t a = 0; a < stream->axes; a++) {
+        const stats_deque_t *lo = &stream->min[a];
+        const stats_deque_t *hi = &stream->max[a];
+        double var = stream->m2[a] > 0 ? stream->m2[a] / stream->len : 0;
+        min[a] = value_of(stream, lo->seq[lo->head], a);
+        max[a] = value_of(stream, hi->seq[hi->head], a);
+        mean[a] = (float)stream->mean[a];
+        variance[a] = (float)var;
+        rms[a] = (float)sqrt(stream->mean[a] * stream->mean[a] + var);
+    }
+
+    emit(out, stream, TAG_STATS_MIN, min, time);
+    emit(out, stream, TAG_STATS_MAX, max, time);
+    emit(out, stream, TAG_STATS_MEAN, mean, time);
+    emit(out, stream, TAG_STATS_VARIANCE, variance, time);
+    emit(out, stream, TAG_STATS_RMS, rms, time);
+}
+
+/**
+ * Passes every sample through, adding the samples of summarized streams to their windows and publishing the statistics
+ * of each stream once its interval has passed.
+ * @param stage The statistics stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void stats_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    stats_stage_ctx_t *ctx = stage->ctx;
+
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        pipeline_emit(out, sample);
+
+        // Decimated copies are already summarized through the full rate samples they were made from
+        uint8_t rule = ctx->rule_of[sample->msg.type];
+        if (rule == STATS_MAX_RULES || sample->flags & SAMPLE_DECIMATED) continue;
+
+        stats_stream_t *stream = find_stream(ctx, sample, rule);
+        if (stream == NULL) {
+            if (!ctx->full) {
+                log_print(stderr, LOG_WARN, "Too many streams to keep statistics of, ignoring the rest");
+                ctx->full = true;
+            }
+            continue;
+        }
+
+        uint64_t window = ctx->config.rules[rule].window_ms * NS_PER_MS;
+        while (stream->len > 0 && stream->times[(stream->seq - stream->len) & WINDOW_MASK] + window <= sample->time) {
+            remove_oldest(stream);
+        }
+
+        float values[3] = {0};
+        stream->axes = sensor_get_values(&sample->msg, values);
+        add_newest(stream, sample->time, values);
+
+        if (sample->time >= stream->next_publish) {
+            publish(out, stream, sample->time);
+            uint64_t interval = ctx->config.interval_ms * NS_PER_MS;
+            stream->next_publish += interval;
+            if (stream->next_publish <= sample->time) stream->next_publish = sample->time + interval;
+        }
+    }
+}
+
+/**
+ * Sets up a stage which keeps rolling statistics of streams.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ * @return EOK if successful, EINVAL if the interval, a window or a tag is invalid.
+ */
+int stats_stage_init(stage_t *stage, stats_stage_ctx_t *ctx, const stats_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    memset(ctx->rule_of, STATS_MAX_RULES, sizeof(ctx->rule_of));
+    if (config->nrules > STATS_MAX_RULES || config->interval_ms == 0) return EINVAL;
+
+    for (uint8_t r = 0; r < config->nrules; r++) {
+        const stats_rule_t *rule = &config->rules[r];
+        if (rule->tag >= SENSOR_TAG_COUNT || rule->window_ms == 0) return EINVAL;
+        ctx->rule_of[rule->tag] = r;
+    }
+
+    stage->name = "stats";
+    stage->ctx = ctx;
+    stage->process = stats_stage_process;
+    return EOK;
+}
@@ -0,0 +1,302 @@
+/**
+ * @file vote_stage.c
+ * @brief Stage which combines the streams of redundant sensors into one consensus stream per tag.
+ *
+ * Stage which combines the streams of redundant sensors into one consensus stream per tag. The board ID can list
+ * several addresses for one kind of sensor, and each gets its own collector; the stage treats the sources of those
+ * collectors as a group. For each voted tag and ID of a group, the samples of every sensor wait in a queue, and a vote
+ * is held as soon as every sensor which is still publishing has a sample waiting. The votes line the sensors up in
+ * time: each takes part with its sample closest before the newest of their oldest samples, so sensors which publish in
+ * batches, like the IMU's FIFO, are compared at the same instant. A sensor which has been silent for `stale_ms` is left
+ * out, so a dead sensor only delays the votes briefly.
+ *
+ * Each vote emits the consensus, from the stage's source, and the spread between the sensors (`TAG_VOTE_SPREAD`: the
+ * largest minus the smallest value of each axis) with an ID holding the tag and the number of sensors which took part
+ * (`VOTE_ID`). The consensus is the median of each axis, or a weighted mean in which each sensor counts in inverse
+ * proportion to its recent mean squared distance from the median, so a noisy or drifting sensor loses its influence.
+ * It takes three sensors to single out a bad one: with two, both are always equally far from their median.
+ *
+ * The sensors' own samples carry on with SAMPLE_FULL_RATE set, so the recorder and the log file keep them but the other
+ * outputs and the later stages only get the consensus.
+ */
+#include "../logging-utils/logging.h"
+#include "stages.h"
+#include <errno.h>
+#include <string.h>
+
+/** The number of nanoseconds in a millisecond. */
+#define NS_PER_MS 1000000ULL
+
+/** How quickly each sensor's distance from the median follows changes, as the weight of the newest vote. */
+#define VOTE_SMOOTHING 0.05f
+
+/** The smallest mean squared distance from the median, which keeps a sensor's weight finite. */
+#define VOTE_MIN_VARIANCE 1e-6f
+
+/** The message queue priority of the spread between sensors. */
+#define SPREAD_PRIO 0
+
+/** The mask which turns a position into an index in a sensor's queue. */
+#define QUEUE_MASK (VOTE_QUEUE_LEN - 1)
+
+_Static_assert((VOTE_QUEUE_LEN & QUEUE_MASK) == 0, "The queue length must be a power of two");
+_Static_assert(VOTE_MAX_MEMBERS <= 8, "The sensors of a group must fit in a byte's bits");
+
+/**
+ * Finds the state of the stream of a group a sample belongs to, starting a new stream if needed.
+ * @param ctx The stage context.
+ * @param sample The sample.
+ * @param group The group of the sample's source.
+ * @return The state of the stream, or null if there is no room for another stream.
+ */
+static vote_stream_t *find_stream(vote_stage_ctx_t *ctx, const sample_t *sample, uint8_t group) {
+    uint8_t id = SENSOR_TAG_DATA[sample->msg.type].has_id ? sample->msg.id : 0;
+    bool taken = false;
+    for (uint8_t i = 0; i < ctx->nstreams; i++) {
+        vote_stream_t *stream = &ctx->streams[i];
+        if (stream->type != sample->msg.type || stream->id != id) continue;
+        if (stream->group == group) return stream;
+        taken = taken || !stream->passthrough;
+    }
+    if (ctx->nstreams == VOTE_MAX_STREAMS) return NULL;
+
+    vote_stream_t *stream = &ctx->streams[ctx->nstreams++];
+    memset(stream, 0, sizeof(*stream));
+    stream->group = group;
+    stream->type = sample->msg.type;
+    stream->id = id;
+
+    // The consensus of two groups would be indistinguishable, since both come from the stage's source
+    if (taken) {
+        log_print(stderr, LOG_WARN, "'%s' is already voted on for another group, passing it through",
+                  SENSOR_TAG_DATA[stream->type].name);
+        stream->passthrough = true;
+    }
+    return stream;
+}
+
+/**
+ * Adds a sample of a sensor to its queue, dropping the sensor's oldest waiting sample if the queue is full.
+ * @param stream The stream.
+ * @param m The index of the sensor in its group.
+ * @param sample The sample.
+ */
+static void enqueue(vote_stream_t *stream, uint8_t m, const sample_t *sample) {
+    if (stream->len[m] == VOTE_QUEUE_LEN) {
+        stream->head[m] = (uint8_t)((stream->head[m] + 1) & QUEUE_MASK);
+        stream->len[m]--;
+    }
+    uint8_t slot = (uint8_t)((stream->head[m] + stream->len[m]) & QUEUE_MASK);
+    stream->times[m][slot] = sample->time;
+    stream->axes = sensor_get_values(&sample->msg, stream->values[m][slot]);
+    stream->len[m]++;
+    stream->last[m] = sample->time;
+    stream->heard |= (uint8_t)(1U << m);
+}
+
+/**
+ * Finds the sensors of a stream which are still publishing, and empties the queues of the others.
+ * @param stream The stream.
+ * @param n The number of sensors in the stream's group.
+ * @param now The time of the newest sample.
+ * @param stale The time after which a silent sensor is left out, in ns.
+ * @return The sensors which are still publishing, one bit each.
+ */
+static uint8_t find_alive(vote_stream_t *stream, uint8_t n, uint64_t now, uint64_t stale) {
+    uint8_t alive = 0;
+    for (uint8_t m = 0; m < n; m++) {
+        if (stream->heard & (1U << m) && stream->last[m] + stale > now) {
+            alive |= (uint8_t)(1U << m);
+        } else {
+            stream->len[m] = 0;
+        }
+    }
+    return alive;
+}
+
+/**
+ * Combines one waiting sample of every sensor which is still publishing, and emits the consensus and the spread between
+ * them. Every such sensor must have a sample waiting.
+ * @param stage The voting stage.
+ * @param stream The stream to vote on.
+ * @param alive The sensors which are still publishing, one bit each.
+ * @param prio The message queue priority of the consensus.
+ * @param out The output of the stage.
+ */
+static void vote(stage_t *stage, vote_stream_t *stream, uint8_t alive, uint8_t prio, stage_out_t *out) {
+    vote_stage_ctx_t *ctx = stage->ctx;
+    uint8_t members[VOTE_MAX_MEMBERS];
+    uint8_t slots[VOTE_MAX_MEMBERS];
+    uint8_t n = 0;
+    uint64_t time = 0;
+    for (uint8_t m = 0; m < ctx->config.groups[stream->group].n; m++) {
+        if (!(alive & (1U << m))) continue;
+        members[n++] = m;
+        uint64_t oldest = stream->times[m][stream->head[m]];
+        if (oldest > time) time = oldest;
+    }
+
+    // Skip the samples which are followed by another one no later than the vote
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t m = members[i];
+        while (stream->len[m] > 1 && stream->times[m][(stream->head[m] + 1) & QUEUE_MASK] <= time) {
+            stream->head[m] = (uint8_t)((stream->head[m] + 1) & QUEUE_MASK);
+            stream->len[m]--;
+        }
+        slots[i] = stream->head[m];
+    }
+
+    float result[3] = {0};
+    float spread[3] = {0};
+    for (uint8_t a = 0; a < stream->axes; a++) {
+        float sorted[VOTE_MAX_MEMBERS] = {0};
+        for (uint8_t i = 0; i < n; i++) {
+            float value = stream->values[members[i]][slots[i]][a];
+            uint8_t j = i;
+            for (; j > 0 && sorted[j - 1] > value; j--) sorted[j] = sorted[j - 1];
+            sorted[j] = value;
+        }
+        float median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+        spread[a] = sorted[n - 1] - sorted[0];
+
+        float sum = 0;
+        float weights = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            float value = stream->values[members[i]][slots[i]][a];
+            float *variance = &stream->variance[members[i]][a];
+            *variance += ((value - median) * (value - median) - *variance) * VOTE_SMOOTHING;
+            float weight = 1 / (*variance + VOTE_MIN_VARIANCE);
+            sum += weight * value;
+            weights += weight;
+        }
+        result[a] = ctx->config.method == VOTE_MEDIAN ? median : sum / weights;
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        uint8_t m = members[i];
+        stream->head[m] = (uint8_t)((stream->head[m] + 1) & QUEUE_MASK);
+        stream->len[m]--;
+    }
+
+    sample_t consensus = {.time = time, .source = stage->source, .prio = prio};
+    consensus.msg.type = stream->type;
+    consensus.msg.id = stream->id;
+    if (stream->axes == 1) {
+        consensus.msg.data.FLOAT = result[0];
+    } else {
+        consensus.msg.data.VEC3D = (vec3d_t){.x = result[0], .y = result[1], .z = result[2]};
+    }
+    pipeline_emit(out, &consensus);
+
+    sample_t disagreement = {.time = time, .source = stage->source, .prio = SPREAD_PRIO};
+    disagreement.msg.type = TAG_VOTE_SPREAD;
+    disagreement.msg.id = VOTE_ID(stream->type, n);
+    disagreement.msg.data.VEC3D = (vec3d_t){.x = spread[0], .y = spread[1], .z = spread[2]};
+    pipeline_emit(out, &disagreement);
+}
+
+/**
+ * Passes every sample through, marking those of grouped sensors as raw copies, and votes on each voted stream as soon
+ * as every sensor which is still publishing has a sample waiting.
+ * @param stage The voting stage.
+ * @param samples The samples to process.
+ * @param n The number of samples to process.
+ * @param out The output of the stage.
+ */
+static void vote_stage_process(stage_t *stage, const sample_t *samples, size_t n, stage_out_t *out) {
+    vote_stage_ctx_t *ctx = stage->ctx;
+    uint64_t stale = ctx->config.stale_ms * NS_PER_MS;
+
+    for (size_t i = 0; i < n; i++) {
+        const sample_t *sample = &samples[i];
+        uint8_t group = ctx->group_of[sample->source];
+        if (group == VOTE_MAX_GROUPS || !ctx->voted[sample->msg.type] || sample->flags != 0) {
+            pipeline_emit(out, sample);
+            continue;
+        }
+
+        vote_stream_t *stream = find_stream(ctx, sample, group);
+        if (stream == NULL || stream->passthrough) {
+            if (stream == NULL && !ctx->full) {
+                log_print(stderr, LOG_WARN, "Too many streams to vote on, passing the rest through");
+                ctx->full = true;
+            }
+            pipeline_emit(out, sample);
+            continue;
+        }
+
+        sample_t raw = *sample;
+        raw.flags = SAMPLE_FULL_RATE;
+        pipeline_emit(out, &raw);
+        enqueue(stream, ctx->member_of[sample->source], sample);
+
+        uint8_t alive = find_alive(stream, ctx->config.groups[group].n, sample->time, stale);
+        for (;;) {
+            bool ready = true;
+            for (uint8_t m = 0; m < ctx->config.groups[group].n; m++) {
+                if (alive & (1U << m) && stream->len[m] == 0) ready = false;
+            }
+            if (!ready) break;
+            vote(stage, stream, alive, sample->prio, out);
+        }
+    }
+}
+
+/**
+ * Adds a group of redundant sensors to vote on. Must be called before any of the sensors publish, but may be called
+ * after the pipeline has started.
+ * @param ctx The stage context.
+ * @param group The sources of the sensors.
+ * @return EOK if successful, ENOSPC if there are already VOTE_MAX_GROUPS groups, EINVAL if the group has fewer than two
+ * or more than VOTE_MAX_MEMBERS sensors, or if one of them is already in a group.
+ */
+int vote_stage_add_group(vote_stage_ctx_t *ctx, const vote_group_t *group) {
+    if (ctx->config.ngroups == VOTE_MAX_GROUPS) return ENOSPC;
+    if (group->n < 2 || group->n > VOTE_MAX_MEMBERS) return EINVAL;
+    for (uint8_t m = 0; m < group->n; m++) {
+        if (ctx->group_of[group->sources[m]] != VOTE_MAX_GROUPS) return EINVAL;
+        for (uint8_t k = 0; k < m; k++) {
+            if (group->sources[k] == group->sources[m]) return EINVAL;
+        }
+    }
+
+    uint8_t g = ctx->config.ngroups;
+    ctx->config.groups[g] = *group;
+    for (uint8_t m = 0; m < group->n; m++) {
+        ctx->member_of[group->sources[m]] = m;
+        ctx->group_of[group->sources[m]] = g;
+    }
+    ctx->config.ngroups++;
+    return EOK;
+}
+
+/**
+ * Sets up a stage which votes on the streams of redundant sensors.
+ * @param stage The stage to set up.
+ * @param ctx Storage for the stage's context.
+ * @param config How the stage is set up.
+ * @return EOK if successful, EINVAL if a tag, a group or the stale time is invalid.
+ */
+int vote_stage_init(stage_t *stage, vote_stage_ctx_t *ctx, const vote_config_t *config) {
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->config = *config;
+    ctx->config.ngroups = 0;
+    memset(ctx->group_of, VOTE_MAX_GROUPS, sizeof(ctx->group_of));
+    if (config->ntags > VOTE_MAX_TAGS || config->ngroups > VOTE_MAX_GROUPS || config->stale_ms == 0) return EINVAL;
+
+    for (uint8_t t = 0; t < config->ntags; t++) {
+        uint8_t tag = config->tags[t];
+        if (tag >= SENSOR_TAG_COUNT) return EINVAL;
+        if (SENSOR_TAG_DATA[tag].dtype != TYPE_FLOAT && SENSOR_TAG_DATA[tag].dtype != TYPE_VEC3D) return EINVAL;
+        ctx->voted[tag] = true;
+    }
+    for (uint8_t g = 0; g < config->ngroups; g++) {
+        int err = vote_stage_add_group(ctx, &config->groups[g]);
+        if (err != EOK) return err;
+    }
+
+    stage->name = "vote";
+    stage->ctx = ctx;
+    stage->process = vote_stage_process;
+    return EOK;
+}